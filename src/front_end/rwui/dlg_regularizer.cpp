@@ -10,10 +10,23 @@ DlgRegularizer::DlgRegularizer(wxWindow* parent, const wxString& Title)
 	: wxDialog(parent,0,Title)
 {
 	this->_decision = wxID_CANCEL;
+	this->_noise = 0;
 	math_la::math_lac::txt::Params p;
 	p.Load_From_File("files\\reg.conf");
 
 	wxToolBar* wtb = new wxToolBar(this, 0, wxDefaultPosition, wxSize(100, 38));
+	wxArrayString criteria;
+	criteria.Add("Manual");
+	criteria.Add("L curve");
+	criteria.Add("S curve");
+	criteria.Add("Largest of L and S curves");
+	criteria.Add("Mean of L and S curves");
+	criteria.Add("Generalized cross validation");
+	criteria.Add("Largest L curve curvature");
+	criteria.Add("Discrepancy principle");
+	this->_criterionChoice = new wxChoice(wtb, wxID_ANY, wxDefaultPosition, wxDefaultSize, criteria);
+	wtb->AddControl(this->_criterionChoice, "Criterion");
+	wtb->Realize();
 
 	this->_OKBtnPressed = false;
 	this->_compensate = false;
@@ -32,6 +45,12 @@ DlgRegularizer::DlgRegularizer(wxWindow* parent, const wxString& Title)
 	{
 		this->_compensate = true;
 	}
+	if ((this->_criterionIndex < 0) || (this->_criterionIndex >= (int)criteria.GetCount()))
+	{
+		this->_criterionIndex = 0;
+	}
+	this->_criterionChoice->SetSelection(this->_criterionIndex);
+	this->_criterionChoice->Bind(wxEVT_CHOICE, &DlgRegularizer::On_Criterion, this);
 	
 	wxBoxSizer* msizer = new wxBoxSizer(wxVERTICAL);
 	msizer->Add(wtb, wxSizerFlags().Expand().Proportion(1));
@@ -161,29 +180,63 @@ void DlgRegularizer::Set_Simulation(const rw::PlugPersistent& sim)
 	}
 	wdlg.Update(5, "Updating lambda space discretization");
 	wdlg.Update(6, "Choosing regularizer");
-	int sel = 0;
-	if (this->_criterionIndex == 1)
+	this->_noise = sim.Noise_Deviation();
+	int sel = this->Criterion_Selection(this->_criterionIndex);
+	this->_regSlider->SetValue(sel);
+	this->Select_Index(sel);
+}
+
+int DlgRegularizer::Criterion_Selection(int criterion)
+{
+	int sel = this->_regSlider->GetValue();
+	if (criterion == 1)
 	{
 		sel = this->Get_L_Selection();
 	}
-	if (this->_criterionIndex == 2)
+	if (criterion == 2)
 	{
 		sel = this->Get_Sigma_Selection();
 	}
-	if (this->_criterionIndex == 3)
+	if (criterion == 3)
 	{
 		int sel1 = this->Get_L_Selection();
 		int sel2 = this->Get_Sigma_Selection();
 		sel = std::max(sel1, sel2);
 	}
-	if (this->_criterionIndex == 4)
+	if (criterion == 4)
 	{
 		int sel1 = this->Get_L_Selection();
 		int sel2 = this->Get_Sigma_Selection();
 		sel = (sel1 + sel2) / 2;
 	}
-	this->_regSlider->SetValue(sel);
-	this->Select_Index(sel);
+	if (criterion == 5)
+	{
+		sel = this->_exponentialFitting.Regularizer_Index(rw::ExponentialFitting::GCV_Criterion);
+	}
+	if (criterion == 6)
+	{
+		sel = this->_exponentialFitting.Regularizer_Index(rw::ExponentialFitting::L_Curve_Criterion);
+	}
+	if (criterion == 7)
+	{
+		/**
+		* Without noise in the decay there is no discrepancy to match, and GCV is used instead
+		*/
+		sel = this->_exponentialFitting.Regularizer_Index(rw::ExponentialFitting::Discrepancy_Criterion, this->_noise);
+	}
+	return(sel);
+}
+
+void DlgRegularizer::On_Criterion(wxCommandEvent& evt)
+{
+	this->_criterionIndex = this->_criterionChoice->GetSelection();
+	if (this->_fx.Size() > 0)
+	{
+		int sel = this->Criterion_Selection(this->_criterionIndex);
+		this->_regSlider->SetValue(sel);
+		this->Select_Index(sel);
+		this->Refresh();
+	}
 }
 
 int DlgRegularizer::Get_L_Selection()
@@ -16,6 +16,7 @@ private:
 	WxPlotter* _rightPlotter;
 	wxSlider* _regSlider;
 	wxStaticText* _textRegularizer;
+	wxChoice* _criterionChoice;
 	
 	math_la::math_lac::full::Vector _lambdas;
 	math_la::math_lac::full::Vector _curvatureVector;
@@ -40,9 +41,12 @@ private:
 	rw::ExponentialFitting _exponentialFitting;
 	scalar _regularizer;
 	int _decision;
+	scalar _noise;
 
 	int Get_L_Selection();
 	int Get_Sigma_Selection();
+	int Criterion_Selection(int criterion);
+	void On_Criterion(wxCommandEvent& evt);
 	void Select_Index(int id);
 	void On_Scroll(wxScrollEvent& evt);
 	void On_Ok_Button(wxCommandEvent& evt);
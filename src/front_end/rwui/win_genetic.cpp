@@ -435,12 +435,14 @@ void WindowGenetic::Add_Button_Tools(wxRibbonPage* ribbonPage, wxMenuBar* menuba
 	bmp = wxBitmap(img);
 	btnBar->AddTool(wxID_STOP, bmp, "Stop evolution");
 	menu->Append(wxID_STOP, "Stop evolution")->SetBitmap(bmp);
+	menu->Append(wxID_BENCH_PROFILE_SIM, "Measure the serial and parallel steps of the profile simulator");
 
 	this->Set_Optimization_Options_Grid();	
 	btnBar->Bind(wxEVT_RIBBONTOOLBAR_CLICKED, &WindowGenetic::Start, this, wxID_APPLY);
 	menu->Bind(wxEVT_MENU, &WindowGenetic::Start, this, wxID_APPLY);
 	btnBar->Bind(wxEVT_RIBBONTOOLBAR_CLICKED, &WindowGenetic::Stop, this, wxID_STOP);
 	menu->Bind(wxEVT_MENU, &WindowGenetic::Stop, this, wxID_STOP);
+	menu->Bind(wxEVT_MENU, &WindowGenetic::Benchmark_Profile_Simulator, this, wxID_BENCH_PROFILE_SIM);
 	this->_pgr->Bind(wxEVT_PG_CHANGED, &WindowGenetic::Update_Grid, this);
 }
 
@@ -831,9 +833,6 @@ void WindowGenetic::Start(wxCommandEvent& evt)
 	if (this->_sim)
 	{
 		this->Update_Optimizer();
-		this->_optimizer->Set_Mapping_Simulation(this->_sim);
-		this->_optimizer->Set_Formation(this->_formation, false);
-		this->_optimizer->Set_Event_Handler(this->_eventHandler);
 		this->_optimizer->Start();
 	}
 	else
@@ -850,6 +849,30 @@ void WindowGenetic::Stop(wxCommandEvent& evt)
 	this->_eventHandler->_prgdlg->Pulse("Executing....");
 }
 
+void WindowGenetic::Benchmark_Profile_Simulator(wxCommandEvent& evt)
+{
+	if (this->_sim)
+	{
+		wxPGProperty* pp = this->_pgr->GetPropertyByName("sim.nprt");
+		int np = pp->GetValue().GetInteger();
+		wxGenericProgressDialog prgdlg("Profile simulator", "Measuring the simulated random walk");
+		prgdlg.Show();
+		prgdlg.Pulse("Stepping the particles");
+		scalar serial = 0;
+		scalar parallel = 0;
+		this->_optimizer->Set_Mapping_Simulation(this->_sim);
+		this->_optimizer->Benchmark_Simulator(np, serial, parallel);
+		wxMessageDialog mgdlg((wxWindow*)this, wxString("Particles: ") << np << wxString("\nSerial particle-steps per second: ") << serial
+			<< wxString("\nParallel particle-steps per second: ") << parallel, wxString("Profile simulator"), wxOK);
+		mgdlg.ShowModal();
+	}
+	else
+	{
+		wxMessageDialog mgdlg((wxWindow*)this, wxString("There is no mapping simulation to build the collision profile"), wxString("No simulation"), wxOK);
+		mgdlg.ShowModal();
+	}
+}
+
 void WindowGenetic::Set_Simulation(rw::PlugPersistent* sim, rw::Plug* formation)
 {
 	this->_sim = sim;
@@ -119,6 +119,7 @@ public:
 	void Set_Optimization_Options_Grid();
 	void Start(wxCommandEvent& evt);
 	void Stop(wxCommandEvent& evt);
+	void Benchmark_Profile_Simulator(wxCommandEvent& evt);
 	void Set_Simulation(rw::PlugPersistent* sim, rw::Plug* formation);
 	void Set_Name(const wxString& name);
 	void Set_Result_Directory(const wxString& dir);
@@ -161,6 +161,7 @@ void WindowImage::Add_Button_Tools(wxRibbonPage* ribbonPage, wxMenuBar* menubar)
 	menu->AppendSeparator();
 	btnBar->AddTool(wxID_BOLD,  bmp, "Apply an erosion and a dilation to denoise the image");
 	menu->Append(wxID_BOLD, "Apply an erosion and a dilation to denoise the image")->SetBitmap(bmp);
+	menu->Append(wxID_CLEAR, "Fill the pores isolated from the border, keeping the effective porosity");
 
 	img.LoadFile("icons/balloons-gray.png");
 	img.Rescale(bmpsize, bmpsize);
@@ -202,6 +203,7 @@ void WindowImage::Add_Button_Tools(wxRibbonPage* ribbonPage, wxMenuBar* menubar)
 	menu->Bind(wxEVT_MENU, &WindowImage::Cluster_Pores, this, wxID_FILE3);
 	btnBar->Bind(wxEVT_RIBBONTOOLBAR_CLICKED, &WindowImage::Denoise, this, wxID_BOLD);
 	menu->Bind(wxEVT_MENU, &WindowImage::Denoise, this, wxID_BOLD);
+	menu->Bind(wxEVT_MENU, &WindowImage::Remove_Isolated_Pores, this, wxID_CLEAR);
 	menubar->Append(menu, "Image processing tools");
 }
 
@@ -612,6 +614,24 @@ void WindowImage::Denoise(wxCommandEvent& evt)
 	}
 }
 
+void WindowImage::Remove_Isolated_Pores(wxCommandEvent& evt)
+{
+	if (this->_binImg.Depth() > 0)
+	{
+		wxGenericProgressDialog prgdlg("Effective porosity", "Filling the pores isolated from the border");
+		prgdlg.Show();
+		prgdlg.Pulse("Filling the pores isolated from the border");
+		int removed = this->_binImg.Remove_Isolated_Pores();
+		this->Show_Images(this->_sliderImg->GetValue());
+		wxMessageDialog mgdlg((wxWindow*)this, wxString("Isolated pore voxels filled: ") << removed, wxString("Effective porosity"), wxOK);
+		mgdlg.ShowModal();
+	}
+	else
+	{
+		wxMessageDialog mgdlg((wxWindow*)this, wxString("There is no image to filter"), wxString("No image"), wxOK);
+		mgdlg.ShowModal();
+	}
+}
 
 void WindowImage::Open_Spheres()
 {
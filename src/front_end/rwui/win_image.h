@@ -69,6 +69,7 @@ public:
 	void Save_Image(wxCommandEvent& evt);
 	void Load_Binary_Image(const wxString& file_name, wxGenericProgressDialog* pgdlg);
 	void Denoise(wxCommandEvent& evt);
+	void Remove_Isolated_Pores(wxCommandEvent& evt);
 	void Add_Button_Tools(wxRibbonPage* ribbonPage, wxMenuBar* menubar);
 	void Hide_Button_Panel();
 	void Show_Button_Panel();
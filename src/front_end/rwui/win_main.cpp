@@ -7,7 +7,6 @@
 #include <wx/stopwatch.h>
 #include <wx/gauge.h>
 #include <wx/choicdlg.h>
-#include <amp.h>
 #include "win_main.h"
 #include "win_sample.h"
 #include "win_image.h"
@@ -293,7 +292,7 @@ void WindowMain::Build_3D_Model(wxCommandEvent& evt)
 			create_dialog = true;
 		}
 		this->_winSample->Build_3D_Model(img, this->_dlg);
-		this->_winRev->Set_Image_Pointer(&img);
+		this->_winRev->Set_Image_Handle(this->_winSample->Image_Handle());
 		if (create_dialog)
 		{
 			this->_dlg->Close();
@@ -50,6 +50,12 @@ using std::map;
 #define wxID_EXEC_RTF_INV wxID_HIGHEST + 30
 #define wxID_PSD wxID_HIGHEST + 31
 #define wxID_MORPH_PSD wxID_HIGHEST + 32
+#define wxID_BENCH_WALK wxID_HIGHEST + 34
+#define wxID_CHECK_FP wxID_HIGHEST + 35
+#define wxID_BENCH_PROFILE_SIM wxID_HIGHEST + 42
+#define wxID_SWEEP_RHO wxID_HIGHEST + 43
+#define wxID_BENCH_INVERSION wxID_HIGHEST + 44
+#define wxID_BENCH_BATCH wxID_HIGHEST + 45
 
 class WindowImage;
 
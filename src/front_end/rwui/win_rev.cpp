@@ -10,7 +10,6 @@ WindowRev::WindowRev(wxWindow* parent) :
 	this->_blueLaplace = 0;
 	this->_windowMain = (WindowMain*)parent;
 	this->_prgdlg = 0;
-	this->_imgPtr = 0;
 	this->_rev = 0;
 	this->_mgr = new wxAuiManager(this);
 	this->_mgr->SetDockSizeConstraint(0.3, 0.36);
@@ -46,7 +45,7 @@ WindowRev::WindowRev(wxWindow* parent) :
 	this->_propertyGrid->Append(new wxIntProperty("T2min (log10) (s)", "T2MIN", -4));
 	this->_propertyGrid->Append(new wxIntProperty("T2max (log10) (s)", "T2MAX", 1));
 	this->_propertyGrid->Append(new wxFloatProperty("Relaxivity factor (Delta)", "DELTA", 0.90));
-	this->_propertyGrid->Append(new wxFloatProperty("Regularizer", "REG", 1));
+	this->_propertyGrid->Append(new wxFloatProperty("Regularizer (negative: GCV)", "REG", 1));
 	this->_propertyGrid->Append(new wxIntProperty("Number of bins", "BINS", 128));
 	this->_propertyGrid->Append(new wxFloatProperty("Time step", "TSTEP", 5e-5));
 	this->_propertyGrid->Append(new wxFloatProperty("Saturation factor", "SAT", 0.001f));
@@ -416,7 +415,7 @@ void WindowRev::On_Walk_Event(int k ,scalar percentage)
 
 void WindowRev::Plot_Convergence()
 {
-	int msize = std::min(this->_imgPtr->Width(), std::min(this->_imgPtr->Height(),this->_imgPtr->Depth()));
+	int msize = std::min(this->_imgHandle->Width(), std::min(this->_imgHandle->Height(),this->_imgHandle->Depth()));
 	this->_plotterA->Erase_All_Curves();
 	this->_plotterA->Set_Title("Section convergency");
 	this->_plotterA->Set_X_Title("Section size (Hundreds of voxels)");
@@ -460,7 +459,7 @@ void WindowRev::Display_Sections()
 
 void WindowRev::Porosity(wxCommandEvent& evt)
 {
-	if (this->_imgPtr)
+	if (this->_imgHandle)
 	{
 		this->_propertyGrid->CommitChangesFromEditor();
 		wxPGProperty* pp = 0;
@@ -516,11 +515,11 @@ void WindowRev::Porosity(wxCommandEvent& evt)
 	}
 }
 
-void WindowRev::Set_Image_Pointer(const rw::BinaryImage* imgptr)
+void WindowRev::Set_Image_Handle(const rw::BinaryImageHandle& img)
 {
-	this->_imgPtr = imgptr;
+	this->_imgHandle = img;
 	this->_rev = new rw::Rev();
-	this->_rev->Set_Image(*imgptr);
+	this->_rev->Set_Image(img);
 }
 
 
@@ -29,7 +29,7 @@ private:
 	scalar _maxPorosity;
 	scalar _minPorosity;
 	vector<float> _sectionSizes;
-	const rw::BinaryImage* _imgPtr;
+	rw::BinaryImageHandle _imgHandle;
 	rw::Rev* _rev;
 
 	math_la::math_lac::full::Vector _maxLaplace;
@@ -51,7 +51,7 @@ public:
 	void Add_Button_Tools(wxRibbonPage* ribbonPage, wxMenuBar* menubar);
 	void Porosity(wxCommandEvent& evt);
 	void Simulate_Pore_Shape(wxCommandEvent& evt);
-	void Set_Image_Pointer(const rw::BinaryImage* imgptr);
+	void Set_Image_Handle(const rw::BinaryImageHandle& img);
 	void Draw_Laplace_Area();
 	void Change_Grid_Value(wxPropertyGridEvent& evt);
 
@@ -8,6 +8,8 @@
 #include "front_end/wx_image_adapter.h"
 #include "front_end/persistent_ui/persistent_ui.h"
 #include "front_end/wx_rgbcolor.h"
+#include "rw/rw_cpu_degrade_impl.h"
+#include "rw/rw_first_passage_impl.h"
 
 wxDEFINE_EVENT(wxWALK_EVENT, wxCommandEvent);
 wxDEFINE_EVENT(wxWALK_END_EVENT, wxCommandEvent);
@@ -179,6 +181,11 @@ void WindowSample::Add_Button_Tools(wxRibbonPage* ribbonPage, wxMenuBar* menubar
 	bmp = wxBitmap(img);
 	btnBar->AddTool(wxID_START, bmp, "Start random walk simulation");
 	menu->Append(wxID_START,"Start random walk simulation")->SetBitmap(bmp);
+	menu->Append(wxID_BENCH_WALK, "Measure the throughput of the CPU random walk kernels");
+	menu->Append(wxID_CHECK_FP, "Check the first-passage walk against the lattice walk");
+	menu->Append(wxID_SWEEP_RHO, "Fit a constant surface relaxivity to the current decay");
+	menu->Append(wxID_BENCH_INVERSION, "Measure the NNLS and BRD inversions of the current simulation");
+	menu->Append(wxID_BENCH_BATCH, "Measure the batch inversion of the current simulation");
 	btnBar->AddSeparator();
 	menu->AppendSeparator();
 	img.LoadFile("icons/balance.png");
@@ -229,6 +236,11 @@ void WindowSample::Add_Button_Tools(wxRibbonPage* ribbonPage, wxMenuBar* menubar
 	menu->Bind(wxEVT_MENU, &WindowSample::Build_3D_Sample, this, wxID_PLACE);
 	btnBar->Bind(wxEVT_RIBBONTOOLBAR_CLICKED, &WindowSample::Walk, this, wxID_START);
 	menu->Bind(wxEVT_MENU, &WindowSample::Walk, this, wxID_START);
+	menu->Bind(wxEVT_MENU, &WindowSample::Benchmark_Walk, this, wxID_BENCH_WALK);
+	menu->Bind(wxEVT_MENU, &WindowSample::Check_First_Passage, this, wxID_CHECK_FP);
+	menu->Bind(wxEVT_MENU, &WindowSample::Sweep_Relaxivity, this, wxID_SWEEP_RHO);
+	menu->Bind(wxEVT_MENU, &WindowSample::Benchmark_Inversion, this, wxID_BENCH_INVERSION);
+	menu->Bind(wxEVT_MENU, &WindowSample::Benchmark_Batch_Inversion, this, wxID_BENCH_BATCH);
 	btnBar->Bind(wxEVT_RIBBONTOOLBAR_CLICKED, &WindowSample::Save_Simulation, this, wxID_SAVE);
 	menu->Bind(wxEVT_MENU, &WindowSample::Save_Simulation, this, wxID_SAVE);
 	btnBar->Bind(wxEVT_RIBBONTOOLBAR_CLICKED, &WindowSample::Show_Regularizer_Dialog, this, wxID_LAPLACE);
@@ -371,6 +383,11 @@ WindowSample::WindowSample(wxWindow* parent) :
 
 	pg->Append(new wxIntProperty("Number of walkers","NW",1280));
 	pg->Append(new wxBoolProperty("GPU acceleration", "GPU", false));
+	wxPGChoices arrWM;
+	arrWM.Add("Lattice steps");
+	arrWM.Add("First-passage sphere jumps");
+	pg->Append(new wxEnumProperty("Walk rule (CPU)", "WM", arrWM, WALK_LATTICE));
+	pg->Append(new wxIntProperty("Hit histogram interval (steps)", "HHI", 0));
 
 	pg->Append(new wxPropertyCategory("Post-processing parameters"));
 	pg->Append(new wxFloatProperty("Noise amplitude", "NSA", 0.01f));
@@ -382,6 +399,11 @@ WindowSample::WindowSample(wxWindow* parent) :
 	pg->Append(new wxIntProperty("Number of bins ", "TBINS", 128));
 	pg->Append(new wxIntProperty("Decay compression (number of samples)", "CPRS", 1024));
 	pg->Append(new wxFloatProperty("Regularizer", "REG", 0.1));
+	wxPGChoices arrINV;
+	arrINV.Add("Non negative least squares");
+	arrINV.Add("Butler-Reeds-Dawson (compressed kernel)");
+	pg->Append(new wxEnumProperty("Inversion method", "INV", arrINV, rw::ExponentialFitting::NNLS_Inversion));
+	pg->Append(new wxIntProperty("Kernel rank (BRD)", "INVR", 32));
 
 	int s_width;
 	int s_height;
@@ -501,7 +523,7 @@ void WindowSample::View_Walkers(wxCommandEvent& evt)
 			if ((this->_currentSimulation) && (this->_viewWalkers) && (this->_imgPtr))
 			{
 				this->_formation = new rw::Plug();
-				this->_formation->Set_Image_Formation(*this->_imgPtr);
+				this->_formation->Set_Image_Formation(this->_imgHandle);
 				this->_currentSimulation->Fill_Plug_Paremeters(*this->_formation);
 			}
 		}
@@ -703,6 +725,10 @@ void WindowSample::Update_Sim_Parameters(const rw::PlugPersistent& sim)
 	pp->SetValue((int)sim.Number_Of_Walkers());
 	pp = this->_pgr->GetPropertyByName("GPU");
 	pp->SetValue((bool)sim.SimulationParams().Get_Bool(GPU_P));
+	pp = this->_pgr->GetPropertyByName("WM");
+	pp->SetValue((int)sim.Walk_Mode());
+	pp = this->_pgr->GetPropertyByName("HHI");
+	pp->SetValue((int)sim.Hit_Histogram_Interval());
 	pp = this->_pgr->GetPropertyByName("NSA");
 	pp->SetValue(sim.Noise_Distortion());
 	pp = this->_pgr->GetPropertyByName("SNR");
@@ -717,6 +743,10 @@ void WindowSample::Update_Sim_Parameters(const rw::PlugPersistent& sim)
 	pp->SetValue(sim.Decay_Reduction());
 	pp = this->_pgr->GetPropertyByName("REG");
 	pp->SetValue(sim.Regularizer());
+	pp = this->_pgr->GetPropertyByName("INV");
+	pp->SetValue((int)sim.Laplace_Inversion());
+	pp = this->_pgr->GetPropertyByName("INVR");
+	pp->SetValue((int)sim.Laplace_Inversion_Rank());
 	pp = this->_pgr->GetPropertyByName("STOP.MTH");
 	pp->SetValue(sim.Magnetization_Threshold());
 	pp = this->_pgr->GetPropertyByName("STOP.MT");
@@ -755,7 +785,8 @@ void WindowSample::Change_Grid_Value(wxPropertyGridEvent& evt)
 	}
 	if (pp->GetName() == wxString("NSA") || (pp->GetName() == wxString("Tmin"))
 		||(pp->GetName() == wxString("Tmax"))||(pp->GetName() == wxString("CPRS"))
-		||(pp->GetName() == wxString("TBINS"))||(pp->GetName() == wxString("REG")))
+		||(pp->GetName() == wxString("TBINS"))||(pp->GetName() == wxString("REG"))
+		||(pp->GetName() == wxString("INV"))||(pp->GetName() == wxString("INVR")))
 	{
 		if (this->_currentSimulation)
 		{
@@ -921,6 +952,11 @@ const rw::PlugPersistent& WindowSample::Current_Simulation() const
 	return(*this->_currentSimulation);
 }
 
+const rw::BinaryImageHandle& WindowSample::Image_Handle() const
+{
+	return(this->_imgHandle);
+}
+
 void WindowSample::Show_Regularizer_Dialog(wxCommandEvent& evt)
 {
 	if ((this->_currentSimulation))
@@ -1278,7 +1314,8 @@ void WindowSample::Build_3D_Model(const rw::BinaryImage& img, wxGenericProgressD
 	pgdlg->Refresh();
 	this->_windowVolume->Volume_Panel().Set_Update_Event(this->_updVol);
 	this->_windowVolume->Volume_Panel().Load_3D_Texture();
-	this->_imgPtr = &img;
+	this->_imgHandle = std::make_shared<const rw::BinaryImage>(img);
+	this->_imgPtr = this->_imgHandle.get();
 	this->_parentMain->Set_Image_Pointer(this->_imgPtr);
 	if (this->_viewWalkers)
 	{
@@ -1384,7 +1421,7 @@ void WindowSample::Update_Walkers(bool updatePos)
 	this->_windowVolume->Volume_Panel().Unlock_Refresh();
 }
 
-void WindowSample::Preprocess_Simulation_Parameters(const rw::BinaryImage& img)
+void WindowSample::Preprocess_Simulation_Parameters(const rw::BinaryImageHandle& img)
 {
 	if ((this->_currentSimulation)&&(this->_currentSimModified)&&(this->_simulationSaved))
 	{
@@ -1518,6 +1555,19 @@ void WindowSample::Preprocess_Simulation_Parameters(const rw::BinaryImage& img)
 	{
 		params.Set_Bool(T2, true);
 	}
+	pv = this->_pgr->GetPropertyByName("WM");
+	this->_currentSimulation->Set_Walk_Mode((uint)pv->GetValue().GetInteger());
+	pv = this->_pgr->GetPropertyByName("HHI");
+	if (!this->_currentSimulation->Set_Hit_Histogram_Interval((uint)std::max((int)pv->GetValue().GetInteger(), 0)))
+	{
+		wxMessageDialog dlg(this, wxString("The walls absorb the walkers or the magnetization has a floor: ")
+			<< wxString("the walk does not record hit histograms"), "Hit histograms", wxOK | wxICON_WARNING);
+		dlg.ShowModal();
+	}
+	rw::SimulationParams walk_params(this->_formation->Simulation_Parameters());
+	walk_params.Set_Value(WALK_MODE, this->_currentSimulation->Walk_Mode());
+	walk_params.Set_Value(HIT_HISTOGRAM_INTERVAL, this->_currentSimulation->Hit_Histogram_Interval());
+	this->_formation->Set_Simulation_Parameter(walk_params);
 	this->_formation->Set_Internal_Gradient(this->_currentSimulation->Gradient());
 	this->_formation->Set_Image_Formation(img);
 	this->_formation->Set_On_Walk_Event(this->_updWalk);
@@ -1547,13 +1597,18 @@ void WindowSample::Postprocess_Simulation_Parameters()
 	scalar regularizer = pv->GetValue().GetDouble();
 	this->_currentSimulation->Set_Laplace_Parameters(tmin, tmax, resolution, regularizer);
 	this->_currentSimulation->Set_Decay_Reduction(decay_compression);
+	pv = this->_pgr->GetPropertyByName("INV");
+	uint inversion = pv->GetValue().GetInteger();
+	pv = this->_pgr->GetPropertyByName("INVR");
+	uint rank = std::max((int)pv->GetValue().GetInteger(), 1);
+	this->_currentSimulation->Set_Laplace_Inversion(inversion, rank);
 }
 
 void WindowSample::Walk(wxCommandEvent& event)
 {
 	if (this->_imgPtr)
 	{
-		this->Preprocess_Simulation_Parameters(*this->_imgPtr);
+		this->Preprocess_Simulation_Parameters(this->_imgHandle);
 	}
 	if ((this->_formation)&&(this->_imgPtr))
 	{
@@ -1563,7 +1618,7 @@ void WindowSample::Walk(wxCommandEvent& event)
 		this->_plotterA->Set_Title("NMR Decay");
 		this->_plotterA->Erase_All_Curves();
 		this->_plotterA->Add_Curves(1);
-		this->Preprocess_Simulation_Parameters(*this->_imgPtr);
+		this->Preprocess_Simulation_Parameters(this->_imgHandle);
 		this->_currentSimulation->Set_Sim_Color(Rw_Color(this->_plotterA->Curve_Color(0)));
 		this->_formation->Place_Walking_Particles();
 		bool gpu = this->_pgr->GetPropertyByName("GPU")->GetValue().GetBool();
@@ -1581,6 +1636,160 @@ void WindowSample::Walk(wxCommandEvent& event)
 	}
 }
 
+void WindowSample::Benchmark_Walk(wxCommandEvent& event)
+{
+	if (this->_imgPtr)
+	{
+		wxGenericProgressDialog prgdlg("Random walk kernels", "Measuring the random walk kernels");
+		prgdlg.Show();
+		prgdlg.Pulse("Placing the walkers");
+		this->_pgr->CommitChangesFromEditor();
+		int NW = this->_pgr->GetPropertyByName("NW")->GetValue().GetInteger();
+		rw::Plug plug;
+		plug.Set_Image_Formation(this->_imgHandle);
+		plug.Set_Number_Of_Walking_Particles(NW);
+		plug.Place_Walking_Particles();
+		prgdlg.Pulse("Stepping the walkers with every kernel");
+		map<int, scalar> steps_per_second;
+		rw::RandomWalkCPUDegradeImplementor implementor(&plug);
+		implementor.Benchmark(steps_per_second);
+		wxString names[] = { "Automatic", "Scalar", "AVX2", "AVX-512" };
+		wxString report = wxString("Walkers: ") << (int)plug.Number_Of_Walking_Particles() << wxString("\n");
+		for (map<int, scalar>::const_iterator it = steps_per_second.begin(); it != steps_per_second.end(); ++it)
+		{
+			report << names[it->first] << wxString(": ") << wxString::FromDouble(it->second*1e-6, 1) << wxString(" million steps per second\n");
+		}
+		wxMessageDialog mgdlg((wxWindow*)this, report, wxString("Random walk kernels"), wxOK);
+		mgdlg.ShowModal();
+	}
+	else
+	{
+		wxMessageDialog dlg(this, "Lacking image formation to measure the random walk",
+			"Random walk kernels", wxOK | wxICON_ERROR);
+		dlg.ShowModal();
+	}
+}
+
+void WindowSample::Check_First_Passage(wxCommandEvent& event)
+{
+	if ((this->_currentSimulation) && (this->_imgPtr))
+	{
+		wxGenericProgressDialog prgdlg("First-passage walk", "Checking the first-passage walk");
+		prgdlg.Show();
+		prgdlg.Pulse("Placing the walkers of the current simulation");
+		rw::Plug plug;
+		plug.Set_Image_Formation(this->_imgHandle);
+		this->_currentSimulation->Fill_Plug_Paremeters(plug);
+		plug.Deallocate_Walking_Particles();
+		plug.Place_Walking_Particles();
+		prgdlg.Pulse("Walking with sphere jumps and with lattice steps");
+		unsigned long long jumps = 0;
+		scalar deviation = 0;
+		rw::RandomWalkFirstPassageImplementor::Compare_With_Lattice(plug, jumps, deviation);
+		wxMessageDialog mgdlg((wxWindow*)this, wxString("Sphere jumps: ") << wxString::Format("%llu", jumps)
+			<< wxString("\nLargest difference between the decays: ") << wxString::FromDouble(deviation, 4),
+			wxString("First-passage walk"), wxOK);
+		mgdlg.ShowModal();
+	}
+	else
+	{
+		wxMessageDialog dlg(this, "No simulation to take the walk parameters from",
+			"First-passage walk", wxOK | wxICON_ERROR);
+		dlg.ShowModal();
+	}
+}
+
+void WindowSample::Sweep_Relaxivity(wxCommandEvent& event)
+{
+	if ((this->_currentSimulation) && (this->_imgPtr))
+	{
+		this->_pgr->CommitChangesFromEditor();
+		wxGenericProgressDialog prgdlg("Constant surface relaxivity", "Fitting a constant surface relaxivity");
+		prgdlg.Show();
+		prgdlg.Pulse("Walking once and recording the hit histograms");
+		rw::Plug plug;
+		plug.Set_Image_Formation(this->_imgHandle);
+		this->_currentSimulation->Fill_Plug_Paremeters(plug);
+		scalar rho = this->_currentSimulation->Surface_Relaxivity();
+		scalar error = 0;
+		scalar best = this->_currentSimulation->Sweep_Surface_Relaxivity(plug, rho / 10, rho * 10, 64, error);
+		if (best <= 0)
+		{
+			wxMessageDialog dlg(this, wxString("The walk cannot record hit histograms, ")
+				<< wxString("or its decays do not overlap the current decay"), "Constant surface relaxivity",
+				wxOK | wxICON_ERROR);
+			dlg.ShowModal();
+			return;
+		}
+		wxMessageDialog mgdlg((wxWindow*)this, wxString("Surface relaxivity: ") << wxString::FromDouble(best, 4)
+			<< wxString("\nRoot mean square difference with the decay: ") << wxString::FromDouble(error, 4),
+			wxString("Constant surface relaxivity"), wxOK);
+		mgdlg.ShowModal();
+	}
+	else
+	{
+		wxMessageDialog dlg(this, "No simulation to take the walk parameters from",
+			"Constant surface relaxivity", wxOK | wxICON_ERROR);
+		dlg.ShowModal();
+	}
+}
+
+void WindowSample::Benchmark_Inversion(wxCommandEvent& event)
+{
+	if (this->_currentSimulation)
+	{
+		this->_pgr->CommitChangesFromEditor();
+		this->Postprocess_Simulation_Parameters();
+		wxGenericProgressDialog prgdlg("T2 inversion", "Measuring the inversion methods");
+		prgdlg.Show();
+		prgdlg.Pulse("Inverting the decay with NNLS and with BRD");
+		scalar nnls = 0;
+		scalar brd = 0;
+		this->_currentSimulation->Benchmark_Laplace(nnls, brd);
+		wxMessageDialog mgdlg((wxWindow*)this, wxString("NNLS: ") << wxString::FromDouble(nnls*1e3, 2)
+			<< wxString(" ms\nBRD: ") << wxString::FromDouble(brd*1e3, 2) << wxString(" ms"),
+			wxString("T2 inversion"), wxOK);
+		mgdlg.ShowModal();
+	}
+	else
+	{
+		wxMessageDialog dlg(this, "No simulation to invert", "T2 inversion", wxOK | wxICON_ERROR);
+		dlg.ShowModal();
+	}
+}
+
+void WindowSample::Benchmark_Batch_Inversion(wxCommandEvent& event)
+{
+	if (this->_currentSimulation)
+	{
+		this->_pgr->CommitChangesFromEditor();
+		this->Postprocess_Simulation_Parameters();
+		wxGenericProgressDialog prgdlg("Batch inversion", "Measuring the batch inversion");
+		prgdlg.Show();
+		prgdlg.Pulse("Inverting copies of the decay as a batch and one by one");
+		int count = 256;
+		scalar sequential = 0;
+		scalar batch = 0;
+		if (!this->_currentSimulation->Benchmark_Laplace_Batch(count, sequential, batch))
+		{
+			wxMessageDialog dlg(this, "The batch inversion differs from the inversion of the decay alone",
+				"Batch inversion", wxOK | wxICON_ERROR);
+			dlg.ShowModal();
+			return;
+		}
+		wxMessageDialog mgdlg((wxWindow*)this, wxString("Decays inverted: ") << count
+			<< wxString("\nOne by one: ") << wxString::FromDouble(sequential, 1) << wxString(" decays per second")
+			<< wxString("\nBatch: ") << wxString::FromDouble(batch, 1) << wxString(" decays per second"),
+			wxString("Batch inversion"), wxOK);
+		mgdlg.ShowModal();
+	}
+	else
+	{
+		wxMessageDialog dlg(this, "No simulation to invert", "Batch inversion", wxOK | wxICON_ERROR);
+		dlg.ShowModal();
+	}
+}
+
 bool WindowSample::Has_Current_Simulation() const
 {
 	return(this->_currentSimulation != 0);
@@ -1724,7 +1933,7 @@ void WindowSample::Pick_Current_Sim_And_Formation(rw::PlugPersistent** sim, rw::
 			delete this->_formation;
 		}
 		this->_formation = new rw::Plug();
-		this->_formation->Set_Image_Formation(*this->_imgPtr);
+		this->_formation->Set_Image_Formation(this->_imgHandle);
 		this->_currentSimulation->Fill_Plug_Paremeters(*this->_formation);
 		(*formation) = this->_formation;
 	}
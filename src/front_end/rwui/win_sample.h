@@ -56,6 +56,10 @@ private:
 	WxPlotter* _plotterA;
 	WxPlotter* _plotterB;
 	const rw::BinaryImage* _imgPtr;
+	/**
+	* Copy of the image of the 3D model, taken once and shared by the plugs of the simulations
+	*/
+	rw::BinaryImageHandle _imgHandle;
 
 	uint _width;
 	uint _height;
@@ -86,11 +90,16 @@ public:
 	void Configure_Gradient_Options();
 	void Change_Grid_Value(wxPropertyGridEvent& evt);
 	void Changing_Grid_Value(wxPropertyGridEvent& evt);
-	void Preprocess_Simulation_Parameters(const rw::BinaryImage& img);
+	void Preprocess_Simulation_Parameters(const rw::BinaryImageHandle& img);
 	void Postprocess_Simulation_Parameters();
 
 	void Build_3D_Sample(wxCommandEvent& evt);
 	void Walk(wxCommandEvent& event);
+	void Benchmark_Walk(wxCommandEvent& event);
+	void Check_First_Passage(wxCommandEvent& event);
+	void Sweep_Relaxivity(wxCommandEvent& event);
+	void Benchmark_Inversion(wxCommandEvent& event);
+	void Benchmark_Batch_Inversion(wxCommandEvent& event);
 	void Show_Regularizer_Dialog(wxCommandEvent& evt);
 	void Save_Simulation(wxCommandEvent& evt);
 	void Laplace(wxCommandEvent& evt);
@@ -102,6 +111,7 @@ public:
 	bool Has_Current_Simulation() const;
 	void Set_Current_Simulation(rw::PlugPersistent* sim, const wxString& sim_path);
 	const rw::PlugPersistent& Current_Simulation() const;
+	const rw::BinaryImageHandle& Image_Handle() const;
 	void Save_Sim(const wxString& sim_file_name, const wxDateTime& wdt);
 
 	void Update_Decay_Plot();
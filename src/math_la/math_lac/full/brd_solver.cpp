@@ -0,0 +1,200 @@
+#include <math.h>
+#include <algorithm>
+#include "math_la/mdefs.h"
+#include "brd_solver.h"
+#include "mkl.h"
+
+namespace math_la
+{
+	namespace math_lac
+	{
+		namespace full
+		{
+			BRDSolver::BRDSolver()
+			{
+				this->_rows = 0;
+				this->_cols = 0;
+				this->_rank = 0;
+			}
+
+			void BRDSolver::Set_Matrix(const full::Matrix& A, int rows, int rank)
+			{
+				this->Set_Factorization(BRDSolver::Factorize(A, rows, rank));
+			}
+
+			BRDFactorizationHandle BRDSolver::Factorize(const full::Matrix& A, int rows, int rank)
+			{
+				int n = std::min(rows, A._rows);
+				int m = A._cols;
+				std::shared_ptr<BRDFactorization> f = std::make_shared<BRDFactorization>();
+				f->Rows = n;
+				f->Columns = m;
+				/**
+				* The right singular vectors of A are the eigenvectors of At*A, and the singular values the square
+				* roots of its eigenvalues, which LAPACK returns in increasing order
+				*/
+				vec(scalar) gram(m*m, (scalar)0);
+				vec(scalar) eigen(m, (scalar)0);
+				cblas_dsyrk(CblasRowMajor, CblasUpper, CblasTrans, m, n, 1, A._data, m, 0, gram.data(), m);
+				LAPACKE_dsyev(LAPACK_ROW_MAJOR, 'V', 'U', m, gram.data(), m, eigen.data());
+				scalar top = (m > 0) ? sqrt(std::max(eigen[m - 1], (scalar)0)) : (scalar)0;
+				int s = 0;
+				while ((s < std::min(rank, m)) && (eigen[m - 1 - s] > 0) && (sqrt(eigen[m - 1 - s]) > BRD_TOLERANCE*top))
+				{
+					++s;
+				}
+				f->Rank = s;
+				f->Singular.assign(s, (scalar)0);
+				f->Kernel.assign(s*m, (scalar)0);
+				vec(scalar) vt(s*m, (scalar)0);
+				for (int q = 0; q < s; ++q)
+				{
+					f->Singular[q] = sqrt(eigen[m - 1 - q]);
+					for (int j = 0; j < m; ++j)
+					{
+						vt[q*m + j] = gram[j*m + m - 1 - q];
+						f->Kernel[q*m + j] = f->Singular[q] * vt[q*m + j];
+					}
+				}
+				f->Compression.assign(s*n, (scalar)0);
+				if (s > 0)
+				{
+					cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, s, n, m, 1, vt.data(), m, A._data, m, 0, f->Compression.data(), n);
+					for (int q = 0; q < s; ++q)
+					{
+						cblas_dscal(n, (scalar)1 / f->Singular[q], f->Compression.data() + q*n, 1);
+					}
+				}
+				return(f);
+			}
+
+			void BRDSolver::Set_Factorization(const BRDFactorizationHandle& factorization)
+			{
+				this->_factorization = factorization;
+				this->_rows = factorization->Rows;
+				int s = factorization->Rank;
+				int m = factorization->Columns;
+				if ((s == this->_rank) && (m == this->_cols) && ((int)this->_x.size() == m))
+				{
+					return;
+				}
+				this->_rank = s;
+				this->_cols = m;
+				this->_data.assign(s, (scalar)0);
+				this->_c.assign(s, (scalar)0);
+				this->_step.assign(s, (scalar)0);
+				this->_trial.assign(s, (scalar)0);
+				this->_hessian.assign(s*s, (scalar)0);
+				this->_x.assign(m, (scalar)0);
+				this->_t.assign(s, (scalar)0);
+			}
+
+			void BRDSolver::Primal(const scalar* c)
+			{
+				int m = this->_cols;
+				cblas_dgemv(CblasRowMajor, CblasTrans, this->_rank, m, 1, this->_factorization->Kernel.data(), m, c, 1, 0, this->_x.data(), 1);
+				for (int j = 0; j < m; ++j)
+				{
+					this->_x[j] = std::max(this->_x[j], (scalar)0);
+				}
+			}
+
+			scalar BRDSolver::Dual(const scalar* c, scalar alpha)
+			{
+				this->Primal(c);
+				scalar f = (scalar)0.5*cblas_ddot(this->_cols, this->_x.data(), 1, this->_x.data(), 1);
+				f = f + (scalar)0.5*alpha*cblas_ddot(this->_rank, c, 1, c, 1);
+				return(f - cblas_ddot(this->_rank, c, 1, this->_data.data(), 1));
+			}
+
+			void BRDSolver::Solve(const full::Vector& y, scalar alpha, full::Vector& x)
+			{
+				int s = this->_rank;
+				int m = this->_cols;
+				x.Set_Size(m);
+				if (s == 0)
+				{
+					return;
+				}
+				const scalar* singular = this->_factorization->Singular.data();
+				const scalar* K = this->_factorization->Kernel.data();
+				alpha = std::max(alpha, (scalar)(BRD_TOLERANCE*BRD_TOLERANCE)*singular[0] * singular[0]);
+				cblas_dgemv(CblasRowMajor, CblasNoTrans, s, this->_rows, 1, this->_factorization->Compression.data(), this->_rows, y._data, 1, 0, this->_data.data(), 1);
+				/**
+				* With every column active the Hessian is Ss^2 + alpha*I, so the iteration starts from the dual of the
+				* unconstrained Tikhonov solution
+				*/
+				for (int a = 0; a < s; ++a)
+				{
+					this->_c[a] = this->_data[a] / (singular[a] * singular[a] + alpha);
+				}
+				for (int its = 0; its < BRD_ITERATIONS; ++its)
+				{
+					/**
+					* Gradient K*x + alpha*c - data and Hessian K+*K+^t + alpha*I, where K+ are the columns of the
+					* kernel with a positive solution entry
+					*/
+					scalar f = this->Dual(this->_c.data(), alpha);
+					cblas_dgemv(CblasRowMajor, CblasNoTrans, s, m, 1, K, m, this->_x.data(), 1, 0, this->_t.data(), 1);
+					std::fill(this->_hessian.begin(), this->_hessian.end(), (scalar)0);
+					for (int a = 0; a < s; ++a)
+					{
+						this->_t[a] = this->_t[a] + alpha*this->_c[a] - this->_data[a];
+						this->_step[a] = -this->_t[a];
+						this->_hessian[a*s + a] = alpha;
+					}
+					for (int j = 0; j < m; ++j)
+					{
+						if (this->_x[j] > 0)
+						{
+							for (int a = 0; a < s; ++a)
+							{
+								scalar ka = K[a*m + j];
+								for (int b = a; b < s; ++b)
+								{
+									this->_hessian[a*s + b] = this->_hessian[a*s + b] + ka*K[b*m + j];
+								}
+							}
+						}
+					}
+					if (LAPACKE_dposv(LAPACK_ROW_MAJOR, 'U', s, 1, this->_hessian.data(), s, this->_step.data(), 1) != 0)
+					{
+						break;
+					}
+					scalar slope = cblas_ddot(s, this->_t.data(), 1, this->_step.data(), 1);
+					if (-slope <= (scalar)1e-14*fabs(f))
+					{
+						break;
+					}
+					scalar t = 1;
+					bool accepted = false;
+					while ((!accepted) && (t > (scalar)1e-10))
+					{
+						for (int a = 0; a < s; ++a)
+						{
+							this->_trial[a] = this->_c[a] + t*this->_step[a];
+						}
+						if (this->Dual(this->_trial.data(), alpha) <= f + (scalar)1e-4*t*slope)
+						{
+							accepted = true;
+						}
+						else
+						{
+							t = t / 2;
+						}
+					}
+					if (!accepted)
+					{
+						break;
+					}
+					std::copy(this->_trial.begin(), this->_trial.end(), this->_c.begin());
+				}
+				this->Primal(this->_c.data());
+				for (int j = 0; j < m; ++j)
+				{
+					x(j, this->_x[j]);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,183 @@
+#ifndef F_BRD_SOLVER
+#define F_BRD_SOLVER
+
+#include <memory>
+#include "matrix.h"
+#include "vector.h"
+#include "math_la/mdefs.h"
+
+/**
+* Singular values below this fraction of the largest one are dropped from the compressed kernel
+*/
+#define BRD_TOLERANCE 1e-7
+
+/**
+* Maximal number of Newton iterations of the BRD solver
+*/
+#define BRD_ITERATIONS 200
+
+namespace math_la
+{
+	namespace math_lac
+	{
+		namespace full
+		{
+			/**
+			* Compression of a BRD kernel to its leading singular triplets. It is read only once computed, so every
+			* solver of the same kernel and rank may share it
+			*/
+			struct BRDFactorization
+			{
+				/**
+				* Number of rows and columns of the kernel, and number of singular triplets kept
+				*/
+				int Rows;
+				int Columns;
+				int Rank;
+
+				/**
+				* Leading singular values, in decreasing order
+				*/
+				vec(scalar) Singular;
+
+				/**
+				* Compressed kernel Ss*Vs^t, s x m row major
+				*/
+				vec(scalar) Kernel;
+
+				/**
+				* Left singular vectors Us^t, s x n row major, which compress the data
+				*/
+				vec(scalar) Compression;
+			};
+
+			typedef std::shared_ptr<const BRDFactorization> BRDFactorizationHandle;
+
+			/**
+			* Non negative Tikhonov regularized least squares by the method of Butler, Reeds and Dawson (BRD). The
+			* kernel A is compressed to its leading singular triplets: the data y are replaced by the s values
+			* Us^t*y and the kernel by Ss*Vs^t, so the problem min |A*x-y|^2 + alpha*|x|^2, x >= 0 is solved in a
+			* space of dimension s, independent of the number of rows of A. Its solution is x = max(0, K^t*c), where
+			* c minimizes a smooth convex function of s variables, found with damped Newton iterations.
+			*
+			* The singular triplets are computed from the eigenvectors of At*A, so the kernel is read once. The
+			* compression is held through a shared read only handle and the Newton workspaces belong to the solver, so
+			* solvers of the same kernel on several threads share one compression. A solver must not be used by several
+			* threads at the same time.
+			*/
+			class BRDSolver
+			{
+			private:
+				/**
+				* Number of rows and columns of the kernel, and number of singular triplets kept
+				*/
+				int _rows;
+				int _cols;
+				int _rank;
+
+				/**
+				* Compression of the kernel, shared with the other solvers of the same kernel and rank
+				*/
+				BRDFactorizationHandle _factorization;
+
+				/**
+				* Newton workspaces: compressed data, dual variables, step, trial point of the line search, Hessian,
+				* solution and gradient
+				*/
+				vec(scalar) _data;
+				vec(scalar) _c;
+				vec(scalar) _step;
+				vec(scalar) _trial;
+				vec(scalar) _hessian;
+				vec(scalar) _x;
+				vec(scalar) _t;
+
+				/**
+				* Computes x = max(0, K^t*c) into _x for the dual variables c
+				*/
+				void Primal(const scalar* c);
+
+				/**
+				* @return The dual function 1/2 |max(0, K^t*c)|^2 + alpha/2 |c|^2 - c*data
+				*/
+				scalar Dual(const scalar* c, scalar alpha);
+			public:
+				BRDSolver();
+
+				/**
+				* Sets the kernel and computes its compression
+				* @param A Matrix of coefficients
+				* @param rows Number of leading rows of A that form the kernel
+				* @param rank Maximal number of singular triplets kept
+				*/
+				void Set_Matrix(const full::Matrix& A, int rows, int rank);
+
+				/**
+				* Computes the compression of a kernel
+				* @param A Matrix of coefficients
+				* @param rows Number of leading rows of A that form the kernel
+				* @param rank Maximal number of singular triplets kept
+				* @return Factorization, to be shared by the solvers of the kernel
+				*/
+				static BRDFactorizationHandle Factorize(const full::Matrix& A, int rows, int rank);
+
+				/**
+				* Shares a factorization. The workspaces are allocated again only if its dimensions change
+				* @param factorization Factorization returned by Factorize
+				*/
+				void Set_Factorization(const BRDFactorizationHandle& factorization);
+
+				/**
+				* @return Factorization of the kernel, null until it is set
+				*/
+				const BRDFactorizationHandle& Factorization() const;
+
+				/**
+				* @return Number of singular triplets of the compressed kernel
+				*/
+				int Rank() const;
+
+				/**
+				* @return Number of rows of the kernel
+				*/
+				int Rows() const;
+
+				/**
+				* @return Number of columns of the kernel
+				*/
+				int Columns() const;
+
+				/**
+				* Minimizes |A*x-y|^2 + alpha*|x|^2 subject to x >= 0
+				* @param y Vector of constants. Only its first Rows() entries are used
+				* @param alpha Regularizer. It is raised to (BRD_TOLERANCE*s1)^2 at least, s1 being the largest singular
+				* value, since the dropped singular triplets would matter below it
+				* @param x Solution vector, of size Columns()
+				*/
+				void Solve(const full::Vector& y, scalar alpha, full::Vector& x);
+			};
+
+			inline int BRDSolver::Rank() const
+			{
+				return(this->_rank);
+			}
+
+			inline int BRDSolver::Rows() const
+			{
+				return(this->_rows);
+			}
+
+			inline int BRDSolver::Columns() const
+			{
+				return(this->_cols);
+			}
+
+			inline const BRDFactorizationHandle& BRDSolver::Factorization() const
+			{
+				return(this->_factorization);
+			}
+		}
+	}
+}
+
+#endif
@@ -6,6 +6,7 @@
 
 #include "math_la/mdefs.h"
 #include "matrix.h"
+#include "nnls_solver.h"
 #include "tbb/parallel_for.h"
 #include "tbb/spin_mutex.h"
 #include "tbb/parallel_reduce.h"
@@ -779,118 +780,10 @@ namespace math_la
 
 			full::Vector Matrix::NNLS(const full::Matrix& M, const full::Vector& d)
 			{
-				full::Matrix A;
-				full::Vector y;
-				A = M;
-				y = d;
-
-				int n = A.Rows();
-				int m = A.Columns();
-				IndxSet P;
-				IndxSet Z;
-				int i;
-				for (i = 0; i < m; ++i)
-				{
-					Z.insert(i);
-				}
-				full::Vector x(m);
-				full::Vector w;
-
-				full::Matrix B;
-				full::Matrix At;
-				At << A.Transposed();
-				B << At*A;
-				full::Vector yb;
-				yb << At*y;
-
-				int j;
-
-				IndxSet::const_iterator ip;
-				bool elp = true;
-				int its = 0;
-				int maxits = max(n, m);
-				maxits = min(maxits, MAX_ITERATIONS);
-				while ((elp) && (its < maxits))
-				{
-					++its;
-					w << At*(y - A*x);
-					if ((Z.size() > 0) && (w.V_Max(Z, j) > EPSILON))
-					{
-						Z.erase(j);
-						P.insert(j);
-						bool ilp = true;
-						while (ilp)
-						{
-							full::Matrix Bp;
-							Bp << B.Sub_Columns(P).Sub_Rows(P);
-							full::Vector sp;
-							sp << Bp.Solve_QR(yb.Sub_Vector(P));
-							if (sp.V_Min() <= 0)
-							{
-								i = 0;
-								ip = P.begin();
-								scalar Regularizer = (scalar)1e32;
-								while (ip != P.end())
-								{
-									scalar d = x(*ip) / (x(*ip) - sp(i));
-									if ((d < Regularizer) && (sp(i) < 0))
-									{
-										Regularizer = d;
-									}
-									++ip;
-									++i;
-								}
-								ip = P.begin();
-								i = 0;
-								IndxSet NS;
-								while (ip != P.end())
-								{
-									x((*ip), x(*ip) + Regularizer*(sp(i) - x(*ip)));
-									scalar vc = x(*ip);
-									if (vc > 0)
-									{
-										NS.insert(*ip);
-									}
-									else
-									{
-										x(*ip, (scalar)0);
-										Z.insert(*ip);
-									}
-									++ip;
-									++i;
-								}
-								P = NS;
-							}
-							else
-							{
-								ip = P.begin();
-								i = 0;
-								while (ip != P.end())
-								{
-									x(*ip, sp(i));
-									++ip;
-									++i;
-								}
-								ilp = false;
-							}
-						}
-					}
-					else
-					{
-						elp = false;
-					}
-				}
-				tbb::parallel_for(tbb::blocked_range<int>(0, x.Size(), BCHUNK_SIZE),
-					[&x](const tbb::blocked_range<int>& b)
-				{
-					for (int i = b.begin(); i < b.end(); ++i)
-					{
-						if (x(i) < EPSILON)
-						{
-							x(i, (scalar)0);
-						}
-					}
-				});
+				NNLSSolver solver;
+				solver.Set_Matrix(M);
+				full::Vector x;
+				solver.Solve(d, x);
 				return(x);
 			}
 
@@ -61,6 +61,8 @@ namespace math_la
 				void Free_Memory();
 			public:
 				friend Matrix operator*(scalar c, const Matrix& m);
+				friend class NNLSSolver;
+				friend class BRDSolver;
 
 				static Matrix Identity(int n);
 
@@ -230,7 +232,7 @@ namespace math_la
 				static full::Vector NNLS_Iterative(const full::Matrix& M, const full::Vector& d);
 
 				/**
-				* Applies non negative least squares using QR methods
+				* Applies non negative least squares with the active set method of NNLSSolver
 				* This method minimizes the norm of M*x-d (the number of rows of M must be equal to the size of d
 				* @param M Matrix of coefficients
 				* @param d Vector of constants
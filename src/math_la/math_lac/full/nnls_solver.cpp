@@ -0,0 +1,272 @@
+#include <math.h>
+#include <algorithm>
+#include "math_la/mdefs.h"
+#include "nnls_solver.h"
+#include "matrix.h"
+#include "tbb/parallel_for.h"
+#include "mkl.h"
+
+namespace math_la
+{
+	namespace math_lac
+	{
+		namespace full
+		{
+			NNLSSolver::NNLSSolver()
+			{
+				this->_rows = 0;
+				this->_cols = 0;
+				this->_size = 0;
+			}
+
+			void NNLSSolver::Set_Matrix(const full::Matrix& A)
+			{
+				this->Set_Factorization(NNLSSolver::Factorize(A));
+			}
+
+			NNLSFactorizationHandle NNLSSolver::Factorize(const full::Matrix& A)
+			{
+				int n = A._rows;
+				int m = A._cols;
+				std::shared_ptr<NNLSFactorization> f = std::make_shared<NNLSFactorization>();
+				f->Rows = n;
+				f->Columns = m;
+				f->Coefficients.assign(A._data, A._data + n*m);
+				f->Normal.assign(m*m, (scalar)0);
+				cblas_dsyrk(CblasRowMajor, CblasUpper, CblasTrans, m, n, 1, f->Coefficients.data(), m, 0, f->Normal.data(), m);
+				scalar* B = f->Normal.data();
+				tbb::parallel_for(tbb::blocked_range<int>(0, m, BCHUNK_SIZE), [B, m](const tbb::blocked_range<int>& b)
+				{
+					for (int i = b.begin(); i < b.end(); ++i)
+					{
+						for (int j = 0; j < i; ++j)
+						{
+							B[i*m + j] = B[j*m + i];
+						}
+					}
+				});
+				return(f);
+			}
+
+			void NNLSSolver::Set_Factorization(const NNLSFactorizationHandle& factorization)
+			{
+				this->_factorization = factorization;
+				this->_rows = factorization->Rows;
+				this->_size = 0;
+				int m = factorization->Columns;
+				if ((m == this->_cols) && ((int)this->_x.size() == m))
+				{
+					return;
+				}
+				this->_cols = m;
+				this->_rhs.assign(m, (scalar)0);
+				this->_r.assign(m*m, (scalar)0);
+				this->_passive.assign(m, 0);
+				this->_inPassive.assign(m, 0);
+				this->_rejected.assign(m, 0);
+				this->_x.assign(m, (scalar)0);
+				this->_s.assign(m, (scalar)0);
+				this->_t.assign(m, (scalar)0);
+			}
+
+			bool NNLSSolver::Add(int j)
+			{
+				int m = this->_cols;
+				int k = this->_size;
+				scalar* R = this->_r.data();
+				const scalar* Bj = this->_factorization->Normal.data() + j*m;
+				scalar d2 = Bj[j];
+				for (int i = 0; i < k; ++i)
+				{
+					scalar u = Bj[this->_passive[i]];
+					for (int l = 0; l < i; ++l)
+					{
+						u = u - R[l*m + i] * this->_t[l];
+					}
+					u = u / R[i*m + i];
+					this->_t[i] = u;
+					d2 = d2 - u*u;
+				}
+				if ((Bj[j] <= 0) || (d2 <= NNLS_DEPENDENCE*Bj[j]))
+				{
+					return(false);
+				}
+				for (int i = 0; i < k; ++i)
+				{
+					R[i*m + k] = this->_t[i];
+					R[k*m + i] = 0;
+				}
+				R[k*m + k] = sqrt(d2);
+				this->_passive[k] = j;
+				this->_inPassive[j] = 1;
+				++this->_size;
+				return(true);
+			}
+
+			void NNLSSolver::Remove(int c)
+			{
+				int m = this->_cols;
+				int k = this->_size;
+				scalar* R = this->_r.data();
+				this->_inPassive[this->_passive[c]] = 0;
+				for (int col = c; col < k - 1; ++col)
+				{
+					for (int i = 0; i <= col + 1; ++i)
+					{
+						R[i*m + col] = R[i*m + col + 1];
+					}
+					this->_passive[col] = this->_passive[col + 1];
+				}
+				/**
+				* Columns c to k-2 now have one entry below the diagonal, which is rotated into the diagonal
+				*/
+				for (int i = c; i < k - 1; ++i)
+				{
+					scalar a = R[i*m + i];
+					scalar b = R[(i + 1)*m + i];
+					scalar r = sqrt(a*a + b*b);
+					if (r > 0)
+					{
+						scalar cs = a / r;
+						scalar sn = b / r;
+						for (int l = i; l < k - 1; ++l)
+						{
+							scalar ri = R[i*m + l];
+							scalar rn = R[(i + 1)*m + l];
+							R[i*m + l] = cs*ri + sn*rn;
+							R[(i + 1)*m + l] = cs*rn - sn*ri;
+						}
+					}
+					R[(i + 1)*m + i] = 0;
+				}
+				--this->_size;
+			}
+
+			void NNLSSolver::Solve_Passive()
+			{
+				int m = this->_cols;
+				int k = this->_size;
+				const scalar* R = this->_r.data();
+				for (int i = 0; i < k; ++i)
+				{
+					scalar t = this->_rhs[this->_passive[i]];
+					for (int l = 0; l < i; ++l)
+					{
+						t = t - R[l*m + i] * this->_t[l];
+					}
+					this->_t[i] = t / R[i*m + i];
+				}
+				for (int i = k - 1; i >= 0; --i)
+				{
+					scalar s = this->_t[i];
+					for (int l = i + 1; l < k; ++l)
+					{
+						s = s - R[i*m + l] * this->_s[l];
+					}
+					this->_s[i] = s / R[i*m + i];
+				}
+			}
+
+			void NNLSSolver::Solve(const full::Vector& y, full::Vector& x)
+			{
+				int m = this->_cols;
+				cblas_dgemv(CblasRowMajor, CblasTrans, this->_rows, m, 1, this->_factorization->Coefficients.data(), m, y._data, 1, 0, this->_rhs.data(), 1);
+				std::fill(this->_x.begin(), this->_x.end(), (scalar)0);
+				std::fill(this->_inPassive.begin(), this->_inPassive.end(), 0);
+				std::fill(this->_rejected.begin(), this->_rejected.end(), 0);
+				this->_size = 0;
+				int maxits = std::min(std::max(this->_rows, m), MAX_ITERATIONS);
+				for (int its = 0; its < maxits; ++its)
+				{
+					/**
+					* The gradient At*(y - A*x) is rhs - B*x, where only the passive columns of B contribute
+					*/
+					int j = -1;
+					scalar wmax = EPSILON;
+					for (int i = 0; i < m; ++i)
+					{
+						if ((!this->_inPassive[i]) && (!this->_rejected[i]))
+						{
+							const scalar* Bi = this->_factorization->Normal.data() + i*m;
+							scalar w = this->_rhs[i];
+							for (int c = 0; c < this->_size; ++c)
+							{
+								int p = this->_passive[c];
+								w = w - Bi[p] * this->_x[p];
+							}
+							if (w > wmax)
+							{
+								wmax = w;
+								j = i;
+							}
+						}
+					}
+					if (j < 0)
+					{
+						break;
+					}
+					if (!this->Add(j))
+					{
+						this->_rejected[j] = 1;
+						continue;
+					}
+					this->Solve_Passive();
+					if (this->_s[this->_size - 1] <= 0)
+					{
+						this->Remove(this->_size - 1);
+						this->_rejected[j] = 1;
+						continue;
+					}
+					while (this->_size > 0)
+					{
+						scalar alpha = 1;
+						int cmin = -1;
+						for (int c = 0; c < this->_size; ++c)
+						{
+							if (this->_s[c] <= 0)
+							{
+								scalar xp = this->_x[this->_passive[c]];
+								scalar a = xp / (xp - this->_s[c]);
+								if ((cmin < 0) || (a < alpha))
+								{
+									alpha = a;
+									cmin = c;
+								}
+							}
+						}
+						if (cmin < 0)
+						{
+							for (int c = 0; c < this->_size; ++c)
+							{
+								this->_x[this->_passive[c]] = this->_s[c];
+							}
+							break;
+						}
+						for (int c = 0; c < this->_size; ++c)
+						{
+							int p = this->_passive[c];
+							this->_x[p] = this->_x[p] + alpha*(this->_s[c] - this->_x[p]);
+						}
+						this->_x[this->_passive[cmin]] = 0;
+						for (int c = this->_size - 1; c >= 0; --c)
+						{
+							int p = this->_passive[c];
+							if (this->_x[p] <= 0)
+							{
+								this->_x[p] = 0;
+								this->Remove(c);
+							}
+						}
+						this->Solve_Passive();
+					}
+					std::fill(this->_rejected.begin(), this->_rejected.end(), 0);
+				}
+				x.Set_Size(m);
+				for (int i = 0; i < m; ++i)
+				{
+					x(i, (this->_x[i] < EPSILON) ? (scalar)0 : this->_x[i]);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,189 @@
+#ifndef F_NNLS_SOLVER
+#define F_NNLS_SOLVER
+
+#include <memory>
+#include "matrix.h"
+#include "vector.h"
+#include "math_la/mdefs.h"
+
+/**
+* A column whose part independent of the passive columns has a squared norm below this fraction of its own
+* squared norm is not added to the passive set
+*/
+#define NNLS_DEPENDENCE 1e-12
+
+namespace math_la
+{
+	namespace math_lac
+	{
+		namespace full
+		{
+			/**
+			* Coefficients of a non negative least squares problem and their normal matrix At*A. They are read only once
+			* computed, so every solver of the same coefficients may share them
+			*/
+			struct NNLSFactorization
+			{
+				/**
+				* Number of rows and columns of the coefficients
+				*/
+				int Rows;
+				int Columns;
+
+				/**
+				* The coefficients, row major
+				*/
+				vec(scalar) Coefficients;
+
+				/**
+				* The normal matrix At*A, row major
+				*/
+				vec(scalar) Normal;
+			};
+
+			typedef std::shared_ptr<const NNLSFactorization> NNLSFactorizationHandle;
+
+			/**
+			* Non negative least squares by the active set method of Lawson and Hanson. The normal matrix At*A of the
+			* coefficients is computed once, and the passive set is solved with the Cholesky factor R of its normal
+			* matrix, which is also the R factor of the QR factorization of the passive columns. When a column enters
+			* the passive set R gains a column, found with a triangular solve, and when a column leaves it, the column
+			* is removed from R and the triangular shape is restored with Givens rotations. Every iteration therefore
+			* costs O(k^2) for k passive columns, instead of a new factorization.
+			*
+			* The normal matrix is held through a shared read only handle, and the workspaces belong to the solver, so
+			* solvers of the same coefficients on several threads share one factorization. The workspaces are allocated
+			* when the factorization is set, so a solver can solve many right hand sides of the same matrix without
+			* allocating. A solver must not be used by several threads at the same time.
+			*/
+			class NNLSSolver
+			{
+			private:
+				/**
+				* Number of rows and columns of the coefficients
+				*/
+				int _rows;
+				int _cols;
+
+				/**
+				* Coefficients and normal matrix, shared with the other solvers of the same coefficients
+				*/
+				NNLSFactorizationHandle _factorization;
+
+				/**
+				* The vector At*y of the current right hand side
+				*/
+				vec(scalar) _rhs;
+
+				/**
+				* Cholesky factor of the normal matrix of the passive set: R(i, c) is stored at i*_cols + c, and column c
+				* belongs to the passive index _passive[c]
+				*/
+				vec(scalar) _r;
+
+				/**
+				* Passive indexes, in the order of the columns of R
+				*/
+				vec(int) _passive;
+
+				/**
+				* Number of passive indexes
+				*/
+				int _size;
+
+				/**
+				* TRUE for the passive indexes
+				*/
+				vec(char) _inPassive;
+
+				/**
+				* TRUE for the indexes that were rejected since the solution last changed
+				*/
+				vec(char) _rejected;
+
+				/**
+				* Current solution, least squares solution of the passive set and a temporary vector
+				*/
+				vec(scalar) _x;
+				vec(scalar) _s;
+				vec(scalar) _t;
+
+				/**
+				* Adds an index at the end of the passive set
+				* @return FALSE if its column depends on the passive columns, and then it is not added
+				*/
+				bool Add(int j);
+
+				/**
+				* Removes the passive index at column c of R
+				*/
+				void Remove(int c);
+
+				/**
+				* Solves the least squares problem of the passive set into _s, by columns of R
+				*/
+				void Solve_Passive();
+			public:
+				NNLSSolver();
+
+				/**
+				* Sets the coefficients and computes their normal matrix
+				* @param A Matrix of coefficients
+				*/
+				void Set_Matrix(const full::Matrix& A);
+
+				/**
+				* Computes the normal matrix of some coefficients
+				* @param A Matrix of coefficients
+				* @return Factorization, to be shared by the solvers of A
+				*/
+				static NNLSFactorizationHandle Factorize(const full::Matrix& A);
+
+				/**
+				* Shares a factorization. The workspaces are allocated again only if the number of columns changes
+				* @param factorization Factorization returned by Factorize
+				*/
+				void Set_Factorization(const NNLSFactorizationHandle& factorization);
+
+				/**
+				* @return Factorization of the coefficients, null until they are set
+				*/
+				const NNLSFactorizationHandle& Factorization() const;
+
+				/**
+				* @return Number of rows of the coefficients
+				*/
+				int Rows() const;
+
+				/**
+				* @return Number of columns of the coefficients
+				*/
+				int Columns() const;
+
+				/**
+				* Minimizes the norm of A*x-y subject to x >= 0
+				* @param y Vector of constants, of size Rows()
+				* @param x Solution vector, of size Columns()
+				*/
+				void Solve(const full::Vector& y, full::Vector& x);
+			};
+
+			inline int NNLSSolver::Rows() const
+			{
+				return(this->_rows);
+			}
+
+			inline int NNLSSolver::Columns() const
+			{
+				return(this->_cols);
+			}
+
+			inline const NNLSFactorizationHandle& NNLSSolver::Factorization() const
+			{
+				return(this->_factorization);
+			}
+		}
+	}
+}
+
+#endif
@@ -22,6 +22,8 @@ namespace math_la
 			typedef set<int> IndxSet;
 
 			class Matrix;
+			class NNLSSolver;
+			class BRDSolver;
 
 			/**
 			* A full::Vector is a one dimension array of numbers that is not optimized for sparsity.
@@ -32,6 +34,8 @@ namespace math_la
 			private:
 				friend Vector operator*(scalar c, const Vector& v);
 				friend class Matrix;
+				friend class NNLSSolver;
+				friend class BRDSolver;
 
 				/**
 				* The size of the vector, defining its total number of entries
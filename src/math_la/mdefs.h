@@ -16,7 +16,14 @@
 #endif
 
 #define SIMD
-#define GPU_AMP
+
+/**
+* Define NO_GPU_AMP to build without C++ AMP: the GPU random walk and the GPU image filters are left out,
+* and the CPU implementations take their place
+*/
+#ifndef NO_GPU_AMP
+	#define GPU_AMP
+#endif
 
 /**
 * Define SINGLE_PREC when single precision floating point is required
@@ -37,6 +44,10 @@ using std::vector;
 	#define GPU  restrict(amp,cpu)
 	#define GPUP restrict(amp)
 	#define CPU  restrict(cpu)
+#else
+	#define GPU
+	#define GPUP
+	#define CPU
 #endif
 
 #define vec(T) vector<T, tbb::cache_aligned_allocator<T>>
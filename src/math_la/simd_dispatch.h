@@ -0,0 +1,107 @@
+#ifndef SIMD_DISPATCH_H
+#define SIMD_DISPATCH_H
+
+#include "mdefs.h"
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#else
+	#include <cpuid.h>
+#endif
+
+#define ISA_AUTO   0
+#define ISA_SCALAR 1
+#define ISA_AVX2   2
+#define ISA_AVX512 3
+
+/**
+* Executes the cpuid instruction
+* @param leaf Function leaf
+* @param subleaf Function subleaf
+* @param regs The registers eax, ebx, ecx and edx
+*/
+inline void simd_cpuid(int leaf, int subleaf, int* regs)
+{
+#ifdef _MSC_VER
+	__cpuidex(regs, leaf, subleaf);
+#else
+	unsigned int a = 0, b = 0, c = 0, d = 0;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	regs[0] = (int)a;
+	regs[1] = (int)b;
+	regs[2] = (int)c;
+	regs[3] = (int)d;
+#endif
+}
+
+/**
+* @return The register state that the operating system saves on context switches (XCR0)
+*/
+inline unsigned long long simd_xcr0()
+{
+#ifdef _MSC_VER
+	return((unsigned long long)_xgetbv(0));
+#else
+	unsigned int a = 0, d = 0;
+	__asm__ volatile("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+	return(((unsigned long long)d << 32) | a);
+#endif
+}
+
+/**
+* Detects the widest instruction set that is supported by the processor and the operating system.
+* The kernels are compiled with /arch:AVX2 and /arch:AVX512, so the compiler may emit any instruction of
+* those levels: AVX2 requires FMA as well, and AVX-512 requires the F, CD, BW, DQ and VL subsets and the
+* operating system saving the opmask and ZMM registers (XCR0 bits 5 to 7).
+* @return ISA_AVX512, ISA_AVX2 or ISA_SCALAR
+*/
+inline int simd_detect_isa()
+{
+	int regs[4];
+	simd_cpuid(0, 0, regs);
+	if (regs[0] < 7)
+	{
+		return(ISA_SCALAR);
+	}
+	simd_cpuid(1, 0, regs);
+	bool fma = (regs[2] & (1 << 12)) != 0;
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	bool avx = (regs[2] & (1 << 28)) != 0;
+	if ((!osxsave) || (!avx))
+	{
+		return(ISA_SCALAR);
+	}
+	unsigned long long xcr0 = simd_xcr0();
+	if ((xcr0 & 0x06) != 0x06)
+	{
+		return(ISA_SCALAR);
+	}
+	simd_cpuid(7, 0, regs);
+	bool avx2 = ((regs[1] & (1 << 5)) != 0) && (fma);
+	if (!avx2)
+	{
+		return(ISA_SCALAR);
+	}
+	bool avx512f = (regs[1] & (1 << 16)) != 0;
+	bool avx512dq = (regs[1] & (1 << 17)) != 0;
+	bool avx512cd = (regs[1] & (1 << 28)) != 0;
+	bool avx512bw = (regs[1] & (1 << 30)) != 0;
+	bool avx512vl = (regs[1] & (1 << 31)) != 0;
+	bool zmm = (xcr0 & 0xE6) == 0xE6;
+	if ((avx512f) && (avx512dq) && (avx512cd) && (avx512bw) && (avx512vl) && (zmm))
+	{
+		return(ISA_AVX512);
+	}
+	return(ISA_AVX2);
+}
+
+/**
+* @return TRUE if the instruction set can be executed in this processor
+* @param isa Instruction set
+*/
+inline bool simd_supported(int isa)
+{
+	return((isa >= ISA_SCALAR) && (isa <= simd_detect_isa()));
+}
+
+#endif
@@ -1,10 +1,13 @@
 #include <string>
 #include <random>
+#include <algorithm>
 #include "tbb/spin_mutex.h"
 #include "tbb/parallel_for.h"
 #include "binary_image.h"
 #include "binary_image_border_creator.h"
-#include "binary_image_opener.h"
+#include "binary_image_distance.h"
+#include "binary_image_union_find.h"
+#include "binary_image_view.h"
 #include "binary_image_denoiser.h"
 #include "binary_image_clusterer.h"
 #include "binary_image_watershed_clusterer.h"
@@ -34,6 +37,7 @@ namespace rw
 		this->_buffer = 0;
 		this->_sharedBuffer = false;
 		this->_blackVoxels = 0;
+		this->_maxDiameter = 0;
 		//this->_flags = CITY_BLOCK;
 	}
 
@@ -45,6 +49,7 @@ namespace rw
 		this->_height = img._height;
 		this->_depth = img._depth;
 		this->_blackVoxels = img._blackVoxels;
+		this->_maxDiameter = 0;
 	}
 
 	BinaryImage::BinaryImage(vec(uint)* buffer, rw::Pos3i size)
@@ -55,33 +60,32 @@ namespace rw
 		this->_buffer = buffer;
 		this->_sharedBuffer = true;
 		this->_blackVoxels = 0;
+		this->_maxDiameter = 0;
 	}
 
 	void BinaryImage::Init()
 	{
-		map<int, vec(uint)*>::iterator i = this->_processedImages.begin();
-		while (i != this->_processedImages.end())
-		{
-			delete i->second;
-		}
-		this->_processedImages.clear();
+		this->Clear_Opened_Cache();
+		this->_radiusMap.clear();
+		this->_maxDiameter = 0;
 		this->_state = new BinaryImageExecutor(this);	
-		this->_poreMap.clear();
+		this->_poreMap.Clear();
+		this->Clear_Derived();
 		this->_blackVoxels = 0;
 		this->_colorMap.clear();
 	}
 
 	BinaryImage BinaryImage::Processed_Image(int key) const
 	{
-		map<int, vec(uint)*>::const_iterator itr = this->_processedImages.find(key);
-		if (itr != this->_processedImages.end())
+		if ((key > 0) && (key <= this->_maxDiameter))
 		{
-			vec(uint)* sel_buffer = itr->second;
+			OpenedImageBuffer opened = this->Opened_Buffer(key);
 			rw::Pos3i size;
 			size.x = this->_width;
 			size.y = this->_height;
 			size.z = this->_depth;
-			BinaryImage rimg(sel_buffer,size);
+			BinaryImage rimg(new vec(uint)(*opened), size);
+			rimg._sharedBuffer = false;
 			rimg._blackVoxels = 0;
 			return(rimg);
 		}
@@ -110,13 +114,10 @@ namespace rw
 		{
 			this->_buffer = 0;
 		}
-		map<int, vec(uint)*>::iterator itr = this->_processedImages.begin();
-		while (itr != this->_processedImages.end())
-		{
-			delete itr->second;
-			++itr;
-		}
-		this->_processedImages.clear();
+		this->Clear_Opened_Cache();
+		this->_radiusMap.clear();
+		this->_maxDiameter = 0;
+		this->Clear_Derived();
 		this->_sharedBuffer = false;
 		this->_width = img._width;
 		this->_height = img._height;
@@ -131,13 +132,102 @@ namespace rw
 		{
 			delete this->_buffer;
 		}
-		map<int, vec(uint)*>::iterator itr = this->_processedImages.begin();
-		while (itr != this->_processedImages.end())
+		this->Clear_Opened_Cache();
+	}
+
+	void BinaryImage::Clear_Opened_Cache() const
+	{
+		std::lock_guard<std::mutex> lock(this->_openedMutex);
+		this->_openedCache.clear();
+	}
+
+	void BinaryImage::Clear_Derived() const
+	{
+		this->_poreSums.Clear();
+		std::lock_guard<std::mutex> lock(this->_wallMutex);
+		vec(uchar)().swap(this->_wallDistance);
+	}
+
+	void BinaryImage::Derive_Opened_Image(int key, vec(uint)& buffer) const
+	{
+		buffer = *this->_buffer;
+		int slabs = (this->_depth + 3) / 4;
+		/**
+		* A slab of four layers covers whole bricks, so the slabs write disjoint words
+		*/
+		tbb::parallel_for(tbb::blocked_range<int>(0, slabs, 1), [this, key, &buffer](const tbb::blocked_range<int>& b)
 		{
-			delete itr->second;
+			for (int s = b.begin(); s < b.end(); ++s)
+			{
+				for (int z = 4 * s; z < min(4 * s + 4, this->_depth); ++z)
+				{
+					for (int y = 0; y < this->_height; ++y)
+					{
+						for (int x = 0; x < this->_width; ++x)
+						{
+							if ((int)this->_radiusMap[(z * this->_height + y) * this->_width + x] < key)
+							{
+								uint b = (x >> 2) + (y >> 2)*((this->_width >> 2) + 1)
+									+ (z >> 2)*((this->_width >> 2) + 1)*((this->_height >> 2) + 1);
+								buffer[2 * b + ((z & 3) >> 1)] |= (0x01 << ((x & 3) + ((y & 3) << 2) + ((z & 1) << 4)));
+							}
+						}
+					}
+				}
+			}
+		});
+	}
+
+	OpenedImageBuffer BinaryImage::Opened_Buffer(int key) const
+	{
+		std::lock_guard<std::mutex> lock(this->_openedMutex);
+		list<std::pair<int, OpenedImageBuffer> >::iterator itr = this->_openedCache.begin();
+		while (itr != this->_openedCache.end())
+		{
+			if (itr->first == key)
+			{
+				this->_openedCache.splice(this->_openedCache.begin(), this->_openedCache, itr);
+				return(itr->second);
+			}
 			++itr;
 		}
-		this->_processedImages.clear();
+		/**
+		* An evicted buffer may still be held by a caller, so a new one is always derived
+		*/
+		vec(uint)* opened = new vec(uint)();
+		this->Derive_Opened_Image(key, *opened);
+		this->_openedCache.push_front(std::pair<int, OpenedImageBuffer>(key, OpenedImageBuffer(opened)));
+		while ((int)this->_openedCache.size() > OPENED_CACHE_SIZE)
+		{
+			this->_openedCache.pop_back();
+		}
+		return(this->_openedCache.front().second);
+	}
+
+	void BinaryImage::Fold_Opened_Image(const vec(uint)& buffer, int key)
+	{
+		int length = this->_width*this->_height*this->_depth;
+		if ((int)this->_radiusMap.size() != length)
+		{
+			this->_radiusMap.assign(length, 0);
+		}
+		rw::Pos3i size;
+		size.x = this->_width;
+		size.y = this->_height;
+		size.z = this->_depth;
+		tbb::parallel_for(tbb::blocked_range<int>(0, length, DCHUNK_SIZE), [this, &buffer, key, size](const tbb::blocked_range<int>& b)
+		{
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				rw::Pos3i pp;
+				Pos3i::Int_To_Pos3i(i, size.x, size.y, size.z, pp);
+				if ((BinaryImage::Accesor_Read(buffer, pp, size) == 0) && ((int)this->_radiusMap[i] < key))
+				{
+					this->_radiusMap[i] = (uchar)key;
+				}
+			}
+		});
+		this->_maxDiameter = max(this->_maxDiameter, key);
 	}
 
 	void BinaryImage::Create(int width, int height, int depth)
@@ -152,10 +242,12 @@ namespace rw
 		}
 		this->_buffer = new vec(uint)(2 * length, 0);
 		this->_blackVoxels = 0;
+		this->Clear_Derived();
 	}
 
 	void BinaryImage::Add_Layer(const BinaryImage::ImageAdapter& img, int depth)
 	{
+		this->Clear_Derived();
 		tbb::spin_mutex* mtx = new tbb::spin_mutex[4];
 		tbb::parallel_for(tbb::blocked_range<int>(0, (int)img.Height(), BCHUNK_SIZE), [this, mtx, &img, depth](const tbb::blocked_range<int>& b)
 		{
@@ -186,6 +278,7 @@ namespace rw
 
 	void BinaryImage::Clear(int depth)
 	{
+		this->Clear_Derived();
 		tbb::spin_mutex* mtx = new tbb::spin_mutex[32];
 		tbb::parallel_for(tbb::blocked_range<int>(0, (int)this->_height, BCHUNK_SIZE), [this, mtx, depth](const tbb::blocked_range<int>& b)
 		{
@@ -254,64 +347,48 @@ namespace rw
 
 	void BinaryImage::Open(BinaryImage::ProgressAdapter* pgdlg)
 	{
-		map<int, vec(uint)*>::iterator itr = this->_processedImages.begin();
-		while (itr != this->_processedImages.end())
-		{
-			delete itr->second;
-			++itr;
-		}
-		this->_processedImages.clear();
-		this->_poreMap.clear();
-		int diam = 1;
+		this->Clear_Opened_Cache();
+		this->Build_Pore_Map();
 		if (pgdlg)
 		{
-			pgdlg->Update(string("Finding pore surfaces"));
+			pgdlg->Update(string("Computing the distance transform"));
 		}
-		this->Create_Border();
-		BinaryImageBorderCreator* bc = static_cast<BinaryImageBorderCreator*>(this->_state);
-		BinaryImageOpener* oc = new BinaryImageOpener(*bc);
-		delete bc;
-		this->_state = oc;
-		bool r = true;
-		int it = 0;
-		while ((diam == 1)||((!oc->Black_Voxels_Covered()) && (it < 100)))
+		BinaryImageDistance distance;
+		distance.Execute(*this);
+		if (pgdlg)
 		{
-			oc->Set_Diameter(diam);
-			oc->Execute(pgdlg);
-			++it;
-			++diam;
-			++diam;
+			pgdlg->Update(string("Computing the local thickness"));
 		}
-		oc->Release_GPU();
-	}
-
-		
-	void BinaryImage::Clear_Null_Processed_Images()
-	{
-		set<int> to_erase;
-		map<int, vec(uint)*>::iterator itr = this->_processedImages.begin();
-		while (itr != this->_processedImages.end())
+		vec(uchar) thickness;
+		vec(int) cluster;
+		distance.Local_Thickness(thickness, cluster);
+		int length = this->_width*this->_height*this->_depth;
+		this->_radiusMap.resize(length);
+		tbb::parallel_for(tbb::blocked_range<int>(0, length, DCHUNK_SIZE), [this, &distance, &thickness, &cluster](const tbb::blocked_range<int>& b)
 		{
-			if (!itr->second)
+			for (int i = b.begin(); i < b.end(); ++i)
 			{
-				to_erase.insert(itr->first);
+				int d = distance.Diameter(i);
+				this->_radiusMap[i] = (uchar)d;
+				int r = this->_poreMap.Rank(i);
+				if (r >= 0)
+				{
+					this->_poreMap.Cluster(r) = cluster[i];
+					this->_poreMap.Diam_Max(r) = (char)thickness[i];
+					this->_poreMap.Dist_Min(r) = (d > 0) ? (char)(d / 2) : (char)1;
+				}
 			}
-			++itr;
-		}
-		set<int>::iterator ii = to_erase.begin();
-		while (ii != to_erase.end())
-		{
-			this->_processedImages.erase(*ii);
-			++ii;
-		}
+		});
+		this->_maxDiameter = distance.Max_Diameter();
 	}
 
+
 	void BinaryImage::Save_File(const string& filename) const
 	{
 		uint black_voxels = this->Black_Voxels();
 		file::Binary file(WRITE);
 		file.Open(filename);
-		file.Write((uchar)0);
+		file.Write((uchar)2);
 		file.Write((int)this->_width);
 		file.Write((int)this->_height);
 		file.Write((int)this->_depth);
@@ -321,36 +398,34 @@ namespace rw
 		{
 			file.Write((uint)(*this->_buffer)[k]);
 		}
-		if (this->_processedImages.size() > 0)
+		/**
+		* The radius map of the solid voxels is zero, so only the pore voxels are written
+		*/
+		file.Write((int)this->_maxDiameter);
+		if (this->_maxDiameter > 0)
 		{
-			file.Write((uint)this->_processedImages.size());
-			map<int, vec(uint)*>::const_iterator itr = this->_processedImages.begin();
-			while (itr != this->_processedImages.end())
+			int length = this->_width*this->_height*this->_depth;
+			for (int i = 0; i < length; ++i)
 			{
-				file.Write((int)itr->first);
-				vec(uint)* proc = itr->second;
-				for (int k = 0; k < proc->size(); ++k)
+				rw::Pos3i pp;
+				Pos3i::Int_To_Pos3i(i, this->_width, this->_height, this->_depth, pp);
+				if ((*this)(pp) == 0)
 				{
-					file.Write((uint)(*proc)[k]);
+					file.Write((uchar)this->_radiusMap[i]);
 				}
-				++itr;
 			}
 		}
-		else
-		{
-			file.Write((uint)0);
-		}
-		if (this->_poreMap.size() > 0)
+		/**
+		* The pore map is written by rank, the order of the pore voxels, so the voxels are not written
+		*/
+		if (this->_poreMap.Size() > 0)
 		{
-			file.Write((uint)this->_poreMap.size());
-			map<int, Pore_Voxel>::const_iterator c_itr = this->_poreMap.begin();
-			while (c_itr != this->_poreMap.end())
+			file.Write((uint)this->_poreMap.Size());
+			for (int r = 0; r < this->_poreMap.Size(); ++r)
 			{
-				file.Write((int)c_itr->first);
-				file.Write((char)c_itr->second.dist_min);
-				file.Write((char)c_itr->second.diam_max);
-				file.Write((int)c_itr->second.cluster);
-				++c_itr;
+				file.Write((char)this->_poreMap.Dist_Min(r));
+				file.Write((char)this->_poreMap.Diam_Max(r));
+				file.Write((int)this->_poreMap.Cluster(r));
 			}
 		}
 		else
@@ -365,8 +440,12 @@ namespace rw
 		pgdlg->Set_Range(4);
 		file::Binary file(READ);
 		file.Open(string(filename.c_str()));
-		this->_poreMap.clear();
-		file.Read_UChar();
+		this->_poreMap.Clear();
+		this->Clear_Derived();
+		this->Clear_Opened_Cache();
+		this->_radiusMap.clear();
+		this->_maxDiameter = 0;
+		uchar version = file.Read_UChar();
 		this->_width = file.Read_Int();
 		this->_height = file.Read_Int();
 		this->_depth = file.Read_Int();
@@ -383,23 +462,51 @@ namespace rw
 			{
 				(*this->_buffer)[k] = file.Read_UInt();
 			}
-			uint sproc = file.Read_UInt();
-			if (sproc > 0)
+			if (version == 0)
 			{
-				if (pgdlg)
+				/**
+				* Files of version 0 store a copy of the image opened by every diameter
+				*/
+				uint sproc = file.Read_UInt();
+				if (sproc > 0)
 				{
-					pgdlg->Update(2, "Loading processed images");
+					if (pgdlg)
+					{
+						pgdlg->Update(2, "Loading processed images");
+					}
+					vec(uint) proc(2 * length, 0);
+					for (uint k = 0; k < sproc; ++k)
+					{
+						int key = file.Read_Int();
+						for (uint s = 0; s < 2 * length; ++s)
+						{
+							proc[s] = file.Read_UInt();
+						}
+						this->Fold_Opened_Image(proc, key);
+					}
 				}
-
-				for (uint k = 0; k < sproc; ++k)
+			}
+			else
+			{
+				int max_diameter = file.Read_Int();
+				if (max_diameter > 0)
 				{
-					int key = file.Read_Int();
-					vec(uint)* proc = new vec(uint)(2 * length, 0);
-					for (uint s = 0; s < 2 * length; ++s)
+					if (pgdlg)
+					{
+						pgdlg->Update(2, "Loading radius map");
+					}
+					int voxels = this->_width*this->_height*this->_depth;
+					this->_radiusMap.assign(voxels, 0);
+					for (int i = 0; i < voxels; ++i)
 					{
-						(*proc)[s] = file.Read_UInt();
+						rw::Pos3i pp;
+						Pos3i::Int_To_Pos3i(i, this->_width, this->_height, this->_depth, pp);
+						if ((*this)(pp) == 0)
+						{
+							this->_radiusMap[i] = file.Read_UChar();
+						}
 					}
-					this->_processedImages[key] = proc;
+					this->_maxDiameter = max_diameter;
 				}
 			}
 		}
@@ -410,16 +517,30 @@ namespace rw
 		uint map_size = file.Read_UInt();
 		if (map_size > 0)
 		{
+			this->Build_Pore_Map();
+			/**
+			* From version 2 the entries are stored by rank, so they only apply to a bitmap with the same pore
+			* voxels. Otherwise the attributes are not read, and the pore map keeps its defaults
+			*/
+			if ((version >= 2) && ((int)map_size != this->_poreMap.Size()))
+			{
+				map_size = 0;
+			}
 			for (uint k = 0; k < map_size; ++k)
 			{
-				int idx = file.Read_Int();
+				/**
+				* Files before version 2 write the voxel of every entry
+				*/
+				int r = (version < 2) ? this->_poreMap.Rank(file.Read_Int()) : (int)k;
 				char rad_min = file.Read_Char();
 				char rad_max = file.Read_Char();
-				Pore_Voxel r;
-				r.dist_min = rad_min;
-				r.diam_max = rad_max;
-				r.cluster = file.Read_Int();
-				this->_poreMap[idx] = r;
+				int cluster = file.Read_Int();
+				if ((r >= 0) && (r < this->_poreMap.Size()))
+				{
+					this->_poreMap.Dist_Min(r) = rad_min;
+					this->_poreMap.Diam_Max(r) = rad_max;
+					this->_poreMap.Cluster(r) = cluster;
+				}
 			}
 		}
 		file.Close();
@@ -498,43 +619,28 @@ namespace rw
 	void BinaryImage::Maximal_Spheres(vector<int>& radius) const
 	{
 		radius.clear();
-		map<int, vec(uint)*>::const_iterator itr = this->_processedImages.begin();
-		while (itr != this->_processedImages.end())
+		for (int diam = 1; diam <= this->_maxDiameter; diam = diam + 2)
 		{
-			radius.push_back(itr->first);
+			radius.push_back(diam);
 		}
 	}
 
 	void BinaryImage::Build_Pore_Map()
 	{
-		this->_poreMap.clear();
-		int length = this->_width*this->_height*this->_depth;
-		tbb::spin_mutex mtx;
-		tbb::parallel_for(tbb::blocked_range<int>(0, length, BCHUNK_SIZE), [this, &mtx](const tbb::blocked_range<int>& b)
-		{
-			for (int i = b.begin(); i < b.end(); ++i)
-			{
-				rw::Pos3i pp;
-				Pos3i::Int_To_Pos3i(i, this->_width, this->_height, this->_depth, pp);
-				if ((*this)(pp) == 0)
-				{
-					mtx.lock();
-					Pore_Voxel r;
-					r.cluster = -1;
-					r.dist_min = 1;
-					r.diam_max = 1;
-					this->_poreMap.insert(std::pair<int, Pore_Voxel>(i, r));
-					mtx.unlock();
-				}
-			}
-		});
+		rw::Pos3i size;
+		size.x = this->_width;
+		size.y = this->_height;
+		size.z = this->_depth;
+		this->_poreMap.Build(*this->_buffer, size);
 	}
 
 	map<uint, RGBColor> BinaryImage::Build_Diameter_Color_Map()
 	{
 		map<uint, RGBColor> rmap;
-		map<int, vec(uint)*>::const_reverse_iterator ritr = this->_processedImages.rbegin();
-		int diam = (int)ritr->first + 1;
+		vector<int> diameters;
+		this->Maximal_Spheres(diameters);
+		vector<int>::const_reverse_iterator ritr = diameters.rbegin();
+		int diam = this->_maxDiameter + 1;
 		int AR = 80;
 		int AG = 80;
 		int AB = 255;
@@ -544,11 +650,11 @@ namespace rw
 		int BB = 50;
 
 		int ik = 0;
-		int ick = (int)this->_processedImages.size() / 2 + 1;
+		int ick = (int)diameters.size() / 2 + 1;
 		bool sr = true;
-		while (ritr != this->_processedImages.rend())
+		while (ritr != diameters.rend())
 		{
-			int i = ritr->first;
+			int i = *ritr;
 			int b = 0;
 			int r = 0;
 			int g = 0;
@@ -612,16 +718,16 @@ namespace rw
 					else
 					{
 						int idx = rw::Pos3i::Pos3i_To_Int(pp, this->_width, this->_height, this->_depth);
-						map<int, Pore_Voxel>::const_iterator ritr = this->_poreMap.find(idx);
-						if (ritr != this->_poreMap.end())
+						int r = this->_poreMap.Rank(idx);
+						if (r >= 0)
 						{
-							int v = (int)ritr->second.diam_max;
+							int v = (int)this->_poreMap.Diam_Max(r);
 							if (!maximal)
 							{
-								v = (int)ritr->second.dist_min;
+								v = (int)this->_poreMap.Dist_Min(r);
 							}
 							RGBColor rad_color = rad_color_map.find(v)->second;
-							if ((ritr->second.diam_max == ritr->second.dist_min)&&(ritr->second.dist_min > 1))
+							if ((this->_poreMap.Diam_Max(r) == this->_poreMap.Dist_Min(r))&&(this->_poreMap.Dist_Min(r) > 1))
 							{
 							//	rad_color = RGBColor(255, 0, 0);
 							}
@@ -661,6 +767,19 @@ namespace rw
 		return(this->_height);
 	}
 
+	void BinaryImage::Build_Pore_Sums() const
+	{
+		if (this->_poreSums.Built())
+		{
+			return;
+		}
+		rw::Pos3i size;
+		size.x = this->_width;
+		size.y = this->_height;
+		size.z = this->_depth;
+		this->_poreSums.Build(*this->_buffer, size);
+	}
+
 	uint BinaryImage::Black_Voxels() const
 	{
 		if (this->_blackVoxels == 0)
@@ -694,7 +813,37 @@ namespace rw
 
 	bool BinaryImage::Opened() const
 	{
-		return((int)this->_processedImages.size() > 0);
+		return(this->_maxDiameter > 0);
+	}
+
+	const vec(uchar)& BinaryImage::Wall_Distance() const
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->_wallMutex);
+			if (!this->_wallDistance.empty())
+			{
+				return(this->_wallDistance);
+			}
+		}
+		/**
+		* The transform runs outside the lock: a thread waiting for it in a parallel loop may take another task
+		* of the same image. Two threads may then both transform the image, and the first map is kept.
+		*/
+		vec(uchar) dist;
+		BinaryImageDistance transform;
+		transform.Execute(*this);
+		transform.Distance_Map(dist);
+		std::lock_guard<std::mutex> lock(this->_wallMutex);
+		if (this->_wallDistance.empty())
+		{
+			this->_wallDistance.swap(dist);
+		}
+		return(this->_wallDistance);
+	}
+
+	const BinaryImagePoreMap& BinaryImage::Pore_Map() const
+	{
+		return(this->_poreMap);
 	}
 
 	void BinaryImage::Count_Spheres(map<int, Freq_Rad>& distribution) const
@@ -715,8 +864,15 @@ namespace rw
 					fr.freq_rad_max = 0;
 					fr.freq_rad_min = 0;
 					fr.freq_rad_eq = 0;
-					map<int, Pore_Voxel>::const_iterator itr = this->_poreMap.find(i);
-					Pore_Voxel r = itr->second;
+					int rank = this->_poreMap.Rank(i);
+					if (rank < 0)
+					{
+						continue;
+					}
+					Pore_Voxel r;
+					r.cluster = this->_poreMap.Cluster(rank);
+					r.diam_max = this->_poreMap.Diam_Max(rank);
+					r.dist_min = this->_poreMap.Dist_Min(rank);
 					mtx.lock();
 					map<int, Freq_Rad>::iterator ii = distribution.find(r.diam_max);
 					if (ii == distribution.end())
@@ -767,6 +923,91 @@ namespace rw
 		this->Cluster_PSD_File("Cluster.csv",1,100);
 	}
 
+	int BinaryImage::Remove_Isolated_Pores(BinaryImage::ProgressAdapter* pgdlg)
+	{
+		rw::Pos3i size;
+		size.x = this->_width;
+		size.y = this->_height;
+		size.z = this->_depth;
+		if (this->_poreMap.Size() == 0)
+		{
+			this->Build_Pore_Map();
+		}
+		if (pgdlg)
+		{
+			pgdlg->Update(string("Labelling the pore space"));
+		}
+		BinaryImageUnionFind components;
+		components.Label(this->_poreMap, size, [](int ra, int rb) { return(true); });
+		/**
+		* The border is a small fraction of the image, so its components are marked serially
+		*/
+		vec(uchar) connected(this->_poreMap.Size(), 0);
+		int plane = size.x*size.y;
+		for (int z = 0; z < size.z; ++z)
+		{
+			bool face = (z == 0) || (z == size.z - 1);
+			for (int y = 0; y < size.y; ++y)
+			{
+				int step = (face || (y == 0) || (y == size.y - 1)) ? 1 : max(size.x - 1, 1);
+				for (int x = 0; x < size.x; x = x + step)
+				{
+					int r = this->_poreMap.Rank(z * plane + y * size.x + x);
+					if (r >= 0)
+					{
+						connected[components.Root(r)] = 1;
+					}
+				}
+			}
+		}
+		if (pgdlg)
+		{
+			pgdlg->Update(string("Filling isolated pores"));
+		}
+		int slabs = (size.z + 3) / 4;
+		vec(int) filled(slabs, 0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, slabs, 1), [this, size, plane, &components, &connected, &filled](const tbb::blocked_range<int>& b)
+		{
+			for (int s = b.begin(); s < b.end(); ++s)
+			{
+				for (int z = 4 * s; z < min(4 * s + 4, size.z); ++z)
+				{
+					for (int y = 0; y < size.y; ++y)
+					{
+						for (int x = 0; x < size.x; ++x)
+						{
+							int r = this->_poreMap.Rank(z * plane + y * size.x + x);
+							if ((r >= 0) && (!connected[components.Root(r)]))
+							{
+								uint br = (x >> 2) + (y >> 2)*((size.x >> 2) + 1) + (z >> 2)*((size.x >> 2) + 1)*((size.y >> 2) + 1);
+								(*this->_buffer)[2 * br + ((z & 3) >> 1)] |= (0x01 << ((x & 3) + ((y & 3) << 2) + ((z & 1) << 4)));
+								++filled[s];
+							}
+						}
+					}
+				}
+			}
+		});
+		int removed = 0;
+		for (int s = 0; s < slabs; ++s)
+		{
+			removed = removed + filled[s];
+		}
+		if (removed > 0)
+		{
+			this->Clear_Opened_Cache();
+			this->_radiusMap.clear();
+			this->_maxDiameter = 0;
+			this->_poreMap.Clear();
+			this->Clear_Derived();
+			this->_colorMap.clear();
+			if (this->_blackVoxels > 0)
+			{
+				this->_blackVoxels = this->_blackVoxels - (uint)removed;
+			}
+		}
+		return(removed);
+	}
 
 	rw::BinaryImage BinaryImage::Sub(int bx, int by, int bz, int dx, int dy, int dz) const
 	{
@@ -840,17 +1081,16 @@ namespace rw
 				Pos3i::Int_To_Pos3i(i, this->_width, this->_height, this->_depth, pp);
 				if ((*this)(pp) == 0)
 				{
-					map<int, BinaryImage::Pore_Voxel>::const_iterator sitr =
-						this->_poreMap.find(i);
-					if (sitr != this->_poreMap.end())
+					int r = this->_poreMap.Rank(i);
+					if (r >= 0)
 					{
-						map<uint, RGBColor>::iterator itr = color_map.find(sitr->second.cluster);
+						map<uint, RGBColor>::iterator itr = color_map.find(this->_poreMap.Cluster(r));
 						if (itr == color_map.end())
 						{
 							mtx.lock();
 							RGBColor sel_color((uchar)Pick_Random(),
 								(uchar)Pick_Random(), (uchar)Pick_Random());
-							color_map[sitr->second.cluster] = sel_color;
+							color_map[this->_poreMap.Cluster(r)] = sel_color;
 							mtx.unlock();
 						}
 					}
@@ -885,17 +1125,16 @@ namespace rw
 					else
 					{
 						int idx = rw::Pos3i::Pos3i_To_Int(pp, this->_width, this->_height, this->_depth);
-						map<int, BinaryImage::Pore_Voxel>::const_iterator sitr =
-							this->_poreMap.find(idx);
-						if (sitr != this->_poreMap.end())
+						int r = this->_poreMap.Rank(idx);
+						if (r >= 0)
 						{
 							RGBColor color;
-							map<uint, RGBColor>::const_iterator itr = this->_colorMap.find(sitr->second.cluster);
+							map<uint, RGBColor>::const_iterator itr = this->_colorMap.find(this->_poreMap.Cluster(r));
 							if (itr != this->_colorMap.end())
 							{
 								color = itr->second;
 							}
-							if (sitr->second.diam_max == sitr->second.dist_min)
+							if (this->_poreMap.Diam_Max(r) == this->_poreMap.Dist_Min(r))
 							{
 								//color = RGBColor(255, 0, 0);
 							}
@@ -951,18 +1190,18 @@ namespace rw
 					rw::Pos3i position_to_check = c_pos + mask[i];
 					int id_position_to_check =
 						rw::Pos3i::Pos3i_To_Int(position_to_check, this->Width(), this->Height(), this->Depth());
-					map<int, rw::BinaryImage::Pore_Voxel>::const_iterator itr = this->_poreMap.find(id_position_to_check);
-					if (itr != this->_poreMap.end())
+					int r = this->_poreMap.Rank(id_position_to_check);
+					if (r >= 0)
 					{
-						const rw::BinaryImage::Pore_Voxel& pv = itr->second;
-						map<int, float2>::iterator map_itr = structure.find(pv.cluster);
+						int cluster = this->_poreMap.Cluster(r);
+						map<int, float2>::iterator map_itr = structure.find(cluster);
 						if (map_itr == structure.end())
 						{
 							float2 ss;
 							ss.y = s_factor;
 							ss.x = 0.0f;
 							mtx.lock();
-							structure.insert(std::pair<int, float2>(pv.cluster, ss));
+							structure.insert(std::pair<int, float2>(cluster, ss));
 							mtx.unlock();
 						}
 						else
@@ -999,11 +1238,10 @@ namespace rw
 				Pos3i::Int_To_Pos3i(i, this->_width, this->_height, this->_depth, pp);
 				if ((*this)(pp) == 0)
 				{
-					map<int,rw::BinaryImage::Pore_Voxel>::const_iterator itr = this->_poreMap.find(i);
-					if (itr != this->_poreMap.end())
+					int r = this->_poreMap.Rank(i);
+					if (r >= 0)
 					{
-						const rw::BinaryImage::Pore_Voxel& pv = itr->second;
-						map<int, float2>::iterator structure_itr = structure.find(pv.cluster);
+						map<int, float2>::iterator structure_itr = structure.find(this->_poreMap.Cluster(r));
 						if (structure_itr != structure.end())
 						{
 							mtx.lock();
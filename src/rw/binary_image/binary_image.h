@@ -3,32 +3,50 @@
 
 #include <map>
 #include <set>
+#include <list>
 #include <string>
+#include <memory>
+#include <mutex>
 #include "rw/binary_image/pos3i.h"
 #include "math_la/mdefs.h"
 #include "math_la/file/binary.h"
 #include "rgb_color.h"
+#include "binary_image_pore_map.h"
+#include "binary_image_pore_sums.h"
 
 
 #define EXPANDED 1 
 #define SPHERES 2
 #define CITY_BLOCK 4
 
+/**
+* Number of opened images derived from the radius map that are kept in memory
+*/
+#define OPENED_CACHE_SIZE 4
+
 namespace rw
 {
 	class BinaryImageExecutor;
 
 	using std::map;
 	using std::set;
+	using std::list;
 	using std::string;
 
+	/**
+	* Shared handle of an opened image derived from the radius map. The cache of the image drops its handle
+	* when the buffer is evicted, but the buffer lives on, unchanged, while other handles remain.
+	*/
+	typedef std::shared_ptr<const vec(uint)> OpenedImageBuffer;
+
 	/**
 	* An encapsulated method to store large binary images, using only one bit per pixel. 
 	* For example, a 1000x1000x1000 image will require only 120 MB to be
 	* stored, which faciliates handling these large textures even in a modest GPU. 
 	* This class can also handle fast morphologic operations such as Dilation 
-	* and Erosion by spherical structuring elements. The opening stores a sequence
-	* of opened images which can be useful to estimate a pore size distribution. 
+	* and Erosion by spherical structuring elements. The opening stores, for every voxel, the largest
+	* diameter at which it survives, from which the opened image of any diameter is derived. This
+	* can be useful to estimate a pore size distribution. 
 	*/
 	class BinaryImage
 	{
@@ -208,20 +226,50 @@ namespace rw
 		vec(uint)* _buffer;
 
 		/**
-		* This is the vector of processed images (opened images). These images are stored after each dilation/erosion in order to preserve
-		* peculairities of the pore space shapes. 
+		* Radius map of the opening: the largest diameter at which every voxel survives the opening, zero for
+		* solid voxels and for the pore voxels that never survive. Indexed as in Pos3i::Pos3i_To_Int.
+		*/
+		vec(uchar) _radiusMap;
+
+		/**
+		* Largest diameter of the radius map, zero if the image has not been opened
+		*/
+		int _maxDiameter;
+
+		/**
+		* Opened images recently derived from the radius map, the most recently used first
+		*/
+		mutable list<std::pair<int, OpenedImageBuffer> > _openedCache;
+
+		/**
+		* Guards the cache of opened images
 		*/
-		map<int, vec(uint)*> _processedImages;
+		mutable std::mutex _openedMutex;
+
 
+		/**
+		* Pore map, characterizing every pore voxel with the attributes of a Binary::Pore_Voxel structure
+		*/
+		BinaryImagePoreMap _poreMap;
 
 		/**
-		* Pore map, characterizing every pore voxel with a Binary::Pore_Voxel structure
+		* Summed volume table of the pore voxels, built on demand by Build_Pore_Sums
 		*/
-		map<int, Pore_Voxel> _poreMap;
+		mutable BinaryImagePoreSums _poreSums;
+
+		/**
+		* Distance from every voxel to the nearest solid voxel, built on demand by Wall_Distance
+		*/
+		mutable vec(uchar) _wallDistance;
+
+		/**
+		* Guards the distance map
+		*/
+		mutable std::mutex _wallMutex;
 
 	
 		/**
-		* Creates a pore map for the black voxels in the image
+		* Creates a pore map for the black voxels in the image, with cluster -1 and unit diameter and distance
 		*/
 		void Build_Pore_Map();
 
@@ -233,10 +281,36 @@ namespace rw
 
 
 		/**
-		* Clears last processed image, the image that has not been eroded because there are no remaining voxels
-		* after the dilation
+		* Releases the opened images derived from the radius map
+		*/
+		void Clear_Opened_Cache() const;
+
+		/**
+		* Releases the summed volume table and the distance map, which every change of the image invalidates
+		*/
+		void Clear_Derived() const;
+
+		/**
+		* Builds the opened image of a diameter from the radius map: the solid with the pore voxels that do not
+		* survive the opening
+		* @param key Diameter of the opening
+		* @param buffer Bricked buffer, laid out as the buffer of the image
+		*/
+		void Derive_Opened_Image(int key, vec(uint)& buffer) const;
+
+		/**
+		* @return The opened image of a diameter, from the cache or derived from the radius map. The buffer is
+		* never modified, and remains valid while the handle is held, even after the cache evicts it.
+		* @param key Diameter of the opening
+		*/
+		OpenedImageBuffer Opened_Buffer(int key) const;
+
+		/**
+		* Raises the radius map of the pore voxels of an opened image to its diameter
+		* @param buffer Bricked buffer of the opened image
+		* @param key Diameter of the opening
 		*/
-		void Clear_Null_Processed_Images();
+		void Fold_Opened_Image(const vec(uint)& buffer, int key);
 
 		/**
 		* Creates internal data structures associated to the border
@@ -287,7 +361,8 @@ namespace rw
 		void Clear(int depth);
 
 		/**
-		* Applies the opening operator.
+		* Applies the opening operator, on the CPU, from the exact distance transform of the image
+		* (see BinaryImageDistance). It fills the pore map and the radius map.
 		* @param pgdlg Progress dialog
 		*/
 		void Open(BinaryImage::ProgressAdapter* pdlg = 0);
@@ -297,6 +372,19 @@ namespace rw
 		*/
 		bool Opened() const;
 
+		/**
+		* Computes the exact distance from every voxel to the nearest solid voxel (see
+		* BinaryImageDistance::Distance_Map). The map is built by the first call and kept until the image
+		* changes, so the plugs that share the image transform it once. It is thread safe.
+		* @return Distance of every voxel, indexed as in Pos3i::Pos3i_To_Int. Solid voxels have distance zero.
+		*/
+		const vec(uchar)& Wall_Distance() const;
+
+		/**
+		* @return The pore map of the image, built when the image is opened or loaded, and empty otherwise
+		*/
+		const BinaryImagePoreMap& Pore_Map() const;
+
 		uint operator()(const rw::Pos3i& pos) const;
 		uint operator()(const rw::Pos3i& pos, int v);
 
@@ -339,7 +427,7 @@ namespace rw
 
 		/**
 		* @return A processed image indexed by key. This is the image where the opening operator corresponding to radius key
-		* has beel applied
+		* has beel applied. It is derived from the radius map, and owns a copy of the cached buffer.
 		* @param key Index of the image
 		*/
 		BinaryImage Processed_Image(int key) const;
@@ -398,11 +486,31 @@ namespace rw
 		int Width() const;
 		int Height() const;
 
+		/**
+		* @return The raw bricked buffer of the image, laid out as in BinaryImage::Accesor_Read
+		*/
+		const uint* Data() const;
+
 		/**
 		*@return The number of black voxels inside the matrix
 		*/
 		uint Black_Voxels() const;
 
+		/**
+		* Builds the summed volume table of the pore voxels, so Pore_Voxels counts the pore voxels of any box
+		* in a time proportional to its faces. A table already built is kept, so the call is cheap to repeat.
+		* The table is released by every method that changes the image, and by every executor that writes it.
+		* It is not thread safe.
+		*/
+		void Build_Pore_Sums() const;
+
+		/**
+		* @return The number of pore voxels inside a box, from the summed volume table (see Build_Pore_Sums)
+		* @param origin Smallest corner of the box
+		* @param size Size of the box, which must lie inside the image
+		*/
+		uint Pore_Voxels(const rw::Pos3i& origin, const rw::Pos3i& size) const;
+
 		/**
 		* @return The sub-image  limited by the indices
 		* @param bx Origin in the x-axis
@@ -425,6 +533,16 @@ namespace rw
 		*/
 		void Cluster_Pores(BinaryImage::ProgressAdapter* pgdlg);
 
+		/**
+		* Fills the isolated pores with solid, so the pore space is the effective porosity. A pore is isolated
+		* if its connected component, by faces, does not reach the border of the image. It takes two linear
+		* passes: the union-find labelling of the pore space, and the filling. The opening is cleared if any
+		* pore is filled.
+		* @param pgdlg Progress dialog
+		* @return Number of filled pore voxels
+		*/
+		int Remove_Isolated_Pores(BinaryImage::ProgressAdapter* pgdlg = 0);
+
 		void Populate_Color_Map(BinaryImage::ColorMap& cmp) const;
 	};
 
@@ -434,6 +552,16 @@ namespace rw
 		cmp._colorMap = &this->_colorMap;
 	}
 
+	inline const uint* BinaryImage::Data() const
+	{
+		return(this->_buffer->data());
+	}
+
+	inline uint BinaryImage::Pore_Voxels(const rw::Pos3i& origin, const rw::Pos3i& size) const
+	{
+		return(this->_poreSums.Count(origin, size));
+	}
+
 	inline uint BinaryImage::Accesor_Read(const vec(uint)& vtx, const rw::Pos3i& pp, const rw::Pos3i& size)
 	{
 		uint b = (pp.x >> 2) + (pp.y >> 2)*((size.x >> 2) + 1)
@@ -472,6 +600,12 @@ namespace rw
 	{
 		return(this->_height);
 	}
+
+	/**
+	* Shared handle of an image that is no longer modified. The plugs, their copies and their implementors
+	* share one image through it, and the last of them releases it.
+	*/
+	typedef std::shared_ptr<const BinaryImage> BinaryImageHandle;
 }
 
 
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <tbb/parallel_for.h>
+#include "binary_image_brick_morphology.h"
+
+namespace rw
+{
+	BinaryImageBrickMorphology::BinaryImageBrickMorphology(const rw::Pos3i& size)
+	{
+		this->_size = size;
+		this->_bricks.x = (size.x >> 2) + 1;
+		this->_bricks.y = (size.y >> 2) + 1;
+		this->_bricks.z = (size.z >> 2) + 1;
+	}
+
+	BinaryImageBrickMorphology::Brick BinaryImageBrickMorphology::Inside(int bx, int by, int bz) const
+	{
+		int cx = std::min(std::max(this->_size.x - 4 * bx, 0), 4);
+		int cy = std::min(std::max(this->_size.y - 4 * by, 0), 4);
+		int cz = std::min(std::max(this->_size.z - 4 * bz, 0), 4);
+		Brick mx = (Brick)((0x01 << cx) - 1) * 0x1111111111111111ULL;
+		Brick my = (Brick)((0x01 << (4 * cy)) - 1) * 0x0001000100010001ULL;
+		Brick mz = (cz == 4) ? ~0ULL : ((0x01ULL << (16 * cz)) - 1);
+		return(mx & my & mz);
+	}
+
+	void BinaryImageBrickMorphology::Load(const uint* buffer, bool solid, vec(Brick)& phase) const
+	{
+		phase.resize(this->Size());
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->_bricks.y*this->_bricks.z, BCHUNK_SIZE), [this, buffer, solid, &phase](const tbb::blocked_range<int>& b)
+		{
+			for (int r = b.begin(); r < b.end(); ++r)
+			{
+				int by = r % this->_bricks.y;
+				int bz = r / this->_bricks.y;
+				for (int bx = 0; bx < this->_bricks.x; ++bx)
+				{
+					int k = r * this->_bricks.x + bx;
+					Brick m = (Brick)buffer[2 * k] | ((Brick)buffer[2 * k + 1] << 32);
+					phase[k] = (solid ? m : ~m) & this->Inside(bx, by, bz);
+				}
+			}
+		});
+	}
+
+	void BinaryImageBrickMorphology::Dilate(const vec(Brick)& in, vec(Brick)& out) const
+	{
+		vec(Brick) tmp(this->Size());
+		out.resize(this->Size());
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->Size(), DCHUNK_SIZE), [this, &in, &tmp](const tbb::blocked_range<int>& b)
+		{
+			for (int k = b.begin(); k < b.end(); ++k)
+			{
+				Brick plus, minus;
+				this->Neighbors_X(in, k, k % this->_bricks.x, plus, minus);
+				tmp[k] = in[k] | plus | minus;
+			}
+		});
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->Size(), DCHUNK_SIZE), [this, &tmp, &out](const tbb::blocked_range<int>& b)
+		{
+			for (int k = b.begin(); k < b.end(); ++k)
+			{
+				Brick plus, minus;
+				this->Neighbors_Y(tmp, k, (k / this->_bricks.x) % this->_bricks.y, plus, minus);
+				out[k] = tmp[k] | plus | minus;
+			}
+		});
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->Size(), DCHUNK_SIZE), [this, &tmp, &out](const tbb::blocked_range<int>& b)
+		{
+			for (int k = b.begin(); k < b.end(); ++k)
+			{
+				Brick plus, minus;
+				int layer = this->_bricks.x*this->_bricks.y;
+				this->Neighbors_Z(out, k, k / layer, plus, minus);
+				tmp[k] = out[k] | plus | minus;
+			}
+		});
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->Size(), DCHUNK_SIZE), [this, &tmp, &out](const tbb::blocked_range<int>& b)
+		{
+			for (int k = b.begin(); k < b.end(); ++k)
+			{
+				int layer = this->_bricks.x*this->_bricks.y;
+				out[k] = tmp[k] & this->Inside(k % this->_bricks.x, (k / this->_bricks.x) % this->_bricks.y, k / layer);
+			}
+		});
+	}
+
+	void BinaryImageBrickMorphology::Erode(const vec(Brick)& in, vec(Brick)& out) const
+	{
+		vec(Brick) other(this->Size());
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->Size(), DCHUNK_SIZE), [this, &in, &other](const tbb::blocked_range<int>& b)
+		{
+			for (int k = b.begin(); k < b.end(); ++k)
+			{
+				int layer = this->_bricks.x*this->_bricks.y;
+				other[k] = ~in[k] & this->Inside(k % this->_bricks.x, (k / this->_bricks.x) % this->_bricks.y, k / layer);
+			}
+		});
+		this->Dilate(other, out);
+		for (int k = 0; k < this->Size(); ++k)
+		{
+			out[k] = in[k] & ~out[k];
+		}
+	}
+
+	void BinaryImageBrickMorphology::Border(const uint* buffer, bool solid, vec(int)& corner, vec(int)& surface) const
+	{
+		vec(Brick) phase;
+		vec(Brick) other;
+		vec(Brick) reach;
+		this->Load(buffer, solid, phase);
+		this->Load(buffer, !solid, other);
+		this->Dilate(other, reach);
+		/**
+		* The corner border overwrites the reach of the other phase, the surface border overwrites the phase
+		*/
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->Size(), DCHUNK_SIZE), [this, &phase, &other, &reach](const tbb::blocked_range<int>& b)
+		{
+			for (int k = b.begin(); k < b.end(); ++k)
+			{
+				Brick xp, xm, yp, ym, zp, zm;
+				this->Neighbors_X(other, k, k % this->_bricks.x, xp, xm);
+				this->Neighbors_Y(other, k, (k / this->_bricks.x) % this->_bricks.y, yp, ym);
+				this->Neighbors_Z(other, k, k / (this->_bricks.x*this->_bricks.y), zp, zm);
+				Brick border = phase[k] & reach[k];
+				Brick corners = border & (xp | xm) & (yp | ym) & (zp | zm);
+				phase[k] = border & ~corners;
+				reach[k] = corners;
+			}
+		});
+		this->Extract(reach, corner);
+		this->Extract(phase, surface);
+	}
+
+	void BinaryImageBrickMorphology::Extract(const vec(Brick)& mask, vec(int)& voxels) const
+	{
+		int layer = this->_bricks.x*this->_bricks.y;
+		vector<vec(int)> layers(this->_bricks.z);
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->_bricks.z, 1), [this, &mask, &layers, layer](const tbb::blocked_range<int>& b)
+		{
+			int plane = this->_size.x*this->_size.y;
+			for (int bz = b.begin(); bz < b.end(); ++bz)
+			{
+				vec(int)& out = layers[bz];
+				for (int k = bz * layer; k < (bz + 1)*layer; ++k)
+				{
+					Brick m = mask[k];
+					int x0 = 4 * (k % this->_bricks.x);
+					int y0 = 4 * ((k / this->_bricks.x) % this->_bricks.y);
+					while (m != 0)
+					{
+						int bit = BinaryImageBrickMorphology::Lowest_Bit(m);
+						m = m & (m - 1);
+						out.push_back((4 * bz + (bit >> 4))*plane + (y0 + ((bit >> 2) & 3))*this->_size.x + x0 + (bit & 3));
+					}
+				}
+			}
+		});
+		vec(int) offset(this->_bricks.z + 1, 0);
+		for (int bz = 0; bz < this->_bricks.z; ++bz)
+		{
+			offset[bz + 1] = offset[bz] + (int)layers[bz].size();
+		}
+		voxels.resize(offset[this->_bricks.z]);
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->_bricks.z, 1), [&layers, &offset, &voxels](const tbb::blocked_range<int>& b)
+		{
+			for (int bz = b.begin(); bz < b.end(); ++bz)
+			{
+				std::copy(layers[bz].begin(), layers[bz].end(), voxels.begin() + offset[bz]);
+			}
+		});
+	}
+}
@@ -0,0 +1,146 @@
+#ifndef BINARY_IMAGE_BRICK_MORPHOLOGY_H
+#define BINARY_IMAGE_BRICK_MORPHOLOGY_H
+
+#include <vector>
+#include "math_la/mdefs.h"
+#include "rw/binary_image/pos3i.h"
+
+namespace rw
+{
+	using std::vector;
+
+	/**
+	* Morphology of a bricked image buffer (see BinaryImage::Accesor_Read) one brick at a time. The two words
+	* of a brick are joined into a 64 bit mask, where the voxel (x, y, z) of the brick is the bit x + 4y + 16z,
+	* so the neighbors of all the voxels of a brick are found with shifts, masks and the face neighbor bricks.
+	* The 3x3x3 dilation is separable, one pass per axis, and the passes are plain loops over contiguous masks
+	* that the compiler vectorizes across bricks.
+	*
+	* A phase is the set of solid voxels, or the set of pore voxels, inside the image. The voxels outside the
+	* image belong to no phase: they are never a border and they never make one.
+	*/
+	class BinaryImageBrickMorphology
+	{
+	public:
+		typedef unsigned long long Brick;
+	private:
+		/**
+		* Size of the image
+		*/
+		rw::Pos3i _size;
+
+		/**
+		* Number of bricks along every axis
+		*/
+		rw::Pos3i _bricks;
+
+		/**
+		* Neighbor masks along every axis, in the positive (plus) and the negative (minus) direction. The
+		* bricks outside the grid are empty.
+		*/
+		void Neighbors_X(const vec(Brick)& in, int b, int bx, Brick& plus, Brick& minus) const;
+		void Neighbors_Y(const vec(Brick)& in, int b, int by, Brick& plus, Brick& minus) const;
+		void Neighbors_Z(const vec(Brick)& in, int b, int bz, Brick& plus, Brick& minus) const;
+
+		/**
+		* @return The voxels of a brick that are inside the image
+		*/
+		Brick Inside(int bx, int by, int bz) const;
+
+		/**
+		* Lists the voxel indexes (as in Pos3i::Pos3i_To_Int) of the masks of every brick. The bricks are split
+		* by layers, which are filled in parallel and then concatenated.
+		*/
+		void Extract(const vec(Brick)& mask, vec(int)& voxels) const;
+	public:
+		BinaryImageBrickMorphology(const rw::Pos3i& size);
+
+		/**
+		* @return Number of bricks of the image
+		*/
+		int Size() const;
+
+		/**
+		* Loads a phase of a bricked buffer
+		* @param buffer Bricked buffer of the image
+		* @param solid TRUE for the solid phase, FALSE for the pore phase
+		* @param phase Mask of the phase for every brick
+		*/
+		void Load(const uint* buffer, bool solid, vec(Brick)& phase) const;
+
+		/**
+		* Dilates a mask by the 3x3x3 cube, inside the image
+		*/
+		void Dilate(const vec(Brick)& in, vec(Brick)& out) const;
+
+		/**
+		* Erodes a phase by the 3x3x3 cube: the voxels whose neighbors inside the image all belong to the phase
+		*/
+		void Erode(const vec(Brick)& in, vec(Brick)& out) const;
+
+		/**
+		* Picks the border voxels of a phase: the voxels with a neighbor of the other phase among their 26
+		* neighbors. A border voxel is on a surface if, along some axis, none of its two face neighbors is of the
+		* other phase, and on a corner otherwise.
+		* @param buffer Bricked buffer of the image
+		* @param solid TRUE for the border of the solid phase, FALSE for the border of the pore phase
+		* @param corner Corner border voxels, indexed as in Pos3i::Pos3i_To_Int
+		* @param surface Surface border voxels, indexed as in Pos3i::Pos3i_To_Int
+		*/
+		void Border(const uint* buffer, bool solid, vec(int)& corner, vec(int)& surface) const;
+
+		/**
+		* @return The index of the lowest set bit of a non empty mask
+		*/
+		static int Lowest_Bit(Brick m);
+	};
+
+	inline int BinaryImageBrickMorphology::Size() const
+	{
+		return(this->_bricks.x*this->_bricks.y*this->_bricks.z);
+	}
+
+	inline int BinaryImageBrickMorphology::Lowest_Bit(Brick m)
+	{
+		static const int DeBruijn[64] = {
+			0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+			62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+			63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+			46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6 };
+		return(DeBruijn[((m & (~m + 1)) * 0x03f79d71b4cb0a89ULL) >> 58]);
+	}
+
+	inline void BinaryImageBrickMorphology::Neighbors_X(const vec(Brick)& in, int b, int bx, Brick& plus, Brick& minus) const
+	{
+		static const Brick X0 = 0x1111111111111111ULL;
+		static const Brick X3 = 0x8888888888888888ULL;
+		Brick c = in[b];
+		Brick n = (bx + 1 < this->_bricks.x) ? in[b + 1] : 0;
+		Brick p = (bx > 0) ? in[b - 1] : 0;
+		plus = ((c >> 1) & ~X3) | ((n & X0) << 3);
+		minus = ((c << 1) & ~X0) | ((p & X3) >> 3);
+	}
+
+	inline void BinaryImageBrickMorphology::Neighbors_Y(const vec(Brick)& in, int b, int by, Brick& plus, Brick& minus) const
+	{
+		static const Brick Y0 = 0x000F000F000F000FULL;
+		static const Brick Y3 = 0xF000F000F000F000ULL;
+		Brick c = in[b];
+		Brick n = (by + 1 < this->_bricks.y) ? in[b + this->_bricks.x] : 0;
+		Brick p = (by > 0) ? in[b - this->_bricks.x] : 0;
+		plus = ((c >> 4) & ~Y3) | ((n & Y0) << 12);
+		minus = ((c << 4) & ~Y0) | ((p & Y3) >> 12);
+	}
+
+	inline void BinaryImageBrickMorphology::Neighbors_Z(const vec(Brick)& in, int b, int bz, Brick& plus, Brick& minus) const
+	{
+		int layer = this->_bricks.x*this->_bricks.y;
+		Brick c = in[b];
+		Brick n = (bz + 1 < this->_bricks.z) ? in[b + layer] : 0;
+		Brick p = (bz > 0) ? in[b - layer] : 0;
+		plus = (c >> 16) | (n << 48);
+		minus = (c << 16) | (p >> 48);
+	}
+}
+
+#endif
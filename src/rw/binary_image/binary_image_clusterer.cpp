@@ -1,4 +1,7 @@
+#include <math.h>
+#include <algorithm>
 #include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
 #include <tbb/spin_mutex.h>
 #include "binary_image_clusterer.h"
 
@@ -23,10 +26,10 @@ namespace rw
 				Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, pp);
 				if (this->Image()(pp) == 0)
 				{
-					map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if (ii != this->Pore_Map().end())
+					int ii = this->Pore_Map().Rank(i);
+					if (ii >= 0)
 					{
-						ii->second.dist_min = ii->second.diam_max;
+						this->Pore_Map().Dist_Min(ii) = this->Pore_Map().Diam_Max(ii);
 					}
 				}
 			}
@@ -35,144 +38,117 @@ namespace rw
 
 	void BinaryImageClusterer::Recluster(int rad, BinaryImage::ProgressAdapter* pgdlg)
 	{
-		map<int, int> fusion_map;
 		rw::Pos3i size3d = this->Size_3D();
-		int length = size3d.x*size3d.y*size3d.z;
-		vec(uint)* buffer_ptr = 0;
-		buffer_ptr = &this->Image_Buffer();
-		vec(uint)& buffer = *buffer_ptr;
-		BinaryImage bimg(&buffer, size3d);
-		int s_max = min(size3d.z, min(size3d.y, size3d.z));
-		tbb::spin_mutex mtx;
+		BinaryImagePoreMap& pmap = this->Pore_Map();
 		const vec(rw::Pos3i) mask = this->Corner_Mask(3);
-		int max_fusion = 1;
 		if (pgdlg)
 		{
 			pgdlg->Update(this->_step, "Checking voxels neighborhood");
 		}
-		tbb::parallel_for(tbb::blocked_range<int>(0, length, length/32),
-			[this, &bimg, &mtx, mask, size3d,rad,&max_fusion, &fusion_map](const tbb::blocked_range<int>& b)
+		/**
+		* Every pore voxel takes the cluster of largest diameter among its neighbors, and every cluster that ties
+		* at that diameter is joined to it. The neighbors are read from the map as it was before the pass and the
+		* choices are written apart, so the pass takes no locks and its result does not depend on the order
+		* of the voxels
+		*/
+		vec(int) cluster(pmap.Size(), -1);
+		vec(char) diam(pmap.Size(), 0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, pmap.Size(), DCHUNK_SIZE),
+			[this, &pmap, &mask, &cluster, &diam, size3d, rad](const tbb::blocked_range<int>& b)
 		{
-			for (int i = b.begin(); i < b.end(); ++i)
+			vec(int) ties;
+			ties.reserve(mask.size());
+			for (int r = b.begin(); r < b.end(); ++r)
 			{
 				rw::Pos3i ppc;
-				Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, ppc);
-				if (bimg(ppc) == 0)
+				Pos3i::Int_To_Pos3i(pmap.Voxel(r), size3d.x, size3d.y, size3d.z, ppc);
+				int best = -1;
+				int best_diam = rad;
+				ties.clear();
+				for (int k = 0; k < (int)mask.size(); ++k)
 				{
-					map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if (ii != this->Pore_Map().end())
+					rw::Pos3i pp = mask[k];
+					pp.x = pp.x + ppc.x;
+					pp.y = pp.y + ppc.y;
+					pp.z = pp.z + ppc.z;
+					if ((pp.x < 0) || (pp.x >= size3d.x) || (pp.y < 0) || (pp.y >= size3d.y)
+						|| (pp.z < 0) || (pp.z >= size3d.z))
 					{
-						int* updates = new int[mask.size()];
-						int toupd = 0;
-						int cluster = -1;
-						int rad_max = rad;
-						map<int, int> cluster_table;
-						for (int k = 0; k < (int)mask.size(); ++k)
-						{
-							updates[k] = -1;
-							rw::Pos3i pp = mask[k];
-							pp.x = pp.x + ppc.x;
-							pp.y = pp.y + ppc.y;
-							pp.z = pp.z + ppc.z;
-							if (!((pp.x < 0) || (pp.x >= size3d.x)
-								|| (pp.y < 0) || (pp.y >= size3d.y)
-								|| (pp.z < 0) || (pp.z >= size3d.z)))
-							{
-								int idp = rw::Pos3i::Pos3i_To_Int(pp, size3d.x, size3d.y, size3d.z);
-								map<int, BinaryImage::Pore_Voxel>::iterator iidp = this->Pore_Map().find(idp);
-								if (iidp != this->Pore_Map().end())
-								{
-									int l_rad = iidp->second.diam_max;
-									if (l_rad > rad)
-									{
-										map<int, int>::iterator ict = cluster_table.find(iidp->second.cluster);
-										if (ict == cluster_table.end())
-										{
-											int x = iidp->second.diam_max;
-											cluster_table.insert(std::pair<int, int>(iidp->second.cluster, x));
-										}
-									}
-									updates[k] = idp;
-									++toupd;
-								}
-							}
-						}
-						if ((int)cluster_table.size() > max_fusion)
-						{
-							mtx.lock();
-							max_fusion = (int)cluster_table.size();
-							mtx.unlock();
-						}
-						map<int, int>::iterator ict = cluster_table.begin();
-						while (ict != cluster_table.end())
-						{
-							if (ict->second > rad_max)
-							{
-								cluster = ict->first;
-								rad_max = ict->second;
-							}
-							++ict;
-						}
-						if (cluster_table.size() == 2)
-						{
-							map<int, int>::iterator ift = cluster_table.begin();
-							map<int, int>::iterator ist = ift;
-							++ist;
-							if (ift->second == ist->second)
-							{
-								mtx.lock();
-								fusion_map[ist->first] = ift->first;
-								mtx.unlock();
-							}
-						}
-
-						if ((cluster >= 0) && (toupd > 0))
+						continue;
+					}
+					int n = pmap.Rank(rw::Pos3i::Pos3i_To_Int(pp, size3d.x, size3d.y, size3d.z));
+					if (n < 0)
+					{
+						continue;
+					}
+					int c = pmap.Cluster(n);
+					int d = pmap.Diam_Max(n);
+					if ((c < 0) || (d <= rad))
+					{
+						continue;
+					}
+					if (d > best_diam)
+					{
+						best = c;
+						best_diam = d;
+						ties.clear();
+					}
+					else if ((d == best_diam) && (c != best))
+					{
+						ties.push_back(c);
+					}
+				}
+				int rb = (best >= 0) ? pmap.Rank(best) : -1;
+				if (rb >= 0)
+				{
+					for (int k = 0; k < (int)ties.size(); ++k)
+					{
+						int rt = pmap.Rank(ties[k]);
+						if (rt >= 0)
 						{
-							for (int k = 0; k < (int)mask.size(); ++k)
-							{
-								if (updates[k] >= 0)
-								{
-									map<int, BinaryImage::Pore_Voxel>::iterator uitr = this->Pore_Map().find(updates[k]);
-									if ((uitr != this->Pore_Map().end())&&(uitr->second.diam_max > 0))
-									{
-										mtx.lock();
-										uitr->second.cluster = cluster;
-										uitr->second.diam_max = -rad_max;
-										mtx.unlock();
-									}
-								}
-							}
+							this->_fusion.Union(rb, rt);
 						}
-						delete[]updates;
 					}
 				}
+				cluster[r] = best;
+				diam[r] = (char)best_diam;
 			}
 		});
-		for (int k = 0; k < max_fusion; ++k)
+		tbb::parallel_for(tbb::blocked_range<int>(0, pmap.Size(), DCHUNK_SIZE),
+			[&pmap, &cluster, &diam](const tbb::blocked_range<int>& b)
 		{
-			if (pgdlg)
+			for (int r = b.begin(); r < b.end(); ++r)
 			{
-				pgdlg->Update(this->_step, "Fusioning same size clusters. Step: " + std::to_string(k+1));
+				if (cluster[r] >= 0)
+				{
+					pmap.Cluster(r) = cluster[r];
+					pmap.Diam_Max(r) = diam[r];
+				}
 			}
-			this->Apply_Fusion_Map(fusion_map);
+		});
+		if (pgdlg)
+		{
+			pgdlg->Update(this->_step, "Fusioning same size clusters");
 		}
+		this->Apply_Fusion(0);
 	}
 
 	void BinaryImageClusterer::Extend_Diameter(int diam, BinaryImage::ProgressAdapter* pgdlg)
 	{
 		rw::Pos3i size3d = this->Size_3D();
 		int length = size3d.x*size3d.y*size3d.z;
-		vec(uint)* buffer_ptr = 0;
+		OpenedImageBuffer opened;
+		const vec(uint)* buffer_ptr = 0;
 		if (diam > 3)
 		{
-			buffer_ptr = &this->Processed_Image(diam);
+			opened = this->Processed_Image(diam);
+			buffer_ptr = opened.get();
 		}
 		else
 		{
 			buffer_ptr = &this->Image_Buffer();
 		}
-		vec(uint)& buffer = *buffer_ptr;
-		BinaryImage bimg(&buffer, size3d);
+		const vec(uint)& buffer = *buffer_ptr;
 		int s_max = min(size3d.z, min(size3d.y, size3d.z));
 		tbb::spin_mutex mtx;
 		this->Add_Mask(diam);
@@ -182,16 +158,16 @@ namespace rw
 			pgdlg->Update(this->_step, std::string("Extending spheres of diameter ") + std::to_string(diam));
 		}
 		tbb::parallel_for(tbb::blocked_range<int>(0, length, length/32),
-			[this, &bimg, &mtx, diam, mask, size3d](const tbb::blocked_range<int>& b)
+			[this, &buffer, &mtx, diam, mask, size3d](const tbb::blocked_range<int>& b)
 		{
 			for (int i = b.begin(); i < b.end(); ++i)
 			{
 				rw::Pos3i ppc;
 				Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, ppc);
-				if (bimg(ppc) == 0)
+				if (BinaryImageExecutor::Accessor_Read(buffer, ppc, size3d) == 0)
 				{
-					map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if (ii != this->Pore_Map().end())
+					int ii = this->Pore_Map().Rank(i);
+					if (ii >= 0)
 					{
 						int* updates = new int[mask.size()];
 						int toupd = 0;
@@ -211,24 +187,24 @@ namespace rw
 								|| (pp.z < 0) || (pp.z >= size3d.z)))
 							{
 								int idp = rw::Pos3i::Pos3i_To_Int(pp, size3d.x, size3d.y, size3d.z);
-								map<int, BinaryImage::Pore_Voxel>::iterator iidp = this->Pore_Map().find(idp);
-								if (iidp != this->Pore_Map().end())
+								int iidp = this->Pore_Map().Rank(idp);
+								if (iidp >= 0)
 								{
-									int l_diam = iidp->second.diam_max;
+									int l_diam = this->Pore_Map().Diam_Max(iidp);
 									if (l_diam > diam)
 									{
-										map<int, int2>::iterator ict = cluster_table.find(iidp->second.cluster);
+										map<int, int2>::iterator ict = cluster_table.find(this->Pore_Map().Cluster(iidp));
 										if (ict != cluster_table.end())
 										{
-											ict->second.x = iidp->second.diam_max;
+											ict->second.x = this->Pore_Map().Diam_Max(iidp);
 											ict->second.y = ict->second.y + 1;
 										}
 										else
 										{
 											int2 ne;
-											ne.x = iidp->second.diam_max;
+											ne.x = this->Pore_Map().Diam_Max(iidp);
 											ne.y = 1;
-											cluster_table.insert(std::pair<int, int2>(iidp->second.cluster, ne));
+											cluster_table.insert(std::pair<int, int2>(this->Pore_Map().Cluster(iidp), ne));
 										}
 									}
 									updates[k] = idp;
@@ -265,12 +241,12 @@ namespace rw
 							{
 								if (updates[k] >= 0)
 								{
-									map<int, BinaryImage::Pore_Voxel>::iterator uitr = this->Pore_Map().find(updates[k]);
-									if ((uitr != this->Pore_Map().end()) && (abs(uitr->second.diam_max) != diam_max))
+									int uitr = this->Pore_Map().Rank(updates[k]);
+									if ((uitr >= 0) && (abs(this->Pore_Map().Diam_Max(uitr)) != diam_max))
 									{
 										mtx.lock();
-										uitr->second.cluster = cluster;
-										uitr->second.diam_max = -diam_max;
+										this->Pore_Map().Cluster(uitr) = cluster;
+										this->Pore_Map().Diam_Max(uitr) = -diam_max;
 										mtx.unlock();
 									}
 								}
@@ -290,12 +266,12 @@ namespace rw
 				Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, pp);
 				if (this->Image()(pp) == 0)
 				{
-					map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if (ii != this->Pore_Map().end())
+					int ii = this->Pore_Map().Rank(i);
+					if (ii >= 0)
 					{
-						if (ii->second.diam_max < 0)
+						if (this->Pore_Map().Diam_Max(ii) < 0)
 						{
-							ii->second.diam_max = abs(ii->second.diam_max);
+							this->Pore_Map().Diam_Max(ii) = abs(this->Pore_Map().Diam_Max(ii));
 						}
 					}
 				}
@@ -304,98 +280,32 @@ namespace rw
 	}
 
 	
-	void BinaryImageClusterer::Apply_Fusion_Map(const map<int, int>& fusion)
+	void BinaryImageClusterer::Apply_Fusion(int diam)
 	{
-		rw::Pos3i size3d = this->Size_3D();
-		int length = size3d.x*size3d.y*size3d.z;
-		tbb::spin_mutex mtx;
-		tbb::parallel_for(tbb::blocked_range<int>(0, (int)length, max((int)length / 128, BCHUNK_SIZE)),
-			[this, &fusion, &mtx,size3d](const tbb::blocked_range<int>& b)
+		BinaryImagePoreMap& pmap = this->Pore_Map();
+		tbb::parallel_for(tbb::blocked_range<int>(0, pmap.Size(), DCHUNK_SIZE),
+			[this, &pmap, diam](const tbb::blocked_range<int>& b)
 		{
-			for (int i = b.begin(); i < b.end(); ++i)
+			for (int r = b.begin(); r < b.end(); ++r)
 			{
-				rw::Pos3i pp;
-				Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, pp);
-				if (this->Image()(pp) == 0)
+				if ((diam > 0) && (pmap.Diam_Max(r) != diam))
 				{
-					map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if (ii != this->Pore_Map().end())
-					{
-						int idcenter = ii->second.cluster;
-						map<int, int>::const_iterator itr = fusion.find(idcenter);
-						if (itr != fusion.end())
-						{
-							int newcenter = itr->second;
-							mtx.lock();
-							ii->second.cluster = newcenter;
-							mtx.unlock();
-						}
-					}
+					continue;
 				}
-			}
-		});
-	}
-
-	void BinaryImageClusterer::Apply_Fusion_Map(const map<int, int>& fusion, int diam)
-	{
-		rw::Pos3i size3d = this->Size_3D();
-		int length = size3d.x*size3d.y*size3d.z;
-		tbb::spin_mutex mtx;
-		tbb::parallel_for(tbb::blocked_range<int>(0, (int)length, max((int)length / 128, BCHUNK_SIZE)),
-			[this, &fusion, &mtx, diam,size3d](const tbb::blocked_range<int>& b)
-		{
-			for (int i = b.begin(); i < b.end(); ++i)
-			{
-				rw::Pos3i pp;
-				Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, pp);
-				if (this->Image()(pp) == 0)
+				int center = pmap.Cluster(r);
+				int rc = (center >= 0) ? pmap.Rank(center) : -1;
+				if (rc >= 0)
 				{
-					map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if ((ii != this->Pore_Map().end()) && (ii->second.diam_max == diam))
+					int root = this->_fusion.Find(rc);
+					if (root != rc)
 					{
-						int idcenter = ii->second.cluster;
-						map<int, int>::const_iterator itr = fusion.find(idcenter);
-						if (itr != fusion.end())
-						{
-							int newcenter = itr->second;
-							mtx.lock();
-							ii->second.cluster = newcenter;
-							mtx.unlock();
-						}
+						pmap.Cluster(r) = pmap.Voxel(root);
 					}
 				}
 			}
 		});
 	}
 
-	void BinaryImageClusterer::Set_Box(rw::Box3D& box, const rw::Pos3i& center, int diam) const
-	{
-		int dr = (int)(((float)diam)*1.41f);
-
-		box._eA.x = center.x - dr;
-		box._eA.y = center.y - dr;
-		box._eA.z = center.z - dr;
-
-		box._eB.x = center.x + dr;
-		box._eB.y = center.y + dr;
-		box._eB.z = center.z + dr;
-	}
-
-
-	void BinaryImageClusterer::Extend_Box(rw::Box3D& box, const rw::Pos3i& center, int diam) const
-	{
-		int dr = (int)(((float)diam)*1.41f);
-
-		box._eA.x = min(center.x - dr, box._eA.x);
-		box._eA.y = min(center.y - dr, box._eA.y);
-		box._eA.z = min(center.z - dr, box._eA.z);
-
-		box._eB.x = max(center.x + dr, box._eB.x);
-		box._eB.y = max(center.y + dr, box._eB.y);
-		box._eB.z = max(center.z + dr, box._eB.z);
-
-	}
-
 	int BinaryImageClusterer::Square_Cluster_Distance(int rad) const
 	{
 		return (4*rad*rad);
@@ -405,135 +315,106 @@ namespace rw
 	void BinaryImageClusterer::Group_Clusters(int diam, BinaryImage::ProgressAdapter* pgdlg)
 	{
 		rw::Pos3i size3d = this->Size_3D();
-		int length = size3d.x*size3d.y*size3d.z;
-		BinaryImage bimg(&this->Image_Buffer(),size3d);
-		set<int> centers;
-		tbb::spin_mutex mtx;
+		BinaryImagePoreMap& pmap = this->Pore_Map();
 		if (pgdlg)
 		{
 			pgdlg->Update(this->_step, std::string("Picking centers from morphology of diameter ") + std::to_string(diam));
 		}
-		tbb::parallel_for(tbb::blocked_range<int>(0, length, BCHUNK_SIZE),
-			[this, &bimg, &mtx, &centers, diam, size3d](const tbb::blocked_range<int>& b)
+		vec(uchar) is_center(pmap.Size(), 0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, pmap.Size(), DCHUNK_SIZE),
+			[&pmap, &is_center, diam](const tbb::blocked_range<int>& b)
 		{
-			for (int i = b.begin(); i < b.end(); ++i)
+			for (int r = b.begin(); r < b.end(); ++r)
 			{
-				rw::Pos3i pp;
-				Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, pp);
-				if (bimg(pp) == 0)
+				if ((pmap.Diam_Max(r) == diam) && (pmap.Cluster(r) >= 0))
 				{
-					map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if (ii != this->Pore_Map().end())
+					int rc = pmap.Rank(pmap.Cluster(r));
+					if (rc >= 0)
 					{
-						if (ii->second.diam_max == diam)
-						{
-							if (centers.find(ii->second.cluster) == centers.end())
-							{
-								mtx.lock();
-								centers.insert(ii->second.cluster);
-								mtx.unlock();
-							}
-						}
+						is_center[rc] = 1;
 					}
 				}
 			}
 		});
-		vec(int) v_centers(centers.begin(), centers.end());
-		map<int, int> fusion_map;
-		vector<set<int>> kdtree;
-		vector<Box3D> boxes;
-		kdtree.reserve(centers.size());
-		boxes.reserve(centers.size());
-		int size = 0;
+		vec(int) v_centers;
+		for (int r = 0; r < (int)is_center.size(); ++r)
+		{
+			if (is_center[r])
+			{
+				v_centers.push_back(pmap.Voxel(r));
+			}
+		}
 		if (pgdlg)
 		{
 			pgdlg->Update(this->_step, std::string("Detecting overlapping centers from spheres of diameter ") + std::to_string(diam));
 		}
-
-		tbb::parallel_for(tbb::blocked_range<int>(0, (int)v_centers.size(), max((int)v_centers.size() / 128, BCHUNK_SIZE)),
-			[this, diam, &kdtree, &mtx, &boxes, &v_centers, size3d,&size](const tbb::blocked_range<int>& b)
+		/**
+		* Centers closer than the cluster distance lie in the same or in neighbor cells of a grid whose cell
+		* is the cluster distance
+		*/
+		int dstc = this->Square_Cluster_Distance(diam);
+		int cell = max(1, (int)ceil(sqrt((double)dstc)));
+		rw::Pos3i cells;
+		cells.x = size3d.x / cell + 1;
+		cells.y = size3d.y / cell + 1;
+		cells.z = size3d.z / cell + 1;
+		vector<std::pair<int, int> > grid(v_centers.size());
+		tbb::parallel_for(tbb::blocked_range<int>(0, (int)v_centers.size(), BCHUNK_SIZE),
+			[&v_centers, &grid, size3d, cell, cells](const tbb::blocked_range<int>& b)
 		{
 			for (int i = b.begin(); i < b.end(); ++i)
 			{
-				Pos3i scenter;
-				int id = v_centers[i];
-				Pos3i::Int_To_Pos3i(id, size3d.x, size3d.y, size3d.z, scenter);
-				bool merged = false;
-				for (int k = 0; k < size; ++k)
-				{
-					Box3D& box = boxes[k];
-					if (box.In(scenter))
-					{
-						mtx.lock();
-						this->Extend_Box(box, scenter, diam);
-						kdtree[k].insert(id);
-						merged = true;
-						k = (int)kdtree.size();
-						mtx.unlock();
-					}
-				}
-				if (!merged)
-				{
-					mtx.lock();
-					set<int> nset;
-					nset.insert(id);
-					kdtree.push_back(nset);
-					Box3D box;
-					this->Set_Box(box, scenter, diam);
-					boxes.push_back(box);
-					size = (int)kdtree.size();
-					mtx.unlock();
-				}
+				rw::Pos3i cp;
+				Pos3i::Int_To_Pos3i(v_centers[i], size3d.x, size3d.y, size3d.z, cp);
+				grid[i].first = cp.x / cell + (cp.y / cell)*cells.x + (cp.z / cell)*cells.x*cells.y;
+				grid[i].second = i;
 			}
 		});
-
+		tbb::parallel_sort(grid.begin(), grid.end());
 		if (pgdlg)
 		{
 			pgdlg->Update(this->_step, std::string("Fusioning overlapping centers from spheres of diameter ") + std::to_string(diam));
 		}
-
-		int dstc = this->Square_Cluster_Distance(diam);
-
-		tbb::parallel_for(tbb::blocked_range<int>(0, (int)kdtree.size(), BCHUNK_SIZE),
-			[this, diam, &kdtree, &fusion_map, &mtx,size3d,dstc](const tbb::blocked_range<int>& b)
+		tbb::parallel_for(tbb::blocked_range<int>(0, (int)v_centers.size(), BCHUNK_SIZE),
+			[this, &pmap, &v_centers, &grid, size3d, cell, cells, dstc](const tbb::blocked_range<int>& b)
 		{
-			for (int k = b.begin(); k < b.end(); ++k)
+			for (int i = b.begin(); i < b.end(); ++i)
 			{
-				set<int>::iterator ii = kdtree[k].begin();
-				while (ii != kdtree[k].end())
+				rw::Pos3i ip;
+				Pos3i::Int_To_Pos3i(v_centers[i], size3d.x, size3d.y, size3d.z, ip);
+				rw::Pos3i ic;
+				ic.x = ip.x / cell;
+				ic.y = ip.y / cell;
+				ic.z = ip.z / cell;
+				for (int dz = max(ic.z - 1, 0); dz <= min(ic.z + 1, cells.z - 1); ++dz)
 				{
-					Pos3i ip;
-					Pos3i::Int_To_Pos3i(*ii, size3d.x, size3d.y, size3d.z, ip);
-					set<int>::iterator jj = ii;
-					++jj;
-					while (jj != kdtree[k].end())
+					for (int dy = max(ic.y - 1, 0); dy <= min(ic.y + 1, cells.y - 1); ++dy)
 					{
-						Pos3i jp;
-						Pos3i::Int_To_Pos3i(*jj, size3d.x, size3d.y, size3d.z, jp);
-						if (ip.Square_Distance(jp) < dstc)
+						for (int dx = max(ic.x - 1, 0); dx <= min(ic.x + 1, cells.x - 1); ++dx)
 						{
-							map<int, int>::iterator fmi = fusion_map.find((*ii));
-							if (fmi == fusion_map.end())
-							{
-								mtx.lock();
-								fusion_map.insert(std::pair<int, int>(*jj, *ii));
-								mtx.unlock();
-							}
-							else
+							int key = dx + dy*cells.x + dz*cells.x*cells.y;
+							vector<std::pair<int, int> >::const_iterator itr =
+								std::lower_bound(grid.begin(), grid.end(), std::pair<int, int>(key, -1));
+							while ((itr != grid.end()) && (itr->first == key))
 							{
-								mtx.lock();
-								int vox = fmi->second;
-								fusion_map.insert(std::pair<int, int>(*jj, vox));
-								mtx.unlock();
+								int j = itr->second;
+								if (j > i)
+								{
+									rw::Pos3i jp;
+									Pos3i::Int_To_Pos3i(v_centers[j], size3d.x, size3d.y, size3d.z, jp);
+									if (ip.Square_Distance(jp) < dstc)
+									{
+										this->_fusion.Union(pmap.Rank(v_centers[i]), pmap.Rank(v_centers[j]));
+									}
+								}
+								++itr;
 							}
 						}
-						++jj;
 					}
-					++ii;
 				}
 			}
 		});
-		this->Apply_Fusion_Map(fusion_map, diam);
+		this->Apply_Fusion(diam);
 	}
 
 	void BinaryImageClusterer::Set_Positive_Distances()
@@ -549,11 +430,11 @@ namespace rw
 				Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, pp);
 				if (this->Image()(pp) == 0)
 				{
-					map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if (ii != this->Pore_Map().end())
+					int ii = this->Pore_Map().Rank(i);
+					if (ii >= 0)
 					{
-						ii->second.diam_max = abs(ii->second.diam_max);
-						ii->second.dist_min = abs(ii->second.dist_min);
+						this->Pore_Map().Diam_Max(ii) = abs(this->Pore_Map().Diam_Max(ii));
+						this->Pore_Map().Dist_Min(ii) = abs(this->Pore_Map().Dist_Min(ii));
 					}
 				}
 			}
@@ -563,6 +444,7 @@ namespace rw
 	void BinaryImageClusterer::Expand_Diameter(BinaryImage::ProgressAdapter* pgdlg)
 	{
 		this->_step = 0;
+		this->_fusion.Reset(this->Pore_Map().Size());
 		int rad = this->Max_Radius();
 		this->Set_Rad_Min_To_Max();
 		while (rad > 0)
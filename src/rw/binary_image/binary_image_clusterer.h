@@ -3,8 +3,8 @@
 
 #include "binary_image_executor.h"
 #include "binary_image_group_mask.h"
+#include "binary_image_union_find.h"
 #include "math_la/mdefs.h"
-#include "box3d.h"
 #include <map>
 
 namespace rw
@@ -15,6 +15,11 @@ namespace rw
 	{
 	private:
 		int _step;
+
+		/**
+		* Fusion of the clusters, by the rank of their centers in the pore map
+		*/
+		BinaryImageUnionFind _fusion;
 	protected:
 		void Set_Rad_Min_To_Max();
 		void Expand_Diameter(BinaryImage::ProgressAdapter* pgdlg);
@@ -22,20 +27,23 @@ namespace rw
 		void Group_Clusters(int diam, BinaryImage::ProgressAdapter* pgdlg);
 
 		/**
-		* When clusters are grouped, a fusion map is constructed to combine overlapping clusters.
-		* This method applies the map and classify the voxels, and this process is irreversible.
-		* @param fusion Fusion map constructed
-		* @param rad Radius of all overlapping spheres classified
+		* When clusters are grouped, the sets of overlapping clusters are joined. This method sets the cluster of
+		* the voxels to the root of their set, in one pass, and this process is irreversible.
+		* @param diam Diameter of all overlapping spheres classified, zero for all the voxels
 		*/
-		void Apply_Fusion_Map(const map<int, int>& fusion, int diam);
-		void Apply_Fusion_Map(const map<int, int>& fusion);
+		void Apply_Fusion(int diam);
 
 
 		void Set_Positive_Distances();
 		uint Number_Of_Steps() const;
+
+		/**
+		* Moves every pore voxel to the cluster of largest diameter among its neighbors, and joins the clusters
+		* of equal diameter that meet at a voxel. It takes two passes over the pore map, without locks, and the
+		* fusion pass.
+		* @param diam Diameter below which the neighbors are not clustered
+		*/
 		void Recluster(int diam, BinaryImage::ProgressAdapter* pgdlg);
-		virtual void Extend_Box(rw::Box3D& box, const rw::Pos3i& center, int diam) const;
-		virtual void Set_Box(rw::Box3D& box, const Pos3i& center, int diam) const;
 		virtual int Square_Cluster_Distance(int diam) const;
 	public:
 		BinaryImageClusterer(BinaryImageExecutor& executor);
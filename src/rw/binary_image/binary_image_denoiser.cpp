@@ -1,8 +1,9 @@
-#include <tbb/spin_mutex.h>
 #include <tbb/parallel_for.h>
+#include <tbb/spin_mutex.h>
 #include <algorithm>
 #include "binary_image_denoiser.h"
 #include "binary_image_opener.h"
+#include "binary_image_brick_morphology.h"
 
 namespace rw
 {
@@ -17,9 +18,12 @@ namespace rw
 		this->Set_Open(false);
 		this->Init();
 		this->_blockSize = BLOCK1;
+#ifdef GPU_AMP
 		this->_gpuArray = 0;
+#endif
 	};
 
+#ifdef GPU_AMP
 	void BinaryImageDenoiser::Load()
 	{
 		if (this->_gpuArray)
@@ -39,6 +43,15 @@ namespace rw
 			delete this->_gpuArray;
 		}
 	}
+#else
+	void BinaryImageDenoiser::Load()
+	{
+	}
+
+	BinaryImageDenoiser::~BinaryImageDenoiser()
+	{
+	}
+#endif
 
 	void BinaryImageDenoiser::Set_Diameter(int diam)
 	{
@@ -55,129 +68,18 @@ namespace rw
 
 	void BinaryImageDenoiser::Pick_Centers_To_Dilate()
 	{
-		rw::Pos3i size3d = this->Size_3D();
-		this->_cornerBorder.clear();
-		this->_surfaceBorder.clear();
-		int black_size = this->Image().Black_Voxels();
-		this->_cornerBorder.reserve((int)black_size);
-		this->_surfaceBorder.reserve((int)black_size);
-		int tot = size3d.x*size3d.y*size3d.z;
-		tbb::spin_mutex mtx;
-		tbb::parallel_for(tbb::blocked_range<int>(0, tot, max(tot / 128, BCHUNK_SIZE)),
-			[this, &mtx, size3d](const tbb::blocked_range<int>& b)
-		{
-			for (int i = b.begin(); i < b.end(); ++i)
-			{
-				int idc = 0;
-				Pos3i pp;
-				Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, pp);
-				uint v = this->Image()(pp);
-				if (v > 0)
-				{
-					int pborder = 0;
-					char surround[27];
-					for (int dxy = 0; dxy < 27; ++dxy)
-					{
-						surround[dxy] = 1;
-						int dz = (dxy / 9) - 1;
-						int dy = (dxy / 3) % 3 - 1;
-						int dx = dxy % 3 - 1;
-						Pos3i ppc = pp;
-						ppc.x = ppc.x + dx;
-						ppc.y = ppc.y + dy;
-						ppc.z = ppc.z + dz;
-						if ((!((ppc.x < 0) || (ppc.x >= size3d.x)
-							|| (ppc.y < 0) || (ppc.y >= size3d.y)
-							|| (ppc.z < 0) || (ppc.z >= size3d.z))) && (this->Image()(ppc) == 0))
-						{
-							surround[dxy] = 0;
-							++pborder;
-						}
-					}
-					if (pborder > 0)
-					{
-						if (((surround[22] > 0) && (surround[4] > 0)) ||
-							((surround[12] > 0) && (surround[14] > 0)) ||
-							((surround[16] > 0) && (surround[10] > 0)))
-						{
-							mtx.lock();
-							this->_surfaceBorder.push_back(i);
-							mtx.unlock();
-						}
-						else
-						{
-							mtx.lock();
-							this->_cornerBorder.push_back(i);
-							mtx.unlock();
-						}
-					}
-				}
-			}
-		});
+		BinaryImageBrickMorphology morphology(this->Size_3D());
+		morphology.Border(this->Image_Buffer().data(), true, this->_cornerBorder, this->_surfaceBorder);
 		this->Set_Border(true);
 	}
 
 	void BinaryImageDenoiser::Pick_Centers_To_Erode()
 	{
-		rw::Pos3i size3d = this->Size_3D();
-		int diam = this->_diameter;
-		tbb::spin_mutex mtx;
-		this->_centersToErodeCorner.clear();
-		this->_centersToErodeSurface.clear();
-		int tot = size3d.x*size3d.y*size3d.z;
-		vec(uint)& dilated = this->Image_Buffer();
-		tbb::parallel_for(tbb::blocked_range<int>(0, tot, max(tot / 128, BCHUNK_SIZE)),
-			[this, &mtx, diam, &dilated, size3d](const tbb::blocked_range<int>& b)
-		{
-			for (int i = b.begin(); i < b.end(); ++i)
-			{
-				rw::Pos3i pp;
-				Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, pp);
-				uint cc = BinaryImageExecutor::Accessor_Read(dilated, pp, size3d);
-				if (cc == 0)
-				{
-					int pborder = 0;
-					char surround[27];
-					for (int dxy = 0; dxy < 27; ++dxy)
-					{
-						surround[dxy] = 0;
-						int dz = (dxy / 9) - 1;
-						int dy = (dxy / 3) % 3 - 1;
-						int dx = dxy % 3 - 1;
-						Pos3i ppc = pp;
-						ppc.x = ppc.x + dx;
-						ppc.y = ppc.y + dy;
-						ppc.z = ppc.z + dz;
-						if ((!((ppc.x < 0) || (ppc.x >= size3d.x)
-							|| (ppc.y < 0) || (ppc.y >= size3d.y)
-							|| (ppc.z < 0) || (ppc.z >= size3d.z))) && (this->Image()(ppc) > 0))
-						{
-							surround[dxy] = 1;
-							++pborder;
-						}
-					}
-					if (pborder > 0)
-					{
-						if (((surround[22] == 0) && (surround[4] == 0)) ||
-							((surround[12] == 0) && (surround[14] == 0)) ||
-							((surround[16] == 0) && (surround[10] == 0)))
-						{
-							mtx.lock();
-							this->_centersToErodeSurface.push_back(i);
-							mtx.unlock();
-						}
-						else
-						{
-							mtx.lock();
-							this->_centersToErodeCorner.push_back(i);
-							mtx.unlock();
-						}
-					}
-				}
-			}
-		});
+		BinaryImageBrickMorphology morphology(this->Size_3D());
+		morphology.Border(this->Image_Buffer().data(), false, this->_centersToErodeCorner, this->_centersToErodeSurface);
 	}
 
+#ifdef GPU_AMP
 	void BinaryImageDenoiser::Erode()
 	{
 		int diam = this->_diameter;
@@ -363,9 +265,66 @@ namespace rw
 			concurrency::copy(a, this->Image_Buffer().begin());
 		}
 	}
+#else
+	/**
+	* Number of mutexes that guard the words of the image buffer, a voxel taking the one of its word index
+	* modulo this number
+	*/
+	const int WORD_MUTEXES = 1024;
+
+	void BinaryImageDenoiser::Apply_Mask(const vec(int)& centers, const vec(rw::Pos3i)& mask, bool value)
+	{
+		rw::Pos3i size3d = this->Size_3D();
+		vec(uint)& a = this->Image_Buffer();
+		vector<tbb::spin_mutex> mtx(WORD_MUTEXES);
+		tbb::parallel_for(tbb::blocked_range<int>(0, (int)centers.size(), SCHUNK_SIZE), [size3d, &a, &mask, &centers, &mtx, value](const tbb::blocked_range<int>& b)
+		{
+			for (int k = b.begin(); k < b.end(); ++k)
+			{
+				rw::Pos3i pcenter;
+				Pos3i::Int_To_Pos3i(centers[k], size3d.x, size3d.y, size3d.z, pcenter);
+				for (int i = 0; i < (int)mask.size(); ++i)
+				{
+					rw::Pos3i mcenter = pcenter + mask[i];
+					if (!((mcenter.x < 0) || (mcenter.x >= size3d.x)
+						|| (mcenter.y < 0) || (mcenter.y >= size3d.y)
+						|| (mcenter.z < 0) || (mcenter.z >= size3d.z)))
+					{
+						uint bk = (mcenter.x >> 2) + (mcenter.y >> 2)*((size3d.x >> 2) + 1)
+							+ (mcenter.z >> 2)*((size3d.x >> 2) + 1)*((size3d.y >> 2) + 1);
+						uint pz = mcenter.z - ((mcenter.z >> 2) << 2);
+						uint w = (bk << 1) + (pz >> 1);
+						uint bit = 0x01 << ((mcenter.x - ((mcenter.x >> 2) << 2)) +
+							((mcenter.y - ((mcenter.y >> 2) << 2)) << 2) + ((pz & 0x01) << 4));
+						tbb::spin_mutex::scoped_lock lock(mtx[w % WORD_MUTEXES]);
+						a[w] = (value) ? (a[w] | bit) : (a[w] & (~bit));
+					}
+				}
+			}
+		});
+	}
+
+	void BinaryImageDenoiser::Erode()
+	{
+		int diam = this->_diameter;
+		this->Apply_Mask(this->_centersToErodeSurface, this->Surface_Mask(diam), false);
+		this->Apply_Mask(this->_centersToErodeCorner, this->Corner_Mask(diam), false);
+	}
+
+	void BinaryImageDenoiser::Dilate()
+	{
+		int diam = this->_diameter;
+		if (diam > 0)
+		{
+			this->Apply_Mask(this->_surfaceBorder, this->Surface_Mask(diam), true);
+			this->Apply_Mask(this->_cornerBorder, this->Corner_Mask(diam), true);
+		}
+	}
+#endif
 
 	void BinaryImageDenoiser::Execute(BinaryImage::ProgressAdapter* pgdlg)
 	{
+		this->Invalidate_Derived();
 		if (pgdlg)
 		{
 			pgdlg->Set_Range(this->Number_Of_Steps());
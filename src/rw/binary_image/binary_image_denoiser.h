@@ -1,7 +1,6 @@
 #ifndef BINARY_IMAGE_DENOISER_H
 #define BINARY_IMAGE_DENOISER_H
 
-#include <amp.h>
 #include "binary_image_executor.h"
 #include "binary_image_mask_handler.h"
 
@@ -17,7 +16,17 @@ namespace rw
 		vec(int) _centersToErodeSurface;
 		vec(int) _cornerBorder;
 		vec(int) _surfaceBorder;
+#ifdef GPU_AMP
 		concurrency::array<uint, 1>* _gpuArray;
+#else
+		/**
+		* Sets or clears the voxels of the mask around every center, on the image buffer
+		* @param centers Centers, as indices of the image
+		* @param mask Offsets of the mask from its center
+		* @param value Value written to the voxels
+		*/
+		void Apply_Mask(const vec(int)& centers, const vec(rw::Pos3i)& mask, bool value);
+#endif
 
 		void Pick_Centers_To_Erode();
 		void Pick_Centers_To_Dilate();
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <math.h>
+#include <limits>
+#include <tbb/parallel_for.h>
+#include "binary_image_distance.h"
+
+namespace rw
+{
+	/**
+	* Position of a voxel in a bricked buffer (see BinaryImage::Accesor_Read)
+	*/
+	static inline void Brick_Bit(const rw::Pos3i& size, int x, int y, int z, uint& word, uint& bit)
+	{
+		uint b = (x >> 2) + (y >> 2)*((size.x >> 2) + 1) + (z >> 2)*((size.x >> 2) + 1)*((size.y >> 2) + 1);
+		word = 2 * b + ((z & 3) >> 1);
+		bit = 0x01 << ((x & 3) + ((y & 3) << 2) + ((z & 1) << 4));
+	}
+
+	BinaryImageDistance::BinaryImageDistance()
+	{
+		this->_image = 0;
+		this->_maxDiameter = 0;
+	}
+
+	void BinaryImageDistance::Execute(const BinaryImage& img)
+	{
+		this->_image = &img;
+		this->_size.x = img.Width();
+		this->_size.y = img.Height();
+		this->_size.z = img.Depth();
+		int length = this->_size.x*this->_size.y*this->_size.z;
+		this->_dist2.assign(length, 0);
+		this->_diameter.assign(length, 0);
+		this->Transform_Rows();
+		this->Transform_Columns();
+		this->Transform_Layers();
+		/**
+		* Largest diameter of every squared distance: the erosion bounds increase with the diameter
+		*/
+		vec(uchar) table(DIST2_MAX + 1, 0);
+		int diam = 1;
+		for (int d2 = 0; d2 <= DIST2_MAX; ++d2)
+		{
+			while ((diam <= OPEN_MAX_DIAMETER) && (d2 > BinaryImageDistance::Erosion_Bound(diam)))
+			{
+				diam = diam + 2;
+			}
+			table[d2] = (diam > 1) ? (uchar)(diam - 2) : (uchar)0;
+		}
+		vec(int) largest(this->_size.z, 0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->_size.z, 1), [this, &table, &largest](const tbb::blocked_range<int>& b)
+		{
+			int plane = this->_size.x*this->_size.y;
+			for (int z = b.begin(); z < b.end(); ++z)
+			{
+				for (int i = z * plane; i < (z + 1)*plane; ++i)
+				{
+					uchar d = table[this->_dist2[i]];
+					this->_diameter[i] = d;
+					largest[z] = std::max(largest[z], (int)d);
+				}
+			}
+		});
+		this->_maxDiameter = 0;
+		for (int z = 0; z < this->_size.z; ++z)
+		{
+			this->_maxDiameter = std::max(this->_maxDiameter, largest[z]);
+		}
+	}
+
+	void BinaryImageDistance::Transform_Rows()
+	{
+		const uint* buffer = this->_image->Data();
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->_size.y*this->_size.z, BCHUNK_SIZE), [this, buffer](const tbb::blocked_range<int>& b)
+		{
+			static const int Far = 1 << 20;
+			vec(int) g(this->_size.x);
+			for (int r = b.begin(); r < b.end(); ++r)
+			{
+				int y = r % this->_size.y;
+				int z = r / this->_size.y;
+				int prev = Far;
+				for (int x = 0; x < this->_size.x; ++x)
+				{
+					uint word, bit;
+					Brick_Bit(this->_size, x, y, z, word, bit);
+					prev = (buffer[word] & bit) ? 0 : std::min(prev + 1, Far);
+					g[x] = prev;
+				}
+				prev = Far;
+				unsigned short* row = &this->_dist2[r * this->_size.x];
+				for (int x = this->_size.x - 1; x >= 0; --x)
+				{
+					prev = (g[x] == 0) ? 0 : std::min(prev + 1, Far);
+					int gx = std::min(g[x], prev);
+					row[x] = (gx < 256) ? (unsigned short)(gx * gx) : (unsigned short)DIST2_MAX;
+				}
+			}
+		});
+	}
+
+	void BinaryImageDistance::Transform_Columns()
+	{
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->_size.z, 1), [this](const tbb::blocked_range<int>& b)
+		{
+			int n = this->_size.y;
+			vec(uint) f(n);
+			vec(uint) d(n);
+			vec(int) v(n);
+			vec(double) s(n + 1);
+			for (int z = b.begin(); z < b.end(); ++z)
+			{
+				for (int x = 0; x < this->_size.x; ++x)
+				{
+					unsigned short* column = &this->_dist2[z * this->_size.x * this->_size.y + x];
+					for (int y = 0; y < n; ++y)
+					{
+						f[y] = column[y * this->_size.x];
+					}
+					BinaryImageDistance::Envelope(f.data(), n, d.data(), v.data(), s.data());
+					for (int y = 0; y < n; ++y)
+					{
+						column[y * this->_size.x] = (unsigned short)d[y];
+					}
+				}
+			}
+		});
+	}
+
+	void BinaryImageDistance::Transform_Layers()
+	{
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->_size.y, 1), [this](const tbb::blocked_range<int>& b)
+		{
+			int n = this->_size.z;
+			int plane = this->_size.x * this->_size.y;
+			vec(uint) f(n);
+			vec(uint) d(n);
+			vec(int) v(n);
+			vec(double) s(n + 1);
+			for (int y = b.begin(); y < b.end(); ++y)
+			{
+				for (int x = 0; x < this->_size.x; ++x)
+				{
+					unsigned short* line = &this->_dist2[y * this->_size.x + x];
+					for (int z = 0; z < n; ++z)
+					{
+						f[z] = line[z * plane];
+					}
+					BinaryImageDistance::Envelope(f.data(), n, d.data(), v.data(), s.data());
+					for (int z = 0; z < n; ++z)
+					{
+						line[z * plane] = (unsigned short)d[z];
+					}
+				}
+			}
+		});
+	}
+
+	void BinaryImageDistance::Envelope(const uint* f, int n, uint* d, int* v, double* s)
+	{
+		int k = -1;
+		for (int q = 0; q < n; ++q)
+		{
+			if (f[q] >= DIST2_MAX)
+			{
+				continue;
+			}
+			double sq = -std::numeric_limits<double>::max();
+			while (k >= 0)
+			{
+				int p = v[k];
+				sq = ((double)f[q] + (double)q*(double)q - (double)f[p] - (double)p*(double)p) / (2.0*(double)(q - p));
+				if (sq > s[k])
+				{
+					break;
+				}
+				--k;
+			}
+			if (k < 0)
+			{
+				sq = -std::numeric_limits<double>::max();
+			}
+			++k;
+			v[k] = q;
+			s[k] = sq;
+		}
+		if (k < 0)
+		{
+			for (int q = 0; q < n; ++q)
+			{
+				d[q] = DIST2_MAX;
+			}
+			return;
+		}
+		int j = 0;
+		for (int q = 0; q < n; ++q)
+		{
+			while ((j < k) && (s[j + 1] < (double)q))
+			{
+				++j;
+			}
+			uint dq = (uint)((q - v[j])*(q - v[j])) + f[v[j]];
+			d[q] = std::min(dq, (uint)DIST2_MAX);
+		}
+	}
+
+	void BinaryImageDistance::Local_Thickness(vec(uchar)& thickness, vec(int)& cluster) const
+	{
+		rw::Pos3i size = this->_size;
+		int plane = size.x*size.y;
+		thickness.assign(plane*size.z, 0);
+		cluster.assign(plane*size.z, -1);
+		/**
+		* Centers of the distance ridge, by layer. A center is skipped when the sphere of a face neighbor
+		* contains its sphere: the ball of a neighbor contains it if it is larger by 2, the cube and the cross
+		* need a margin of 4.
+		*/
+		vector<vec(int)> centers(size.z);
+		tbb::parallel_for(tbb::blocked_range<int>(0, size.z, 1), [this, size, plane, &centers](const tbb::blocked_range<int>& b)
+		{
+			static const int Neighbor[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+			for (int z = b.begin(); z < b.end(); ++z)
+			{
+				for (int y = 0; y < size.y; ++y)
+				{
+					for (int x = 0; x < size.x; ++x)
+					{
+						int i = z * plane + y * size.x + x;
+						int d = this->_diameter[i];
+						if (d == 0)
+						{
+							continue;
+						}
+						int margin = (d >= 5) ? 2 : 4;
+						bool ridge = true;
+						for (int k = 0; (k < 6) && (ridge); ++k)
+						{
+							int nx = x + Neighbor[k][0];
+							int ny = y + Neighbor[k][1];
+							int nz = z + Neighbor[k][2];
+							if ((nx >= 0) && (nx < size.x) && (ny >= 0) && (ny < size.y) && (nz >= 0) && (nz < size.z))
+							{
+								ridge = ((int)this->_diameter[nz * plane + ny * size.x + nx] < d + margin);
+							}
+						}
+						if (ridge)
+						{
+							centers[z].push_back(i);
+						}
+					}
+				}
+			}
+		});
+		int rmax = (this->_maxDiameter < 5) ? 1 : this->_maxDiameter / 2;
+		tbb::parallel_for(tbb::blocked_range<int>(0, size.z, 1), [this, size, plane, rmax, &centers, &thickness, &cluster](const tbb::blocked_range<int>& b)
+		{
+			for (int z = b.begin(); z < b.end(); ++z)
+			{
+				uchar* tz = &thickness[z * plane];
+				int* cz = &cluster[z * plane];
+				for (int lz = std::max(z - rmax, 0); lz <= std::min(z + rmax, size.z - 1); ++lz)
+				{
+					int dz = z - lz;
+					const vec(int)& layer = centers[lz];
+					for (int k = 0; k < (int)layer.size(); ++k)
+					{
+						int c = layer[k];
+						int d = this->_diameter[c];
+						int r = (d < 5) ? 1 : d / 2;
+						if (abs(dz) > r)
+						{
+							continue;
+						}
+						int x0 = c % size.x;
+						int y0 = (c / size.x) % size.y;
+						for (int y = std::max(y0 - r, 0); y <= std::min(y0 + r, size.y - 1); ++y)
+						{
+							for (int x = std::max(x0 - r, 0); x <= std::min(x0 + r, size.x - 1); ++x)
+							{
+								if (BinaryImageDistance::In_Mask(d, x - x0, y - y0, dz))
+								{
+									int j = y * size.x + x;
+									if ((d > (int)tz[j]) || ((d == (int)tz[j]) && (c < cz[j])))
+									{
+										tz[j] = (uchar)d;
+										cz[j] = c;
+									}
+								}
+							}
+						}
+					}
+				}
+				for (int j = 0; j < plane; ++j)
+				{
+					if (tz[j] == 0)
+					{
+						tz[j] = 1;
+					}
+				}
+			}
+		});
+	}
+
+	void BinaryImageDistance::Distance_Map(vec(uchar)& dist) const
+	{
+		dist.assign(this->_dist2.size(), 0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, (int)this->_dist2.size(), DCHUNK_SIZE), [this, &dist](const tbb::blocked_range<int>& b)
+		{
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				int d = (int)sqrt((double)this->_dist2[i]);
+				while ((d + 1)*(d + 1) <= (int)this->_dist2[i])
+				{
+					++d;
+				}
+				dist[i] = (uchar)std::min(d, 255);
+			}
+		});
+	}
+}
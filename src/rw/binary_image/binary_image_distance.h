@@ -0,0 +1,173 @@
+#ifndef BINARY_IMAGE_DISTANCE_H
+#define BINARY_IMAGE_DISTANCE_H
+
+#include <stdlib.h>
+#include "math_la/mdefs.h"
+#include "binary_image.h"
+
+#define DIST2_MAX		65535
+#define OPEN_MAX_DIAMETER	127
+
+namespace rw
+{
+	/**
+	* Opens a binary image on the CPU from its exact Euclidean distance transform, instead of dilating the
+	* solid by every diameter. A pore voxel survives the opening by a diameter when its squared distance to the
+	* nearest solid voxel exceeds the erosion bound of the diameter (see Erosion_Bound), so the distance
+	* transform gives, in one pass, the largest diameter at which every voxel survives. The local thickness
+	* then paints the maximal inscribed sphere of every center on the distance ridge.
+	*
+	* The transform is separable (rows, columns and layers), linear in the number of voxels, and does not
+	* depend on the size of the pores. The voxels outside the image are not solid.
+	*/
+	class BinaryImageDistance
+	{
+	private:
+		/**
+		* Opened image
+		*/
+		const BinaryImage* _image;
+
+		/**
+		* Size of the image
+		*/
+		rw::Pos3i _size;
+
+		/**
+		* Squared distance from every voxel to the nearest solid voxel, saturated at DIST2_MAX
+		*/
+		vec(unsigned short) _dist2;
+
+		/**
+		* Largest diameter at which every voxel survives the opening, zero if it never does
+		*/
+		vec(uchar) _diameter;
+
+		/**
+		* Largest diameter of the image
+		*/
+		int _maxDiameter;
+	protected:
+		/**
+		* Distance along the rows (x) to the nearest solid voxel
+		*/
+		void Transform_Rows();
+
+		/**
+		* Lower envelope transform along the columns (y) of every layer
+		*/
+		void Transform_Columns();
+
+		/**
+		* Lower envelope transform along the layers (z)
+		*/
+		void Transform_Layers();
+
+		/**
+		* Squared distance transform of a line, as the lower envelope of the parabolas rooted at its samples
+		* @param f Squared distances of the line samples, DIST2_MAX if there is no solid voxel
+		* @param n Number of samples
+		* @param d Transformed squared distances
+		* @param v Workspace of n roots
+		* @param s Workspace of n + 1 boundaries
+		*/
+		static void Envelope(const uint* f, int n, uint* d, int* v, double* s);
+	public:
+		BinaryImageDistance();
+
+		/**
+		* Computes the distance transform of an image, and the largest diameter of every voxel
+		* @param img Binary image
+		*/
+		void Execute(const BinaryImage& img);
+
+		/**
+		* @return The largest squared distance to the solid removed by the opening of a diameter, as the
+		* masks of the opening define it: the cross for diameter 1, the cube for diameter 3, and the
+		* ball 4*|v|^2 <= diam^2 otherwise
+		* @param diam Odd diameter
+		*/
+		static int Erosion_Bound(int diam);
+
+		/**
+		* @return TRUE if an offset belongs to the opening mask of a diameter
+		* @param diam Odd diameter
+		*/
+		static bool In_Mask(int diam, int dx, int dy, int dz);
+
+		/**
+		* @return Squared distance from a voxel to the nearest solid voxel
+		* @param i Voxel, indexed as in Pos3i::Pos3i_To_Int
+		*/
+		uint Square_Distance(int i) const;
+
+		/**
+		* @return Largest diameter at which a voxel survives the opening, zero if it never does
+		* @param i Voxel, indexed as in Pos3i::Pos3i_To_Int
+		*/
+		int Diameter(int i) const;
+
+		/**
+		* @return Largest diameter of the image
+		*/
+		int Max_Diameter() const;
+
+		/**
+		* Evaluates the Euclidean distance from every voxel to the nearest solid voxel, rounded down
+		* @param dist Distance of every voxel, saturated at 255, zero on the solid
+		*/
+		void Distance_Map(vec(uchar)& dist) const;
+
+		/**
+		* Evaluates the local thickness: the diameter of the largest opening sphere that contains every voxel.
+		* Centers whose sphere lies inside the sphere of a neighbor are skipped. Ties are broken by the
+		* smallest center, so the result does not depend on the number of threads.
+		* @param thickness Diameter of the largest sphere of every voxel, 1 if no sphere contains it
+		* @param cluster Center of the largest sphere of every voxel, -1 if no sphere contains it
+		*/
+		void Local_Thickness(vec(uchar)& thickness, vec(int)& cluster) const;
+	};
+
+	inline uint BinaryImageDistance::Square_Distance(int i) const
+	{
+		return(this->_dist2[i]);
+	}
+
+	inline int BinaryImageDistance::Diameter(int i) const
+	{
+		return(this->_diameter[i]);
+	}
+
+	inline int BinaryImageDistance::Max_Diameter() const
+	{
+		return(this->_maxDiameter);
+	}
+
+	inline int BinaryImageDistance::Erosion_Bound(int diam)
+	{
+		if (diam < 3)
+		{
+			return(1);
+		}
+		if (diam == 3)
+		{
+			return(3);
+		}
+		return((diam * diam) / 4);
+	}
+
+	inline bool BinaryImageDistance::In_Mask(int diam, int dx, int dy, int dz)
+	{
+		if (diam < 3)
+		{
+			return(abs(dx) + abs(dy) + abs(dz) <= 1);
+		}
+		if (diam == 3)
+		{
+			return((abs(dx) <= 1) && (abs(dy) <= 1) && (abs(dz) <= 1));
+		}
+		return(4 * (dx*dx + dy*dy + dz*dz) <= diam * diam);
+	}
+}
+
+#endif
@@ -3,7 +3,6 @@
 
 #include "binary_image.h"
 #include "math_la/file/binary.h"
-#include <amp.h>
 namespace rw
 {
 	class BinaryImageExecutor
@@ -26,12 +25,22 @@ namespace rw
 		void Set_Open(bool t);
 		void Set_Border(bool t);
 		void Set_Denoised(bool t);
-		map<int, rw::BinaryImage::Pore_Voxel>& Pore_Map();
+		BinaryImagePoreMap& Pore_Map();
+
+		/**
+		* @return The buffer of the image. An executor that writes it calls Invalidate_Derived first.
+		*/
 		vec(uint)& Image_Buffer();
-		vec(uint)& Processed_Image(int rad);
+
+		/**
+		* Releases the summed volume table and the distance map of the image, which an executor that writes the
+		* buffer invalidates
+		*/
+		void Invalidate_Derived();
+		OpenedImageBuffer Processed_Image(int rad);
 		void Set_Processed_Image(vec(uint)* buffer, int rad);
 		void Rebuild_Pore_Map();
-		static uint Accessor_Read(vec(uint)& vtx, const rw::Pos3i& pp, const rw::Pos3i& size);
+		static uint Accessor_Read(const vec(uint)& vtx, const rw::Pos3i& pp, const rw::Pos3i& size);
 		void Init();
 	public:
 		BinaryImageExecutor(rw::BinaryImage* image);
@@ -48,6 +57,7 @@ namespace rw
 		virtual uint Number_Of_Steps() const;
 		int Max_Radius() const;
 
+#ifdef GPU_AMP
 		static concurrency::array<uint, 1>* Create_GPU_Texture(const rw::BinaryImage& img);
 
 		/**
@@ -57,9 +67,11 @@ namespace rw
 		* @param size Three dimension size of the texture
 		*/
 		static uint Accesor_Read(const concurrency::array<uint, 1>& vtx, const rw::Pos3i& pp, const rw::Pos3i& size) GPUP;
-
+#endif
 	};
 
+#ifdef GPU_AMP
+
 	inline uint BinaryImageExecutor::Accesor_Read(const concurrency::array<uint, 1>& vtx, const rw::Pos3i& pp, const rw::Pos3i& size) GPUP
 	{
 		uint b = (pp.x >> 2) + (pp.y >> 2)*((size.x >> 2) + 1)
@@ -75,12 +87,18 @@ namespace rw
 		concurrency::array<uint, 1>* r = new concurrency::array<uint, 1>((int)img._buffer->size(),img._buffer->begin());
 		return(r);
 	}
+#endif
 
 	inline vec(uint)& BinaryImageExecutor::Image_Buffer()
 	{
 		return(*this->_image->_buffer);
 	}
 
+	inline void BinaryImageExecutor::Invalidate_Derived()
+	{
+		this->_image->Clear_Derived();
+	}
+
 	inline void BinaryImageExecutor::Set_Defined(bool t)
 	{
 		this->_defined = t;
@@ -129,7 +147,7 @@ namespace rw
 		}
 	}
 
-	inline map<int, rw::BinaryImage::Pore_Voxel>& BinaryImageExecutor::Pore_Map()
+	inline BinaryImagePoreMap& BinaryImageExecutor::Pore_Map()
 	{
 		return(this->_image->_poreMap);
 	}
@@ -214,9 +232,9 @@ namespace rw
 		this->_image->Build_Pore_Map();
 	}
 
-	inline vec(uint)& BinaryImageExecutor::Processed_Image(int rad)
+	inline OpenedImageBuffer BinaryImageExecutor::Processed_Image(int rad)
 	{
-		return(*this->_image->_processedImages[rad]);
+		return(this->_image->Opened_Buffer(rad));
 	}
 
 	inline rw::Pos3i BinaryImageExecutor::Size_3D() const
@@ -235,24 +253,18 @@ namespace rw
 
 	inline void BinaryImageExecutor::Set_Processed_Image(vec(uint)* buffer, int rad)
 	{
-		map<int, vec(uint)*>::iterator itr = this->_image->_processedImages.find(rad);
-		if (itr != this->_image->_processedImages.end())
-		{
-			delete itr->second;
-			this->_image->_processedImages.erase(rad);
-		}
-		this->_image->_processedImages[rad] = buffer;
+		this->_image->Fold_Opened_Image(*buffer, rad);
+		delete buffer;
 	}
 
-	inline uint BinaryImageExecutor::Accessor_Read(vec(uint)& vtx, const rw::Pos3i& pp, const rw::Pos3i& size) 
+	inline uint BinaryImageExecutor::Accessor_Read(const vec(uint)& vtx, const rw::Pos3i& pp, const rw::Pos3i& size) 
 	{
 		return(rw::BinaryImage::Accesor_Read(vtx, pp, size));
 	}
 
 	inline int BinaryImageExecutor::Max_Radius() const
 	{
-		int rad = this->_image->_processedImages.rbegin()->first;
-		return(rad);
+		return(this->_image->_maxDiameter);
 	}
 }
 
@@ -3,6 +3,7 @@
 #include <tbb/parallel_for.h>
 #include <tbb/spin_mutex.h>
 #include "binary_image_opener.h"
+#ifdef GPU_AMP
 
 namespace rw
 {
@@ -75,25 +76,25 @@ namespace rw
 
 	void BinaryImageOpener::Set_DiamMin_To_2Rad(int _2rad)
 	{
-		vec(uint)& buffer = this->Processed_Image(_2rad);
+		OpenedImageBuffer opened = this->Processed_Image(_2rad);
+		const vec(uint)& buffer = *opened;
 		rw::Pos3i size = this->Size_3D();
-		BinaryImage bimg(&buffer,size);
 
 		int rad = _2rad / 2;
 		int length = size.x*size.y*size.z;
 		tbb::parallel_for(tbb::blocked_range<int>(0, length, BCHUNK_SIZE),
-			[this, rad, &bimg, size](const tbb::blocked_range<int>& b)
+			[this, rad, &buffer, size](const tbb::blocked_range<int>& b)
 		{
 			for (int i = b.begin(); i < b.end(); ++i)
 			{
 				rw::Pos3i pp;
 				Pos3i::Int_To_Pos3i(i, size.x, size.y, size.z, pp);
-				if (bimg(pp) == 0)
+				if (BinaryImageExecutor::Accessor_Read(buffer, pp, size) == 0)
 				{
-					map<int, rw::BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if (ii != this->Pore_Map().end())
+					int ii = this->Pore_Map().Rank(i);
+					if (ii >= 0)
 					{
-						ii->second.dist_min = (char)rad;
+						this->Pore_Map().Dist_Min(ii) = (char)rad;
 					}
 				}
 			}
@@ -298,12 +299,12 @@ namespace rw
 							|| (pp.z < 0) || (pp.z >= size3d.z)))
 						{
 							int idp = rw::Pos3i::Pos3i_To_Int(pp, size3d.x, size3d.y, size3d.z);
-							map<int, BinaryImage::Pore_Voxel>::iterator pidp = this->Pore_Map().find(idp);
-							if ((pidp != this->Pore_Map().end()) && (pidp->second.diam_max < diam))
+							int pidp = this->Pore_Map().Rank(idp);
+							if ((pidp >= 0) && (this->Pore_Map().Diam_Max(pidp) < diam))
 							{
 								mtx.lock();
-								pidp->second.diam_max = diam;
-								pidp->second.cluster = ii;
+								this->Pore_Map().Diam_Max(pidp) = diam;
+								this->Pore_Map().Cluster(pidp) = ii;
 								mtx.unlock();
 							}
 						}
@@ -336,12 +337,12 @@ namespace rw
 							|| (pp.z < 0) || (pp.z >= size3d.z)))
 						{
 							int idp = rw::Pos3i::Pos3i_To_Int(pp, size3d.x, size3d.y, size3d.z);
-							map<int, BinaryImage::Pore_Voxel>::iterator pidp = this->Pore_Map().find(idp);
-							if ((pidp != this->Pore_Map().end()) && (pidp->second.diam_max < diam))
+							int pidp = this->Pore_Map().Rank(idp);
+							if ((pidp >= 0) && (this->Pore_Map().Diam_Max(pidp) < diam))
 							{
 								mtx.lock();
-								pidp->second.diam_max = diam;
-								pidp->second.cluster = ii;
+								this->Pore_Map().Diam_Max(pidp) = diam;
+								this->Pore_Map().Cluster(pidp) = ii;
 								mtx.unlock();
 							}
 						}
@@ -383,7 +384,7 @@ namespace rw
 			pgdlg->Set_Range(this->Number_Of_Steps()+this->_step);
 		}
 		this->_step = this->_step + 1;
-		if (this->Pore_Map().size() == 0)
+		if (this->Pore_Map().Size() == 0)
 		{
 			if (pgdlg)
 			{
@@ -400,4 +401,6 @@ namespace rw
 	}
 
 
-}
\ No newline at end of file
+}
+
+#endif
@@ -1,8 +1,8 @@
 #ifndef BINARY_IMAGE_OPENER_H
 #define BINARY_IMAGE_OPENER_H
 
-#include <amp.h>
 #include "math_la/mdefs.h"
+#ifdef GPU_AMP
 #include "binary_image_border_creator.h"
 #include "binary_image.h"
 #include "binary_image_executor.h"
@@ -96,3 +96,4 @@ namespace rw
 
 #endif
 
+#endif
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <tbb/parallel_for.h>
+#include "binary_image_pore_map.h"
+
+namespace rw
+{
+	BinaryImagePoreMap::BinaryImagePoreMap()
+	{
+		this->_ranks.assign(1, 0);
+	}
+
+	void BinaryImagePoreMap::Build(const vec(uint)& buffer, const rw::Pos3i& size)
+	{
+		int length = size.x*size.y*size.z;
+		int words = (length + 31) / 32;
+		this->_bits.assign(words, 0);
+		this->_ranks.assign(words + 1, 0);
+		int chunks = (words + DCHUNK_SIZE - 1) / DCHUNK_SIZE;
+		vec(uint) offset(chunks + 1, 0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, chunks, 1), [this, &buffer, size, length, words, &offset](const tbb::blocked_range<int>& b)
+		{
+			for (int c = b.begin(); c < b.end(); ++c)
+			{
+				uint count = 0;
+				for (int w = c * DCHUNK_SIZE; w < std::min((c + 1)*DCHUNK_SIZE, words); ++w)
+				{
+					uint bits = 0;
+					for (int i = 32 * w; i < std::min(32 * w + 32, length); ++i)
+					{
+						rw::Pos3i pp;
+						Pos3i::Int_To_Pos3i(i, size.x, size.y, size.z, pp);
+						uint br = (pp.x >> 2) + (pp.y >> 2)*((size.x >> 2) + 1) + (pp.z >> 2)*((size.x >> 2) + 1)*((size.y >> 2) + 1);
+						if ((buffer[2 * br + ((pp.z & 3) >> 1)] & (0x01 << ((pp.x & 3) + ((pp.y & 3) << 2) + ((pp.z & 1) << 4)))) == 0)
+						{
+							bits = bits | (0x01u << (i & 31));
+						}
+					}
+					this->_bits[w] = bits;
+					this->_ranks[w] = count;
+					count = count + BinaryImagePoreMap::Bit_Count(bits);
+				}
+				offset[c + 1] = count;
+			}
+		});
+		for (int c = 0; c < chunks; ++c)
+		{
+			offset[c + 1] = offset[c + 1] + offset[c];
+		}
+		tbb::parallel_for(tbb::blocked_range<int>(0, chunks, 1), [this, words, &offset](const tbb::blocked_range<int>& b)
+		{
+			for (int c = b.begin(); c < b.end(); ++c)
+			{
+				for (int w = c * DCHUNK_SIZE; w < std::min((c + 1)*DCHUNK_SIZE, words); ++w)
+				{
+					this->_ranks[w] = this->_ranks[w] + offset[c];
+				}
+			}
+		});
+		uint pores = offset[chunks];
+		this->_ranks[words] = pores;
+		this->_cluster.assign(pores, -1);
+		this->_diamMax.assign(pores, 1);
+		this->_distMin.assign(pores, 1);
+	}
+
+	void BinaryImagePoreMap::Clear()
+	{
+		this->_bits.clear();
+		this->_ranks.assign(1, 0);
+		this->_cluster.clear();
+		this->_diamMax.clear();
+		this->_distMin.clear();
+	}
+
+	int BinaryImagePoreMap::Voxel(int rank) const
+	{
+		int w = (int)(std::upper_bound(this->_ranks.begin(), this->_ranks.end() - 1, (uint)rank) - this->_ranks.begin()) - 1;
+		uint bits = this->_bits[w];
+		uint skip = (uint)rank - this->_ranks[w];
+		for (uint k = 0; k < skip; ++k)
+		{
+			bits = bits & (bits - 1);
+		}
+		int b = 0;
+		while ((bits & (0x01u << b)) == 0)
+		{
+			++b;
+		}
+		return(32 * w + b);
+	}
+}
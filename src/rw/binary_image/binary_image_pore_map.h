@@ -0,0 +1,147 @@
+#ifndef BINARY_IMAGE_PORE_MAP_H
+#define BINARY_IMAGE_PORE_MAP_H
+
+#include "rw/binary_image/pos3i.h"
+#include "math_la/mdefs.h"
+
+namespace rw
+{
+	/**
+	* Attributes of the pore voxels of a binary image, stored as dense arrays indexed by the rank of the pore
+	* voxel: the number of pore voxels before it in the order of Pos3i::Pos3i_To_Int. A bitmap of the pore
+	* voxels in that order, with the number of pore voxels before every word, converts a voxel index into its
+	* rank (Rank) and back (Voxel) in constant and logarithmic time. The store takes two bits per voxel and
+	* six bytes per pore voxel.
+	*/
+	class BinaryImagePoreMap
+	{
+	private:
+		/**
+		* Pore voxels bitmap, 32 voxels per word, in the order of Pos3i::Pos3i_To_Int
+		*/
+		vec(uint) _bits;
+
+		/**
+		* Number of pore voxels before every word of the bitmap. The last entry is the number of pore voxels
+		*/
+		vec(uint) _ranks;
+
+		/**
+		* Maximal sphere cluster to which every pore voxel belongs
+		*/
+		vec(int) _cluster;
+
+		/**
+		* The diameter of the maximal ball that contains every pore voxel
+		*/
+		vec(char) _diamMax;
+
+		/**
+		* The distance from every pore voxel to the nearest wall
+		*/
+		vec(char) _distMin;
+	public:
+		BinaryImagePoreMap();
+
+		/**
+		* Indexes the pore voxels of a bricked image buffer (see BinaryImage::Accesor_Read). The attributes
+		* are cluster -1, diameter 1 and distance 1.
+		* @param buffer Bricked buffer of the image
+		* @param size Size of the image
+		*/
+		void Build(const vec(uint)& buffer, const rw::Pos3i& size);
+
+		/**
+		* Removes all the pore voxels
+		*/
+		void Clear();
+
+		/**
+		* @return Number of pore voxels
+		*/
+		int Size() const;
+
+		/**
+		* @return The rank of a voxel, -1 if it is not a pore voxel or it is outside the image
+		* @param i Voxel, indexed as in Pos3i::Pos3i_To_Int
+		*/
+		int Rank(int i) const;
+
+		/**
+		* @return The voxel of a rank, indexed as in Pos3i::Pos3i_To_Int
+		* @param rank Rank of a pore voxel, smaller than Size()
+		*/
+		int Voxel(int rank) const;
+
+		int& Cluster(int rank);
+		int Cluster(int rank) const;
+		char& Diam_Max(int rank);
+		char Diam_Max(int rank) const;
+		char& Dist_Min(int rank);
+		char Dist_Min(int rank) const;
+
+		/**
+		* @return Number of set bits of a word
+		*/
+		static uint Bit_Count(uint v);
+	};
+
+	inline int BinaryImagePoreMap::Size() const
+	{
+		return((int)this->_cluster.size());
+	}
+
+	inline uint BinaryImagePoreMap::Bit_Count(uint v)
+	{
+		v = v - ((v >> 1) & 0x55555555);
+		v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+		return((((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+	}
+
+	inline int BinaryImagePoreMap::Rank(int i) const
+	{
+		if ((uint)(i >> 5) >= (uint)this->_bits.size())
+		{
+			return(-1);
+		}
+		uint w = this->_bits[i >> 5];
+		uint bit = 0x01u << (i & 31);
+		if ((w & bit) == 0)
+		{
+			return(-1);
+		}
+		return((int)(this->_ranks[i >> 5] + BinaryImagePoreMap::Bit_Count(w & (bit - 1))));
+	}
+
+	inline int& BinaryImagePoreMap::Cluster(int rank)
+	{
+		return(this->_cluster[rank]);
+	}
+
+	inline int BinaryImagePoreMap::Cluster(int rank) const
+	{
+		return(this->_cluster[rank]);
+	}
+
+	inline char& BinaryImagePoreMap::Diam_Max(int rank)
+	{
+		return(this->_diamMax[rank]);
+	}
+
+	inline char BinaryImagePoreMap::Diam_Max(int rank) const
+	{
+		return(this->_diamMax[rank]);
+	}
+
+	inline char& BinaryImagePoreMap::Dist_Min(int rank)
+	{
+		return(this->_distMin[rank]);
+	}
+
+	inline char BinaryImagePoreMap::Dist_Min(int rank) const
+	{
+		return(this->_distMin[rank]);
+	}
+}
+
+#endif
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <tbb/parallel_for.h>
+#include "binary_image_pore_sums.h"
+#include "binary_image_pore_map.h"
+
+namespace rw
+{
+	/**
+	* @return Number of set bits of a brick
+	*/
+	static inline uint Brick_Count(unsigned long long m)
+	{
+		return(BinaryImagePoreMap::Bit_Count((uint)m) + BinaryImagePoreMap::Bit_Count((uint)(m >> 32)));
+	}
+
+	/**
+	* @return The bits of a brick with x in [x0, x1), y in [y0, y1) and z in [z0, z1), all of them in [0, 4]
+	*/
+	static inline unsigned long long Brick_Box(int x0, int x1, int y0, int y1, int z0, int z1)
+	{
+		unsigned long long mx = (unsigned long long)((0x01 << x1) - (0x01 << x0)) * 0x1111111111111111ULL;
+		unsigned long long my = (unsigned long long)((0x01 << (4 * y1)) - (0x01 << (4 * y0))) * 0x0001000100010001ULL;
+		unsigned long long hz = (z1 == 4) ? ~0ULL : ((0x01ULL << (16 * z1)) - 1);
+		unsigned long long lz = (z0 == 4) ? ~0ULL : ((0x01ULL << (16 * z0)) - 1);
+		return(mx & my & hz & ~lz);
+	}
+
+	BinaryImagePoreSums::BinaryImagePoreSums()
+	{
+		this->_size.x = 0;
+		this->_size.y = 0;
+		this->_size.z = 0;
+		this->_bricks = this->_size;
+	}
+
+	void BinaryImagePoreSums::Build(const vec(uint)& buffer, const rw::Pos3i& size)
+	{
+		this->_size = size;
+		this->_bricks.x = (size.x >> 2) + 1;
+		this->_bricks.y = (size.y >> 2) + 1;
+		this->_bricks.z = (size.z >> 2) + 1;
+		int sx = this->_bricks.x + 1;
+		int sy = this->_bricks.y + 1;
+		int sz = this->_bricks.z + 1;
+		this->_pores.resize(this->_bricks.x*this->_bricks.y*this->_bricks.z);
+		this->_sums.assign(sx*sy*sz, 0);
+		/**
+		* Pore voxels of every brick, inside the image
+		*/
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->_bricks.y*this->_bricks.z, BCHUNK_SIZE), [this, &buffer, size](const tbb::blocked_range<int>& b)
+		{
+			for (int r = b.begin(); r < b.end(); ++r)
+			{
+				int by = r % this->_bricks.y;
+				int bz = r / this->_bricks.y;
+				int cy = std::min(std::max(size.y - 4 * by, 0), 4);
+				int cz = std::min(std::max(size.z - 4 * bz, 0), 4);
+				for (int bx = 0; bx < this->_bricks.x; ++bx)
+				{
+					int k = r * this->_bricks.x + bx;
+					int cx = std::min(std::max(size.x - 4 * bx, 0), 4);
+					unsigned long long m = (unsigned long long)buffer[2 * k] | ((unsigned long long)buffer[2 * k + 1] << 32);
+					this->_pores[k] = ~m & Brick_Box(0, cx, 0, cy, 0, cz);
+					this->_sums[this->Entry(bx + 1, by + 1, bz + 1)] = Brick_Count(this->_pores[k]);
+				}
+			}
+		});
+		/**
+		* Prefix sums along every axis, each line independent of the others
+		*/
+		tbb::parallel_for(tbb::blocked_range<int>(0, sy*sz, BCHUNK_SIZE), [this, sx](const tbb::blocked_range<int>& b)
+		{
+			for (int r = b.begin(); r < b.end(); ++r)
+			{
+				uint* line = &this->_sums[r * sx];
+				for (int x = 1; x < sx; ++x)
+				{
+					line[x] = line[x] + line[x - 1];
+				}
+			}
+		});
+		tbb::parallel_for(tbb::blocked_range<int>(0, sx*sz, BCHUNK_SIZE), [this, sx, sy](const tbb::blocked_range<int>& b)
+		{
+			for (int r = b.begin(); r < b.end(); ++r)
+			{
+				uint* line = &this->_sums[(r / sx) * sx * sy + r % sx];
+				for (int y = 1; y < sy; ++y)
+				{
+					line[y * sx] = line[y * sx] + line[(y - 1) * sx];
+				}
+			}
+		});
+		tbb::parallel_for(tbb::blocked_range<int>(0, sx*sy, BCHUNK_SIZE), [this, sx, sy, sz](const tbb::blocked_range<int>& b)
+		{
+			for (int r = b.begin(); r < b.end(); ++r)
+			{
+				uint* line = &this->_sums[r];
+				for (int z = 1; z < sz; ++z)
+				{
+					line[z * sx * sy] = line[z * sx * sy] + line[(z - 1) * sx * sy];
+				}
+			}
+		});
+	}
+
+	void BinaryImagePoreSums::Clear()
+	{
+		this->_pores.clear();
+		this->_sums.clear();
+	}
+
+	uint BinaryImagePoreSums::Count(const rw::Pos3i& origin, const rw::Pos3i& size) const
+	{
+		int x1 = origin.x + size.x;
+		int y1 = origin.y + size.y;
+		int z1 = origin.z + size.z;
+		/**
+		* Bricks cut by the box, and bricks whole inside it
+		*/
+		int bx0 = origin.x >> 2;
+		int by0 = origin.y >> 2;
+		int bz0 = origin.z >> 2;
+		int bx1 = (x1 + 3) >> 2;
+		int by1 = (y1 + 3) >> 2;
+		int bz1 = (z1 + 3) >> 2;
+		int ix0 = (origin.x + 3) >> 2;
+		int iy0 = (origin.y + 3) >> 2;
+		int iz0 = (origin.z + 3) >> 2;
+		int ix1 = std::max(x1 >> 2, ix0);
+		int iy1 = std::max(y1 >> 2, iy0);
+		int iz1 = std::max(z1 >> 2, iz0);
+		uint count = this->Sum(ix0, iy0, iz0, ix1, iy1, iz1);
+		for (int bz = bz0; bz < bz1; ++bz)
+		{
+			int z0 = std::max(origin.z - 4 * bz, 0);
+			int zz = std::min(z1 - 4 * bz, 4);
+			bool inz = (bz >= iz0) && (bz < iz1);
+			for (int by = by0; by < by1; ++by)
+			{
+				int y0 = std::max(origin.y - 4 * by, 0);
+				int yy = std::min(y1 - 4 * by, 4);
+				bool iny = (by >= iy0) && (by < iy1);
+				for (int bx = bx0; bx < bx1; ++bx)
+				{
+					if ((inz) && (iny) && (bx == ix0) && (ix1 > ix0))
+					{
+						bx = ix1 - 1;
+						continue;
+					}
+					int x0 = std::max(origin.x - 4 * bx, 0);
+					int xx = std::min(x1 - 4 * bx, 4);
+					int k = bx + this->_bricks.x*(by + this->_bricks.y*bz);
+					count = count + Brick_Count(this->_pores[k] & Brick_Box(x0, xx, y0, yy, z0, zz));
+				}
+			}
+		}
+		return(count);
+	}
+}
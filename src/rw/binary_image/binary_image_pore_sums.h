@@ -0,0 +1,99 @@
+#ifndef BINARY_IMAGE_PORE_SUMS_H
+#define BINARY_IMAGE_PORE_SUMS_H
+
+#include "rw/binary_image/pos3i.h"
+#include "math_la/mdefs.h"
+
+namespace rw
+{
+	/**
+	* Summed volume table of the pore voxels of a bricked image buffer (see BinaryImage::Accesor_Read). The
+	* table is kept at the resolution of the 4x4x4 bricks, one word per brick instead of one per voxel, so it
+	* takes half a bit per voxel. The pore voxels of the bricks that lie whole inside a box are counted with
+	* eight lookups, and those of the bricks cut by the faces of the box with the bit count of the brick masked
+	* by the box, so a box of side s costs O(s^2 / 16) instead of O(s^3).
+	*/
+	class BinaryImagePoreSums
+	{
+	private:
+		/**
+		* Size of the image
+		*/
+		rw::Pos3i _size;
+
+		/**
+		* Number of bricks along every axis
+		*/
+		rw::Pos3i _bricks;
+
+		/**
+		* Pore bits of every brick, the voxel (x, y, z) of the brick is the bit x + 4y + 16z
+		*/
+		vec(unsigned long long) _pores;
+
+		/**
+		* Pore voxels of the bricks [0, bx) x [0, by) x [0, bz), with a leading zero row along every axis
+		*/
+		vec(uint) _sums;
+
+		/**
+		* @return Index of the table entry of the corner (bx, by, bz)
+		*/
+		int Entry(int bx, int by, int bz) const;
+
+		/**
+		* @return Pore voxels of the bricks [bx0, bx1) x [by0, by1) x [bz0, bz1)
+		*/
+		uint Sum(int bx0, int by0, int bz0, int bx1, int by1, int bz1) const;
+	public:
+		BinaryImagePoreSums();
+
+		/**
+		* Builds the table of a bricked image buffer
+		* @param buffer Bricked buffer of the image
+		* @param size Size of the image
+		*/
+		void Build(const vec(uint)& buffer, const rw::Pos3i& size);
+
+		/**
+		* Releases the table
+		*/
+		void Clear();
+
+		/**
+		* @return TRUE if the table has been built
+		*/
+		bool Built() const;
+
+		/**
+		* @return Number of pore voxels inside a box, which must lie inside the image
+		* @param origin Smallest corner of the box
+		* @param size Size of the box
+		*/
+		uint Count(const rw::Pos3i& origin, const rw::Pos3i& size) const;
+	};
+
+	inline bool BinaryImagePoreSums::Built() const
+	{
+		return(this->_sums.size() > 0);
+	}
+
+	inline int BinaryImagePoreSums::Entry(int bx, int by, int bz) const
+	{
+		return(bx + (this->_bricks.x + 1)*(by + (this->_bricks.y + 1)*bz));
+	}
+
+	inline uint BinaryImagePoreSums::Sum(int bx0, int by0, int bz0, int bx1, int by1, int bz1) const
+	{
+		if ((bx0 >= bx1) || (by0 >= by1) || (bz0 >= bz1))
+		{
+			return(0);
+		}
+		return(this->_sums[this->Entry(bx1, by1, bz1)] - this->_sums[this->Entry(bx0, by1, bz1)]
+			- this->_sums[this->Entry(bx1, by0, bz1)] - this->_sums[this->Entry(bx1, by1, bz0)]
+			+ this->_sums[this->Entry(bx0, by0, bz1)] + this->_sums[this->Entry(bx0, by1, bz0)]
+			+ this->_sums[this->Entry(bx1, by0, bz0)] - this->_sums[this->Entry(bx0, by0, bz0)]);
+	}
+}
+
+#endif
@@ -0,0 +1,33 @@
+#include <tbb/parallel_for.h>
+#include "binary_image_union_find.h"
+
+namespace rw
+{
+	BinaryImageUnionFind::BinaryImageUnionFind()
+	{
+	}
+
+	void BinaryImageUnionFind::Reset(int n)
+	{
+		vector<std::atomic<int> > parent(n);
+		this->_parent.swap(parent);
+		tbb::parallel_for(tbb::blocked_range<int>(0, n, DCHUNK_SIZE), [this](const tbb::blocked_range<int>& b)
+		{
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				this->_parent[i].store(i, std::memory_order_relaxed);
+			}
+		});
+	}
+
+	void BinaryImageUnionFind::Flatten()
+	{
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->Size(), DCHUNK_SIZE), [this](const tbb::blocked_range<int>& b)
+		{
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				this->_parent[i].store(this->Find(i), std::memory_order_relaxed);
+			}
+		});
+	}
+}
@@ -0,0 +1,187 @@
+#ifndef BINARY_IMAGE_UNION_FIND_H
+#define BINARY_IMAGE_UNION_FIND_H
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <tbb/parallel_for.h>
+#include "math_la/mdefs.h"
+#include "binary_image_pore_map.h"
+
+namespace rw
+{
+	using std::vector;
+
+	/**
+	* Disjoint sets of the pore voxels of an image, indexed by their rank in the pore map, that can be joined
+	* concurrently without locks. A set is joined to another by linking the larger root to the smaller one with
+	* a compare and swap, so the root of every set is its smallest element and the result does not depend on
+	* the order of the unions. Find compresses the paths by halving them.
+	*/
+	class BinaryImageUnionFind
+	{
+	private:
+		/**
+		* Parent of every element, itself for the roots
+		*/
+		vector<std::atomic<int> > _parent;
+	public:
+		BinaryImageUnionFind();
+
+		/**
+		* Makes every element a set of its own
+		* @param n Number of elements
+		*/
+		void Reset(int n);
+
+		/**
+		* @return Number of elements
+		*/
+		int Size() const;
+
+		/**
+		* @return The root of the set of an element, its smallest element
+		* @param i Element
+		*/
+		int Find(int i);
+
+		/**
+		* Joins the sets of two elements. It can be called concurrently.
+		*/
+		void Union(int a, int b);
+
+		/**
+		* Links every element to its root, so Root can be used instead of Find
+		*/
+		void Flatten();
+
+		/**
+		* @return The root of an element of a flattened forest
+		* @param i Element
+		*/
+		int Root(int i) const;
+
+		/**
+		* Labels the connected components of the pore space. The image is split into slabs of layers which are
+		* labelled independently, and then the faces between the slabs are merged concurrently. The forest is
+		* flattened at the end.
+		* @param pores Pore map of the image
+		* @param size Size of the image
+		* @param same same(ra, rb) is TRUE if two face neighbor pore voxels, given by rank, are connected
+		*/
+		template<class Same>
+		void Label(const BinaryImagePoreMap& pores, const rw::Pos3i& size, const Same& same);
+	};
+
+	inline int BinaryImageUnionFind::Size() const
+	{
+		return((int)this->_parent.size());
+	}
+
+	inline int BinaryImageUnionFind::Root(int i) const
+	{
+		return(this->_parent[i].load(std::memory_order_relaxed));
+	}
+
+	inline int BinaryImageUnionFind::Find(int i)
+	{
+		int p = this->_parent[i].load(std::memory_order_relaxed);
+		while (p != i)
+		{
+			int gp = this->_parent[p].load(std::memory_order_relaxed);
+			if (gp != p)
+			{
+				this->_parent[i].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+			}
+			i = gp;
+			p = this->_parent[i].load(std::memory_order_relaxed);
+		}
+		return(i);
+	}
+
+	inline void BinaryImageUnionFind::Union(int a, int b)
+	{
+		while (true)
+		{
+			a = this->Find(a);
+			b = this->Find(b);
+			if (a == b)
+			{
+				return;
+			}
+			if (a < b)
+			{
+				std::swap(a, b);
+			}
+			int expected = a;
+			if (this->_parent[a].compare_exchange_strong(expected, b))
+			{
+				return;
+			}
+		}
+	}
+
+	template<class Same>
+	void BinaryImageUnionFind::Label(const BinaryImagePoreMap& pores, const rw::Pos3i& size, const Same& same)
+	{
+		this->Reset(pores.Size());
+		int plane = size.x*size.y;
+		int slab = std::max(1, DCHUNK_SIZE / std::max(1, plane)) * 4;
+		int slabs = (size.z + slab - 1) / slab;
+		tbb::parallel_for(tbb::blocked_range<int>(0, slabs, 1), [this, &pores, size, plane, slab, &same](const tbb::blocked_range<int>& b)
+		{
+			for (int s = b.begin(); s < b.end(); ++s)
+			{
+				for (int z = s * slab; z < std::min((s + 1)*slab, size.z); ++z)
+				{
+					for (int y = 0; y < size.y; ++y)
+					{
+						for (int x = 0; x < size.x; ++x)
+						{
+							int i = z * plane + y * size.x + x;
+							int r = pores.Rank(i);
+							if (r < 0)
+							{
+								continue;
+							}
+							int n = (x > 0) ? pores.Rank(i - 1) : -1;
+							if ((n >= 0) && (same(r, n)))
+							{
+								this->Union(r, n);
+							}
+							n = (y > 0) ? pores.Rank(i - size.x) : -1;
+							if ((n >= 0) && (same(r, n)))
+							{
+								this->Union(r, n);
+							}
+							n = (z > s * slab) ? pores.Rank(i - plane) : -1;
+							if ((n >= 0) && (same(r, n)))
+							{
+								this->Union(r, n);
+							}
+						}
+					}
+				}
+			}
+		});
+		tbb::parallel_for(tbb::blocked_range<int>(1, slabs, 1), [this, &pores, size, plane, slab, &same](const tbb::blocked_range<int>& b)
+		{
+			for (int s = b.begin(); s < b.end(); ++s)
+			{
+				int z = s * slab;
+				for (int j = 0; j < plane; ++j)
+				{
+					int r = pores.Rank(z * plane + j);
+					int n = pores.Rank((z - 1) * plane + j);
+					if ((r >= 0) && (n >= 0) && (same(r, n)))
+					{
+						this->Union(r, n);
+					}
+				}
+			}
+		});
+		this->Flatten();
+	}
+}
+
+#endif
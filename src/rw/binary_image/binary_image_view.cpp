@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include "binary_image_view.h"
+
+namespace rw
+{
+	BinaryImageView::BinaryImageView()
+	{
+		this->_origin.x = 0;
+		this->_origin.y = 0;
+		this->_origin.z = 0;
+		this->_size = this->_origin;
+	}
+
+	BinaryImageView::BinaryImageView(const BinaryImageHandle& parent)
+	{
+		this->_parent = parent;
+		this->_origin.x = 0;
+		this->_origin.y = 0;
+		this->_origin.z = 0;
+		this->_size.x = parent->Width();
+		this->_size.y = parent->Height();
+		this->_size.z = parent->Depth();
+	}
+
+	BinaryImageView::BinaryImageView(const BinaryImageHandle& parent, const rw::Pos3i& origin, const rw::Pos3i& size)
+	{
+		this->_parent = parent;
+		this->_origin = origin;
+		this->_size = size;
+	}
+
+	uint BinaryImageView::Black_Voxels() const
+	{
+		if (this->Whole())
+		{
+			return(this->_parent->Black_Voxels());
+		}
+		int nrows = this->_size.y*this->_size.z;
+		return(tbb::parallel_reduce(tbb::blocked_range<int>(0, nrows, BCHUNK_SIZE), (uint)0,
+			[this](const tbb::blocked_range<int>& b, uint count)
+		{
+			for (int r = b.begin(); r < b.end(); ++r)
+			{
+				rw::Pos3i pp;
+				pp.y = r % this->_size.y;
+				pp.z = r / this->_size.y;
+				for (pp.x = 0; pp.x < this->_size.x; ++pp.x)
+				{
+					if ((*this)(pp) == 0)
+					{
+						++count;
+					}
+				}
+			}
+			return(count);
+		}, [](uint a, uint b)
+		{
+			return(a + b);
+		}));
+	}
+
+	void BinaryImageView::Pore_Rank_Index(vec(uint)& rows) const
+	{
+		int nrows = this->_size.y*this->_size.z;
+		rows.assign(nrows + 1, 0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, nrows, BCHUNK_SIZE), [this, &rows](const tbb::blocked_range<int>& b)
+		{
+			for (int r = b.begin(); r < b.end(); ++r)
+			{
+				rw::Pos3i pp;
+				pp.y = r % this->_size.y;
+				pp.z = r / this->_size.y;
+				uint count = 0;
+				for (pp.x = 0; pp.x < this->_size.x; ++pp.x)
+				{
+					if ((*this)(pp) == 0)
+					{
+						++count;
+					}
+				}
+				rows[r + 1] = count;
+			}
+		});
+		for (int r = 0; r < nrows; ++r)
+		{
+			rows[r + 1] = rows[r + 1] + rows[r];
+		}
+	}
+
+	rw::Pos3i BinaryImageView::Pore_Voxel_Of_Rank(const vec(uint)& rows, uint rank) const
+	{
+		int r = (int)(std::upper_bound(rows.begin(), rows.end(), rank) - rows.begin()) - 1;
+		rw::Pos3i pp;
+		pp.y = r % this->_size.y;
+		pp.z = r / this->_size.y;
+		uint skip = rank - rows[r];
+		for (pp.x = 0; pp.x < this->_size.x; ++pp.x)
+		{
+			if ((*this)(pp) == 0)
+			{
+				if (skip == 0)
+				{
+					break;
+				}
+				--skip;
+			}
+		}
+		return(pp);
+	}
+
+	const BinaryImagePoreMap* BinaryImageView::Pore_Map() const
+	{
+		if ((!this->Whole()) || (this->_parent->Pore_Map().Size() == 0) ||
+			((uint)this->_parent->Pore_Map().Size() != this->_parent->Black_Voxels()))
+		{
+			return(0);
+		}
+		return(&this->_parent->Pore_Map());
+	}
+
+	BinaryImage BinaryImageView::Copy() const
+	{
+		return(this->_parent->Sub(this->_origin.x, this->_origin.y, this->_origin.z, this->_size.x, this->_size.y, this->_size.z));
+	}
+}
@@ -0,0 +1,178 @@
+#ifndef BINARY_IMAGE_VIEW_H
+#define BINARY_IMAGE_VIEW_H
+
+#include "math_la/mdefs.h"
+#include "rw/binary_image/pos3i.h"
+#include "binary_image.h"
+
+namespace rw
+{
+	/**
+	* Read-only view of a box of a binary image. It keeps the origin and the size of the box over the buffer
+	* of the parent image, so a section of the image is simulated without copying it. The voxels are addressed
+	* relative to the origin of the box, and the bricked buffer keeps the layout of the parent (see Data,
+	* Brick_Row and Brick_Slice). The view shares the ownership of the parent, so the parent lives as long as
+	* a view of it.
+	*/
+	class BinaryImageView
+	{
+	private:
+		/**
+		* Viewed image
+		*/
+		BinaryImageHandle _parent;
+
+		/**
+		* Origin of the box in the parent image
+		*/
+		rw::Pos3i _origin;
+
+		/**
+		* Size of the box
+		*/
+		rw::Pos3i _size;
+	public:
+		/**
+		* Empty view
+		*/
+		BinaryImageView();
+
+		/**
+		* View of the whole image
+		*/
+		BinaryImageView(const BinaryImageHandle& parent);
+
+		/**
+		* View of a box of the image
+		* @param parent Viewed image
+		* @param origin Origin of the box in the parent image
+		* @param size Size of the box, which must lie inside the parent image
+		*/
+		BinaryImageView(const BinaryImageHandle& parent, const rw::Pos3i& origin, const rw::Pos3i& size);
+
+		int Width() const;
+		int Height() const;
+		int Depth() const;
+		int Length() const;
+		const rw::Pos3i& Origin() const;
+
+		/**
+		* @return TRUE if the view covers the whole parent image
+		*/
+		bool Whole() const;
+
+		/**
+		* @return The viewed image
+		*/
+		const BinaryImage& Parent() const;
+
+		/**
+		* @return The bricked buffer of the parent image
+		*/
+		const uint* Data() const;
+
+		/**
+		* @return Number of bricks in a row, and in a slice, of the buffer of the parent image
+		*/
+		int Brick_Row() const;
+		int Brick_Slice() const;
+
+		/**
+		* @return The voxel of a position relative to the origin of the box, zero for pore voxels
+		*/
+		uint operator()(const rw::Pos3i& pos) const;
+
+		/**
+		* @return The number of pore voxels of the box
+		*/
+		uint Black_Voxels() const;
+
+		/**
+		* Builds the rank index of the pore voxels of the box: the number of pore voxels before every row. A row
+		* is a line along x, and rows are ordered by y and then z as in Pos3i::Pos3i_To_Int. The pore map of the
+		* parent ranks the voxels of the whole image only, so a box that is a section needs its own index.
+		* @param rows rows[y + z*height] is the number of pore voxels before row (y,z), and the last entry the
+		* number of pore voxels of the box
+		*/
+		void Pore_Rank_Index(vec(uint)& rows) const;
+
+		/**
+		* Selects a pore voxel by its rank, the number of pore voxels of the box before it in the order of
+		* Pos3i::Pos3i_To_Int
+		* @param rows Rank index of the box (see Pore_Rank_Index)
+		* @param rank Rank of the voxel, smaller than the number of pore voxels
+		* @return The position of the pore voxel, relative to the origin of the box
+		*/
+		rw::Pos3i Pore_Voxel_Of_Rank(const vec(uint)& rows, uint rank) const;
+
+		/**
+		* @return The pore map of the parent if the view covers the whole image and the map is built, 0
+		* otherwise. Its ranks are those of Pore_Voxel_Of_Rank.
+		*/
+		const BinaryImagePoreMap* Pore_Map() const;
+
+		/**
+		* @return A copy of the box, for the procedures that need an image of their own
+		*/
+		BinaryImage Copy() const;
+	};
+
+	inline int BinaryImageView::Width() const
+	{
+		return(this->_size.x);
+	}
+
+	inline int BinaryImageView::Height() const
+	{
+		return(this->_size.y);
+	}
+
+	inline int BinaryImageView::Depth() const
+	{
+		return(this->_size.z);
+	}
+
+	inline int BinaryImageView::Length() const
+	{
+		return(this->_size.x*this->_size.y*this->_size.z);
+	}
+
+	inline const rw::Pos3i& BinaryImageView::Origin() const
+	{
+		return(this->_origin);
+	}
+
+	inline bool BinaryImageView::Whole() const
+	{
+		return((this->_parent) && (this->_origin.x == 0) && (this->_origin.y == 0) && (this->_origin.z == 0)
+			&& (this->_size.x == this->_parent->Width()) && (this->_size.y == this->_parent->Height())
+			&& (this->_size.z == this->_parent->Depth()));
+	}
+
+	inline const BinaryImage& BinaryImageView::Parent() const
+	{
+		return(*this->_parent);
+	}
+
+	inline const uint* BinaryImageView::Data() const
+	{
+		return(this->_parent->Data());
+	}
+
+	inline int BinaryImageView::Brick_Row() const
+	{
+		return((this->_parent->Width() >> 2) + 1);
+	}
+
+	inline int BinaryImageView::Brick_Slice() const
+	{
+		return(this->Brick_Row()*((this->_parent->Height() >> 2) + 1));
+	}
+
+	inline uint BinaryImageView::operator()(const rw::Pos3i& pos) const
+	{
+		return((*this->_parent)(pos + this->_origin));
+	}
+}
+
+#endif
@@ -1,5 +1,6 @@
+#include <algorithm>
 #include <tbb/parallel_for.h>
-#include <tbb/spin_mutex.h>
+#include <tbb/parallel_sort.h>
 #include "binary_image_watershed_clusterer.h"
 
 namespace rw
@@ -33,21 +34,19 @@ namespace rw
 		return(r);
 	}
 
-	void BinaryImageWaterShedClusterer::Median()
+	void BinaryImageWaterShedClusterer::Median(vec(uchar)& height)
 	{
 		rw::Pos3i size3d = this->Size_3D();
-		tbb::spin_mutex mtx;
-		set<int> indexes;
 		vec(rw::Pos3i) nhd = this->Neigborhood(1);
 		int length = size3d.x*size3d.y*size3d.z;
+		height.assign(this->Pore_Map().Size(), 0);
 		tbb::parallel_for(tbb::blocked_range<int>(0, length, BCHUNK_SIZE),
-			[this, size3d, &indexes, &mtx, nhd](const tbb::blocked_range<int>& b)
+			[this, size3d, &height, &nhd](const tbb::blocked_range<int>& b)
 		{
-			for (int id = b.begin(); id < b.end(); ++id)
+			for (int i = b.begin(); i < b.end(); ++i)
 			{
-				int i = id;
-				map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-				if (ii != this->Pore_Map().end())
+				int ii = this->Pore_Map().Rank(i);
+				if (ii >= 0)
 				{
 					rw::Pos3i root_pos;
 					rw::Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, root_pos);
@@ -56,201 +55,344 @@ namespace rw
 					{
 						rw::Pos3i n_pos = nhd[k];
 						n_pos = n_pos + root_pos;
-						int idn_pos = rw::Pos3i::Pos3i_To_Int(n_pos, size3d.x, size3d.y, size3d.z);
-						map<int, BinaryImage::Pore_Voxel>::iterator idn_itr = this->Pore_Map().find(idn_pos);
-						if (idn_itr != this->Pore_Map().end())
+						if ((n_pos.x >= 0) && (n_pos.x < size3d.x) && (n_pos.y >= 0) && (n_pos.y < size3d.y) && (n_pos.z >= 0) && (n_pos.z < size3d.z))
 						{
-							avg = avg + idn_itr->second.dist_min;
+							int idn_itr = this->Pore_Map().Rank(rw::Pos3i::Pos3i_To_Int(n_pos, size3d.x, size3d.y, size3d.z));
+							if (idn_itr >= 0)
+							{
+								avg = avg + max((int)this->Pore_Map().Dist_Min(idn_itr), 0);
+							}
 						}
 					}
 					avg = avg / (int)nhd.size() + 1;
-					ii->second.dist_min = (char)avg;
+					height[ii] = (uchar)min(avg, WATERSHED_LEVELS - 1);
 				}
 			}
 		});
 	}
 
-	void BinaryImageWaterShedClusterer::Cluster(const vec(int)& input, vec(int)& output, int rad, BinaryImage::ProgressAdapter* pgdlg)
+	void BinaryImageWaterShedClusterer::Flood_Slab(int z0, int z1, const vec(uchar)& height, vec(int)& basin)
 	{
-		if (pgdlg)
+		static const int Unprocessed = -1;
+		static const int Mask = -2;
+		static const int Queued = -3;
+		const BinaryImagePoreMap& pmap = this->Pore_Map();
+		rw::Pos3i size3d = this->Size_3D();
+		int plane = size3d.x*size3d.y;
+		int first = z0 * plane;
+		int n = (z1 - z0)*plane;
+		/**
+		* Hierarchical queue: the pore voxels of the slab sorted by height, in increasing index within a level
+		*/
+		vec(int) rank(n);
+		vec(int) start(WATERSHED_LEVELS + 1, 0);
+		for (int v = 0; v < n; ++v)
 		{
-			pgdlg->Update(this->_step,"Wathershedding step " + std::to_string(this->_step));
+			rank[v] = pmap.Rank(first + v);
+			if (rank[v] >= 0)
+			{
+				++start[height[rank[v]] + 1];
+			}
 		}
-
-		rw::Pos3i size3d = this->Size_3D();
-		tbb::spin_mutex mtx;
-		set<int> indexes;
-		vec(rw::Pos3i) nhd = this->Neigborhood(rad);
-		tbb::parallel_for(tbb::blocked_range<int>(0, (int)input.size(), 1000*BCHUNK_SIZE),
-			[this, size3d, &indexes, &mtx,nhd,&input](const tbb::blocked_range<int>& b)
+		for (int h = 0; h < WATERSHED_LEVELS; ++h)
+		{
+			start[h + 1] = start[h + 1] + start[h];
+		}
+		vec(int) order(start[WATERSHED_LEVELS]);
+		vec(int) next(start.begin(), start.end() - 1);
+		for (int v = 0; v < n; ++v)
 		{
-			for (int id = b.begin(); id < b.end(); ++id)
+			if (rank[v] >= 0)
 			{
-				int i = input[id];
-				map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-				int current_rad = ii->second.dist_min;
-				rw::Pos3i current_pos;
-				rw::Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, current_pos);
-				BinaryImage::Pore_Voxel* root = &(ii->second);
-				bool clustered = false;
-				int cluster = -1;
-				rw::Pos3i root_pos = current_pos;
-				while ((root) && (!clustered))
+				order[next[height[rank[v]]]++] = v;
+			}
+		}
+		vec(int) label(n, Unprocessed);
+		vec(int) fifo;
+		fifo.reserve(plane);
+		int neighbor[6];
+		auto Neighbors = [size3d, plane, n](int v, int* nb)
+		{
+			int x = v % size3d.x;
+			int y = (v / size3d.x) % size3d.y;
+			nb[0] = (x > 0) ? v - 1 : -1;
+			nb[1] = (x < size3d.x - 1) ? v + 1 : -1;
+			nb[2] = (y > 0) ? v - size3d.x : -1;
+			nb[3] = (y < size3d.y - 1) ? v + size3d.x : -1;
+			nb[4] = (v >= plane) ? v - plane : -1;
+			nb[5] = (v + plane < n) ? v + plane : -1;
+		};
+		for (int h = WATERSHED_LEVELS - 1; h >= 0; --h)
+		{
+			for (int k = start[h]; k < start[h + 1]; ++k)
+			{
+				label[order[k]] = Mask;
+			}
+			/**
+			* Extends the basins of the higher levels
+			*/
+			fifo.clear();
+			for (int k = start[h]; k < start[h + 1]; ++k)
+			{
+				int v = order[k];
+				Neighbors(v, neighbor);
+				for (int j = 0; j < 6; ++j)
 				{
-					root = 0;
-					for (int k = 0; k < nhd.size(); ++k)
+					if ((neighbor[j] >= 0) && (rank[neighbor[j]] >= 0) && (label[neighbor[j]] >= 0))
 					{
-						rw::Pos3i n_pos = nhd[k];
-						n_pos = n_pos + root_pos;
-						int idn_pos = rw::Pos3i::Pos3i_To_Int(n_pos, size3d.x, size3d.y, size3d.z);
-						map<int, BinaryImage::Pore_Voxel>::iterator idn_itr = this->Pore_Map().find(idn_pos);
-						if (idn_itr != this->Pore_Map().end())
-						{
-							if (idn_itr->second.dist_min > current_rad)
-							{
-								current_rad = idn_itr->second.dist_min;
-								root = &(idn_itr->second);
-								current_pos = n_pos;
-								clustered = false;
-							}
-							if (idn_itr->second.cluster >= 0)
-							{
-								if (current_rad <= idn_itr->second.dist_min)
-								{
-									current_rad = idn_itr->second.dist_min;
-									clustered = true;
-									cluster = idn_itr->second.cluster;
-								}
-							}
-						}
-					}		
-					root_pos = current_pos;
+						label[v] = Queued;
+						fifo.push_back(v);
+						break;
+					}
 				}
-				if (clustered)
+			}
+			for (size_t head = 0; head < fifo.size(); ++head)
+			{
+				int v = fifo[head];
+				int best = Unprocessed;
+				int best_height = -1;
+				Neighbors(v, neighbor);
+				for (int j = 0; j < 6; ++j)
+				{
+					int u = neighbor[j];
+					if ((u < 0) || (rank[u] < 0))
+					{
+						continue;
+					}
+					if ((label[u] >= 0) && ((int)height[rank[u]] > best_height))
+					{
+						best = label[u];
+						best_height = height[rank[u]];
+					}
+					else if (label[u] == Mask)
+					{
+						label[u] = Queued;
+						fifo.push_back(u);
+					}
+				}
+				label[v] = best;
+			}
+			/**
+			* The remaining plateaus are regional maxima of the slab
+			*/
+			for (int k = start[h]; k < start[h + 1]; ++k)
+			{
+				int s = order[k];
+				if (label[s] != Mask)
 				{
-					ii->second.dist_min = current_rad;
-					ii->second.cluster = -cluster;
+					continue;
 				}
-				else
+				label[s] = first + s;
+				fifo.clear();
+				fifo.push_back(s);
+				for (size_t head = 0; head < fifo.size(); ++head)
 				{
-					mtx.lock();
-					indexes.insert(i);
-					mtx.unlock();
+					Neighbors(fifo[head], neighbor);
+					for (int j = 0; j < 6; ++j)
+					{
+						int u = neighbor[j];
+						if ((u >= 0) && (rank[u] >= 0) && (label[u] == Mask))
+						{
+							label[u] = first + s;
+							fifo.push_back(u);
+						}
+					}
 				}
 			}
-		});
-		this->Update_Clusters();
-		output.assign(indexes.begin(), indexes.end());
-		++this->_step;
+		}
+		for (int v = 0; v < n; ++v)
+		{
+			if (rank[v] >= 0)
+			{
+				basin[rank[v]] = label[v];
+			}
+		}
 	}
 
-	void BinaryImageWaterShedClusterer::Update_Clusters()
+	void BinaryImageWaterShedClusterer::Merge_Seams(const vec(uchar)& height, const vec(int)& basin)
 	{
+		BinaryImagePoreMap& pmap = this->Pore_Map();
 		rw::Pos3i size3d = this->Size_3D();
-		int length = size3d.x*size3d.y*size3d.z;
-
-		tbb::parallel_for(tbb::blocked_range<int>(0, length, BCHUNK_SIZE),
-			[this, size3d](const tbb::blocked_range<int>& b)
+		int plane = size3d.x*size3d.y;
+		int slabs = (size3d.z + WATERSHED_SLAB - 1) / WATERSHED_SLAB;
+		/**
+		* A seed is ordered by its height, and then by its smallest index, as in the flooding
+		*/
+		auto Before = [&pmap, &height](int a, int b)
 		{
-			for (int i = b.begin(); i < b.end(); ++i)
+			int ha = height[pmap.Rank(a)];
+			int hb = height[pmap.Rank(b)];
+			return((ha > hb) || ((ha == hb) && (a < b)));
+		};
+		auto Seam = [&pmap, plane](int s, int j, int& ra, int& rb)
+		{
+			int z = s * WATERSHED_SLAB;
+			ra = pmap.Rank((z - 1)*plane + j);
+			rb = pmap.Rank(z*plane + j);
+			return((ra >= 0) && (rb >= 0));
+		};
+		/**
+		* The pieces of a plateau cut by the seams are seed plateaus of their slabs at the same height. They are
+		* joined by the rank of their seeds, so the root of a plateau is its smallest voxel, its seed in the
+		* flooding of the whole image
+		*/
+		BinaryImageUnionFind plateaus;
+		plateaus.Reset(pmap.Size());
+		tbb::parallel_for(tbb::blocked_range<int>(1, slabs, 1), [&pmap, &height, &basin, &plateaus, &Seam, plane](const tbb::blocked_range<int>& b)
+		{
+			for (int s = b.begin(); s < b.end(); ++s)
 			{
-				rw::Pos3i cpos;
-				rw::Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, cpos);
-				if (this->Image()(cpos) == 0)
+				for (int j = 0; j < plane; ++j)
 				{
-					map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if (ii != this->Pore_Map().end())
+					int ra, rb;
+					if (!Seam(s, j, ra, rb))
 					{
-						BinaryImage::Pore_Voxel& pv = ii->second;
-						if ((pv.diam_max == pv.dist_min) && (pv.dist_min > 1))
-						{
-							pv.cluster = abs(pv.cluster);
-						}
+						continue;
+					}
+					int sa = pmap.Rank(basin[ra]);
+					int sb = pmap.Rank(basin[rb]);
+					if ((height[ra] == height[sa]) && (height[rb] == height[sb]) && (height[ra] == height[rb]))
+					{
+						plateaus.Union(sa, sb);
 					}
 				}
 			}
 		});
-	}
-
-	void BinaryImageWaterShedClusterer::Init_Clusters(vec(int)& points, BinaryImage::ProgressAdapter* pgdlg)
-	{
-		if (pgdlg)
+		plateaus.Flatten();
+		/**
+		* A plateau that touches a higher or equal voxel of another basin across a seam is not a regional maximum
+		* of the image. Every slab lists these links as (plateau, (height, target)) pairs; the lists are
+		* concatenated and sorted by plateau with the best link first, the highest neighbor and then the first
+		* target in the order of the seeds. A link always goes to a higher seed, so the links form a forest.
+		*/
+		vector<vector<std::pair<int, int2> > > found(slabs);
+		tbb::parallel_for(tbb::blocked_range<int>(1, slabs, 1), [&pmap, &height, &basin, &plateaus, &found, &Seam, plane](const tbb::blocked_range<int>& b)
 		{
-			pgdlg->Update("Init clusters");
-		}
-		rw::Pos3i size3d = this->Size_3D();
-		int length = size3d.x*size3d.y*size3d.z;
-		tbb::spin_mutex mtx;
-		set<int> indexes;		
-		
-		tbb::parallel_for(tbb::blocked_range<int>(0, length, BCHUNK_SIZE),
-			[this, size3d,&indexes,&mtx](const tbb::blocked_range<int>& b)
-		{
-			for (int i = b.begin(); i < b.end(); ++i)
+			for (int s = b.begin(); s < b.end(); ++s)
 			{
-				rw::Pos3i cpos;
-				rw::Pos3i::Int_To_Pos3i(i, size3d.x, size3d.y, size3d.z, cpos);
-				if (this->Image()(cpos) == 0)
+				for (int j = 0; j < plane; ++j)
 				{
-					map<int, BinaryImage::Pore_Voxel>::iterator ii = this->Pore_Map().find(i);
-					if (ii != this->Pore_Map().end())
+					int ra, rb;
+					if (!Seam(s, j, ra, rb))
 					{
-						BinaryImage::Pore_Voxel& pv = ii->second;
-						if ((pv.diam_max == pv.dist_min)&&(pv.dist_min > 1))
+						continue;
+					}
+					for (int side = 0; side < 2; ++side)
+					{
+						int rv = (side == 0) ? ra : rb;
+						int rn = (side == 0) ? rb : ra;
+						int hs = height[pmap.Rank(basin[rv])];
+						int ht = height[pmap.Rank(basin[rn])];
+						if ((height[rv] != hs) || (height[rn] < hs) || ((height[rn] == hs) && (ht == hs)))
 						{
-							pv.cluster = i;							
+							continue;
 						}
-						else
+						std::pair<int, int2> c;
+						c.first = plateaus.Root(pmap.Rank(basin[rv]));
+						c.second.x = height[rn];
+						c.second.y = basin[rn];
+						if ((found[s].empty()) || (found[s].back().first != c.first) || (found[s].back().second.x != c.second.x)
+							|| (found[s].back().second.y != c.second.y))
 						{
-							pv.cluster = -1;
-							mtx.lock();
-							indexes.insert(i);
-							mtx.unlock();
+							found[s].push_back(c);
 						}
 					}
 				}
 			}
 		});
-		points.assign(indexes.begin(), indexes.end());
+		vector<int> offset(slabs + 1, 0);
+		for (int s = 0; s < slabs; ++s)
+		{
+			offset[s + 1] = offset[s] + (int)found[s].size();
+		}
+		vector<std::pair<int, int2> > links(offset[slabs]);
+		tbb::parallel_for(tbb::blocked_range<int>(0, slabs, 1), [&found, &offset, &links](const tbb::blocked_range<int>& b)
+		{
+			for (int s = b.begin(); s < b.end(); ++s)
+			{
+				std::copy(found[s].begin(), found[s].end(), links.begin() + offset[s]);
+				vector<std::pair<int, int2> >().swap(found[s]);
+			}
+		});
+		tbb::parallel_sort(links.begin(), links.end(), [&Before](const std::pair<int, int2>& a, const std::pair<int, int2>& b)
+		{
+			if (a.first != b.first)
+			{
+				return(a.first < b.first);
+			}
+			if (a.second.x != b.second.x)
+			{
+				return(a.second.x > b.second.x);
+			}
+			return(Before(a.second.y, b.second.y));
+		});
+		links.erase(std::unique(links.begin(), links.end(), [](const std::pair<int, int2>& a, const std::pair<int, int2>& b)
+		{
+			return(a.first == b.first);
+		}), links.end());
+		auto Find_Link = [&links](int plateau)
+		{
+			vector<std::pair<int, int2> >::const_iterator itr = std::lower_bound(links.begin(), links.end(), plateau,
+				[](const std::pair<int, int2>& l, int v) { return(l.first < v); });
+			return(((itr != links.end()) && (itr->first == plateau)) ? (int)(itr - links.begin()) : -1);
+		};
+		auto Root = [&pmap, &plateaus, &links, &Find_Link](int seed)
+		{
+			int plateau = plateaus.Root(pmap.Rank(seed));
+			int l = Find_Link(plateau);
+			while (l >= 0)
+			{
+				plateau = plateaus.Root(pmap.Rank(links[l].second.y));
+				l = Find_Link(plateau);
+			}
+			return(pmap.Voxel(plateau));
+		};
+		tbb::parallel_for(tbb::blocked_range<int>(0, pmap.Size(), DCHUNK_SIZE), [&pmap, &basin, &Root](const tbb::blocked_range<int>& b)
+		{
+			for (int r = b.begin(); r < b.end(); ++r)
+			{
+				pmap.Cluster(r) = Root(basin[r]);
+			}
+		});
 	}
 
 	void BinaryImageWaterShedClusterer::Execute(BinaryImage::ProgressAdapter* pgdlg)
 	{
 		if (pgdlg)
 		{
-			pgdlg->Set_Range(10*this->Max_Radius());
+			pgdlg->Set_Range(3);
 		}
 		this->_step = 0;
-		vec(int)* input = new vec(int)();
-		vec(int)* output = new vec(int)();
-		this->Median();
-		this->Init_Clusters(*input,pgdlg);
-		int k = 0;
-		int rad = 1;
-		int size = 0;
-		while ((input->size() > 0)&&(k < 50))
+		if (this->Pore_Map().Size() == 0)
 		{
-			if (pgdlg)
-			{
-				pgdlg->Update(this->_step,string("Clustering")+std::to_string(input->size())+string(" points"));
-			}
-
-			this->Cluster(*input,*output,rad,pgdlg);			
-			if ((int)output->size() != size)
-			{
-				size = (int)output->size();
-			}
-			else
+			this->Rebuild_Pore_Map();
+		}
+		if (pgdlg)
+		{
+			pgdlg->Update(this->_step, "Smoothing the distance map");
+		}
+		vec(uchar) height;
+		this->Median(height);
+		++this->_step;
+		if (pgdlg)
+		{
+			pgdlg->Update(this->_step, "Flooding the distance map");
+		}
+		rw::Pos3i size3d = this->Size_3D();
+		int slabs = (size3d.z + WATERSHED_SLAB - 1) / WATERSHED_SLAB;
+		vec(int) basin(this->Pore_Map().Size(), -1);
+		tbb::parallel_for(tbb::blocked_range<int>(0, slabs, 1), [this, size3d, &height, &basin](const tbb::blocked_range<int>& b)
+		{
+			for (int s = b.begin(); s < b.end(); ++s)
 			{
-				++rad;
+				this->Flood_Slab(s * WATERSHED_SLAB, min((s + 1) * WATERSHED_SLAB, size3d.z), height, basin);
 			}
-			delete input;
-			input = output;
-			output = new vec(int);
-			++k;
+		});
+		++this->_step;
+		if (pgdlg)
+		{
+			pgdlg->Update(this->_step, "Merging basins at the seams");
 		}
-		delete input;
-		delete output;
+		this->Merge_Seams(height, basin);
 	}
-
-}
\ No newline at end of file
+}
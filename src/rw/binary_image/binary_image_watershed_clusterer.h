@@ -3,20 +3,61 @@
 
 #include "binary_image_executor.h"
 #include "binary_image_group_mask.h"
+#include "binary_image_union_find.h"
 #include "math_la/mdefs.h"
 
+/**
+* Number of layers of the slabs that are flooded in parallel
+*/
+#define WATERSHED_SLAB 16
+
+/**
+* Number of levels of the hierarchical queue, the heights are clamped to it
+*/
+#define WATERSHED_LEVELS 128
+
 namespace rw
 {
+	/**
+	* Segments the pore space by a watershed of the distance to the walls. The heights are flooded from the
+	* highest level down with a hierarchical queue, one bucket per integer height: every level first extends
+	* the basins of the higher levels by a breadth first search, and the plateaus that remain start new basins,
+	* so every regional maximum of the heights seeds one basin. The cluster of a pore voxel is the seed of its
+	* basin.
+	*
+	* The image is flooded by slabs of WATERSHED_SLAB layers in parallel. The pieces of a plateau cut by the
+	* seams are joined in a union-find, and a plateau that touches a higher or equal voxel of another basin
+	* across a seam is not a regional maximum of the image, so it is linked to the basin of its highest
+	* neighbor across the seam. The basins that remain are the regional maxima of the whole image.
+	*/
 	class BinaryImageWaterShedClusterer : public BinaryImageExecutor
 	{
 	private:
 		int _step;
 	protected:
-		void Init_Clusters(vec(int)& points, BinaryImage::ProgressAdapter* pgdlg);
 		vec(rw::Pos3i) Neigborhood(int rad);
-		void Cluster(const vec(int)& input, vec(int)& output, int rad, BinaryImage::ProgressAdapter* pgdlg = 0);
-		void Median();
-		void Update_Clusters();
+
+		/**
+		* Smooths the distances to the walls of the pore map into the heights of the watershed
+		* @param height Height of every pore voxel, by rank
+		*/
+		void Median(vec(uchar)& height);
+
+		/**
+		* Floods the layers [z0, z1) of the image
+		* @param height Height of every pore voxel, by rank
+		* @param basin Seed of the basin of every pore voxel, by rank. Only the voxels of the slab are written
+		*/
+		void Flood_Slab(int z0, int z1, const vec(uchar)& height, vec(int)& basin);
+
+		/**
+		* Joins the pieces of the plateaus cut by the seams, links the basins that are not regional maxima of the
+		* image to the basin of their highest neighbor across a seam between slabs, and sets the cluster of every
+		* pore voxel
+		* @param height Height of every pore voxel, by rank
+		* @param basin Seed of the basin of every pore voxel, by rank
+		*/
+		void Merge_Seams(const vec(uchar)& height, const vec(int)& basin);
 	public:
 		BinaryImageWaterShedClusterer(BinaryImageExecutor& executor);
 		void Execute(BinaryImage::ProgressAdapter* pgdlg = 0);
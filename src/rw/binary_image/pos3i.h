@@ -1,9 +1,10 @@
 #ifndef POSITION3D_H
 #define POSITION3D_H
 
-#include <amp.h>
-#include <amp_math.h>
 #include "math_la/mdefs.h"
+#ifdef GPU_AMP
+	#include <amp_math.h>
+#endif
 
 namespace rw
 {
@@ -0,0 +1,150 @@
+#include "tbb/parallel_reduce.h"
+#include "tbb/blocked_range.h"
+#include "collision_trace.h"
+#include "walker_store.h"
+
+namespace rw
+{
+	/**
+	* Reduction body of the replay. Every body accumulates the changes of magnetization of its groups, per step
+	*/
+	class CollisionReplay
+	{
+	public:
+		const CollisionTrace* _trace;
+		const vector<vec(uchar)>* _events;
+		const vec(float)* _delta;
+		vector<scalar> _change;
+
+		CollisionReplay(const CollisionTrace* trace, const vector<vec(uchar)>* events, const vec(float)* delta)
+		{
+			this->_trace = trace;
+			this->_events = events;
+			this->_delta = delta;
+			this->_change.assign(trace->Steps(), 0);
+		}
+
+		CollisionReplay(CollisionReplay& p, tbb::split)
+		{
+			this->_trace = p._trace;
+			this->_events = p._events;
+			this->_delta = p._delta;
+			this->_change.assign(p._trace->Steps(), 0);
+		}
+
+		void operator()(const tbb::blocked_range<int>& r)
+		{
+			scalar p[WALKER_LANES];
+			scalar d[WALKER_LANES];
+			int walkers = this->_trace->Walkers();
+			uint steps = this->_trace->Steps();
+			for (int g = r.begin(); g < r.end(); ++g)
+			{
+				for (int l = 0; l < WALKER_LANES; ++l)
+				{
+					int i = g * WALKER_LANES + l;
+					p[l] = 1;
+					d[l] = (i < walkers) ? (scalar)(*this->_delta)[i] : (scalar)1;
+				}
+				const vec(uchar)& ev = (*this->_events)[g];
+				size_t k = 0;
+				uint step = 0;
+				while (k < ev.size())
+				{
+					uint gap = 0;
+					int shift = 0;
+					uchar b;
+					do
+					{
+						b = ev[k++];
+						gap = gap | ((uint)(b & 0x7F) << shift);
+						shift = shift + 7;
+					} while (b & 0x80);
+					step = step + gap;
+					uint lanes = (uint)ev[k] | ((uint)ev[k + 1] << 8);
+					k = k + 2;
+					if (step >= steps)
+					{
+						break;
+					}
+					scalar change = 0;
+					for (int l = 0; l < WALKER_LANES; ++l)
+					{
+						if (lanes & (0x01 << l))
+						{
+							change = change + p[l] * (d[l] - (scalar)1);
+							p[l] = p[l] * d[l];
+						}
+					}
+					this->_change[step] = this->_change[step] + change;
+				}
+			}
+		}
+
+		void join(CollisionReplay& p)
+		{
+			for (size_t t = 0; t < this->_change.size(); ++t)
+			{
+				this->_change[t] = this->_change[t] + p._change[t];
+			}
+		}
+	};
+
+	CollisionTrace::CollisionTrace()
+	{
+		this->_walkers = 0;
+		this->_steps = 0;
+	}
+
+	void CollisionTrace::Clear(int walkers)
+	{
+		int groups = (walkers + WALKER_LANES - 1) / WALKER_LANES;
+		this->_events.assign(groups, vec(uchar)());
+		this->_last.assign(groups, 0);
+		this->_walkers = walkers;
+		this->_steps = 0;
+	}
+
+	void CollisionTrace::Record(int group, uint step, uint lanes)
+	{
+		vec(uchar)& ev = this->_events[group];
+		uint gap = step - this->_last[group];
+		this->_last[group] = step;
+		while (gap >= 0x80)
+		{
+			ev.push_back((uchar)((gap & 0x7F) | 0x80));
+			gap = gap >> 7;
+		}
+		ev.push_back((uchar)gap);
+		ev.push_back((uchar)(lanes & 0xFF));
+		ev.push_back((uchar)((lanes >> 8) & 0xFF));
+	}
+
+	void CollisionTrace::Set_Steps(uint steps)
+	{
+		this->_steps = steps;
+	}
+
+	size_t CollisionTrace::Memory() const
+	{
+		size_t bytes = 0;
+		for (size_t g = 0; g < this->_events.size(); ++g)
+		{
+			bytes = bytes + this->_events[g].size();
+		}
+		return(bytes);
+	}
+
+	void CollisionTrace::Replay(const vec(float)& delta, vector<scalar>& magnetization) const
+	{
+		CollisionReplay body(this, &this->_events, &delta);
+		tbb::parallel_deterministic_reduce(tbb::blocked_range<int>(0, (int)this->_events.size(), 64), body);
+		magnetization.resize(this->_steps);
+		scalar m = (scalar)this->_walkers;
+		for (uint t = 0; t < this->_steps; ++t)
+		{
+			m = m + body._change[t];
+			magnetization[t] = m;
+		}
+	}
+}
@@ -0,0 +1,110 @@
+#ifndef COLLISION_TRACE_H
+#define COLLISION_TRACE_H
+
+#include <vector>
+#include "math_la/mdefs.h"
+
+namespace rw
+{
+	using std::vector;
+
+	/**
+	* Without a field gradient, the paths of the walkers do not depend on their surface relaxivity when the walls
+	* degrade their magnetization. A walk with a repeated seed can therefore be recorded once as the steps at which
+	* every walker collides, and its decay replayed for any relaxivity of the walkers without the image.
+	*
+	* The walkers are traced in groups of WALKER_LANES (16), the lanes of the CPU walk. Every group stores a byte
+	* stream of events: the number of steps since the previous event of the group, as a variable length integer,
+	* followed by the 16 bit mask of the lanes that collided at that step.
+	*/
+	class CollisionTrace
+	{
+	private:
+		/**
+		* Event stream of every group of walkers
+		*/
+		vector<vec(uchar)> _events;
+
+		/**
+		* Step of the last event of every group
+		*/
+		vec(uint) _last;
+
+		/**
+		* Number of traced walkers
+		*/
+		int _walkers;
+
+		/**
+		* Number of traced steps
+		*/
+		uint _steps;
+	public:
+		CollisionTrace();
+
+		/**
+		* Removes all the events
+		* @param walkers Number of traced walkers
+		*/
+		void Clear(int walkers);
+
+		/**
+		* Records the collisions of a group of walkers at a step. The steps of a group must be recorded in
+		* increasing order. Different groups may be recorded concurrently.
+		* @param group Group of walkers
+		* @param step Step of the walk
+		* @param lanes Mask of the lanes of the group that collided
+		*/
+		void Record(int group, uint step, uint lanes);
+
+		/**
+		* Sets the number of traced steps, at the end of the walk
+		* @param steps Number of steps
+		*/
+		void Set_Steps(uint steps);
+
+		/**
+		* @return Number of traced steps
+		*/
+		uint Steps() const;
+
+		/**
+		* @return Number of traced walkers
+		*/
+		int Walkers() const;
+
+		/**
+		* @return TRUE if the trace holds a walk
+		*/
+		bool Recorded() const;
+
+		/**
+		* @return Size of the event streams in bytes
+		*/
+		size_t Memory() const;
+
+		/**
+		* Replays the trace for a magnetization factor of every walker
+		* @param delta delta[i] is the magnetization factor of a collision of walker i
+		* @param magnetization magnetization[t] is the sum of the walkers' magnetization after step t, one value per traced step
+		*/
+		void Replay(const vec(float)& delta, vector<scalar>& magnetization) const;
+	};
+
+	inline uint CollisionTrace::Steps() const
+	{
+		return(this->_steps);
+	}
+
+	inline int CollisionTrace::Walkers() const
+	{
+		return(this->_walkers);
+	}
+
+	inline bool CollisionTrace::Recorded() const
+	{
+		return((this->_walkers > 0) && (this->_steps > 0));
+	}
+}
+
+#endif
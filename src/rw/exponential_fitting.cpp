@@ -1,10 +1,14 @@
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <limits>
 #include "math_la/txt/separator.h"
 #include "math_la/txt/converter.h"
 #include "exponential_fitting.h"
 #include "persistence/plug_persistent.h"
 #include "tbb/parallel_for.h"
+#include "tbb/combinable.h"
+#include "tbb/tick_count.h"
 
 using std::ifstream;
 
@@ -17,6 +21,9 @@ namespace rw
 		this->_normalizeLaplaceRange = false;
 		this->_kernelType = 1;
 		this->_modKernel = false;
+		this->_inversion = ExponentialFitting::NNLS_Inversion;
+		this->_compressionRank = 32;
+		this->_lambda = 0;
 	}
 
 	void ExponentialFitting::Normalize(bool nf)
@@ -114,30 +121,10 @@ namespace rw
 		});
 		uint n = this->_decayDomain.Size();
 		uint m = this->_laplaceDomain.Size();
-		math_la::math_lac::full::Matrix A(n, m);
-		tbb::parallel_for(tbb::blocked_range<int>(0, (int)n, BCHUNK_SIZE), [&A, m, this](const tbb::blocked_range<int>& b)
+		this->_lambda = fabs(lambda);
+		this->_kernel = KernelCache::Find(this->_decayDomain, this->_laplaceDomain, this->_lambda, this->_kernelType);
+		if (lambda != 0)
 		{
-			for (int i = b.begin(); i < b.end(); ++i)
-			{
-				for (int j = 0; j < (int)m; ++j)
-				{
-					scalar s = this->_laplaceDomain(j);
-					scalar v = exp(-this->_decayDomain(i) / this->_laplaceDomain(j));
-					A(i, j, v);
-				}
-			}
-		});
-
-		if (lambda == 0)
-		{
-			this->_kernelMatrix << A;
-		}
-		else
-		{
-			lambda = fabs(lambda);
-			this->_kernelMatrix << math_la::math_lac::full::Matrix(m + n, m);
-			this->_kernelMatrix(0, 0, A);
-			this->_kernelMatrix(n, 0, lambda* math_la::math_lac::full::Matrix::Identity(m));
 			math_la::math_lac::full::Vector tt = this->_decayRange;
 			this->_decayRange = math_la::math_lac::full::Vector(m + n);
 			tbb::parallel_for(tbb::blocked_range<int>(0, n, BCHUNK_SIZE), [this, &tt](const tbb::blocked_range<int>& b)
@@ -155,50 +142,153 @@ namespace rw
 		scalar lambda_min, scalar lambda_max, int lambda_resolution)
 	{
 		this->Modify_Kernel_Decay(this->_decayRange);
+		this->Kernel_T2_Mount(laplace_t_min, laplace_t_max, range_size, 0);
+		this->Sweep_Regularizer(lambda_min, lambda_max, lambda_resolution);
 		math_la::math_lac::full::Vector dx(lambda_resolution);
 		math_la::math_lac::full::Vector da(lambda_resolution);
-		math_la::math_lac::full::Vector circ(lambda_resolution);
+		for (int j = 0; j < lambda_resolution; ++j)
+		{
+			dx(j, sqrt(this->_sweep.Residual(j)));
+			da(j, 0.5*log10(this->_sweep.Norm(j)));
+		}
+		this->_laplaceDomain = dx;
+		this->_laplaceRange = da;
+		return(this->_sweep.Curvature);
+	}
+
+	void ExponentialFitting::Sweep_Regularizer(scalar lambda_min, scalar lambda_max, int lambda_resolution)
+	{
+		int rows = this->_kernel->Rows();
+		int range_size = this->_kernel->Columns();
 		scalar loglambdamin = log10(lambda_min);
 		scalar loglambdamax = log10(lambda_max);
 		scalar ds = (loglambdamax - loglambdamin) / ((scalar)lambda_resolution);
-		math_la::math_lac::full::Matrix U;
-		math_la::math_lac::full::Matrix V;
-		math_la::math_lac::full::Matrix D;
-		this->Kernel_T2_Mount(laplace_t_min, laplace_t_max, range_size, 0);
-		this->_kernelMatrix.SVD_Zero_Shift(U, V, D);
-		math_la::math_lac::full::Vector UY = U.Transposed()*this->_decayRange;
-		for (int j = 0; j < lambda_resolution; ++j)
+		const math_la::math_lac::full::Matrix& U = this->_kernel->Left_Singular_Vectors();
+		const math_la::math_lac::full::Matrix& D = this->_kernel->Singular_Values();
+		/**
+		* Coefficients of the decay on the left singular vectors. Those of the zero singular values and the
+		* part of the decay outside the singular vectors kept are fitted by no regularizer
+		*/
+		math_la::math_lac::full::Vector UY(range_size);
+		vec(scalar) rho(range_size, (scalar)0);
+		scalar yy = 0;
+		for (int k = 0; k < rows; ++k)
+		{
+			yy = yy + this->_decayRange(k)*this->_decayRange(k);
+		}
+		scalar fitted = 0;
+		for (int i = 0; i < std::min(range_size, rows); ++i)
+		{
+			scalar bi = 0;
+			for (int k = 0; k < rows; ++k)
+			{
+				bi = bi + U(k, i)*this->_decayRange(k);
+			}
+			UY(i, bi);
+			rho[i] = D(i, i);
+			if (rho[i] > EPSILON)
+			{
+				fitted = fitted + bi*bi;
+			}
+		}
+		this->_sweep.Lambda.Set_Size(lambda_resolution);
+		this->_sweep.Residual.Set_Size(lambda_resolution);
+		this->_sweep.Norm.Set_Size(lambda_resolution);
+		this->_sweep.Curvature.Set_Size(lambda_resolution);
+		this->_sweep.GCV.Set_Size(lambda_resolution);
+		this->_sweep.Floor = std::max(yy - fitted, (scalar)0);
+		Regularizer_Sweep& sweep = this->_sweep;
+		tbb::parallel_for(tbb::blocked_range<int>(0, lambda_resolution), [&sweep, &UY, &rho, loglambdamin, ds, range_size, rows](const tbb::blocked_range<int>& b)
 		{
-			scalar lambda = loglambdamin + ds*((scalar)j);
-			lambda = pow(10, lambda);
-			scalar lambda2 = lambda*lambda;
-			scalar e = 0;
-			scalar n = 0;
-			scalar np = 0;
-			for (int i = 0; i < range_size; ++i)
+			for (int j = b.begin(); j < b.end(); ++j)
 			{
-				scalar rho = D(i, i);
-				scalar rho2 = rho*rho;
-				if (rho > EPSILON)
+				scalar lambda = loglambdamin + ds*((scalar)j);
+				lambda = pow(10, lambda);
+				scalar lambda2 = lambda*lambda;
+				scalar e = 0;
+				scalar n = 0;
+				scalar np = 0;
+				scalar trace = 0;
+				for (int i = 0; i < range_size; ++i)
 				{
-					scalar bi = UY(i);
-					scalar fi = rho2 / (rho2 + lambda2);
-					scalar fi2 = fi*fi;
-					scalar bi2 = bi*bi;
-					n = n + fi2*bi2 / (rho2);
-					e = e + (1 - fi)*(1 - fi)*bi2;
-					np = np - (4 / lambda)*(1 - fi)*fi2*bi2 / rho2;
+					scalar rho2 = rho[i] * rho[i];
+					if (rho[i] > EPSILON)
+					{
+						scalar bi = UY(i);
+						scalar fi = rho2 / (rho2 + lambda2);
+						scalar fi2 = fi*fi;
+						scalar bi2 = bi*bi;
+						n = n + fi2*bi2 / (rho2);
+						e = e + (1 - fi)*(1 - fi)*bi2;
+						np = np - (4 / lambda)*(1 - fi)*fi2*bi2 / rho2;
+						trace = trace + fi;
+					}
+				}
+				scalar cr = (-2 * n*e / np)*(lambda*lambda*np*e + 2 * lambda*n*e + lambda*lambda*lambda*lambda*n*np)
+					/ (pow(lambda*lambda*n*n + e*e, 1.5));
+				scalar dof = (scalar)rows - trace;
+				sweep.Lambda(j, lambda);
+				sweep.Residual(j, e);
+				sweep.Norm(j, n);
+				sweep.Curvature(j, cr);
+				/**
+				* No degree of freedom is left when the filter fits every sample, and the criterion is undefined
+				*/
+				sweep.GCV(j, (dof > 0) ? (e + sweep.Floor) / (dof*dof) : std::numeric_limits<scalar>::infinity());
+			}
+		});
+	}
+
+	int ExponentialFitting::Regularizer_Index(int criterion, scalar noise) const
+	{
+		int size = this->_sweep.Lambda.Size();
+		int sel = 0;
+		if ((criterion == ExponentialFitting::Discrepancy_Criterion) && (noise > 0))
+		{
+			/**
+			* The residual grows with the regularizer, so the largest one within the noise level is taken
+			*/
+			scalar target = (scalar)this->_kernel->Rows()*noise*noise;
+			for (int j = 0; j < size; ++j)
+			{
+				if (this->_sweep.Residual(j) + this->_sweep.Floor <= target)
+				{
+					sel = j;
 				}
 			}
-			dx(j, sqrt(e));
-			da(j, 0.5*log10(n));
-			scalar cr = (-2 * n*e / np)*(lambda*lambda*np*e + 2 * lambda*n*e + lambda*lambda*lambda*lambda*n*np)
-				/ (pow(lambda*lambda*n*n + e*e, 1.5));
-			circ(j, cr);
 		}
-		this->_laplaceDomain = dx;
-		this->_laplaceRange = da;
-		return(circ);
+		else if (criterion == ExponentialFitting::L_Curve_Criterion)
+		{
+			for (int j = 1; j < size; ++j)
+			{
+				if (this->_sweep.Curvature(j) > this->_sweep.Curvature(sel))
+				{
+					sel = j;
+				}
+			}
+		}
+		else
+		{
+			for (int j = 1; j < size; ++j)
+			{
+				if (this->_sweep.GCV(j) < this->_sweep.GCV(sel))
+				{
+					sel = j;
+				}
+			}
+		}
+		return(sel);
+	}
+
+	scalar ExponentialFitting::Select_Regularizer(scalar laplace_t_min, scalar laplace_t_max, int range_size,
+		scalar lambda_min, scalar lambda_max, int lambda_resolution, int criterion, scalar noise)
+	{
+		this->Modify_Kernel_Decay(this->_decayRange);
+		this->Kernel_T2_Mount(laplace_t_min, laplace_t_max, range_size, 0);
+		this->Sweep_Regularizer(lambda_min, lambda_max, lambda_resolution);
+		scalar lambda = this->_sweep.Lambda(this->Regularizer_Index(criterion, noise));
+		this->Kernel_T2_Mount(laplace_t_min, laplace_t_max, range_size, lambda);
+		return(lambda);
 	}
 
 	math_la::math_lac::full::Vector ExponentialFitting::Laplace_Domain() const
@@ -214,7 +304,7 @@ namespace rw
 	void ExponentialFitting::Solve(math_la::math_lac::full::Vector& domain, math_la::math_lac::full::Vector& bins)
 	{
 		this->Modify_Kernel_Decay(this->_decayRange);
-		this->_laplaceRange = math_la::math_lac::full::Matrix::NNLS(this->_kernelMatrix, this->_decayRange);
+		this->Invert();
 		domain = this->_laplaceDomain;
 		bins = this->_laplaceRange;
 		scalar n = 0;
@@ -238,6 +328,179 @@ namespace rw
 		}
 	}
 
+	void ExponentialFitting::Invert()
+	{
+		if (this->_inversion == ExponentialFitting::BRD_Inversion)
+		{
+			this->_kernel->BRD(this->_compressionRank, this->_brd);
+			this->_brd.Solve(this->_decayRange, this->_lambda*this->_lambda, this->_laplaceRange);
+		}
+		else
+		{
+			this->_kernel->NNLS(this->_nnls);
+			this->_nnls.Solve(this->_decayRange, this->_laplaceRange);
+		}
+	}
+
+	void ExponentialFitting::Set_Inversion(int inversion, int rank)
+	{
+		this->_inversion = inversion;
+		this->_compressionRank = std::max(rank, 1);
+	}
+
+	void ExponentialFitting::Benchmark_Inversion(scalar& nnls, scalar& brd)
+	{
+		this->Modify_Kernel_Decay(this->_decayRange);
+		int selected = this->_inversion;
+		int order[2] = { ExponentialFitting::NNLS_Inversion, ExponentialFitting::BRD_Inversion };
+		if (selected == ExponentialFitting::NNLS_Inversion)
+		{
+			std::swap(order[0], order[1]);
+		}
+		for (int k = 0; k < 2; ++k)
+		{
+			this->_inversion = order[k];
+			tbb::tick_count tstart = tbb::tick_count::now();
+			this->Invert();
+			scalar secs = (scalar)(tbb::tick_count::now() - tstart).seconds();
+			if (order[k] == ExponentialFitting::NNLS_Inversion)
+			{
+				nnls = secs;
+			}
+			else
+			{
+				brd = secs;
+			}
+		}
+		this->_inversion = selected;
+	}
+
+	bool ExponentialFitting::Solve_Batch(const math_la::math_lac::full::Matrix& decays, math_la::math_lac::full::Matrix& bins,
+		math_la::math_lac::full::Vector& factors)
+	{
+		InversionKernelHandle kernel = this->_kernel;
+		if (!kernel)
+		{
+			return(false);
+		}
+		int n = kernel->Rows();
+		int m = kernel->Columns();
+		int rows = (this->_lambda == 0) ? n : n + m;
+		int count = decays.Columns();
+		if ((decays.Rows() != n) || (count <= 0))
+		{
+			return(false);
+		}
+		bins << math_la::math_lac::full::Matrix(m, count);
+		factors.Set_Size(count);
+		/**
+		* The threads share the factorizations of the cache, and every thread allocates its workspaces once, on
+		* its first decay
+		*/
+		tbb::combinable<math_la::math_lac::full::NNLSSolver> nnls([kernel]()
+		{
+			math_la::math_lac::full::NNLSSolver s;
+			kernel->NNLS(s);
+			return(s);
+		});
+		int rank = this->_compressionRank;
+		tbb::combinable<math_la::math_lac::full::BRDSolver> brd([kernel, rank]()
+		{
+			math_la::math_lac::full::BRDSolver s;
+			kernel->BRD(rank, s);
+			return(s);
+		});
+		bool t1 = (this->_kernelType == 0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, count), [this, &decays, &bins, &factors, &nnls, &brd, n, m, rows, t1](const tbb::blocked_range<int>& b)
+		{
+			math_la::math_lac::full::Vector y(rows);
+			math_la::math_lac::full::Vector x;
+			for (int c = b.begin(); c < b.end(); ++c)
+			{
+				for (int i = 0; i < n; ++i)
+				{
+					scalar v = decays(i, c);
+					y(i, t1 ? ((scalar)1 - v) / (scalar)2 : v);
+				}
+				if (this->_inversion == ExponentialFitting::BRD_Inversion)
+				{
+					brd.local().Solve(y, this->_lambda*this->_lambda, x);
+				}
+				else
+				{
+					nnls.local().Solve(y, x);
+				}
+				scalar sum = 0;
+				scalar xmax = 0;
+				for (int j = 0; j < m; ++j)
+				{
+					sum = sum + x(j);
+					xmax = std::max(xmax, x(j));
+				}
+				scalar f = (this->_normalizeLaplaceRange) ? xmax : sum;
+				scalar s = ((this->_normalizeLaplaceRange) && (xmax > 0)) ? (scalar)1 / xmax : (scalar)1;
+				for (int j = 0; j < m; ++j)
+				{
+					bins(j, c, s*x(j));
+				}
+				factors(c, f);
+			}
+		});
+		return(true);
+	}
+
+	bool ExponentialFitting::Benchmark_Batch(scalar& sequential, scalar& batch, int count)
+	{
+		if ((!this->_kernel) || (count <= 0))
+		{
+			return(false);
+		}
+		this->Modify_Kernel_Decay(this->_decayRange);
+		int n = this->_kernel->Rows();
+		bool t1 = (this->_kernelType == 0);
+		math_la::math_lac::full::Matrix decays(n, count);
+		for (int i = 0; i < n; ++i)
+		{
+			scalar v = this->_decayRange(i);
+			v = t1 ? (scalar)1 - (scalar)2 * v : v;
+			for (int c = 0; c < count; ++c)
+			{
+				decays(i, c, v);
+			}
+		}
+		math_la::math_lac::full::Vector range = this->_laplaceRange;
+		tbb::tick_count tstart = tbb::tick_count::now();
+		for (int c = 0; c < count; ++c)
+		{
+			this->Invert();
+		}
+		scalar secs = (scalar)(tbb::tick_count::now() - tstart).seconds();
+		sequential = (secs > 0) ? (scalar)count / secs : (scalar)0;
+		math_la::math_lac::full::Matrix bins;
+		math_la::math_lac::full::Vector factors;
+		tstart = tbb::tick_count::now();
+		bool solved = this->Solve_Batch(decays, bins, factors);
+		secs = (scalar)(tbb::tick_count::now() - tstart).seconds();
+		batch = (secs > 0) ? (scalar)count / secs : (scalar)0;
+		/**
+		* The batch solves the same systems with copies of the same factorizations, so its first distribution,
+		* scaled back, matches the last sequential one up to rounding
+		*/
+		bool same = solved;
+		for (int j = 0; (same) && (j < bins.Rows()); ++j)
+		{
+			scalar x = this->_laplaceRange(j);
+			scalar v = bins(j, 0);
+			if ((this->_normalizeLaplaceRange) && (factors(0) > 0))
+			{
+				v = v*factors(0);
+			}
+			same = (fabs(v - x) <= 1e-6*std::max((scalar)1, fabs(x)));
+		}
+		this->_laplaceRange = range;
+		return(same);
+	}
+
 	ExponentialFitting ExponentialFitting::Logarithmic_Reduction(int n)
 	{
 		if (n < this->_decayDomain.Size())
@@ -292,6 +555,8 @@ namespace rw
 			});
 			r._decayDomain = flt;
 			r._decayRange = fly;
+			r._inversion = this->_inversion;
+			r._compressionRank = this->_compressionRank;
 			return(r);
 		}
 		else
@@ -350,6 +615,8 @@ namespace rw
 			}
 			r._decayDomain = flt;
 			r._decayRange = fly;
+			r._inversion = this->_inversion;
+			r._compressionRank = this->_compressionRank;
 			return(r);
 		}
 		else
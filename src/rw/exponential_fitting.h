@@ -5,6 +5,7 @@
 #include "rw/plug.h"
 #include "math_la/math_lac/full/matrix.h"
 #include "math_la/math_lac/full/vector.h"
+#include "rw/kernel_cache.h"
 
 using std::string;
 
@@ -19,6 +20,76 @@ namespace rw
 
 	class ExponentialFitting
 	{
+	public:
+		/**
+		* Methods to invert the decay into the T2 distribution
+		*/
+		enum Inversion
+		{
+			/**
+			* Non negative least squares on the kernel, stacked with the regularizer rows
+			*/
+			NNLS_Inversion,
+			/**
+			* Butler-Reeds-Dawson on the kernel compressed to its leading singular triplets
+			*/
+			BRD_Inversion
+		};
+
+		/**
+		* Criteria to select the regularizer from the singular values of the kernel
+		*/
+		enum Regularizer_Criterion
+		{
+			/**
+			* Corner of the L-curve, where its curvature is largest
+			*/
+			L_Curve_Criterion,
+			/**
+			* Minimum of the generalized cross validation function
+			*/
+			GCV_Criterion,
+			/**
+			* Largest regularizer whose residual does not exceed the noise of the decay
+			*/
+			Discrepancy_Criterion
+		};
+
+		/**
+		* Tikhonov filter of the kernel evaluated on a logarithmic grid of regularizers
+		*/
+		struct Regularizer_Sweep
+		{
+			/**
+			* Regularizer values
+			*/
+			math_la::math_lac::full::Vector Lambda;
+
+			/**
+			* Squared residual norm, over the nonzero singular values
+			*/
+			math_la::math_lac::full::Vector Residual;
+
+			/**
+			* Squared solution norm
+			*/
+			math_la::math_lac::full::Vector Norm;
+
+			/**
+			* Curvature of the L-curve
+			*/
+			math_la::math_lac::full::Vector Curvature;
+
+			/**
+			* Generalized cross validation function, infinite where no degree of freedom is left
+			*/
+			math_la::math_lac::full::Vector GCV;
+
+			/**
+			* Squared norm of the part of the decay that no regularizer fits, to be added to Residual
+			*/
+			scalar Floor;
+		};
 	private:
 		/**
 		* Decay values corresponding to its range
@@ -26,9 +97,9 @@ namespace rw
 		math_la::math_lac::full::Vector _decayRange;
 
 		/**
-		* Kernel matrix to obtaind the T2 distribution
+		* Kernel to obtain the T2 distribution, shared through the kernel cache
 		*/
-		math_la::math_lac::full::Matrix _kernelMatrix;
+		InversionKernelHandle _kernel;
 
 		/**
 		* Decay values corresponding to its domain
@@ -65,6 +136,47 @@ namespace rw
 		*/
 		bool _modKernel;
 
+		/**
+		* Inversion method, NNLS_Inversion by default
+		*/
+		int _inversion;
+
+		/**
+		* Maximal number of singular triplets of the kernel kept by BRD_Inversion
+		*/
+		int _compressionRank;
+
+		/**
+		* Solvers of the inversions. They share the factorizations of the kernel and keep their workspaces from
+		* one inversion to the next
+		*/
+		math_la::math_lac::full::NNLSSolver _nnls;
+		math_la::math_lac::full::BRDSolver _brd;
+
+		/**
+		* Regularizer of the mounted kernel
+		*/
+		scalar _lambda;
+
+		/**
+		* Regularizer sweep of the last call to Regularizer_Mount or Select_Regularizer
+		*/
+		Regularizer_Sweep _sweep;
+
+		/**
+		* Inverts the decay with the selected method into _laplaceRange
+		*/
+		void Invert();
+
+		/**
+		* Evaluates the Tikhonov filter of the cached singular values of the mounted kernel into _sweep, all
+		* the regularizers in parallel. The kernel must be mounted without regularizer.
+		* @param lambda_min Minimal regularizer value
+		* @param lambda_max Maximal regularizer value
+		* @param lambda_resolution Number of regularizers
+		*/
+		void Sweep_Regularizer(scalar lambda_min, scalar lambda_max, int lambda_resolution);
+
 		/**
 		* This method is necessary to adapy a T2 or T1 distribution. 
 		* @param decay Range of the decay to modify
@@ -92,7 +204,8 @@ namespace rw
 		void Load_Decay(const vector<rw::Step_Value>& values);
 
 		/**
-		* Mounts the kernel matrix associated to the T2 distribution. 
+		* Mounts the kernel matrix associated to the T2 distribution. The kernel and its factorizations are
+		* taken from the kernel cache, so fittings with the same time grid, T2 grid and regularizer share them.
 		* @param laplace_t_min Minimal laplace time (in logarithmic scale). For example, use -2 instead of 0.01
 		* @param laplace_t_max Maximal laplace time (in logarithmic scale). For example, use 2 instead of 100
 		* @param range_size Number of bins of the T2 distribution
@@ -112,6 +225,31 @@ namespace rw
 
 		math_la::math_lac::full::Vector Regularizer_Mount(scalar laplace_t_min, scalar laplace_t_max, int range_size,
 			scalar lambda_min, scalar lambda_max, int lambda_resolution);
+
+		/**
+		* Selects the regularizer of the last call to Regularizer_Mount or Select_Regularizer by a criterion
+		* @param criterion L_Curve_Criterion, GCV_Criterion or Discrepancy_Criterion
+		* @param noise Standard deviation of the noise of the decay, used by Discrepancy_Criterion. GCV_Criterion
+		* is used instead when it is not positive
+		* @return Index of the selected regularizer
+		*/
+		int Regularizer_Index(int criterion, scalar noise = 0) const;
+
+		/**
+		* Selects the regularizer by a criterion and mounts the kernel with it, so Solve can follow without an
+		* interactive step. The singular values come from the kernel cache.
+		* @param laplace_t_min Minimal laplace time (in logarithmic scale)
+		* @param laplace_t_max Maximal laplace time (in logarithmic scale)
+		* @param range_size Number of bins of the T2 distribution
+		* @param lambda_min Minimal regularizer value
+		* @param lambda_max Maximal regularizer value
+		* @param lambda_resolution Number of regularizers evaluated
+		* @param criterion L_Curve_Criterion, GCV_Criterion or Discrepancy_Criterion
+		* @param noise Standard deviation of the noise of the decay, used by Discrepancy_Criterion
+		* @return The selected regularizer
+		*/
+		scalar Select_Regularizer(scalar laplace_t_min, scalar laplace_t_max, int range_size,
+			scalar lambda_min, scalar lambda_max, int lambda_resolution, int criterion, scalar noise = 0);
 		/**
 		* Solves the T2 distribution 
 		* @param domain Time domain of the T2 distribution. Non logarithmic scale
@@ -173,6 +311,50 @@ namespace rw
 		* Sets kernel type, T1 or T2
 		*/
 		void Set_Kernel_Type(int kernel_type);
+
+		/**
+		* Selects the inversion method of Solve
+		* @param inversion NNLS_Inversion or BRD_Inversion
+		* @param rank Maximal number of singular triplets of the kernel kept by BRD_Inversion
+		*/
+		void Set_Inversion(int inversion, int rank = 32);
+
+		/**
+		* @return The inversion method of Solve
+		*/
+		int Inversion_Method() const;
+
+		/**
+		* Measures the time of both inversion methods on the mounted kernel. The T2 distribution of the selected
+		* method is left in the laplace range.
+		* @param nnls Seconds of NNLS_Inversion
+		* @param brd Seconds of BRD_Inversion
+		*/
+		void Benchmark_Inversion(scalar& nnls, scalar& brd);
+
+		/**
+		* Solves the T2 distributions of many decays sampled on the time grid of the mounted kernel, with the
+		* selected inversion method. The decays share the kernel and its factorizations, and are solved in
+		* parallel, every thread with its own solver.
+		* @param decays Decay magnetizations, one decay per column, as loaded by Load_Decay
+		* @param bins T2 distributions, one per column, normalized as by Solve
+		* @param factors Laplace factor of every distribution
+		* @return FALSE, with no distribution solved, if no kernel is mounted or the decays do not have one row
+		* per sample of its time grid
+		*/
+		bool Solve_Batch(const math_la::math_lac::full::Matrix& decays, math_la::math_lac::full::Matrix& bins,
+			math_la::math_lac::full::Vector& factors);
+
+		/**
+		* Measures the throughput of Solve_Batch against inverting the decays one by one, on copies of the
+		* loaded decay. The kernel must be mounted. The first distribution of the batch is checked against the
+		* one inverted alone. Both rates are in wall clock time, so the batch is credited with its threads.
+		* @param sequential Decays per second inverted one by one
+		* @param batch Decays per second inverted by Solve_Batch
+		* @param count Number of decays
+		* @return FALSE if the batch could not be solved or its distributions differ from the sequential ones
+		*/
+		bool Benchmark_Batch(scalar& sequential, scalar& batch, int count = 256);
 	};
 
 	inline int ExponentialFitting::Range_Size() const
@@ -185,6 +367,11 @@ namespace rw
 		return(this->_laplaceFactor);
 	}
 
+	inline int ExponentialFitting::Inversion_Method() const
+	{
+		return(this->_inversion);
+	}
+
 }
 
 
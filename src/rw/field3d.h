@@ -1,9 +1,11 @@
 #ifndef FIELD3D_H
 #define FIELD3D_H
 
-#include <amp.h>
-#include <amp_math.h>
+#include <cmath>
 #include "math_la/mdefs.h"
+#ifdef GPU_AMP
+	#include <amp_math.h>
+#endif
 
 
 struct Field3D
@@ -37,7 +39,11 @@ inline scalar Field3D::Exponential_Factor(int dx, int dy, int dz) const GPU
 	sdx = this->x*sdx;
 	sdy = this->y*sdy;
 	sdz = this->z*sdz;
+#ifdef GPU_AMP
 	scalar dg = concurrency::precise_math::sqrt(sdx*sdx + sdy*sdy + sdz*sdz);
+#else
+	scalar dg = std::sqrt(sdx*sdx + sdy*sdy + sdz*sdz);
+#endif
 	return((scalar)1-dg);
 }
 
@@ -0,0 +1,81 @@
+#include <math.h>
+#include "tbb/parallel_for.h"
+#include "hit_histogram.h"
+
+namespace rw
+{
+	HitHistogram::HitHistogram()
+	{
+		this->_walkers = 0;
+		this->_timeStep = 0;
+		this->_bulkFactor = 1;
+	}
+
+	void HitHistogram::Clear(int walkers, scalar time_step, scalar bulk_factor)
+	{
+		this->_records.clear();
+		this->_walkers = walkers;
+		this->_timeStep = time_step;
+		this->_bulkFactor = bulk_factor;
+	}
+
+	void HitHistogram::Add(uint iteration, const vec(scalar)& weights)
+	{
+		Record r;
+		r.iteration = iteration;
+		int first = 0;
+		int last = (int)weights.size() - 1;
+		while ((first <= last) && (weights[first] == 0))
+		{
+			++first;
+		}
+		while ((last >= first) && (weights[last] == 0))
+		{
+			--last;
+		}
+		r.first = first;
+		for (int h = first; h <= last; ++h)
+		{
+			r.weight.push_back((float)weights[h]);
+		}
+		this->_records.push_back(r);
+	}
+
+	scalar HitHistogram::Magnetization(int i, scalar delta) const
+	{
+		const Record& r = this->_records[i];
+		scalar m = 0;
+		scalar p = pow(delta, (scalar)r.first);
+		for (int k = 0; k < (int)r.weight.size(); ++k)
+		{
+			m = m + (scalar)r.weight[k] * p;
+			p = p * delta;
+		}
+		m = m / (scalar)std::max(this->_walkers, 1);
+		return(m*pow(this->_bulkFactor, (scalar)(r.iteration + 1)));
+	}
+
+	void HitHistogram::Decay(scalar delta, vector<rw::Step_Value>& decay) const
+	{
+		decay.resize(this->_records.size());
+		for (int i = 0; i < (int)this->_records.size(); ++i)
+		{
+			rw::Step_Value& v = decay[i];
+			v.Iteration = this->_records[i].iteration;
+			v.Time = ((scalar)v.Iteration)*this->_timeStep;
+			v.Magnetization = this->Magnetization(i, delta);
+		}
+	}
+
+	void HitHistogram::Decays(const vector<scalar>& deltas, vector<vector<rw::Step_Value> >& decays) const
+	{
+		decays.resize(deltas.size());
+		tbb::parallel_for(tbb::blocked_range<int>(0, (int)deltas.size(), 1), [this, &deltas, &decays](const tbb::blocked_range<int>& b)
+		{
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				this->Decay(deltas[i], decays[i]);
+			}
+		});
+	}
+}
@@ -0,0 +1,123 @@
+#ifndef HIT_HISTOGRAM_H
+#define HIT_HISTOGRAM_H
+
+#include <vector>
+#include "math_la/mdefs.h"
+#include "rw/random_walk_step_value.h"
+
+namespace rw
+{
+	using std::vector;
+
+	/**
+	* With a constant surface relaxivity, the magnetization of a walker is delta^hits times the factors of the
+	* bulk relaxation and of the field gradient. The histogram of the hits of the walkers, weighted by their
+	* gradient factor, therefore determines the decay for any delta. This class stores that histogram at a
+	* sequence of recorded iterations of a single walk, and evaluates the decays of many relaxivities from it.
+	*/
+	class HitHistogram
+	{
+	private:
+		/**
+		* The histogram at a recorded iteration. Only the range of hits with non-zero weights is kept.
+		*/
+		struct Record
+		{
+			/**
+			* Recorded iteration
+			*/
+			uint iteration;
+
+			/**
+			* Number of hits of the first weight
+			*/
+			int first;
+
+			/**
+			* weight[k] is the sum of the gradient factors of the walkers with first+k hits
+			*/
+			vec(float) weight;
+		};
+
+		/**
+		* Recorded histograms, in increasing order of iteration
+		*/
+		vector<Record> _records;
+
+		/**
+		* Number of walkers of the simulation
+		*/
+		int _walkers;
+
+		/**
+		* Time of a step
+		*/
+		scalar _timeStep;
+
+		/**
+		* Bulk relaxation factor of a step
+		*/
+		scalar _bulkFactor;
+	public:
+		HitHistogram();
+
+		/**
+		* Removes all the records
+		* @param walkers Number of walkers of the simulation
+		* @param time_step Time of a step
+		* @param bulk_factor Bulk relaxation factor of a step
+		*/
+		void Clear(int walkers, scalar time_step, scalar bulk_factor);
+
+		/**
+		* Records the histogram of an iteration
+		* @param iteration Iteration
+		* @param weights weights[h] is the sum of the gradient factors of the walkers with h hits
+		*/
+		void Add(uint iteration, const vec(scalar)& weights);
+
+		/**
+		* @return Number of recorded iterations
+		*/
+		int Size() const;
+
+		/**
+		* @return The iteration of a record
+		* @param i Record
+		*/
+		uint Iteration(int i) const;
+
+		/**
+		* @return The normalized magnetization of a record, including the bulk relaxation
+		* @param i Record
+		* @param delta Magnetization factor of a collision
+		*/
+		scalar Magnetization(int i, scalar delta) const;
+
+		/**
+		* Evaluates the decay of a relaxivity at every recorded iteration
+		* @param delta Magnetization factor of a collision (see Plug::Surface_Relaxivity_Delta)
+		* @param decay Decay values
+		*/
+		void Decay(scalar delta, vector<rw::Step_Value>& decay) const;
+
+		/**
+		* Evaluates, in parallel, the decays of many relaxivities
+		* @param deltas Magnetization factors of a collision
+		* @param decays Decay of every delta
+		*/
+		void Decays(const vector<scalar>& deltas, vector<vector<rw::Step_Value> >& decays) const;
+	};
+
+	inline int HitHistogram::Size() const
+	{
+		return((int)this->_records.size());
+	}
+
+	inline uint HitHistogram::Iteration(int i) const
+	{
+		return(this->_records[i].iteration);
+	}
+}
+
+#endif
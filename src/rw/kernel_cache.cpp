@@ -0,0 +1,220 @@
+#include <cmath>
+#include <list>
+#include "kernel_cache.h"
+#include "tbb/parallel_for.h"
+
+namespace rw
+{
+	/**
+	* Kernels of the cache, the most recently used first, and the mutex that guards them
+	*/
+	static std::list<InversionKernelHandle> cacheKernels;
+	static std::mutex cacheMutex;
+
+	/**
+	* FNV-1a hash of a block of bytes, chained from h
+	*/
+	static size_t Hash_Bytes(size_t h, const void* data, size_t size)
+	{
+		const unsigned char* b = (const unsigned char*)data;
+		for (size_t k = 0; k < size; ++k)
+		{
+			h = (h ^ (size_t)b[k]) * (size_t)1099511628211ULL;
+		}
+		return(h);
+	}
+
+	InversionKernel::InversionKernel(const math_la::math_lac::full::Vector& time, const math_la::math_lac::full::Vector& t2, scalar lambda, int kernel_type)
+	{
+		this->_time.resize(time.Size());
+		for (int i = 0; i < time.Size(); ++i)
+		{
+			this->_time[i] = time(i);
+		}
+		this->_t2.resize(t2.Size());
+		for (int j = 0; j < t2.Size(); ++j)
+		{
+			this->_t2[j] = t2(j);
+		}
+		this->_lambda = lambda;
+		this->_kernelType = kernel_type;
+		this->_hash = InversionKernel::Hash(time, t2, lambda, kernel_type);
+		this->_kernelReady = false;
+		this->_svdReady = false;
+	}
+
+	size_t InversionKernel::Hash(const math_la::math_lac::full::Vector& time, const math_la::math_lac::full::Vector& t2, scalar lambda, int kernel_type)
+	{
+		size_t h = (size_t)14695981039346656037ULL;
+		int sizes[3] = { time.Size(), t2.Size(), kernel_type };
+		h = Hash_Bytes(h, sizes, sizeof(sizes));
+		h = Hash_Bytes(h, &lambda, sizeof(scalar));
+		for (int i = 0; i < time.Size(); ++i)
+		{
+			scalar v = time(i);
+			h = Hash_Bytes(h, &v, sizeof(scalar));
+		}
+		for (int j = 0; j < t2.Size(); ++j)
+		{
+			scalar v = t2(j);
+			h = Hash_Bytes(h, &v, sizeof(scalar));
+		}
+		return(h);
+	}
+
+	bool InversionKernel::Matches(size_t hash, const math_la::math_lac::full::Vector& time, const math_la::math_lac::full::Vector& t2, scalar lambda, int kernel_type) const
+	{
+		if ((hash != this->_hash) || (lambda != this->_lambda) || (kernel_type != this->_kernelType) ||
+			(time.Size() != this->Rows()) || (t2.Size() != this->Columns()))
+		{
+			return(false);
+		}
+		for (int i = 0; i < time.Size(); ++i)
+		{
+			if (time(i) != this->_time[i])
+			{
+				return(false);
+			}
+		}
+		for (int j = 0; j < t2.Size(); ++j)
+		{
+			if (t2(j) != this->_t2[j])
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+
+	void InversionKernel::Mount()
+	{
+		if (this->_kernelReady)
+		{
+			return;
+		}
+		int n = this->Rows();
+		int m = this->Columns();
+		int rows = (this->_lambda == 0) ? n : n + m;
+		this->_kernel << math_la::math_lac::full::Matrix(rows, m);
+		tbb::parallel_for(tbb::blocked_range<int>(0, n, BCHUNK_SIZE), [this, m](const tbb::blocked_range<int>& b)
+		{
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				for (int j = 0; j < m; ++j)
+				{
+					this->_kernel(i, j, exp(-this->_time[i] / this->_t2[j]));
+				}
+			}
+		});
+		if (this->_lambda != 0)
+		{
+			for (int j = 0; j < m; ++j)
+			{
+				this->_kernel(n + j, j, this->_lambda);
+			}
+		}
+		this->_kernelReady = true;
+	}
+
+	const math_la::math_lac::full::Matrix& InversionKernel::Kernel()
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->Mount();
+		return(this->_kernel);
+	}
+
+	void InversionKernel::NNLS(math_la::math_lac::full::NNLSSolver& solver)
+	{
+		math_la::math_lac::full::NNLSFactorizationHandle f;
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			if (!this->_nnls)
+			{
+				this->Mount();
+				this->_nnls = math_la::math_lac::full::NNLSSolver::Factorize(this->_kernel);
+			}
+			f = this->_nnls;
+		}
+		if (solver.Factorization() != f)
+		{
+			solver.Set_Factorization(f);
+		}
+	}
+
+	void InversionKernel::BRD(int rank, math_la::math_lac::full::BRDSolver& solver)
+	{
+		math_la::math_lac::full::BRDFactorizationHandle f;
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			math_la::math_lac::full::BRDFactorizationHandle& cached = this->_brd[rank];
+			if (!cached)
+			{
+				this->Mount();
+				cached = math_la::math_lac::full::BRDSolver::Factorize(this->_kernel, this->Rows(), rank);
+			}
+			f = cached;
+		}
+		if (solver.Factorization() != f)
+		{
+			solver.Set_Factorization(f);
+		}
+	}
+
+	void InversionKernel::Decompose()
+	{
+		if (this->_svdReady)
+		{
+			return;
+		}
+		this->Mount();
+		math_la::math_lac::full::Matrix V;
+		this->_kernel.SVD_Zero_Shift(this->_u, V, this->_d);
+		this->_svdReady = true;
+	}
+
+	const math_la::math_lac::full::Matrix& InversionKernel::Left_Singular_Vectors()
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->Decompose();
+		return(this->_u);
+	}
+
+	const math_la::math_lac::full::Matrix& InversionKernel::Singular_Values()
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->Decompose();
+		return(this->_d);
+	}
+
+	InversionKernelHandle KernelCache::Find(const math_la::math_lac::full::Vector& time, const math_la::math_lac::full::Vector& t2, scalar lambda, int kernel_type)
+	{
+		size_t h = InversionKernel::Hash(time, t2, lambda, kernel_type);
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		for (std::list<InversionKernelHandle>::iterator it = cacheKernels.begin(); it != cacheKernels.end(); ++it)
+		{
+			if ((*it)->Matches(h, time, t2, lambda, kernel_type))
+			{
+				cacheKernels.splice(cacheKernels.begin(), cacheKernels, it);
+				return(cacheKernels.front());
+			}
+		}
+		cacheKernels.push_front(InversionKernelHandle(new InversionKernel(time, t2, lambda, kernel_type)));
+		while (cacheKernels.size() > KERNEL_CACHE_SIZE)
+		{
+			cacheKernels.pop_back();
+		}
+		return(cacheKernels.front());
+	}
+
+	void KernelCache::Clear()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		cacheKernels.clear();
+	}
+
+	int KernelCache::Size()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		return((int)cacheKernels.size());
+	}
+}
@@ -0,0 +1,185 @@
+#ifndef KERNEL_CACHE_H
+#define KERNEL_CACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include "math_la/mdefs.h"
+#include "math_la/math_lac/full/matrix.h"
+#include "math_la/math_lac/full/vector.h"
+#include "math_la/math_lac/full/nnls_solver.h"
+#include "math_la/math_lac/full/brd_solver.h"
+
+/**
+* Maximal number of kernels kept by the kernel cache. The least recently used one is released first
+*/
+#define KERNEL_CACHE_SIZE 16
+
+namespace rw
+{
+	/**
+	* Kernel exp(-t_i/T_j) of a decay time grid t and a T2 grid T, stacked over lambda*I when the regularizer
+	* lambda is not zero, together with the factorizations that the inversions derive from it. The kernel and
+	* every factorization are computed the first time they are requested, and are read only from then on.
+	* Several threads may share a kernel: the setup is guarded by a mutex, the solvers share the factorizations
+	* through read only handles, and every caller owns the workspaces of its solvers.
+	*/
+	class InversionKernel
+	{
+	private:
+		/**
+		* Decay time grid, T2 grid, regularizer and kernel type of the kernel
+		*/
+		vec(scalar) _time;
+		vec(scalar) _t2;
+		scalar _lambda;
+		int _kernelType;
+
+		/**
+		* Hash of the grids, regularizer and kernel type
+		*/
+		size_t _hash;
+
+		/**
+		* Guards the lazy setup below
+		*/
+		std::mutex _mutex;
+
+		/**
+		* Kernel matrix, of size (n+m) x m when stacked with the regularizer and n x m otherwise
+		*/
+		bool _kernelReady;
+		math_la::math_lac::full::Matrix _kernel;
+
+		/**
+		* Normal matrix of the kernel, null until the first NNLS solver is requested
+		*/
+		math_la::math_lac::full::NNLSFactorizationHandle _nnls;
+
+		/**
+		* Compressions of the kernel, by maximal rank
+		*/
+		std::map<int, math_la::math_lac::full::BRDFactorizationHandle> _brd;
+
+		/**
+		* Left singular vectors and singular values of the kernel
+		*/
+		bool _svdReady;
+		math_la::math_lac::full::Matrix _u;
+		math_la::math_lac::full::Matrix _d;
+
+		/**
+		* Computes the kernel matrix, if it was not computed yet. The mutex must be held
+		*/
+		void Mount();
+
+		/**
+		* Computes the singular value decomposition of the kernel, if it was not computed yet. The mutex must be held
+		*/
+		void Decompose();
+	public:
+		/**
+		* @param time Decay time grid
+		* @param t2 T2 grid, non logarithmic scale
+		* @param lambda Regularizer
+		* @param kernel_type Kernel type: T1 or T2
+		*/
+		InversionKernel(const math_la::math_lac::full::Vector& time, const math_la::math_lac::full::Vector& t2, scalar lambda, int kernel_type);
+
+		/**
+		* @return Hash of the decay time grid, the T2 grid, the regularizer and the kernel type
+		*/
+		static size_t Hash(const math_la::math_lac::full::Vector& time, const math_la::math_lac::full::Vector& t2, scalar lambda, int kernel_type);
+
+		/**
+		* @return TRUE if the kernel was built from exactly these grids, regularizer and kernel type
+		*/
+		bool Matches(size_t hash, const math_la::math_lac::full::Vector& time, const math_la::math_lac::full::Vector& t2, scalar lambda, int kernel_type) const;
+
+		/**
+		* @return Number of rows of the kernel that belong to the decay
+		*/
+		int Rows() const;
+
+		/**
+		* @return Number of bins of the T2 grid
+		*/
+		int Columns() const;
+
+		/**
+		* @return The kernel matrix
+		*/
+		const math_la::math_lac::full::Matrix& Kernel();
+
+		/**
+		* Shares the normal matrix of the kernel with a solver. Only the handle is taken under the mutex, and the
+		* solver keeps its workspaces when it already solved this kernel
+		* @param solver NNLS solver of the kernel
+		*/
+		void NNLS(math_la::math_lac::full::NNLSSolver& solver);
+
+		/**
+		* Shares the compressed kernel with a solver, as NNLS does
+		* @param rank Maximal number of singular triplets kept
+		* @param solver BRD solver of the decay rows of the kernel
+		*/
+		void BRD(int rank, math_la::math_lac::full::BRDSolver& solver);
+
+		/**
+		* @return Left singular vectors of the kernel
+		*/
+		const math_la::math_lac::full::Matrix& Left_Singular_Vectors();
+
+		/**
+		* @return Singular values of the kernel, on the diagonal
+		*/
+		const math_la::math_lac::full::Matrix& Singular_Values();
+	};
+
+	/**
+	* Shared handle of a kernel of the cache. A kernel released by the cache lives on while handles to it remain.
+	*/
+	typedef std::shared_ptr<InversionKernel> InversionKernelHandle;
+
+	/**
+	* Process wide cache of inversion kernels. The experiments of an optimization share their time grid, T2
+	* grid and regularizer, so every inversion after the first finds its kernel and factorizations ready.
+	* All the methods are thread safe.
+	*/
+	class KernelCache
+	{
+	public:
+		/**
+		* Finds the kernel of the grids, adding it to the cache if it is not there. The kernel is computed
+		* on first use, outside the lock of the cache.
+		* @param time Decay time grid
+		* @param t2 T2 grid, non logarithmic scale
+		* @param lambda Regularizer
+		* @param kernel_type Kernel type: T1 or T2
+		* @return Handle of the kernel
+		*/
+		static InversionKernelHandle Find(const math_la::math_lac::full::Vector& time, const math_la::math_lac::full::Vector& t2, scalar lambda, int kernel_type);
+
+		/**
+		* Releases every kernel of the cache
+		*/
+		static void Clear();
+
+		/**
+		* @return Number of kernels in the cache
+		*/
+		static int Size();
+	};
+
+	inline int InversionKernel::Rows() const
+	{
+		return((int)this->_time.size());
+	}
+
+	inline int InversionKernel::Columns() const
+	{
+		return((int)this->_t2.size());
+	}
+}
+
+#endif
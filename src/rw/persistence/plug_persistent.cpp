@@ -72,12 +72,6 @@ namespace rw
 
 	PlugPersistent::~PlugPersistent()
 	{
-		for (int k = 0; k < (int)this->_profileSequence.size(); ++k)
-		{
-			vector<scalar>* profile = this->_profileSequence[k];
-			delete profile;
-		}
-		this->_profileSequence.clear();
 	}
 
 
@@ -106,6 +100,64 @@ namespace rw
 		return(this->_simParams.Get_Value(DECAY_REDUCTION));
 	}
 
+	void PlugPersistent::Set_Walk_Mode(uint mode)
+	{
+		this->_simParams.Set_Value(WALK_MODE, mode);
+	}
+
+	uint PlugPersistent::Walk_Mode() const
+	{
+		return(this->_simParams.Get_Value(WALK_MODE));
+	}
+
+	void PlugPersistent::Set_Absorbing_Walls(bool absorbing)
+	{
+		this->_simParams.Set_Bool(DEGR, !absorbing);
+	}
+
+	bool PlugPersistent::Absorbing_Walls() const
+	{
+		return(this->_simParams.Kill());
+	}
+
+	void PlugPersistent::Set_Magnetization_Floor(scalar floor)
+	{
+		this->_simParams.Set_Float(MAGNETIZATION_FLOOR, (float)floor);
+	}
+
+	scalar PlugPersistent::Magnetization_Floor() const
+	{
+		return((scalar)this->_simParams.Get_Float(MAGNETIZATION_FLOOR));
+	}
+
+	bool PlugPersistent::Set_Hit_Histogram_Interval(uint interval)
+	{
+		this->_simParams.Set_Value(HIT_HISTOGRAM_INTERVAL, interval);
+		return((interval == 0) || ((!this->_simParams.Kill()) && (this->_simParams.Magnetization_Floor() <= 0)));
+	}
+
+	uint PlugPersistent::Hit_Histogram_Interval() const
+	{
+		return(this->_simParams.Get_Value(HIT_HISTOGRAM_INTERVAL));
+	}
+
+	void PlugPersistent::Set_Laplace_Inversion(uint inversion, uint rank)
+	{
+		this->_simParams.Set_Value(LAPLACE_INVERSION, inversion);
+		this->_simParams.Set_Value(LAPLACE_RANK, rank);
+	}
+
+	uint PlugPersistent::Laplace_Inversion() const
+	{
+		return(this->_simParams.Get_Value(LAPLACE_INVERSION));
+	}
+
+	uint PlugPersistent::Laplace_Inversion_Rank() const
+	{
+		uint rank = this->_simParams.Get_Value(LAPLACE_RANK);
+		return((rank == 0) ? 32 : rank);
+	}
+
 
 	scalar PlugPersistent::Laplace_T_Min() const
 	{
@@ -246,7 +298,7 @@ namespace rw
 		bfile.Write((uint)this->_gradientUnits);
 		bfile.Write((uint)this->_gyroUnits);
 		bfile.Write((uint)this->_timeStepUnits);
-		bfile.Write((uint)0);
+		this->_profileSequence.Write(bfile);
 		bfile.Close();
 	}
 
@@ -419,7 +471,7 @@ namespace rw
 		this->_gradientUnits = bfile.Read_UInt();
 		this->_gyroUnits = bfile.Read_UInt();
 		this->_timeStepUnits = bfile.Read_UInt();
-		bfile.Read_UInt();
+		this->_profileSequence.Read(bfile);
 		bfile.Close();
 	}
 
@@ -458,11 +510,7 @@ namespace rw
 		this->_dimension = plug.Dimension();	
 		this->_walkersStartPosition = plug._walkersStartPosition;
 		this->_totalIterations = plug.Total_Number_Of_Simulated_Iterations();
-		for (int k = 0; k < plug._profileSequence.size(); ++k)
-		{
-			vector<scalar>* vsc = new vector<scalar>(*plug._profileSequence[k]);
-			this->_profileSequence.push_back(vsc);
-		}
+		this->_profileSequence = plug._profileSequence;
 	}
 
 
@@ -479,11 +527,7 @@ namespace rw
 		genalg._lambda = this->_laplaceRegularizer;
 		genalg._reductionT2 = this->_simParams.Get_Value(DECAY_REDUCTION);
 		genalg._laplaceTransform = this->_laplaceTransform;
-		for (int k = 0; k < this->_profileSequence.size(); ++k)
-		{
-			vector<scalar>* vsc = new vector<scalar>(*this->_profileSequence[k]);
-			genalg._profileSequence.push_back(vsc);
-		}
+		genalg._profileSequence = this->_profileSequence;
 	}
 
 
@@ -504,22 +548,9 @@ namespace rw
 			plug._timeStep = this->Time_Step_Simulation();
 			plug._gradient = this->Gradient();
 			plug._totalIterations = this->_totalIterations;
-			if (this->_profileSequence.size() > 0)
+			if (this->_profileSequence.Size() > 0)
 			{
-				if (plug._profileSequence.size() > 0)
-				{
-					for (int k = 0; k < plug._profileSequence.size(); ++k)
-					{
-						vector<scalar>* profile = plug._profileSequence[k];
-						delete profile;
-					}
-				}
-				plug._profileSequence.clear();
-				for (int k = 0; k < (int)this->_profileSequence.size(); ++k)
-				{
-					vector<scalar>* profile = new vector<scalar>(*this->_profileSequence[k]);
-					plug._profileSequence.push_back(profile);
-				}
+				plug._profileSequence = this->_profileSequence;
 			}
 		}
 		return(r);
@@ -527,13 +558,12 @@ namespace rw
 
 	int PlugPersistent::Profile_Process_Vector_Size() const
 	{
-		return((int)this->_profileSequence.size());
+		return(this->_profileSequence.Size());
 	}
 
-	const vector<scalar>& PlugPersistent::Profile_Vector(int id) const
+	void PlugPersistent::Profile_Vector(int id, vector<scalar>& profile) const
 	{
-		vector<scalar>* ptr = this->_profileSequence[id];
-		return(*ptr);
+		this->_profileSequence.Decode(id, profile);
 	}
 
 
@@ -707,6 +737,19 @@ namespace rw
 		return(this->_noiseAmplitude);
 	}
 
+	scalar PlugPersistent::Noise_Deviation() const
+	{
+		if ((this->_noiseAmplitude == 0) || (this->_decayValues.size() == 0))
+		{
+			return(0);
+		}
+		/**
+		* The noise is uniform on [-amplitude/2, amplitude/2], scaled as in Decay_Step_Value
+		*/
+		scalar nms = std::max(this->_decayValues[0].Magnetization, (scalar)1.0);
+		return(this->_noiseAmplitude*nms / sqrt((scalar)12));
+	}
+
 	rw::Step_Value PlugPersistent::Decay_Step_Value(int id) const
 	{
 		if (this->_noiseAmplitude == 0)
@@ -1068,9 +1111,8 @@ namespace rw
 		return(snr);
 	}
 
-	void PlugPersistent::Apply_Laplace()
+	void PlugPersistent::Mount_Laplace(ExponentialFitting& fit) const
 	{
-		ExponentialFitting fit;
 		uint tt = 1;
 		if (this->SimulationParams().T1_Relaxation())
 		{
@@ -1081,10 +1123,96 @@ namespace rw
 		fit = fit.Logarithmic_Reduction(this->_simParams.Get_Value(DECAY_REDUCTION));
 		fit.Kernel_T2_Mount(this->_laplaceT2min, this->_laplaceT2max, 
 			this->_laplaceResolution,this->_laplaceRegularizer);
+		fit.Set_Inversion(this->Laplace_Inversion(), this->Laplace_Inversion_Rank());
+	}
+
+	void PlugPersistent::Apply_Laplace()
+	{
+		ExponentialFitting fit;
+		this->Mount_Laplace(fit);
 		fit.Solve(this->_laplaceT, this->_laplaceTransform);	
 		this->_laplaceApplied = true;
 	}
 
+	void PlugPersistent::Benchmark_Laplace(scalar& nnls, scalar& brd) const
+	{
+		ExponentialFitting fit;
+		this->Mount_Laplace(fit);
+		fit.Benchmark_Inversion(nnls, brd);
+	}
+
+	bool PlugPersistent::Benchmark_Laplace_Batch(int count, scalar& sequential, scalar& batch) const
+	{
+		ExponentialFitting fit;
+		this->Mount_Laplace(fit);
+		sequential = 0;
+		batch = 0;
+		return(fit.Benchmark_Batch(sequential, batch, count));
+	}
+
+	scalar PlugPersistent::Sweep_Surface_Relaxivity(rw::Plug& plug, scalar rho_min, scalar rho_max, int count,
+		scalar& error) const
+	{
+		error = 0;
+		rw::SimulationParams params(plug.Simulation_Parameters());
+		params.Set_Value(HIT_HISTOGRAM_INTERVAL, std::max(this->Hit_Histogram_Interval(), (uint)1));
+		plug.Set_Simulation_Parameter(params);
+		if ((plug.Hit_Histogram_Interval() == 0) || (this->_decayValues.size() < 2) || (count <= 0) ||
+			(rho_min <= 0) || (rho_max < rho_min))
+		{
+			return(0);
+		}
+		vector<scalar> rhos(count);
+		vector<scalar> deltas(count);
+		for (int k = 0; k < count; ++k)
+		{
+			scalar s = (count > 1) ? (scalar)k / (scalar)(count - 1) : (scalar)0;
+			rhos[k] = rho_min*pow(rho_max / rho_min, s);
+			deltas[k] = std::max(this->Surface_Relaxivity_Factor(rhos[k]), (scalar)0);
+		}
+		plug.Set_Surface_Relaxivity_Delta(deltas[0]);
+		plug.Deallocate_Walking_Particles();
+		plug.Place_Walking_Particles();
+		plug.Random_Walk_Procedure();
+		vector<vector<rw::Step_Value> > decays;
+		plug.Relaxivity_Sweep(deltas, decays);
+		scalar best = 0;
+		for (int k = 0; k < count; ++k)
+		{
+			scalar sum = 0;
+			int samples = 0;
+			size_t j = 0;
+			for (const rw::Step_Value& v : decays[k])
+			{
+				while ((j + 2 < this->_decayValues.size()) && (this->_decayValues[j + 1].Time < v.Time))
+				{
+					++j;
+				}
+				const rw::Step_Value& a = this->_decayValues[j];
+				const rw::Step_Value& b = this->_decayValues[j + 1];
+				if ((v.Time < a.Time) || (v.Time > b.Time) || (b.Time <= a.Time))
+				{
+					continue;
+				}
+				scalar u = (v.Time - a.Time) / (b.Time - a.Time);
+				scalar d = v.Magnetization - (a.Magnetization + u*(b.Magnetization - a.Magnetization));
+				sum = sum + d*d;
+				++samples;
+			}
+			if (samples == 0)
+			{
+				continue;
+			}
+			scalar rms = sqrt(sum / (scalar)samples);
+			if ((best == 0) || (rms < error))
+			{
+				best = rhos[k];
+				error = rms;
+			}
+		}
+		return(best);
+	}
+
 	void PlugPersistent::Set_Image_Path(const string& path)
 	{
 		this->_imagePath = path;
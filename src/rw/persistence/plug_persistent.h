@@ -142,7 +142,7 @@ namespace rw
 		* The sequence of colision rate along the simulation. This collision rate distribution evolves with time and this evolution
 		* is captured in this sequence. The size of these vectors do not need to be of the same size of the total number of walkers
 		*/
-		vector <vector<scalar>*> _profileSequence;
+		rw::ProfileSequence _profileSequence;
 
 		/**
 		* Simulation name. It can be used as a unique identifier. 
@@ -294,6 +294,12 @@ namespace rw
 		* Populates simulation values with the information collected in the Formation
 		*/
 		void Fill_Sim_Values(const rw::Plug& env);
+
+		/**
+		* Loads the decay into a fitting and mounts the kernel of the Laplace transform with the internal parameters
+		* @param fit Fitting to mount
+		*/
+		void Mount_Laplace(ExponentialFitting& fit) const;
 	public:	
 		PlugPersistent();
 		~PlugPersistent();
@@ -322,6 +328,11 @@ namespace rw
 		*/
 		scalar Noise_Distortion() const;
 
+		/**
+		* @return Standard deviation of the noise that Decay_Step_Value adds to the decay, zero without noise
+		*/
+		scalar Noise_Deviation() const;
+
 		/**
 		* Sets the diffusion coefficient of the simulation. 
 		* @param diffusion_coefficient Diffusion coefficient value
@@ -438,6 +449,77 @@ namespace rw
 		*/
 		int Decay_Reduction() const;
 
+		/**
+		* Sets the walk rule of the CPU simulation
+		* @param mode WALK_LATTICE for the voxel by voxel walk, or WALK_FIRST_PASSAGE to let the walkers
+		* jump across the pore space by spheres that do not touch the walls. The jumps skip the steps that
+		* absorbing walls, a magnetization floor or a hit histogram follow, so with any of them set the CPU
+		* walk falls back to the lattice (see RandomWalkFirstPassageImplementor::Supports).
+		*/
+		void Set_Walk_Mode(uint mode);
+
+		/**
+		* @return The walk rule of the CPU simulation
+		*/
+		uint Walk_Mode() const;
+
+		/**
+		* Sets the collision rule of the walkers
+		* @param absorbing If TRUE, a walker is absorbed on a collision with probability 1 - delta, instead of
+		* losing a fraction of its magnetization
+		*/
+		void Set_Absorbing_Walls(bool absorbing);
+
+		/**
+		* @return TRUE if the walkers are absorbed by the walls
+		*/
+		bool Absorbing_Walls() const;
+
+		/**
+		* Sets the magnetization below which a walker stops walking. Its magnetization is frozen and still
+		* contributes to the decay. Zero disables the floor.
+		* @param floor Magnetization floor
+		*/
+		void Set_Magnetization_Floor(scalar floor);
+
+		/**
+		* @return The magnetization floor of the walkers
+		*/
+		scalar Magnetization_Floor() const;
+
+		/**
+		* Sets the number of steps between two recorded hit histograms. With a non-zero interval, the walk
+		* records the histograms of the walkers' hits, from which Plug::Relaxivity_Sweep evaluates the decay
+		* of any constant surface relaxivity. Only the CPU lattice walk records them, so a plug with an interval
+		* is walked on it even if the GPU or the first-passage walk is selected. Zero disables the histograms.
+		* @param interval Number of steps
+		* @return FALSE if the interval is ignored, because the walls absorb the walkers or the magnetization
+		* has a floor (see Plug::Hit_Histogram_Interval)
+		*/
+		bool Set_Hit_Histogram_Interval(uint interval);
+
+		/**
+		* @return The number of steps between two recorded hit histograms
+		*/
+		uint Hit_Histogram_Interval() const;
+
+		/**
+		* Sets the inversion method of the Laplace transform (see rw::ExponentialFitting::Set_Inversion)
+		* @param inversion ExponentialFitting::NNLS_Inversion or ExponentialFitting::BRD_Inversion
+		* @param rank Maximal number of singular triplets of the kernel kept by the BRD inversion
+		*/
+		void Set_Laplace_Inversion(uint inversion, uint rank);
+
+		/**
+		* @return The inversion method of the Laplace transform
+		*/
+		uint Laplace_Inversion() const;
+
+		/**
+		* @return Maximal number of singular triplets of the kernel kept by the BRD inversion, 32 if it was never set
+		*/
+		uint Laplace_Inversion_Rank() const;
+
 		/**
 		* @return Number of bins of the Laplace transform
 		*/
@@ -559,6 +641,42 @@ namespace rw
 		*/
 		void Apply_Laplace();
 
+		/**
+		* Mounts the kernel of Apply_Laplace and measures both inversion methods on it (see
+		* rw::ExponentialFitting::Benchmark_Inversion). The stored Laplace transform is not modified.
+		* @param nnls Seconds of the NNLS inversion
+		* @param brd Seconds of the BRD inversion
+		*/
+		void Benchmark_Laplace(scalar& nnls, scalar& brd) const;
+
+		/**
+		* Mounts the kernel of Apply_Laplace and measures the batch inversion against inverting the decays one by
+		* one (see rw::ExponentialFitting::Benchmark_Batch). The stored Laplace transform is not modified.
+		* @param count Number of decays of the batch
+		* @param sequential Decays per second inverted one by one
+		* @param batch Decays per second inverted as a batch
+		* @return FALSE if the batch could not be solved or its first distribution differs from the sequential one
+		*/
+		bool Benchmark_Laplace_Batch(int count, scalar& sequential, scalar& batch) const;
+
+		/**
+		* Calibrates a constant surface relaxivity against the decay of the simulation. The plug is walked
+		* once with the weakest relaxivity, recording hit histograms every Hit_Histogram_Interval() steps (every
+		* step without interval), and the decays of count relaxivities, spaced logarithmically in [rho_min,
+		* rho_max], are evaluated from them (see Plug::Relaxivity_Sweep).
+		* @param plug Plug with the image and the parameters of the simulation (see Fill_Plug_Paremeters). Its
+		* walkers are placed again.
+		* @param rho_min Weakest surface relaxivity, in the units of Surface_Relaxivity
+		* @param rho_max Strongest surface relaxivity, in the units of Surface_Relaxivity
+		* @param count Number of relaxivities
+		* @param error Root mean square difference between the decay of the relaxivity returned and the decay
+		* of the simulation, interpolated at the recorded times
+		* @return The relaxivity of the smallest error, zero if the walk cannot record the histograms or if no
+		* decay overlaps the one of the simulation
+		*/
+		scalar Sweep_Surface_Relaxivity(rw::Plug& plug, scalar rho_min, scalar rho_max, int count,
+			scalar& error) const;
+
 		/**
 		* Image identifier
 		*/
@@ -677,9 +795,11 @@ namespace rw
 		int Profile_Process_Vector_Size() const;
 
 		/**
-		* @return Profile vectoir indexed by id
+		* Decodes the profile indexed by id
+		* @param id Index of the profile
+		* @param profile Values of the profile
 		*/
-		const vector<scalar>& Profile_Vector(int id) const;
+		void Profile_Vector(int id, vector<scalar>& profile) const;
 
 		/**
 		* Sets the time in which the simulation was executed
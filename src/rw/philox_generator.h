@@ -0,0 +1,117 @@
+#ifndef PHILOX_GENERATOR_H
+#define PHILOX_GENERATOR_H
+
+#include "math_la/mdefs.h"
+
+namespace rw
+{
+	#define PHILOX_M0 0xD2511F53
+	#define PHILOX_M1 0xCD9E8D57
+	#define PHILOX_W0 0x9E3779B9
+	#define PHILOX_W1 0xBB67AE85
+	#define PHILOX_ROUNDS 10
+	#define PHILOX_BLOCK 4
+	#define PHILOX_STREAM_ABSORPTION 1
+	#define PHILOX_STREAM_PLACEMENT 2
+
+	/**
+	* A counter-based random number generator (Philox4x32-10). Unlike a streamed generator, it has no
+	* internal state: every block of four random words is a pure function of a key and a counter.
+	* The random walk keys the generator with the simulation seed and uses the pair (walker id, step) as
+	* counter, so every walker can generate its own decisions on the fly, in any thread and in any order,
+	* and the paths are always the same for the same seed.
+	*/
+	class PhiloxGenerator
+	{
+	private:
+		/**
+		* Key of the generator, derived from the simulation seed
+		*/
+		uint _key[2];
+
+		/**
+		* 32x32 bits multiplication, returning the high and low words of the product
+		*/
+		static void Mul_Hi_Lo(uint a, uint b, uint& hi, uint& lo);
+	public:
+		/**
+		* @param seed Seed of the simulation. The same seed always generates the same sequences
+		*/
+		PhiloxGenerator(uint seed = 0);
+
+		/**
+		* Sets a new key for the generator
+		* @param seed Seed of the simulation
+		*/
+		void Set_Seed(uint seed);
+
+		/**
+		* Generates a block of four random words associated to a walker and a step.
+		* @param walker Walker identifier (first word of the counter)
+		* @param step Block of steps (second word of the counter). Each block serves PHILOX_BLOCK steps
+		* @param out The four random words
+		* @param stream Independent sequence of the walker (third word of the counter)
+		*/
+		void Generate(uint walker, uint step, uint* out, uint stream = 0) const;
+
+		/**
+		* Maps a random word into the interval [0,n) by a multiplication and a shift, which avoids the
+		* division of the modulus operator.
+		* @param word Random word
+		* @param n Size of the interval
+		* @return An integer in [0,n)
+		*/
+		static int Bounded(uint word, uint n);
+	};
+
+	inline PhiloxGenerator::PhiloxGenerator(uint seed)
+	{
+		this->Set_Seed(seed);
+	}
+
+	inline void PhiloxGenerator::Set_Seed(uint seed)
+	{
+		this->_key[0] = seed;
+		this->_key[1] = seed ^ PHILOX_W1;
+	}
+
+	inline void PhiloxGenerator::Mul_Hi_Lo(uint a, uint b, uint& hi, uint& lo)
+	{
+		unsigned long long p = (unsigned long long)a * (unsigned long long)b;
+		hi = (uint)(p >> 32);
+		lo = (uint)p;
+	}
+
+	inline void PhiloxGenerator::Generate(uint walker, uint step, uint* out, uint stream) const
+	{
+		uint c0 = walker;
+		uint c1 = step;
+		uint c2 = stream;
+		uint c3 = 0;
+		uint k0 = this->_key[0];
+		uint k1 = this->_key[1];
+		for (int r = 0; r < PHILOX_ROUNDS; ++r)
+		{
+			uint hi0, lo0, hi1, lo1;
+			PhiloxGenerator::Mul_Hi_Lo(PHILOX_M0, c0, hi0, lo0);
+			PhiloxGenerator::Mul_Hi_Lo(PHILOX_M1, c2, hi1, lo1);
+			c0 = hi1 ^ c1 ^ k0;
+			c1 = lo1;
+			c2 = hi0 ^ c3 ^ k1;
+			c3 = lo0;
+			k0 = k0 + PHILOX_W0;
+			k1 = k1 + PHILOX_W1;
+		}
+		out[0] = c0;
+		out[1] = c1;
+		out[2] = c2;
+		out[3] = c3;
+	}
+
+	inline int PhiloxGenerator::Bounded(uint word, uint n)
+	{
+		return((int)(((unsigned long long)word * (unsigned long long)n) >> 32));
+	}
+}
+
+#endif
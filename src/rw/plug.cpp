@@ -7,6 +7,7 @@
 #include "plug.h"
 #include "tbb/parallel_for.h"
 #include "tbb/parallel_reduce.h"
+#include "tbb/combinable.h"
 #include "relaxivity_distribution.h"
 #include "random_walk_implementor.h"
 #include "rw_impl_creator.h"
@@ -21,9 +22,7 @@ namespace rw
 	Plug::Plug()
 	{
 		this->_implementor = 0;
-		this->_mask = 0;
 		this->_simParams.Set_Bool(T2, true);
-		this->_image = 0;
 		this->_simParams.Set_Value(PROFILE_SIZE, 32768);
 		this->_simParams.Set_Value(PROFILE_UPDATE, 0);
 		this->_simParams.Set_Bool(VARYING, false);
@@ -78,6 +77,8 @@ namespace rw
 		this->_mask = e._mask;
 		this->_simParams = e._simParams;
 		this->_image = e._image;
+		this->_view = e._view;
+		this->_poreRanks = e._poreRanks;
 		this->_decayValues.reserve(16000);
 		this->_surfaceRelaxationRate = (scalar)e._surfaceRelaxationRate;
 		this->_bulkRelaxationTime = (scalar)e._bulkRelaxationTime;
@@ -104,14 +105,6 @@ namespace rw
 
 	Plug::~Plug()
 	{
-		if (this->_mask)
-		{
-			delete this->_mask;
-		}
-		if (this->_image)
-		{
-			delete this->_image;
-		}
 		this->Clear_Collision_Profile();
 		if (this->_implementor)
 		{
@@ -121,10 +114,42 @@ namespace rw
 
 	void Plug::Set_Image_Formation(const BinaryImage& image)
 	{
-		this->_image = new BinaryImage(image);
-		this->_simParams.Set_Value(DIM_X,image.Width());
-		this->_simParams.Set_Value(DIM_Y, image.Height());
-		this->_simParams.Set_Value(DIM_Z, image.Depth());
+		this->Set_Image_Formation(std::make_shared<BinaryImage>(image));
+	}
+
+	void Plug::Set_Image_Formation(const BinaryImageHandle& image)
+	{
+		this->_image = image;
+		this->_view = BinaryImageView(image);
+		this->_poreRanks.clear();
+		this->_simParams.Set_Value(DIM_X, image->Width());
+		this->_simParams.Set_Value(DIM_Y, image->Height());
+		this->_simParams.Set_Value(DIM_Z, image->Depth());
+	}
+
+	void Plug::Set_Image_Section(const BinaryImageHandle& image, const Pos3i& origin, const Pos3i& size)
+	{
+		this->_view = BinaryImageView(image, origin, size);
+		if (this->_view.Whole())
+		{
+			this->_image = image;
+		}
+		else
+		{
+			this->_image.reset();
+		}
+		this->_poreRanks.clear();
+		this->_simParams.Set_Value(DIM_X, size.x);
+		this->_simParams.Set_Value(DIM_Y, size.y);
+		this->_simParams.Set_Value(DIM_Z, size.z);
+	}
+
+	void Plug::Copy_Section()
+	{
+		if (!this->_image)
+		{
+			this->_image = std::make_shared<BinaryImage>(this->_view.Copy());
+		}
 	}
 
 	void Plug::Lock()
@@ -259,52 +284,85 @@ namespace rw
 	void Plug::Update_Collision_Profile(uint currentItr)
 	{
 		uint ss = this->_simParams.Get_Value(PROFILE_SIZE);
-		uint compr = this->_simParams.Get_Value(PROFILE_UPDATE);
-		int rr = max((int)(this->_walkers.size() / (10 * ss)), (int)1);
-		map<int, int> xiprof;
-		vector<scalar> hst(this->_walkers.size());
-		vector<scalar>* chst = new vector<scalar>(compr);
-		for (int t = 0; t < this->_walkers.size(); ++t)
-		{
-			Walker& w = this->_walkers[t];
-			int xi = (int)w.Hits();
-			map<int, int>::iterator iix = xiprof.find(xi);
-			if (iix != xiprof.end())
+		int nw = (int)this->_walkers.size();
+		int rr = max((int)(nw / (10 * ss)), (int)1);
+		vector<scalar> chst(ss, (scalar)0);
+		if (nw == 0)
+		{
+			this->_profileSequence.Push(chst);
+			return;
+		}
+		int top = tbb::parallel_reduce(tbb::blocked_range<int>(0, nw, DCHUNK_SIZE), 0, [this](const tbb::blocked_range<int>& b, int m)
+		{
+			for (int t = b.begin(); t < b.end(); ++t)
 			{
-				iix->second = iix->second + 1;
+				m = max(m, this->_walkers[t].Hits());
 			}
-			else
+			return(m);
+		}, [](int a, int b)
+		{
+			return(max(a, b));
+		});
+		/**
+		* Histogram of the hits, one partial histogram per thread
+		*/
+		tbb::combinable<vector<uint> > partial([top]()
+		{
+			return(vector<uint>(top + 1, 0));
+		});
+		tbb::parallel_for(tbb::blocked_range<int>(0, nw, DCHUNK_SIZE), [this, &partial](const tbb::blocked_range<int>& b)
+		{
+			vector<uint>& h = partial.local();
+			for (int t = b.begin(); t < b.end(); ++t)
 			{
-				xiprof[xi] = 1;
+				++h[this->_walkers[t].Hits()];
 			}
-		}
-		map<int, int>::const_reverse_iterator iix = xiprof.rbegin();
-		int ii = 0;
-		while (iix != xiprof.rend())
+		});
+		vector<uint> count(top + 1, 0);
+		partial.combine_each([&count](const vector<uint>& h)
 		{
-			for (int k = 0; k < iix->second; ++k)
+			for (int k = 0; k < (int)h.size(); ++k)
 			{
-				hst[ii] = (scalar)iix->first/(scalar)currentItr;
-				++ii;
+				count[k] = count[k] + h[k];
 			}
-			++iix;
-		}
-		scalar factor = (scalar)this->_walkers.size() / (scalar)ss;
-		for (uint i = 0; i < ss; ++i)
-		{
-			int k = (int)(((scalar)i)*factor);
-			int flag = max(0, k - rr);
-			int size = min(k + rr, (int)this->_walkers.size());
-			int n = 0;
-			scalar xi = 0;
-			for (int j = flag; j < size; ++j)
+		});
+		/**
+		* The collision rates sorted in decreasing order are runs of equal values, one per hit count. The
+		* sum of the j largest rates is the sum of the runs before the one of j, plus part of that run.
+		*/
+		vector<scalar> value;
+		vector<uint> start(1, 0);
+		vector<scalar> sum(1, (scalar)0);
+		for (int h = top; h >= 0; --h)
+		{
+			if (count[h] > 0)
 			{
-				xi = xi + hst[j];
-				++n;
+				value.push_back((scalar)h / (scalar)currentItr);
+				start.push_back(start.back() + count[h]);
+				sum.push_back(sum.back() + (scalar)count[h] * value.back());
 			}
-			(*chst)[i] = xi / (scalar)n;
 		}
-		this->_profileSequence.push_back(chst);
+		auto Prefix = [&value, &start, &sum](int j)
+		{
+			int r = (int)(std::upper_bound(start.begin(), start.end(), (uint)j) - start.begin()) - 1;
+			if (r >= (int)value.size())
+			{
+				return(sum.back());
+			}
+			return(sum[r] + (scalar)(j - (int)start[r]) * value[r]);
+		};
+		scalar factor = (scalar)nw / (scalar)ss;
+		tbb::parallel_for(tbb::blocked_range<int>(0, (int)ss, BCHUNK_SIZE), [nw, rr, factor, &chst, &Prefix](const tbb::blocked_range<int>& b)
+		{
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				int k = (int)(((scalar)i)*factor);
+				int flag = max(0, k - rr);
+				int size = min(k + rr, nw);
+				chst[i] = (Prefix(size) - Prefix(flag)) / (scalar)(size - flag);
+			}
+		});
+		this->_profileSequence.Push(chst);
 	}
 
 	void Plug::Set_Collision_Rate_Profile_Interval(int steps, int size)
@@ -319,12 +377,7 @@ namespace rw
 
 	void Plug::Clear_Collision_Profile()
 	{
-		for (int k = 0; k < (int)this->_profileSequence.size(); ++k)
-		{
-			vector<scalar>* profile = this->_profileSequence[k];
-			delete profile;
-		}
-		this->_profileSequence.clear();
+		this->_profileSequence.Clear();
 	}
 
 	void Plug::Set_Relaxivity_Distribution(RelaxivityDistribution* f, uint itr)
@@ -412,10 +465,59 @@ namespace rw
 		this->_decayValues.push_back(value);
 	}
 
+	bool Plug::Replay_Collision_Trace(const CollisionTrace& trace)
+	{
+		if ((!trace.Recorded()) || (trace.Walkers() != (int)this->_walkers.size()) || (this->_simParams.Kill()) || (this->_gradient.Active()))
+		{
+			return(false);
+		}
+		vec(float) delta(this->_walkers.size());
+		tbb::parallel_for(tbb::blocked_range<int>(0, (int)this->_walkers.size(), DCHUNK_SIZE), [this, &delta](const tbb::blocked_range<int>& b)
+		{
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				delta[i] = (float)this->_walkers[i].Rho();
+			}
+		});
+		vector<scalar> magnetization;
+		trace.Replay(delta, magnetization);
+		this->Clear_Decay_Steps();
+		scalar rate_factor = exp(-this->Time_Step() / this->TBulk_Seconds());
+		scalar N = (scalar)this->Number_Of_Walking_Particles();
+		scalar Ebulk = (scalar)1.0;
+		scalar E = 1;
+		uint currentIteration = 0;
+		while ((E > this->Stop_Threshold()) && (currentIteration < (uint)magnetization.size()) && (currentIteration < this->Max_Number_Of_Iterations()))
+		{
+			Ebulk = Ebulk * rate_factor;
+			E = Ebulk * magnetization[currentIteration] / N;
+			rw::Step_Value v;
+			v.Magnetization = E;
+			v.Iteration = currentIteration;
+			v.Time = ((scalar)currentIteration)*this->Time_Step();
+			this->_decayValues.push_back(v);
+			++currentIteration;
+		}
+		if ((E > this->Stop_Threshold()) && (currentIteration < this->Max_Number_Of_Iterations()))
+		{
+			this->Clear_Decay_Steps();
+			return(false);
+		}
+		this->Set_Total_Number_Of_Simulated_Iterations(currentIteration);
+		if (this->_simParams.T1_Relaxation())
+		{
+			for (int j = 0; j < (int)this->_decayValues.size(); ++j)
+			{
+				this->_decayValues[j].Magnetization = (scalar)1 - (scalar)2 * this->_decayValues[j].Magnetization;
+			}
+		}
+		return(true);
+	}
+
 	scalar Plug::Porosity() const
 	{
-		scalar p = (scalar)this->_image->Black_Voxels();
-		scalar n = (scalar)(this->_image->Width()*this->_image->Height()*this->_image->Depth());
+		scalar p = (scalar)this->_view.Black_Voxels();
+		scalar n = (scalar)this->_view.Length();
 		return(p/n);
 	}
 
@@ -505,7 +607,7 @@ namespace rw
 
 	void Plug::Set_Mask(const rw::BinaryImage& image)
 	{
-		this->_mask = new BinaryImage(image);
+		this->_mask = std::make_shared<BinaryImage>(image);
 	}
 
 	void Plug::Place_Walking_Particles()
@@ -9,10 +9,9 @@
 #include <thread>
 #include <random>
 #include <algorithm>
-#include <amp.h>
-#include <amp_math.h>
 #include "binary_image/pos3i.h"
 #include "binary_image/binary_image.h"
+#include "binary_image/binary_image_view.h"
 #include "math_la/mdefs.h"
 #include "math_la/math_lac/full/vector.h"
 #include "tbb/blocked_range.h"
@@ -24,7 +23,10 @@
 #include "simulator.h"
 #include "random_walk_observer.h"
 #include "random_walk_step_value.h"
+#include "hit_histogram.h"
+#include "collision_trace.h"
 #include "sim_params.h"
+#include "profile_sequence.h"
 
 
 namespace rw
@@ -98,15 +100,26 @@ namespace rw
 		vector<Pos3i> _walkersStartPosition;
 
 		/**
-		* Binary texture defining the pore space (and solid parts) of the sample
+		* Rank index of the pore voxels of a section, built by the placer (see BinaryImageView::Pore_Rank_Index)
 		*/
-		BinaryImage* _image;
+		vec(uint) _poreRanks;
+
+		/**
+		* Binary texture defining the pore space (and solid parts) of the sample, shared with the copies of the
+		* plug. A plug set on a section of an image has no texture of its own until Copy_Section is called.
+		*/
+		BinaryImageHandle _image;
+
+		/**
+		* View of the walked box of the texture, read by the walks and the placer
+		*/
+		BinaryImageView _view;
 
 		/**
 		* The mask is a binary image that blocks the walkers displacemente without degrading its
 		* energy (not used yet)
 		*/
-		BinaryImage* _mask;
+		BinaryImageHandle _mask;
 
 		/**
 		* Vector of magnetization decay values
@@ -119,7 +132,17 @@ namespace rw
 		* It is updated only if _updateProfileInterval > 0. This affects
 		* GPU Random Walk performance. 
 		*/
-		vector<vector<scalar>*> _profileSequence;
+		rw::ProfileSequence _profileSequence;
+
+		/**
+		* Hit histograms recorded during the RW simulation, when HIT_HISTOGRAM_INTERVAL is set
+		*/
+		HitHistogram _hitHistogram;
+
+		/**
+		* Collisions of the walkers recorded during the RW simulation, when COLLISION_TRACE is set
+		*/
+		CollisionTrace _collisionTrace;
 
 		/**
 		* Bulk relaxation time (T2b)
@@ -298,6 +321,27 @@ namespace rw
 		*/
 		void Set_Image_Formation(const BinaryImage& image);
 
+		/**
+		* Defines the image formation without copying it. The image is shared with every copy of the plug.
+		*/
+		void Set_Image_Formation(const BinaryImageHandle& image);
+
+		/**
+		* Defines a box of an image as the formation, without copying it. The image is shared with the view of
+		* the plug and with every copy of the plug.
+		* @param image Image that contains the section
+		* @param origin Origin of the section in the image
+		* @param size Size of the section, which must lie inside the image
+		*/
+		void Set_Image_Section(const BinaryImageHandle& image, const Pos3i& origin, const Pos3i& size);
+
+		/**
+		* Copies the section of a plug set by Set_Image_Section into a texture of its own, for the procedures that
+		* need a whole image. The walks keep reading the section through the view. Nothing is done if the plug
+		* already has a texture.
+		*/
+		void Copy_Section();
+
 		/**
 		* @return Dimension of the formation. It can be 2 or 3. 
 		*/
@@ -309,10 +353,16 @@ namespace rw
 		void Recharge_Walkers_Magnetization();
 
 		/**
-		* @return Binary image associated to the plug pore space description (a 3D or 2D texture)
+		* @return Binary image associated to the plug pore space description (a 3D or 2D texture). A plug set on
+		* a section has one only after Copy_Section.
 		*/
 		const BinaryImage& Plug_Texture() const;
 
+		/**
+		* @return View of the texture that the walkers move in
+		*/
+		const BinaryImageView& Plug_View() const;
+
 		/**
 		* Place walking particles inside the formation texture
 		*/
@@ -600,11 +650,81 @@ namespace rw
 		* @param itrs Number of iterations
 		*/
 		void Set_Total_Number_Of_Simulated_Iterations(uint itrs);
+
+		/**
+		* @return The number of steps between two recorded hit histograms. Zero if the walk records the
+		* magnetization of the surface relaxivity delta instead, which it always does when the walls absorb the
+		* walkers or the magnetization has a floor: a histogram only holds for walls that degrade it.
+		*/
+		uint Hit_Histogram_Interval() const;
+
+		/**
+		* @return The hit histograms recorded by the last simulation
+		*/
+		const HitHistogram& Hit_Histogram() const;
+
+		/**
+		* Evaluates the decays of many constant surface relaxivities from the hit histograms of the last
+		* simulation, without walking again. The simulation must have been executed with a
+		* HIT_HISTOGRAM_INTERVAL, and the walk must have been long enough for the weakest relaxivity.
+		* @param deltas Surface relaxivity deltas (see Set_Surface_Relaxivity_Delta)
+		* @param decays Decay of every delta, sampled every Hit_Histogram_Interval() steps
+		*/
+		void Relaxivity_Sweep(const vector<scalar>& deltas, vector<vector<rw::Step_Value> >& decays) const;
+
+		/**
+		* @return TRUE if the CPU walk records the collisions of the walkers (see CollisionTrace)
+		*/
+		bool Recording_Collision_Trace() const;
+
+		/**
+		* @return The collisions recorded by the last simulation
+		*/
+		const CollisionTrace& Collision_Trace() const;
+
+		/**
+		* Evaluates the decay of the plug by replaying the collisions of another walk with the relaxivities of
+		* its walkers, instead of walking them. The trace must come from a walk of the same walkers, starting at
+		* the same positions with the same seed. The replay is exact when the walls degrade the magnetization and
+		* there is no field gradient, otherwise the decay is not evaluated.
+		* @param trace Collisions of the walk
+		* @return FALSE if the decay cannot be replayed, or if the trace ends before the stop threshold
+		*/
+		bool Replay_Collision_Trace(const CollisionTrace& trace);
 	};
 
+	inline bool Plug::Recording_Collision_Trace() const
+	{
+		return(this->_simParams.Get_Value(COLLISION_TRACE) != 0);
+	}
+
+	inline const CollisionTrace& Plug::Collision_Trace() const
+	{
+		return(this->_collisionTrace);
+	}
+
+	inline uint Plug::Hit_Histogram_Interval() const
+	{
+		if ((this->_simParams.Kill()) || (this->_simParams.Magnetization_Floor() > 0))
+		{
+			return(0);
+		}
+		return(this->_simParams.Get_Value(HIT_HISTOGRAM_INTERVAL));
+	}
+
+	inline const HitHistogram& Plug::Hit_Histogram() const
+	{
+		return(this->_hitHistogram);
+	}
+
+	inline void Plug::Relaxivity_Sweep(const vector<scalar>& deltas, vector<vector<rw::Step_Value> >& decays) const
+	{
+		this->_hitHistogram.Decays(deltas, decays);
+	}
+
 	inline bool Plug::Masked() const
 	{
-		return(this->_mask != 0);
+		return(this->_mask != nullptr);
 	}
 
 	inline uint Plug::Number_Of_Walking_Particles() const
@@ -644,7 +764,7 @@ namespace rw
 
 	inline bool Plug::Has_Associated_Image() const
 	{
-		return ((this->_image) && (this->_image->Length() > 0));
+		return (this->_view.Length() > 0);
 	}
 
 	inline bool Plug::Empty_Particles() const
@@ -654,7 +774,7 @@ namespace rw
 
 	inline uint Plug::Seed_For_Random_Number_Generation() const
 	{
-		return(this->_simParams.Get_Bool(SEED));
+		return(this->_simParams.Get_Value(SEED));
 	}
 	
 	inline bool Plug::Varying_Surface_Relaxivity() const
@@ -667,6 +787,11 @@ namespace rw
 		return(*this->_image);
 	}
 
+	inline const BinaryImageView& Plug::Plug_View() const
+	{
+		return(this->_view);
+	}
+
 	inline uint Plug::Max_Number_Of_Iterations() const
 	{
 		return(this->_simParams.Get_Value(ITERATION_LIMIT));
@@ -690,7 +815,7 @@ namespace rw
 	inline uint Plug::Dimension() const
 	{
 		uint r = 3;
-		if (this->_image->Depth() == 0)
+		if (this->_view.Depth() == 0)
 		{
 			r = 2;
 		}
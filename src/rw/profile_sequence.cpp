@@ -0,0 +1,102 @@
+#include <cmath>
+#include <algorithm>
+#include "profile_sequence.h"
+
+namespace rw
+{
+	ProfileSequence::ProfileSequence()
+	{
+		this->_offsets.assign(1, 0);
+	}
+
+	void ProfileSequence::Push(const vector<scalar>& profile)
+	{
+		double top = 0;
+		for (int i = 0; i < (int)profile.size(); ++i)
+		{
+			top = std::max(top, std::fabs((double)profile[i]));
+		}
+		double step = top / (double)(1 << PROFILE_SEQUENCE_BITS);
+		long long last = 0;
+		for (int i = 0; i < (int)profile.size(); ++i)
+		{
+			long long q = (step > 0) ? std::llround((double)profile[i] / step) : 0;
+			long long d = q - last;
+			unsigned long long z = ((unsigned long long)d << 1) ^ (unsigned long long)(d >> 63);
+			while (z >= 0x80)
+			{
+				this->_codes.push_back((uchar)(z | 0x80));
+				z = z >> 7;
+			}
+			this->_codes.push_back((uchar)z);
+			last = q;
+		}
+		this->_offsets.push_back(this->_codes.size());
+		this->_sizes.push_back((int)profile.size());
+		this->_steps.push_back(step);
+	}
+
+	void ProfileSequence::Clear()
+	{
+		this->_codes.clear();
+		this->_offsets.assign(1, 0);
+		this->_sizes.clear();
+		this->_steps.clear();
+	}
+
+	void ProfileSequence::Decode(int id, vector<scalar>& profile) const
+	{
+		int size = this->_sizes[id];
+		double step = this->_steps[id];
+		profile.resize(size);
+		size_t c = this->_offsets[id];
+		long long last = 0;
+		for (int i = 0; i < size; ++i)
+		{
+			unsigned long long z = 0;
+			int shift = 0;
+			uchar b;
+			do
+			{
+				b = this->_codes[c];
+				++c;
+				z = z | ((unsigned long long)(b & 0x7F) << shift);
+				shift = shift + 7;
+			} while (b & 0x80);
+			last = last + ((long long)(z >> 1) ^ -(long long)(z & 1));
+			profile[i] = (scalar)((double)last * step);
+		}
+	}
+
+	void ProfileSequence::Write(file::Binary& bfile) const
+	{
+		bfile.Write((uint)this->Size());
+		for (int k = 0; k < this->Size(); ++k)
+		{
+			bfile.Write((uint)this->_sizes[k]);
+			bfile.Write((double)this->_steps[k]);
+			bfile.Write((uint)(this->_offsets[k + 1] - this->_offsets[k]));
+			for (size_t c = this->_offsets[k]; c < this->_offsets[k + 1]; ++c)
+			{
+				bfile.Write((uchar)this->_codes[c]);
+			}
+		}
+	}
+
+	void ProfileSequence::Read(file::Binary& bfile)
+	{
+		this->Clear();
+		uint n = bfile.Read_UInt();
+		for (uint k = 0; k < n; ++k)
+		{
+			this->_sizes.push_back((int)bfile.Read_UInt());
+			this->_steps.push_back(bfile.Read_Double());
+			uint bytes = bfile.Read_UInt();
+			for (uint c = 0; c < bytes; ++c)
+			{
+				this->_codes.push_back(bfile.Read_UChar());
+			}
+			this->_offsets.push_back(this->_codes.size());
+		}
+	}
+}
@@ -0,0 +1,112 @@
+#ifndef PROFILE_SEQUENCE_H
+#define PROFILE_SEQUENCE_H
+
+#include <vector>
+#include <string>
+#include "math_la/mdefs.h"
+#include "math_la/file/binary.h"
+
+/**
+* Number of bits of the fixed point quantization of a profile, relative to its largest value
+*/
+#define PROFILE_SEQUENCE_BITS 24
+
+namespace rw
+{
+	using std::vector;
+	using std::string;
+
+	/**
+	* Compact store of the sequence of collision profiles of a random walk, one profile per update interval.
+	* Every profile is quantized to fixed point, with a step of its largest value over 2^PROFILE_SEQUENCE_BITS,
+	* and the differences between consecutive values are stored as zigzag variable length integers. The
+	* profiles are sorted in decreasing order, so most differences take one or two bytes instead of the eight
+	* of a double. The profiles are decoded on demand, and any interval can be decoded on its own.
+	*/
+	class ProfileSequence
+	{
+	private:
+		/**
+		* Coded differences of all the profiles
+		*/
+		vec(uchar) _codes;
+
+		/**
+		* Start of every profile in _codes. The last entry is the size of _codes
+		*/
+		vec(size_t) _offsets;
+
+		/**
+		* Number of values of every profile
+		*/
+		vec(int) _sizes;
+
+		/**
+		* Quantization step of every profile
+		*/
+		vec(double) _steps;
+	public:
+		ProfileSequence();
+
+		/**
+		* Codes a profile and appends it to the sequence
+		* @param profile Values of the profile
+		*/
+		void Push(const vector<scalar>& profile);
+
+		/**
+		* Removes all the profiles
+		*/
+		void Clear();
+
+		/**
+		* @return Number of profiles
+		*/
+		int Size() const;
+
+		/**
+		* @return Number of values of a profile
+		* @param id Index of the profile
+		*/
+		int Profile_Size(int id) const;
+
+		/**
+		* @return Number of bytes of the coded profiles
+		*/
+		size_t Bytes() const;
+
+		/**
+		* Decodes a profile
+		* @param id Index of the profile
+		* @param profile Values of the profile
+		*/
+		void Decode(int id, vector<scalar>& profile) const;
+
+		/**
+		* Writes the number of profiles followed by the coded profiles
+		*/
+		void Write(file::Binary& bfile) const;
+
+		/**
+		* Reads the profiles written by Write
+		*/
+		void Read(file::Binary& bfile);
+	};
+
+	inline int ProfileSequence::Size() const
+	{
+		return((int)this->_sizes.size());
+	}
+
+	inline int ProfileSequence::Profile_Size(int id) const
+	{
+		return(this->_sizes[id]);
+	}
+
+	inline size_t ProfileSequence::Bytes() const
+	{
+		return(this->_codes.size());
+	}
+}
+
+#endif
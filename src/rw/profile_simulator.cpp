@@ -1,3 +1,8 @@
+#include <bitset>
+#include <algorithm>
+#include "tbb/parallel_for.h"
+#include "tbb/parallel_reduce.h"
+#include "tbb/tick_count.h"
 #include "profile_simulator.h"
 
 namespace rw
@@ -7,8 +12,10 @@ ProfileSimulator::ProfileSimulator() : Simulator()
 {
 	this->_shared = false;
 	this->_profile = 0;
+	this->_profileSequence = 0;
+	this->_decodedId = -1;
 	this->_particlesEnergy = 0;
-	this->_killedWalkers = 0;
+	this->_collisions = 0;
 	this->_shared = false;
 	this->_decisionArray = 0;
 	this->_collisionProbabilities = 0;
@@ -22,12 +29,22 @@ ProfileSimulator::ProfileSimulator() : Simulator()
 
 const vector<scalar>& ProfileSimulator::Sequential_Profile(int id_seq) const
 {
-	if (id_seq >= (int)this->_profileSequence->size())
+	if (id_seq >= this->_profileSequence->Size())
 	{
-		id_seq = (int)this->_profileSequence->size() - 1;
+		id_seq = this->_profileSequence->Size() - 1;
 	}
-	vector<scalar>* ptr = (*this->_profileSequence)[id_seq];
-	return(*ptr);
+	if (id_seq != this->_decodedId)
+	{
+		this->_profileSequence->Decode(id_seq, this->_decodedProfile);
+		this->_decodedId = id_seq;
+	}
+	return(this->_decodedProfile);
+}
+
+void ProfileSimulator::Set_Profile_Sequence(const rw::ProfileSequence* sequence)
+{
+	this->_profileSequence = sequence;
+	this->_decodedId = -1;
 }
 
 void ProfileSimulator::Share_Profile(map<scalar, scalar>* profile)
@@ -79,11 +96,16 @@ void ProfileSimulator::Set_Particle_Array()
 	{
 		this->Set_Profile(new map<scalar, scalar>());
 	}
-	if (this->_killedWalkers)
+	this->_killed.assign((particles + 31) / 32, 0);
+	for (int k = 0; k < (int)this->_blockStreams.size(); ++k)
 	{
-		delete this->_killedWalkers;
+		vslDeleteStream(&this->_blockStreams[k]);
+	}
+	this->_blockStreams.resize((particles + DCHUNK_SIZE - 1) / DCHUNK_SIZE);
+	for (int k = 0; k < (int)this->_blockStreams.size(); ++k)
+	{
+		vslNewStream(&this->_blockStreams[k], VSL_BRNG_SFMT19937, (uint)Plug::_randomSeedGenerator());
 	}
-	this->_killedWalkers = new set<int>();
 	this->_decisionArray = allocScalar(3 * particles);
 	this->_collisionProbabilities = allocScalar(particles);
 	this->_degradeCoefficients = allocScalar(particles);
@@ -173,6 +195,80 @@ scalar ProfileSimulator::Hit_Probability(scalar idx) const
 }
 
 scalar ProfileSimulator::Magnetization()
+{
+	int n = (int)this->_particlesEnergy->size();
+	if (n == 0)
+	{
+		return(0);
+	}
+	/**
+	* Decay factor of a non colliding step along each direction: z, y and x
+	*/
+	scalar factor[3];
+	for (int dir = 0; dir < 3; ++dir)
+	{
+		int dx = dir / 2;
+		int dy = dir % 2;
+		factor[dir] = this->Gradient().Exponential_Factor(dx, dy, 1 - dx - dy);
+	}
+	scalar* energy = this->_particlesEnergy->data();
+	int* collisions = this->_collisions->data();
+	int blocks = (int)this->_blockStreams.size();
+	scalar nu = tbb::parallel_deterministic_reduce(tbb::blocked_range<int>(0, blocks, 1), (scalar)0,
+		[this, n, &factor, energy, collisions](const tbb::blocked_range<int>& b, scalar sum)
+	{
+		for (int blk = b.begin(); blk < b.end(); ++blk)
+		{
+			int first = blk * DCHUNK_SIZE;
+			int count = std::min(DCHUNK_SIZE, n - first);
+			scalar* u = this->_decisionArray + 3 * first;
+			vdRngUniform(VSL_RNG_METHOD_UNIFORM_STD_ACCURATE, this->_blockStreams[blk], 3 * count, u, (scalar)0, (scalar)1);
+			const scalar* hit = u;
+			const scalar* kill = u + count;
+			const scalar* dir = u + 2 * count;
+			const scalar* P = this->_collisionProbabilities + first;
+			const scalar* D = this->_degradeCoefficients + first;
+			scalar* E = energy + first;
+			int* C = collisions + first;
+			/**
+			* Every word of particles is updated by a branch free loop that the compiler vectorizes, and then
+			* its kill flags are packed into the bitset and its magnetizations are summed.
+			*/
+			int killed[32];
+			for (int w = 0; w < count; w += 32)
+			{
+				int top = std::min(32, count - w);
+				for (int l = 0; l < top; ++l)
+				{
+					int i = w + l;
+					int h = hit[i] <= P[i];
+					scalar t = (scalar)3 * dir[i];
+					scalar g = (t < (scalar)1) ? factor[0] : factor[1];
+					g = (t < (scalar)2) ? g : factor[2];
+					E[i] = E[i] * (h ? D[i] : g);
+					C[i] = C[i] + h;
+					killed[l] = h & (kill[i] >= D[i]);
+				}
+				uint mask = 0;
+				scalar s[4] = { 0, 0, 0, 0 };
+				for (int l = 0; l < top; ++l)
+				{
+					mask = mask | ((uint)killed[l] << l);
+					s[l & 3] = s[l & 3] + E[w + l];
+				}
+				this->_killed[(first + w) >> 5] |= mask;
+				sum = sum + (s[0] + s[1]) + (s[2] + s[3]);
+			}
+		}
+		return(sum);
+	}, [](scalar a, scalar b)
+	{
+		return(a + b);
+	});
+	return(nu / (scalar)n);
+}
+
+scalar ProfileSimulator::Serial_Magnetization()
 {
 	scalar nu = 0;
 	vdRngUniform(VSL_RNG_METHOD_UNIFORM_STD_ACCURATE, this->_randomNumberStream,
@@ -187,7 +283,7 @@ scalar ProfileSimulator::Magnetization()
 			(*this->_collisions)[j] = (*this->_collisions)[j] + 1;
 			if (this->_decisionArray[3 * j + 1] >= d)
 			{
-				this->_killedWalkers->insert(j);
+				this->_killed[j >> 5] |= 0x01u << (j & 31);
 			}
 		}
 		else
@@ -205,6 +301,50 @@ scalar ProfileSimulator::Magnetization()
 	return(nu);
 }
 
+void ProfileSimulator::Benchmark(scalar& serial, scalar& parallel, int steps)
+{
+	serial = 0;
+	parallel = 0;
+	if ((!this->_particlesEnergy) || (this->_particlesEnergy->size() == 0))
+	{
+		return;
+	}
+	vector<scalar> energy(*this->_particlesEnergy);
+	vector<int> collisions(*this->_collisions);
+	vec(uint) killed(this->_killed);
+	scalar work = (scalar)this->_particlesEnergy->size()*(scalar)steps;
+	tbb::tick_count tstart = tbb::tick_count::now();
+	for (int k = 0; k < steps; ++k)
+	{
+		this->Serial_Magnetization();
+	}
+	scalar secs = (scalar)(tbb::tick_count::now() - tstart).seconds();
+	serial = (secs > 0) ? work / secs : (scalar)0;
+	*this->_particlesEnergy = energy;
+	*this->_collisions = collisions;
+	this->_killed = killed;
+	tstart = tbb::tick_count::now();
+	for (int k = 0; k < steps; ++k)
+	{
+		this->Magnetization();
+	}
+	secs = (scalar)(tbb::tick_count::now() - tstart).seconds();
+	parallel = (secs > 0) ? work / secs : (scalar)0;
+	*this->_particlesEnergy = energy;
+	*this->_collisions = collisions;
+	this->_killed = killed;
+}
+
+int ProfileSimulator::Killed_Particles() const
+{
+	int killed = 0;
+	for (int k = 0; k < (int)this->_killed.size(); ++k)
+	{
+		killed = killed + (int)std::bitset<32>(this->_killed[k]).count();
+	}
+	return(killed);
+}
+
 void ProfileSimulator::Set_Delta(scalar delta)
 {
 	this->_rho = delta;
@@ -230,6 +370,10 @@ ProfileSimulator::~ProfileSimulator()
 		freeScalar(this->_collisionProbabilities);
 	}
 	vslDeleteStream(&this->_randomNumberStream);
+	for (int k = 0; k < (int)this->_blockStreams.size(); ++k)
+	{
+		vslDeleteStream(&this->_blockStreams[k]);
+	}
 	if (!this->_shared)
 	{
 		delete this->_profile;
@@ -38,7 +38,14 @@ namespace rw
 		* The collision profile of the walkers evolves with time. This can be saved in layers and these layers can be used to reproduce
 		* the simulation. This sequence is used to change the collision profile with time. 
 		*/
-		vector<vector<scalar>*>* _profileSequence;
+		const rw::ProfileSequence* _profileSequence;
+
+		/**
+		* The last profile decoded from _profileSequence, and its index (-1 if none). Update reads the same
+		* profile for a whole update interval, so it is decoded once per interval.
+		*/
+		mutable vector<scalar> _decodedProfile;
+		mutable int _decodedId;
 
 		/**
 		* The magnetization of all particles that are being simulations
@@ -56,15 +63,21 @@ namespace rw
 		vector<int>* _collisions;
 
 		/**
-		* The set of killed walkers
+		* Bitset of the killed walkers, 32 particles per word
 		*/
-		set<int>* _killedWalkers;
+		vec(uint) _killed;
 
 		/**
-		* The random number generator according to which the simulation is executed
+		* The random number generator according to which the serial simulation is executed
 		*/
 		VSLStreamStatePtr _randomNumberStream;
 
+		/**
+		* One random number generator for every block of DCHUNK_SIZE particles. The blocks draw their numbers
+		* independently, so the result of a step does not depend on the number of threads.
+		*/
+		vector<VSLStreamStatePtr> _blockStreams;
+
 		/**
 		* The value of uniform relaxivity
 		*/
@@ -85,7 +98,8 @@ namespace rw
 		int _avgMax;
 
 		/**
-		* An array of the precalculated probabilites of hitting for each particle
+		* The random numbers of a step, three per particle. Every block of particles stores the numbers of
+		* the hit decisions, then those of the kill decisions and then those of the directions.
 		*/
 		scalar* _decisionArray;
 
@@ -134,6 +148,22 @@ namespace rw
 		*/
 		scalar Magnetization();
 
+		/**
+		* Serial version of Magnetization, one particle at a time with a single random number generator
+		* @return The total magnetization of the simulator at the current iteration
+		*/
+		scalar Serial_Magnetization();
+
+		/**
+		* Measures the throughput of Serial_Magnetization and Magnetization. The magnetizations, hits and killed
+		* particles are restored afterwards, only the random number generators advance. Both rates are in wall clock
+		* time.
+		* @param serial Particle-steps per second of Serial_Magnetization
+		* @param parallel Particle-steps per second of Magnetization
+		* @param steps Number of steps to measure for every version
+		*/
+		void Benchmark(scalar& serial, scalar& parallel, int steps = 64);
+
 		/**
 		* @return The hit probability indexed by idx in the interval [0,1]. 
 		*/
@@ -183,6 +213,12 @@ namespace rw
 		* @param id_seq Identifier of the profile
 		*/
 		const vector<scalar>& Sequential_Profile(int id_seq) const;
+
+		/**
+		* Sets the sequence of profiles that changes the collision profile with time
+		* @param sequence Sequence of profiles, it is not owned by the simulator
+		*/
+		void Set_Profile_Sequence(const rw::ProfileSequence* sequence);
 	};
 
 	inline scalar ProfileSimulator::Magnetization(int id) const
@@ -190,11 +226,6 @@ namespace rw
 		return((*this->_particlesEnergy)[id]);
 	}
 
-	inline int ProfileSimulator::Killed_Particles() const
-	{
-		return((int)this->_killedWalkers->size());
-	}
-
 	inline int ProfileSimulator::Hits(int id) const
 	{
 		return((*this->_collisions)[id]);
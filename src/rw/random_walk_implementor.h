@@ -93,8 +93,8 @@ namespace rw
 
 		virtual void operator()() = 0;
 
-		BinaryImage& Image();
-		BinaryImage& Mask();
+		const BinaryImage& Image();
+		const BinaryImage& Mask();
 
 		bool Masked() const;
 
@@ -103,8 +103,28 @@ namespace rw
 		void Set_Seed(uint seed);
 
 		bool Has_Walk_Event() const;
+
+		/**
+		* @return The hit histograms of the parent formation
+		*/
+		HitHistogram& Hit_Histogram();
+
+		/**
+		* @return The collision trace of the parent formation
+		*/
+		CollisionTrace& Collision_Trace();
 	};
 
+	inline CollisionTrace& RandomWalkImplementor::Collision_Trace()
+	{
+		return(this->_parentFormation->_collisionTrace);
+	}
+
+	inline HitHistogram& RandomWalkImplementor::Hit_Histogram()
+	{
+		return(this->_parentFormation->_hitHistogram);
+	}
+
 	inline RandomWalkImplementor::~RandomWalkImplementor()
 	{
 		this->_parentFormation = 0;
@@ -117,10 +137,10 @@ namespace rw
 
 	inline bool RandomWalkImplementor::Masked() const
 	{
-		return(this->_parentFormation->_mask != 0);
+		return(this->_parentFormation->_mask != nullptr);
 	}
 
-	inline BinaryImage& RandomWalkImplementor::Mask()
+	inline const BinaryImage& RandomWalkImplementor::Mask()
 	{
 		return(*this->_parentFormation->_mask);
 	}
@@ -207,9 +227,10 @@ namespace rw
 		return(this->_parentFormation->_walkers[id]);
 	}
 
-	inline BinaryImage& RandomWalkImplementor::Image()
+	inline const BinaryImage& RandomWalkImplementor::Image()
 	{
-		return(*this->_parentFormation->_image);
+		this->_parentFormation->Copy_Section();
+		return(this->_parentFormation->Plug_Texture());
 	}
 
 	inline void RandomWalkImplementor::Set_Seed(uint seed)
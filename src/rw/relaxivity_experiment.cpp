@@ -91,7 +91,7 @@ void RelaxivityExperiment::Prepare()
 		RelaxivityOptimizer* go = (RelaxivityOptimizer*)this->Parent_Optimizer();
 		rw::ProfileSimulator* sr = (rw::ProfileSimulator*)this->_simulator;
 		this->_simulator->_profileUpdateInterval = go->_updateProfileInterval;
-		sr->_profileSequence = &go->_profileSequence;
+		sr->Set_Profile_Sequence(&go->_profileSequence);
 		sr->Share_Profile(((rw::ProfileSimulator*)go->_simulator)->Profile());
 		this->_simulator->Set_NumberOfParticles(go->_simulator->Total_Particles());
 		if (go->Function_Shape() == rw::RelaxivityDistribution::Sigmoid)
@@ -126,9 +126,13 @@ void RelaxivityExperiment::Execute()
 	Plug* e = this->_formation;
 	e->_decayValues.clear();
 	if (!this->_simulateWalk)
-	{		
-		e->Init_Walkers_Position();
-		e->Random_Walk_Procedure();		
+	{
+		const rw::Plug* traced = this->Parent_Optimizer()->_tracedPlug;
+		if ((!traced) || (!e->Replay_Collision_Trace(traced->Collision_Trace())))
+		{
+			e->Init_Walkers_Position();
+			e->Random_Walk_Procedure();
+		}
 	}
 	else
 	{
@@ -139,7 +143,6 @@ void RelaxivityExperiment::Execute()
 	this->_fitting.Load_Decay(e->_decayValues);
 	this->_fitting = this->_fitting.Sequential_Logarithmic_Reduction(this->Parent_Optimizer()->_reductionT2);
 	this->Parent_Optimizer()->UnLock_Event_Trigger();
-	e->_image = 0;
 	this->_strikeNormalizer = (scalar)e->_decayValues.size();
 	this->_decay = e->_decayValues;
 }
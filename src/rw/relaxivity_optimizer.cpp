@@ -2,6 +2,7 @@
 #include "exponential_fitting.h"
 #include "persistence/plug_persistent.h"
 #include "profile_simulator.h"
+#include "hat.h"
 
 namespace rw
 {
@@ -9,6 +10,7 @@ namespace rw
 RelaxivityOptimizer::RelaxivityOptimizer(int size) : Population(size)
 {
 	this->_basisPlug = 0;
+	this->_tracedPlug = 0;
 	this->_reductionT2 = 1024;
 	this->_lambda = 1;
 	this->Set_Max_Fitness(false);
@@ -42,13 +44,10 @@ RelaxivityOptimizer::~RelaxivityOptimizer()
 	{
 		delete this->_simulator;
 	}
-	for (int k = 0; k < (int)this->_profileSequence.size(); ++k)
+	if (this->_tracedPlug)
 	{
-		vector<scalar>* profile = this->_profileSequence[k];
-		delete profile;
+		delete this->_tracedPlug;
 	}
-	this->_profileSequence.clear();
-
 }
 
 math_la::math_lac::genetic::Creature* RelaxivityOptimizer::Create_Individual(const math_la::math_lac::genetic::Creature* parent) const
@@ -109,6 +108,55 @@ void RelaxivityOptimizer::Set_Formation(const rw::Plug* e, bool calcLaplace)
 		simulator->Set_NumberOfParticles(this->_totalNumberOfParticles);
 		this->_simulator = simulator;
 	}
+	this->Trace_Basis_Walk();
+}
+
+void RelaxivityOptimizer::Trace_Basis_Walk()
+{
+	if (this->_tracedPlug)
+	{
+		delete this->_tracedPlug;
+		this->_tracedPlug = 0;
+	}
+	if ((!this->_basisPlug) || (!this->_repeatPath) || (this->_simulateWalk))
+	{
+		return;
+	}
+	rw::Plug* traced = new rw::Plug(*this->_basisPlug);
+	rw::SimulationParams params(traced->Simulation_Parameters());
+	params.Set_Value(COLLISION_TRACE, 1);
+	traced->Set_Simulation_Parameter(params);
+	traced->Repeat_Walkers_Paths(true, this->_seed);
+	for (int i = 0; i < (int)traced->Number_Of_Walking_Particles(); ++i)
+	{
+		traced->Walking_Particle(i).Set_Rho(1);
+	}
+	traced->Init_Walkers_Position();
+	traced->Random_Walk_Procedure();
+	this->_tracedPlug = traced;
+}
+
+void RelaxivityOptimizer::Benchmark_Simulator(int particles, scalar& serial, scalar& parallel) const
+{
+	serial = 0;
+	parallel = 0;
+	if ((!this->_mappingSimulation) || (particles <= 0))
+	{
+		return;
+	}
+	rw::ProfileSimulator simulator;
+	math_la::math_lac::full::Vector domain;
+	math_la::math_lac::full::Vector range;
+	this->_mappingSimulation->Build_Collision_Rate_Distribution(domain, range);
+	simulator.Set_Collision_Profile(domain, range);
+	simulator.Set_NumberOfParticles(particles);
+	Hat* hat = new Hat();
+	hat->Set_Simulation(*this->_mappingSimulation);
+	hat->Set_Size(0);
+	hat->Set_Ground(this->fBoxKmin);
+	simulator.Set_Relaxivity_Distribution(hat);
+	simulator.Prepare();
+	simulator.Benchmark(serial, parallel);
 }
 
 void RelaxivityOptimizer::Set_Laplace_Parameters(scalar lambda, scalar LT2min, scalar LT2max, 
@@ -68,6 +68,13 @@ private:
 	*/
 	const rw::Plug* _basisPlug;
 
+	/**
+	* Copy of the basis plug walked once with the seed of the repeated paths, recording the collisions of its
+	* walkers. The experiments replay them instead of walking (see Plug::Replay_Collision_Trace). Null when the
+	* paths are not repeated or the walk is simulated.
+	*/
+	rw::Plug* _tracedPlug;
+
 	/**
 	* The mapping simulation, on which the RTF of every walkers is defined and on which other paremeters like pixel, Laplace resolution,
 	* regularizer, etc. resolution are stored. 
@@ -177,7 +184,7 @@ private:
 	/**
 	* Sequential set of profiles of the random walk simulation
 	*/
-	vector<vector<scalar>*> _profileSequence;
+	rw::ProfileSequence _profileSequence;
 
 	/**
 	* This is the number of iterations that are necessary to pass from a Collision Profile to other
@@ -186,6 +193,13 @@ private:
 protected:
 	math_la::math_lac::genetic::Creature* Create_Individual(const math_la::math_lac::genetic::Creature* parent) const;
 	void Shape_Creature(math_la::math_lac::genetic::Creature* c);
+
+	/**
+	* Walks a copy of the basis plug with the collision trace enabled, when the paths are repeated and the walk
+	* is not simulated, so that the experiments can replay it. Its walkers do not relax at the walls, so the
+	* trace lasts as long as the walk of any experiment.
+	*/
+	void Trace_Basis_Walk();
 public:
 	RelaxivityOptimizer(int size = 64);
 	~RelaxivityOptimizer();
@@ -219,6 +233,15 @@ public:
 	const rw::PlugPersistent& Mapping_Simulation() const;
 	void Repeat_Paths(bool r, uint seed);
 	void Set_Cycle(uint cycle);
+
+	/**
+	* Builds a profile simulator from the collision profile of the mapping simulation, with a constant relaxivity
+	* (the ground of the hat functions), and measures its serial and parallel steps (see rw::ProfileSimulator::Benchmark)
+	* @param particles Number of simulated particles
+	* @param serial Particle-steps per second of the serial version, zero if there is no mapping simulation
+	* @param parallel Particle-steps per second of the parallel version, zero if there is no mapping simulation
+	*/
+	void Benchmark_Simulator(int particles, scalar& serial, scalar& parallel) const;
 };
 
 inline scalar RelaxivityOptimizer::Hat_Line() const
@@ -1,8 +1,14 @@
 #include <set>
 #include <vector>
+#include <memory>
+#include <exception>
 #include <math.h>
 #include "tbb/parallel_for.h"
 #include "tbb/parallel_reduce.h"
+#include "tbb/task_arena.h"
+#include "tbb/concurrent_queue.h"
+#include "tbb/task_group.h"
+#include "tbb/spin_mutex.h"
 #include "exponential_fitting.h"
 #include "rw/persistence/plug_persistent.h"
 #include "rev.h"
@@ -19,6 +25,7 @@ Rev::Rev()
 
 	this->_nwcorr = 0.99;
 	this->_reg = 0.1;
+	this->_memoryBudget = (size_t)1 << 30;
 	this->_currentSectionSize = 256;
 
 	this->_event = 0;
@@ -160,58 +167,44 @@ void Rev::Build_Subsets()
 
 scalar Rev::Section_Porosity(const Pos3i& pp) const
 {
-	int np = 0; 
+	Pos3i origin;
+	origin.x = max(pp.x, 0);
+	origin.y = max(pp.y, 0);
+	origin.z = max(pp.z, 0);
+	Pos3i size;
+	size.x = max(min(pp.x + this->_currentSectionSize, this->_secX) - origin.x, 0);
+	size.y = max(min(pp.y + this->_currentSectionSize, this->_secY) - origin.y, 0);
+	size.z = max(min(pp.z + this->_currentSectionSize, this->_secZ) - origin.z, 0);
 	int dp = this->_currentSectionSize*this->_currentSectionSize*this->_currentSectionSize;
-	for (int z = 0; z < this->_currentSectionSize; ++z)
-	{
-		for (int y = 0; y < this->_currentSectionSize; ++y)
-		{
-			for (int x = 0; x < this->_currentSectionSize; ++x)
-			{
-				Pos3i cp;
-				cp.x = pp.x + x;
-				cp.y = pp.y + y;
-				cp.z = pp.z + z;
-				if ((*this->_imgPtr)(cp) == 0)
-				{
-					++np;
-				}
-			}
-		}
-	}
+	uint np = this->_image->Pore_Voxels(origin, size);
 	scalar r = (scalar)np / (scalar)dp;
 	return(r);
 }
 
 void Rev::Porosity_Distribution(scalar& mean, scalar& std_dev, scalar& min, scalar& max)
 {
-	tbb::spin_mutex mtx;
 	min = (scalar)1;
 	max = (scalar)0;
-	tbb::parallel_for(tbb::blocked_range<int>(0, (int)this->_origins.size(), 4), [this,&mtx,&min,&max](const tbb::blocked_range<int>& b)
+	tbb::parallel_for(tbb::blocked_range<int>(0, (int)this->_origins.size(), 4), [this](const tbb::blocked_range<int>& b)
 	{
 		for (int i = b.begin(); i < b.end(); ++i)
 		{
 			Pos3i origin = this->_origins[i];
 			this->_porosities[i] = this->Section_Porosity(origin);
-			if (this->_porosities[i] < min)
-			{
-				mtx.lock();
-				min = this->_porosities[i];
-				mtx.unlock();
-			}
-			if (this->_porosities[i] > max)
-			{
-				mtx.lock();
-				max = this->_porosities[i];
-				mtx.unlock();
-			}
 		}
 	});
 	mean = 0;
 	std_dev = 0;
 	for (int i = 0; i < (int)this->_porosities.size(); ++i)
 	{
+		if (this->_porosities[i] < min)
+		{
+			min = this->_porosities[i];
+		}
+		if (this->_porosities[i] > max)
+		{
+			max = this->_porosities[i];
+		}
 		mean = mean + this->_porosities[i];
 		std_dev = std_dev + this->_porosities[i] * this->_porosities[i];
 	}
@@ -252,8 +245,9 @@ bool Rev::Porosity_Test(scalar& mean, scalar& std_dev, scalar& min, scalar& max)
 {
 	bool pass = false;
 	this->Build_Subsets();
-	scalar porosity = (scalar)this->_imgPtr->Black_Voxels()
-		/ ((scalar)(this->_imgPtr->Width()*this->_imgPtr->Height()*this->_imgPtr->Depth()));
+	this->_image->Build_Pore_Sums();
+	scalar porosity = (scalar)this->_image->Black_Voxels()
+		/ ((scalar)(this->_image->Width()*this->_image->Height()*this->_image->Depth()));
 	mean = 0; 
 	std_dev = 0;
 	this->Porosity_Distribution(mean, std_dev,min,max);
@@ -271,44 +265,208 @@ bool Rev::Porosity_Test_Executed() const
 
 
 
-void Rev::Walk_Inside_Sections(int nw, scalar delta, scalar t2min, scalar t2max, uint res,scalar reg, scalar dt)
+size_t Rev::Walker_Memory()
 {
-	uint s_size = this->_currentSectionSize;
-	bool pass = false;
-	int i = 0;
-	rw::Plug* formation = 0;
+	/**
+	* A walker takes its record, its start position and its lanes in the walker store
+	*/
+	return(sizeof(rw::Walker) + sizeof(rw::Pos3i) + 6 * sizeof(int));
+}
 
-	for (int k = 0; k < (int)this->_origins.size(); ++k)
-	{
-		formation = new Plug(*this->_base, false);
+int Rev::Concurrent_Sections(int nw, int cores) const
+{
+	size_t section = (size_t)max(nw, 1) * Rev::Walker_Memory();
+	int fit = (int)max(this->_memoryBudget / section, (size_t)1);
+	return(max(min(min(fit, cores), (int)this->_origins.size()), 1));
+}
 
-		math_la::math_lac::full::Vector laplace;
-		math_la::math_lac::full::Vector t2;
-		rw::ExponentialFitting ef;
+int Rev::Walker_Batch(int nw, int concurrent) const
+{
+	size_t share = this->_memoryBudget / (size_t)max(concurrent, 1);
+	int fit = (int)min(max(share / Rev::Walker_Memory(), (size_t)1), (size_t)max(nw, 1));
+	return(fit);
+}
+
+void Rev::Set_Memory_Budget(size_t bytes)
+{
+	this->_memoryBudget = bytes;
+}
+
+void Rev::Walk_Inside_Sections(int nw, scalar delta, scalar t2min, scalar t2max, uint res,scalar reg, scalar dt)
+{
+	int sections = (int)this->_origins.size();
+	this->_laplaces.assign(sections, math_la::math_lac::full::Vector());
+	this->_timeT2.assign(sections, math_la::math_lac::full::Vector());
+	int cores = tbb::this_task_arena::max_concurrency();
+	int workers = max(cores - 1, 1);
+	int concurrent = this->Concurrent_Sections(nw, workers);
+	int threads = max(workers / concurrent, 1);
+	int batch = this->Walker_Batch(nw, concurrent);
+	int batches = (max(nw, 1) + batch - 1) / batch;
+	/**
+	* The plugs are created serially, since they draw their seeds from a shared generator. A section that
+	* does not fit its share of the memory budget is walked in batches of walkers, every batch with its own
+	* seed, and its decay is the mean of the decays of the batches. The walkers are allocated when the
+	* section starts, so only the sections being walked hold them.
+	*/
+	vector<std::unique_ptr<rw::Plug> > formations(sections);
+	vector<vector<uint> > seeds(sections);
+	for (int k = 0; k < sections; ++k)
+	{
 		rw::Pos3i pp = this->_origins[k];
-		BinaryImage img = this->_imgPtr->Sub(pp.x, pp.y, pp.z, 
-			this->_currentSectionSize, this->_currentSectionSize, this->_currentSectionSize);
-
-		formation->Set_TBulk_Time_Seconds(10);
-		formation->Set_Time_Step(dt);
-		formation->Set_Surface_Relaxivity_Delta(delta);
-		formation->Set_Image_Formation(img);
-		formation->Set_Number_Of_Walking_Particles(nw);
-		formation->Place_Walking_Particles();
-		//formation->Activate_GPU_Walk(true);
-		formation->Random_Walk_Procedure();
-		ef.Load_Formation(*formation);
-		ef = ef.Logarithmic_Reduction(1024);
-		ef.Kernel_T2_Mount(t2min, t2max, res, reg);
-		ef.Solve(t2, laplace);
-		this->_laplaces.push_back(laplace);
-		this->_timeT2.push_back(t2);
-		scalar p = (scalar)k / (scalar)this->_origins.size();
+		pp.x = max(pp.x, 0);
+		pp.y = max(pp.y, 0);
+		pp.z = max(pp.z, 0);
+		rw::Pos3i size;
+		size.x = min(this->_currentSectionSize, this->_secX - pp.x);
+		size.y = min(this->_currentSectionSize, this->_secY - pp.y);
+		size.z = min(this->_currentSectionSize, this->_secZ - pp.z);
+		formations[k].reset(new Plug(*this->_base, false));
+		formations[k]->Set_TBulk_Time_Seconds(10);
+		formations[k]->Set_Time_Step(dt);
+		formations[k]->Set_Surface_Relaxivity_Delta(delta);
+		formations[k]->Set_Image_Section(this->_image, pp, size);
+		if (batches > 1)
+		{
+			for (int b = 0; b < batches; ++b)
+			{
+				seeds[k].push_back(formations[k]->Pick_New_Seed());
+			}
+		}
+	}
+	/**
+	* The sections run in an arena of worker slots only, and this thread walks none of them: it blocks on the
+	* queue of the finished sections and reports every one as soon as it is pushed, so the event is always
+	* called from the thread that started the walks. Every section is pushed to the queue even if it fails: its
+	* exception is kept, the sections not started yet are skipped, and the first exception is rethrown once all
+	* the sections are done. An exception of the event is kept the same way. Without worker threads this thread
+	* walks the sections itself, and reports them once they are all done.
+	*/
+	tbb::concurrent_bounded_queue<int> finished;
+	std::exception_ptr error;
+	tbb::spin_mutex errorMutex;
+	auto Walk_Sections = [this, sections, threads, nw, batch, t2min, t2max, res, reg, &formations, &seeds, &finished, &error, &errorMutex]()
+	{
+		tbb::parallel_for(tbb::blocked_range<int>(0, sections, 1), [this, threads, nw, batch, t2min, t2max, res, reg, &formations, &seeds, &finished, &error, &errorMutex](const tbb::blocked_range<int>& b)
+		{
+			for (int k = b.begin(); k < b.end(); ++k)
+			{
+				bool failed = false;
+				{
+					tbb::spin_mutex::scoped_lock lock(errorMutex);
+					failed = (bool)error;
+				}
+				if (!failed)
+				{
+					try
+					{
+						rw::Plug* formation = formations[k].get();
+						const vector<uint>& seed = seeds[k];
+						tbb::task_arena section(threads);
+						section.execute([this, k, formation, &seed, nw, batch, t2min, t2max, res, reg]()
+						{
+							rw::ExponentialFitting ef;
+							if (seed.empty())
+							{
+								formation->Set_Number_Of_Walking_Particles(nw);
+								formation->Place_Walking_Particles();
+								formation->Random_Walk_Procedure();
+							}
+							else
+							{
+								vector<rw::Step_Value> mean;
+								for (int b = 0; b < (int)seed.size(); ++b)
+								{
+									int walkers = min(batch, nw - b * batch);
+									formation->Set_Number_Of_Walking_Particles(walkers);
+									formation->Repeat_Walkers_Paths(true, seed[b]);
+									formation->Place_Walking_Particles();
+									formation->Random_Walk_Procedure();
+									scalar weight = (scalar)walkers / (scalar)nw;
+									if (b == 0)
+									{
+										mean = formation->_decayValues;
+										for (int j = 0; j < (int)mean.size(); ++j)
+										{
+											mean[j].Magnetization = mean[j].Magnetization*weight;
+										}
+									}
+									else
+									{
+										mean.resize(min(mean.size(), formation->_decayValues.size()));
+										for (int j = 0; j < (int)mean.size(); ++j)
+										{
+											mean[j].Magnetization = mean[j].Magnetization + formation->_decayValues[j].Magnetization*weight;
+										}
+									}
+								}
+								formation->_decayValues = mean;
+							}
+							ef.Load_Formation(*formation);
+							ef = ef.Logarithmic_Reduction(1024);
+							if (reg < 0)
+							{
+								ef.Select_Regularizer(t2min, t2max, res, REV_LAMBDA_MIN, REV_LAMBDA_MAX, REV_LAMBDA_RESOLUTION,
+									rw::ExponentialFitting::GCV_Criterion, 0);
+							}
+							else
+							{
+								ef.Kernel_T2_Mount(t2min, t2max, res, reg);
+							}
+							ef.Solve(this->_timeT2[k], this->_laplaces[k]);
+						});
+					}
+					catch (...)
+					{
+						tbb::spin_mutex::scoped_lock lock(errorMutex);
+						if (!error)
+						{
+							error = std::current_exception();
+						}
+					}
+				}
+				formations[k].reset();
+				finished.push(k);
+			}
+		});
+	};
+	tbb::task_arena arena(concurrent, 0);
+	tbb::task_group walks;
+	arena.execute([&walks, &Walk_Sections, cores]()
+	{
+		walks.run(Walk_Sections);
+		if (cores == 1)
+		{
+			walks.wait();
+		}
+	});
+	for (int reported = 1; reported <= sections; ++reported)
+	{
+		int k;
+		finished.pop(k);
 		if (this->_event)
 		{
-			this->_event->On_Walk_Event(k,p);
+			try
+			{
+				this->_event->On_Walk_Event(k, (scalar)reported / (scalar)sections);
+			}
+			catch (...)
+			{
+				tbb::spin_mutex::scoped_lock lock(errorMutex);
+				if (!error)
+				{
+					error = std::current_exception();
+				}
+			}
 		}
-		delete formation;
+	}
+	arena.execute([&walks]()
+	{
+		walks.wait();
+	});
+	if (error)
+	{
+		std::rethrow_exception(error);
 	}
 }
 
@@ -322,13 +480,13 @@ uint Rev::Section_Size() const
 	return(this->_currentSectionSize);
 }
 
-void Rev::Set_Image(const rw::BinaryImage& img)
+void Rev::Set_Image(const rw::BinaryImageHandle& img)
 {
-	this->_imgPtr = &img;
+	this->_image = img;
 	this->_base = new Plug();
-	this->_secX = this->_imgPtr->Width();
-	this->_secY = this->_imgPtr->Height();
-	this->_secZ = this->_imgPtr->Depth();
+	this->_secX = this->_image->Width();
+	this->_secY = this->_image->Height();
+	this->_secZ = this->_image->Depth();
 }
 
 uint Rev::Section_Number_Of_Walkers() const
@@ -5,6 +5,13 @@
 #include <random>
 #include "plug.h"
 
+/**
+* Regularizer range and resolution of the generalized cross validation, when the sections select their own
+*/
+#define REV_LAMBDA_MIN 1e-4
+#define REV_LAMBDA_MAX 10
+#define REV_LAMBDA_RESOLUTION 64
+
 namespace rw
 {
 
@@ -16,6 +23,11 @@ public:
 	class RevEvent
 	{
 	public:
+		/**
+		* Called when a section has been walked and inverted, from the thread that called Walk_Inside_Sections
+		* @param k Index of the section, whose T2 distribution is ready (see Get_T2_Distribution)
+		* @param percentage Fraction of the sections that have finished
+		*/
 		virtual void On_Walk_Event(int k, scalar percentage) = 0;
 	};
 
@@ -23,7 +35,7 @@ private:
 	std::ranlux48 _gen;
 	Rev::RevEvent* _event;
 	const Plug* _base;
-	const rw::BinaryImage* _imgPtr;
+	rw::BinaryImageHandle _image;
 	int _currentSectionSize;
 	vector <Pos3i> _origins;
 	vector <scalar> _porosities;
@@ -44,9 +56,34 @@ private:
 	scalar _nwcorr;
 	scalar _reg;
 
+	/**
+	* Memory that the sections walked at once may take, in bytes
+	*/
+	size_t _memoryBudget;
+
 	void Porosity_Distribution(scalar& mean, scalar& std_dev, scalar& min, scalar& max);
 	scalar Section_Porosity(const Pos3i& pp) const;
 	void Build_Subsets();
+
+	/**
+	* @return Memory taken by a walker while a section is walked, in bytes
+	*/
+	static size_t Walker_Memory();
+
+	/**
+	* @return Number of sections walked at once: one per core, as long as their walkers fit the memory budget
+	* @param nw Number of walkers of a section
+	* @param cores Number of cores
+	*/
+	int Concurrent_Sections(int nw, int cores) const;
+
+	/**
+	* @return Number of walkers of a section walked at once, so the sections walked at once fit the memory
+	* budget. A section with more walkers is walked in batches.
+	* @param nw Number of walkers of a section
+	* @param concurrent Number of sections walked at once
+	*/
+	int Walker_Batch(int nw, int concurrent) const;
 public:
 	Rev();
 	bool Porosity_Test(scalar& mean, scalar& std_dev, scalar& min, scalar& max);
@@ -56,9 +93,23 @@ public:
 	void Set_Sample_Size(uint size);
 	uint Sample_Size() const;
 	
+	/**
+	* Walks the sections and inverts their decays. Several sections are walked at once, each one in an arena
+	* with its share of the cores and in batches of walkers that fit its share of the memory budget. The
+	* finished sections are reported to the event in the order of completion, from the calling thread, which
+	* walks sections as well. If a section throws, the sections not started yet are skipped, and the exception
+	* is rethrown once the running ones finish. A negative regularizer selects the regularizer of every
+	* section by generalized cross validation.
+	*/
 	void Walk_Inside_Sections(int nw, scalar delta, scalar t2min, scalar t2max, uint res, scalar reg, scalar dt);
+
+	/**
+	* Sets the memory that the sections walked at once may take
+	* @param bytes Memory budget, in bytes
+	*/
+	void Set_Memory_Budget(size_t bytes);
 	void Section(int id, rw::Pos3i& origin, scalar& porosity) const;
-	void Set_Image(const rw::BinaryImage& img);
+	void Set_Image(const rw::BinaryImageHandle& img);
 	void Set_Porosity_Test_Threshold(scalar threshold);
 	uint Section_Number_Of_Walkers() const;
 	void Set_Event(rw::Rev::RevEvent* event);
@@ -1,32 +1,37 @@
 #include <tbb/parallel_for.h>
 #include <tbb/partitioner.h>
 #include <tbb/parallel_reduce.h>
-#include <mkl_vsl.h>
+#include <tbb/tick_count.h>
 #include <time.h>
+#include <string.h>
 #include "rw_cpu_degrade_impl.h"
 
 namespace rw
 {
 	static const int TimeSize = 512;
-	static const int Block_Size = 397312;
-	
+
 	RandomWalkCPUDegradeImplementor::RandomWalkCPUDegradeImplementor(rw::Plug* parent) : RandomWalkImplementor(parent)
 	{
 		this->_maxRnd = 6;
 		this->_chunkSize = 8;
 		this->_shared = false;
-		this->_collisionDistribution = allocInt((int)this->Plug().Number_Of_Walking_Particles()*TimeSize);
-		this->_magnetization = new scalar[TimeSize];
-		this->_textureDepth = parent->Plug_Texture().Depth();
-		this->_textureHeight = parent->Plug_Texture().Height();
-		this->_textureWidth = parent->Plug_Texture().Width();
+		this->_currentIteration = 0;
+		this->_magnetization = new scalar[MAG_LANES*TimeSize];
+		this->_store = new WalkerStore();
+		this->_context.Set(parent->Plug_View(), parent->Gradient());
+		this->Select_Kernel((int)parent->Simulation_Parameters().Get_Value(SIMD_LEVEL));
+		this->_absorbing = parent->Simulation_Parameters().Kill();
+		this->_floor = std::max(parent->Simulation_Parameters().Magnetization_Floor(), 0.0f);
+		this->_frozen = 0;
+		this->_histogramInterval = parent->Hit_Histogram_Interval();
+		this->_tracing = false;
 	}
 
 	RandomWalkCPUDegradeImplementor::~RandomWalkCPUDegradeImplementor()
 	{
-		if (!this->_shared)
+		if ((!this->_shared) && (this->_store))
 		{
-			freeInt(this->_collisionDistribution);
+			delete this->_store;
 		}
 		if (this->_magnetization)
 		{
@@ -37,27 +42,42 @@ namespace rw
 	RandomWalkCPUDegradeImplementor::RandomWalkCPUDegradeImplementor(RandomWalkCPUDegradeImplementor& p, split) : RandomWalkImplementor(p)
 	{
 		this->_shared = true;
-		this->_collisionDistribution = p._collisionDistribution;
-		this->_magnetization = new scalar[TimeSize];
-		for (int k = 0; k < TimeSize; ++k)
+		this->_generator = p._generator;
+		this->_currentIteration = p._currentIteration;
+		this->_store = p._store;
+		this->_context = p._context;
+		this->_kernel = p._kernel;
+		this->_isa = p._isa;
+		this->_absorbing = p._absorbing;
+		this->_floor = p._floor;
+		this->_frozen = 0;
+		this->_histogramInterval = p._histogramInterval;
+		this->_tracing = p._tracing;
+		if (this->_histogramInterval > 0)
+		{
+			this->_histograms.resize(TimeSize / this->_histogramInterval + 1);
+		}
+		this->_magnetization = new scalar[MAG_LANES*TimeSize];
+		for (int k = 0; k < MAG_LANES*TimeSize; ++k)
 		{
 			this->_magnetization[k] = 0;
 		}
 		this->_chunkSize = p._chunkSize;
 		this->_maxRnd = p._maxRnd;
-		this->_textureDepth = p._textureDepth;
-		this->_textureHeight = p._textureHeight;
-		this->_textureWidth = p._textureWidth;
 	}
 
 
 
 	void RandomWalkCPUDegradeImplementor::init()
 	{
-		for (int k = 0; k < TimeSize; ++k)
+		for (int k = 0; k < MAG_LANES*TimeSize; ++k)
 		{
 			this->_magnetization[k] = 0;
 		}
+		if (this->_histogramInterval > 0)
+		{
+			this->_histograms.assign(TimeSize / this->_histogramInterval + 1, vec(scalar)());
+		}
 	}
 
 	void RandomWalkCPUDegradeImplementor::Set_Max_Rnd(uint maxrnd)
@@ -65,6 +85,12 @@ namespace rw
 		this->_maxRnd = maxrnd;
 	}
 
+	void RandomWalkCPUDegradeImplementor::Select_Kernel(int isa)
+	{
+		this->_isa = isa;
+		this->_kernel = Select_Walk_Kernel(this->_isa);
+	}
+
 	void RandomWalkCPUDegradeImplementor::operator()()
 	{
 		this->Execute();
@@ -79,16 +105,25 @@ namespace rw
 	{
 		this->Set_Degrees_Of_Freedom();
 		rw::Plug& frm_sample = this->Plug();
-		this->_chunkSize = frm_sample.Minimal_Walkers_Per_Thread();
-		tbb::affinity_partitioner partitioner;
+		this->_chunkSize = std::max(frm_sample.Minimal_Walkers_Per_Thread() / WALKER_LANES, (uint)1);
 		clock_t tstart = clock();
 		frm_sample.Clear_Decay_Steps();
 		this->Reserve_Values_Memory_Space(300000);
-		int nw = (int)frm_sample.Number_Of_Walking_Particles();
+		this->_store->Load(this->Walkers());
+		this->_frozen = 0;
 		scalar E = 1;
 		scalar rate_factor = exp(-frm_sample.Time_Step() / frm_sample.TBulk_Seconds());
-		uint N = 0;
-		uint Voxel_Length = 0;		
+		this->_histogramInterval = frm_sample.Hit_Histogram_Interval();
+		if (this->_histogramInterval > 0)
+		{
+			this->_store->Set_Delta(1.0f);
+			this->Hit_Histogram().Clear(frm_sample.Number_Of_Walking_Particles(), frm_sample.Time_Step(), rate_factor);
+		}
+		this->_tracing = (frm_sample.Recording_Collision_Trace()) && (!this->_absorbing);
+		if (this->_tracing)
+		{
+			this->Collision_Trace().Clear(this->_store->Size());
+		}
 		this->Init_Iterations();
 		uint seed = 0;
 		if (frm_sample.Repeating_Walkers_Paths())
@@ -99,44 +134,62 @@ namespace rw
 		{
 			seed = (uint)this->Pick_New_Seed();
 		}
-		VSLStreamStatePtr stream;
-		vslNewStream(&stream, VSL_BRNG_SFMT19937, seed);
-
+		this->_generator.Set_Seed(seed);
 		this->Set_Seed(seed);
 		scalar Ebulk = (scalar)1.0;
 		uint currentIteration = 0;
 		int updprof = frm_sample.Update_Profile_Interval();
-		int updsr = frm_sample.Update_Varying_Relaxivity_Steps();
 		while ((E > frm_sample.Stop_Threshold()) && (currentIteration < (int)frm_sample.Max_Number_Of_Iterations()))
 		{
 			this->init();
-			viRngUniform(VSL_RNG_METHOD_UNIFORM_STD, stream,
-				(int)frm_sample.Number_Of_Walking_Particles()*TimeSize, this->_collisionDistribution, 0, this->_maxRnd);
-			tbb::parallel_reduce(tbb::blocked_range<int>(0, nw, this->_chunkSize), *this, partitioner);
+			this->_currentIteration = currentIteration;
+			tbb::parallel_deterministic_reduce(tbb::blocked_range<int>(0, this->_store->Groups(), this->_chunkSize), *this);
 			bool updateCollision = false;
+			if ((this->_histogramInterval > 0) && (this->First_Record(currentIteration) < TimeSize))
+			{
+				E = this->Push_Histograms(currentIteration);
+			}
 			for (int k = 0; k < TimeSize; ++k)
 			{
-				scalar frac = this->_magnetization[k] / (scalar)(frm_sample.Number_Of_Walking_Particles());
-				Ebulk = Ebulk * rate_factor;
-				E = frac;
-				E = E * Ebulk;
-				rw::Step_Value v;
-				v.Magnetization = E;
-				v.Iteration = currentIteration;
-				v.Time = ((scalar)currentIteration)*frm_sample.Time_Step();
-				this->Push_Seq_Step_Value(v);
-				++currentIteration;						
+				if (this->_histogramInterval == 0)
+				{
+					scalar mk = this->_frozen;
+					for (int j = 0; j < MAG_LANES; ++j)
+					{
+						mk = mk + this->_magnetization[MAG_LANES*k + j];
+					}
+					scalar frac = mk / (scalar)(frm_sample.Number_Of_Walking_Particles());
+					Ebulk = Ebulk * rate_factor;
+					E = frac;
+					E = E * Ebulk;
+					rw::Step_Value v;
+					v.Magnetization = E;
+					v.Iteration = currentIteration;
+					v.Time = ((scalar)currentIteration)*frm_sample.Time_Step();
+					this->Push_Seq_Step_Value(v);
+				}
+				++currentIteration;
 				if ((updprof > 0) && (currentIteration % updprof == 0))
 				{
 					updateCollision = true;
 				}
 			}
+			this->Compact();
+			if ((updateCollision) || (this->Has_Walk_Event()))
+			{
+				this->_store->Store(this->Walkers());
+			}
 			if (updateCollision)
 			{
 				frm_sample.Update_Collision_Profile(currentIteration);
 			}
 			this->Observe(currentIteration, E);
-		}		
+		}
+		this->_store->Store(this->Walkers());
+		if (this->_tracing)
+		{
+			this->Collision_Trace().Set_Steps(currentIteration);
+		}
 		frm_sample.Set_Total_Number_Of_Simulated_Iterations(currentIteration);
 		this->Check_T1_Experiment();
 		clock_t tend = clock();
@@ -145,69 +198,244 @@ namespace rw
 		int isecs = (int)ms_elapsed;
 		isecs = isecs / 1000;
 		this->Walk_End(isecs);
-		freeInt(this->_collisionDistribution);
 		delete[]this->_magnetization;
-		this->_collisionDistribution = 0;
 		this->_magnetization = 0;
-		vslDeleteStream(&stream);
 	};
 
 	void RandomWalkCPUDegradeImplementor::join(RandomWalkCPUDegradeImplementor& p)
 	{
-		for (int k = 0; k < TimeSize; ++k)
+		for (int k = 0; k < MAG_LANES*TimeSize; ++k)
 		{
 			this->_magnetization[k] = this->_magnetization[k] + p._magnetization[k];
 		}
+		for (int s = 0; s < (int)p._histograms.size(); ++s)
+		{
+			vec(scalar)& h = this->_histograms[s];
+			const vec(scalar)& ph = p._histograms[s];
+			if (h.size() < ph.size())
+			{
+				h.resize(ph.size(), 0);
+			}
+			for (int j = 0; j < (int)ph.size(); ++j)
+			{
+				h[j] = h[j] + ph[j];
+			}
+		}
 	};
 
-	void RandomWalkCPUDegradeImplementor::operator()(const blocked_range<int>& range)
+	void RandomWalkCPUDegradeImplementor::Generate_Directions(int group, int steps, uchar* dir) const
 	{
-		rw::Plug& f = this->Plug();
-		int nw = f.Number_Of_Walking_Particles();
-		for (int t = range.begin(); t < range.end(); ++t)
+		uint rnd[PHILOX_BLOCK];
+		uint block = this->_currentIteration / PHILOX_BLOCK;
+		const int* ids = this->_store->Ids() + group * WALKER_LANES;
+		for (int l = 0; l < WALKER_LANES; ++l)
 		{
-			for (int k = 0; k < TimeSize; ++k)
+			if (ids[l] < 0)
 			{
-				rw::Walker& w = this->Walker(t);		
-				int* rnd = this->_collisionDistribution + t * TimeSize + k;
-				this->Process_Walker(t, w, this->_collisionDistribution[t*TimeSize + k],f.Gradient());
-				this->_magnetization[k] = this->_magnetization[k] + w.Magnetization();
+				for (int k = 0; k < steps; ++k)
+				{
+					dir[k*WALKER_LANES + l] = 0;
+				}
+				continue;
+			}
+			uint id = (uint)ids[l];
+			for (int k = 0; k < steps; k = k + PHILOX_BLOCK)
+			{
+				this->_generator.Generate(id, block + k / PHILOX_BLOCK, rnd);
+				for (int j = 0; j < PHILOX_BLOCK; ++j)
+				{
+					dir[(k + j)*WALKER_LANES + l] = (uchar)PhiloxGenerator::Bounded(rnd[j], this->_maxRnd);
+				}
 			}
 		}
-	};
+	}
 
-	void RandomWalkCPUDegradeImplementor::Process_Walker(int id, rw::Walker& walker, int rnd, const Field3D& gradient)
+	void RandomWalkCPUDegradeImplementor::Generate_Collisions(int group, int steps, float* collision) const
 	{
-		Pos3i pp;
+		static const scalar Word_Scale = 1.0 / 4294967296.0;
+		uint rnd[PHILOX_BLOCK];
+		uint block = this->_currentIteration / PHILOX_BLOCK;
+		const int* ids = this->_store->Ids() + group * WALKER_LANES;
+		const float* delta = this->_store->Delta() + group * WALKER_LANES;
+		for (int l = 0; l < WALKER_LANES; ++l)
+		{
+			if (ids[l] < 0)
+			{
+				for (int k = 0; k < steps; ++k)
+				{
+					collision[k*WALKER_LANES + l] = 0.0f;
+				}
+				continue;
+			}
+			uint id = (uint)ids[l];
+			for (int k = 0; k < steps; k = k + PHILOX_BLOCK)
+			{
+				this->_generator.Generate(id, block + k / PHILOX_BLOCK, rnd, PHILOX_STREAM_ABSORPTION);
+				for (int j = 0; j < PHILOX_BLOCK; ++j)
+				{
+					collision[(k + j)*WALKER_LANES + l] = ((scalar)rnd[j] * Word_Scale < (scalar)delta[l]) ? 1.0f : 0.0f;
+				}
+			}
+		}
+	}
 
-		int dxy = ((int)(rnd) << 1);
-		int dg1 = 1 - (dxy >> 3);
-		int dg2 = dxy >> 2;
+	int RandomWalkCPUDegradeImplementor::First_Record(uint start) const
+	{
+		return((int)(this->_histogramInterval - 1 - start % this->_histogramInterval));
+	}
 
-		int dx = dg1 * (1 - dg2)*(dxy - 1);
-		int dy = dg1 * dg2*(dxy - 5);
-		int dz = (1 - dg1)*(dg2 >> 1)*(dxy - 9);
+	void RandomWalkCPUDegradeImplementor::Record_Histogram(int group, int slot)
+	{
+		vec(scalar)& h = this->_histograms[slot];
+		const int* hits = this->_store->Hits() + group * WALKER_LANES;
+		const float* energy = this->_store->Energy() + group * WALKER_LANES;
+		for (int l = 0; l < WALKER_LANES; ++l)
+		{
+			int n = hits[l] >> SHIFT_STRIKES;
+			if (n >= (int)h.size())
+			{
+				h.resize(n + 1, 0);
+			}
+			h[n] = h[n] + (scalar)energy[l];
+		}
+	}
 
-		rw::Pos3i pw = walker.Position();
-		pp.x = pw.x + dx;
-		pp.y = pw.y + dy;
-		pp.z = pw.z + dz;
+	scalar RandomWalkCPUDegradeImplementor::Push_Histograms(uint start)
+	{
+		rw::Plug& frm_sample = this->Plug();
+		HitHistogram& histogram = this->Hit_Histogram();
+		scalar delta = frm_sample.Surface_Relaxivity_Delta();
+		scalar E = 0;
+		int slot = 0;
+		for (int k = this->First_Record(start); k < TimeSize; k = k + (int)this->_histogramInterval)
+		{
+			histogram.Add(start + (uint)k, this->_histograms[slot]);
+			E = histogram.Magnetization(histogram.Size() - 1, delta);
+			rw::Step_Value v;
+			v.Magnetization = E;
+			v.Iteration = start + (uint)k;
+			v.Time = ((scalar)v.Iteration)*frm_sample.Time_Step();
+			this->Push_Seq_Step_Value(v);
+			++slot;
+		}
+		return(E);
+	}
 
-		if ((pp.x >= 0) && (pp.x < (int)this->_textureWidth) &&
-			(pp.y >= 0) && (pp.y < (int)this->_textureHeight) &&
-			(pp.z >= 0) && (pp.z < (int)this->_textureDepth))
+	void RandomWalkCPUDegradeImplementor::Trace_Collisions(int group, uint step, const int* before)
+	{
+		const int* hits = this->_store->Hits() + group * WALKER_LANES;
+		uint lanes = 0;
+		for (int l = 0; l < WALKER_LANES; ++l)
 		{
-			int v = this->Image()(pp);
-			if (v == 0)
+			if ((hits[l] >> SHIFT_STRIKES) != (before[l] >> SHIFT_STRIKES))
 			{
-				walker.Set_Position(pp);
-				walker.Set_Magnetization(walker.Magnetization()*gradient.Exponential_Factor(dx, dy, dz));
+				lanes = lanes | (0x01 << l);
 			}
-			else
+		}
+		if (lanes)
+		{
+			this->Collision_Trace().Record(group, step, lanes);
+		}
+	}
+
+	void RandomWalkCPUDegradeImplementor::Compact()
+	{
+		if ((this->_histogramInterval == 0) && (!this->_tracing) && ((this->_absorbing) || (this->_floor > 0)))
+		{
+			this->_store->Compact(this->Walkers(), this->_floor, this->_frozen);
+		}
+	}
+
+	void RandomWalkCPUDegradeImplementor::operator()(const blocked_range<int>& range)
+	{
+		uchar dir[TimeSize*WALKER_LANES];
+		float* collision = 0;
+		if ((this->_absorbing) && (this->_histogramInterval == 0))
+		{
+			if (this->_collision.empty())
 			{
-				walker.Degrade();
+				this->_collision.resize(TimeSize*WALKER_LANES);
 			}
+			collision = this->_collision.data();
 		}
-	}
+		for (int g = range.begin(); g < range.end(); ++g)
+		{
+			this->Generate_Directions(g, TimeSize, dir);
+			if (collision)
+			{
+				this->Generate_Collisions(g, TimeSize, collision);
+			}
+			if ((this->_histogramInterval == 0) && (!this->_tracing))
+			{
+				this->_kernel(this->_context, *this->_store, g, dir, collision, TimeSize, this->_magnetization);
+				continue;
+			}
+			/**
+			* The group is stepped up to every record, where its hits are added to the histogram, or one step
+			* at a time while its collisions are traced
+			*/
+			int k = 0;
+			int slot = 0;
+			int record = (this->_histogramInterval > 0) ? this->First_Record(this->_currentIteration) : TimeSize;
+			int before[WALKER_LANES];
+			while (k < TimeSize)
+			{
+				int end = std::min(record + 1, TimeSize);
+				if (this->_tracing)
+				{
+					end = k + 1;
+					memcpy(before, this->_store->Hits() + g * WALKER_LANES, sizeof(before));
+				}
+				this->_kernel(this->_context, *this->_store, g, dir + k * WALKER_LANES, (collision) ? collision + k * WALKER_LANES : 0,
+					end - k, this->_magnetization + k * MAG_LANES);
+				if (this->_tracing)
+				{
+					this->Trace_Collisions(g, this->_currentIteration + (uint)k, before);
+				}
+				if (end == record + 1)
+				{
+					this->Record_Histogram(g, slot);
+					++slot;
+					record = record + (int)this->_histogramInterval;
+				}
+				k = end;
+			}
+		}
+	};
 
-}
\ No newline at end of file
+	void RandomWalkCPUDegradeImplementor::Benchmark(map<int, scalar>& steps_per_second, int blocks)
+	{
+		steps_per_second.clear();
+		/**
+		* Execute releases the magnetization buffer when the walk ends
+		*/
+		if (!this->_magnetization)
+		{
+			this->_magnetization = new scalar[MAG_LANES*TimeSize];
+		}
+		this->Set_Degrees_Of_Freedom();
+		this->_tracing = false;
+		this->_chunkSize = std::max(this->Plug().Minimal_Walkers_Per_Thread() / WALKER_LANES, (uint)1);
+		this->_generator.Set_Seed(this->Plug().Seed_For_Random_Number_Generation());
+		int selected = this->_isa;
+		for (int isa = ISA_SCALAR; isa <= ISA_AVX512; ++isa)
+		{
+			if (simd_supported(isa))
+			{
+				this->Select_Kernel(isa);
+				this->_store->Load(this->Walkers());
+				tbb::tick_count tstart = tbb::tick_count::now();
+				for (int b = 0; b < blocks; ++b)
+				{
+					this->init();
+					this->_currentIteration = b * TimeSize;
+					tbb::parallel_deterministic_reduce(tbb::blocked_range<int>(0, this->_store->Groups(), this->_chunkSize), *this);
+				}
+				scalar secs = (scalar)(tbb::tick_count::now() - tstart).seconds();
+				scalar steps = (scalar)this->_store->Size()*(scalar)(blocks*TimeSize);
+				steps_per_second[isa] = (secs > 0) ? steps / secs : (scalar)0;
+			}
+		}
+		this->Select_Kernel(selected);
+	}
+}
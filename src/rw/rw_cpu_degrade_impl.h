@@ -4,28 +4,35 @@
 #include "random_walk_implementor.h"
 #include "rw/walker.h"
 #include "rw/plug.h"
+#include "rw/philox_generator.h"
+#include "rw/walker_store.h"
+#include "rw/rw_cpu_kernels.h"
 
 namespace rw
 {
+	/**
+	* The CPU random walk. The walkers are copied into a structure-of-arrays WalkerStore and advanced in
+	* groups of WALKER_LANES by a stepping kernel. The kernel is picked at runtime according to the
+	* instruction set of the processor (AVX-512, AVX2 or a scalar fallback), or forced with the
+	* simulation parameter SIMD_LEVEL.
+	*
+	* The walls either degrade the magnetization of the walkers by delta, or absorb them with probability
+	* 1 - delta (when the simulation parameters do not Degrade()). Absorbed walkers, and walkers whose
+	* magnetization falls to the floor MAGNETIZATION_FLOOR, are retired from the store after every block of
+	* steps, and their frozen magnetization is added to the decay without walking them any more.
+	*
+	* With a HIT_HISTOGRAM_INTERVAL, the walls do not degrade the walkers. Every interval of steps the walk
+	* records the histogram of the walkers' hits, weighted by their gradient factor, from which the decay of
+	* any constant relaxivity is evaluated (see HitHistogram). The decay of the plug is then sampled at the
+	* recorded iterations only.
+	*
+	* When the plug records a COLLISION_TRACE, the walkers are stepped one step at a time and the collisions of
+	* every group are added to the trace of the plug. The walkers are not retired while they are traced.
+	*/
 	class RandomWalkCPUDegradeImplementor : public RandomWalkImplementor
 	{
 	private:
 
-		/**
-		* The width of the 3D texture
-		*/
-		uint _textureWidth;
-
-		/**
-		* The height of the 3D texture
-		*/
-		uint _textureHeight;
-
-		/**
-		* Depth of the 3D texture
-		*/
-		uint _textureDepth;
-		
 		/**
 		* The maximal number for the random number generation, required for every walker to make a decision
 		*/
@@ -45,17 +52,132 @@ namespace rw
 		bool _shared;
 
 		/**
-		* Magnetization processed by the instance
+		* Magnetization processed by the instance, MAG_LANES partial sums per step
 		*/
 		scalar* _magnetization;
 
 		/**
-		* Vector of collisions, shared by the walkers
+		* Counter-based generator of the walkers' decisions. It is keyed by the simulation seed, and each
+		* walker draws its directions from the counter (walker id, step), so no random buffer is stored
+		*/
+		PhiloxGenerator _generator;
+
+		/**
+		* Iteration at which the current block of TimeSize steps starts
+		*/
+		uint _currentIteration;
+
+		/**
+		* Structure-of-arrays copy of the walkers, shared by the children of the reduction
+		*/
+		WalkerStore* _store;
+
+		/**
+		* Texture and gradient information of the stepping kernel
+		*/
+		Walk_Kernel_Context _context;
+
+		/**
+		* Stepping kernel of the selected instruction set
 		*/
-		int* _collisionDistribution;
+		Walk_Kernel _kernel;
+
+		/**
+		* Instruction set of the stepping kernel
+		*/
+		int _isa;
+
+		/**
+		* TRUE if the walls absorb the walkers instead of degrading their magnetization
+		*/
+		bool _absorbing;
+
+		/**
+		* Magnetization below which the walkers are retired
+		*/
+		float _floor;
+
+		/**
+		* Magnetization of the retired walkers, added to every step
+		*/
+		scalar _frozen;
+
+		/**
+		* Number of steps between two recorded hit histograms, zero if they are not recorded
+		*/
+		uint _histogramInterval;
+
+		/**
+		* Hit histograms of the records of the current block processed by the instance
+		*/
+		vector<vec(scalar)> _histograms;
+
+		/**
+		* TRUE if the collisions of the walkers are traced
+		*/
+		bool _tracing;
+
+		/**
+		* Collision decisions of the absorbing walk, allocated once by every instance of the reduction and
+		* reused by all the ranges that it processes
+		*/
+		vector<float> _collision;
 	protected:
 		void Set_Max_Rnd(uint maxrnd);
 
+		/**
+		* Generates the directions of a group of walkers for a block of steps
+		* @param group Group of walkers
+		* @param steps Number of steps
+		* @param dir Directions, dir[k*WALKER_LANES + l] is the direction of lane l at step k
+		*/
+		void Generate_Directions(int group, int steps, uchar* dir) const;
+
+		/**
+		* Decides, for the absorbing walk, the fate of a group of walkers on a collision at every step of a block
+		* @param group Group of walkers
+		* @param steps Number of steps
+		* @param collision Zero if the walker is absorbed by a collision, one if it is reflected, laid out as the directions
+		*/
+		void Generate_Collisions(int group, int steps, float* collision) const;
+
+		/**
+		* Retires the walkers that are absorbed or below the magnetization floor
+		*/
+		void Compact();
+
+		/**
+		* Adds a group of walkers to a hit histogram of the current block
+		* @param group Group of walkers
+		* @param slot Record of the block
+		*/
+		void Record_Histogram(int group, int slot);
+
+		/**
+		* Moves the histograms of the current block to the plug, and pushes the decay of its relaxivity
+		* @param start First iteration of the block
+		* @return The magnetization of the last record, or zero if the block has no record
+		*/
+		scalar Push_Histograms(uint start);
+
+		/**
+		* @return Step of the first record of the block, as an offset from its first iteration
+		*/
+		int First_Record(uint start) const;
+
+		/**
+		* Adds the collisions of a group of walkers at a step to the collision trace
+		* @param group Group of walkers
+		* @param step Step of the walk
+		* @param before Hits of the lanes of the group before the step
+		*/
+		void Trace_Collisions(int group, uint step, const int* before);
+
+		/**
+		* Selects the stepping kernel
+		* @param isa Instruction set. ISA_AUTO picks the widest available one
+		*/
+		void Select_Kernel(int isa);
 	public:
 		RandomWalkCPUDegradeImplementor(rw::Plug* parent);
 		RandomWalkCPUDegradeImplementor(RandomWalkCPUDegradeImplementor& p, split);
@@ -66,6 +188,10 @@ namespace rw
 		*/
 		void init();
 		uint Max_Rnd() const;
+
+		/**
+		* Processes a range of walker groups during TimeSize steps
+		*/
 		void operator()(const blocked_range<int>& r);
 
 		/**
@@ -75,15 +201,33 @@ namespace rw
 
 		void operator()();
 
-		virtual void Process_Walker(int id, rw::Walker& walker, int rnd, const Field3D& gradient);
+		/**
+		* @return The instruction set of the stepping kernel
+		*/
+		int Instruction_Set() const;
+
 		virtual void Execute();
 		virtual void Set_Degrees_Of_Freedom();
+
+		/**
+		* Measures the throughput of the stepping kernels, on a copy of the plug walkers. The walkers of
+		* the plug are not modified. It may be called before or after Execute.
+		* @param steps_per_second Walker-steps per second of wall clock time, indexed by instruction set. Only
+		* the instruction sets supported by the processor are measured.
+		* @param blocks Number of blocks of steps to measure for every kernel
+		*/
+		void Benchmark(map<int, scalar>& steps_per_second, int blocks = 4);
 	};
 
 	inline uint RandomWalkCPUDegradeImplementor::Max_Rnd() const
 	{
 		return(this->_maxRnd);
 	}
+
+	inline int RandomWalkCPUDegradeImplementor::Instruction_Set() const
+	{
+		return(this->_isa);
+	}
 }
 
 
@@ -0,0 +1,94 @@
+#include "rw_cpu_kernels.h"
+
+namespace rw
+{
+	/**
+	* Displacement of each of the six directions. Direction 2k-1 and 2k move backwards and forward along
+	* axis k, as in the original walker decision rule.
+	*/
+	static const int Dir_X[8] = { -1, 1, 0, 0, 0, 0, 0, 0 };
+	static const int Dir_Y[8] = { 0, 0, -1, 1, 0, 0, 0, 0 };
+	static const int Dir_Z[8] = { 0, 0, 0, 0, -1, 1, 0, 0 };
+
+	void Walk_Kernel_Context::Set(const BinaryImageView& view, const Field3D& gradient)
+	{
+		this->texture = view.Data();
+		this->width = view.Width();
+		this->height = view.Height();
+		this->depth = view.Depth();
+		this->originX = view.Origin().x;
+		this->originY = view.Origin().y;
+		this->originZ = view.Origin().z;
+		this->brickRow = view.Brick_Row();
+		this->brickSlice = view.Brick_Slice();
+		for (int k = 0; k < 8; ++k)
+		{
+			this->factor[k] = (float)gradient.Exponential_Factor(Dir_X[k], Dir_Y[k], Dir_Z[k]);
+		}
+	}
+
+	void Walk_Group_Scalar(const Walk_Kernel_Context& c, WalkerStore& store, int group, const uchar* dir, const float* collision, int steps, double* acc)
+	{
+		int first = group * WALKER_LANES;
+		int* X = store.X() + first;
+		int* Y = store.Y() + first;
+		int* Z = store.Z() + first;
+		int* H = store.Hits() + first;
+		float* E = store.Energy() + first;
+		const float* D = store.Delta() + first;
+		for (int k = 0; k < steps; ++k)
+		{
+			const uchar* dk = dir + k * WALKER_LANES;
+			const float* ck = (collision) ? collision + k * WALKER_LANES : D;
+			double* ak = acc + k * MAG_LANES;
+			for (int l = 0; l < WALKER_LANES; ++l)
+			{
+				int d = dk[l];
+				int x = X[l] + Dir_X[d];
+				int y = Y[l] + Dir_Y[d];
+				int z = Z[l] + Dir_Z[d];
+				if ((x >= 0) && (x < c.width) && (y >= 0) && (y < c.height) && (z >= 0) && (z < c.depth))
+				{
+					int tx = x + c.originX;
+					int ty = y + c.originY;
+					int tz = z + c.originZ;
+					uint b = (tx >> 2) + (ty >> 2)*c.brickRow + (tz >> 2)*c.brickSlice;
+					uint word = c.texture[2 * b + ((tz & 0x03) >> 1)];
+					uint bit = (tx & 0x03) + ((ty & 0x03) << 2) + ((tz & 0x01) << 4);
+					if (((word >> bit) & 0x01) == 0)
+					{
+						X[l] = x;
+						Y[l] = y;
+						Z[l] = z;
+						E[l] = E[l] * c.factor[d];
+					}
+					else
+					{
+						E[l] = E[l] * ck[l];
+						H[l] = H[l] + (1 << SHIFT_STRIKES);
+					}
+				}
+				ak[l & (MAG_LANES - 1)] = ak[l & (MAG_LANES - 1)] + (double)E[l];
+			}
+		}
+	}
+
+	Walk_Kernel Select_Walk_Kernel(int& isa)
+	{
+		int best = simd_detect_isa();
+		if ((isa == ISA_AUTO) || (isa > best))
+		{
+			isa = best;
+		}
+		if (isa == ISA_AVX512)
+		{
+			return(&Walk_Group_AVX512);
+		}
+		if (isa == ISA_AVX2)
+		{
+			return(&Walk_Group_AVX2);
+		}
+		isa = ISA_SCALAR;
+		return(&Walk_Group_Scalar);
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef RANDOM_WALK_CPU_KERNELS_H
+#define RANDOM_WALK_CPU_KERNELS_H
+
+#include "math_la/mdefs.h"
+#include "math_la/simd_dispatch.h"
+#include "rw/walker_store.h"
+#include "rw/field3d.h"
+#include "rw/binary_image/binary_image.h"
+#include "rw/binary_image/binary_image_view.h"
+
+namespace rw
+{
+	/**
+	* Number of partial sums of the magnetization kept for every step. Vector kernels accumulate their
+	* lanes into these slots, so the magnetization buffer of a step has MAG_LANES entries.
+	*/
+	#define MAG_LANES 4
+
+	/**
+	* Read-only information that every stepping kernel requires: the bricked texture, its size and
+	* the magnetization factor of each of the walker's directions. The texture may be a view of a box of a
+	* larger image: the walkers move inside the box, and the texture is read at their position plus the origin.
+	*/
+	struct Walk_Kernel_Context
+	{
+		/**
+		* Bricked texture (see BinaryImage::Accesor_Read)
+		*/
+		const uint* texture;
+		int width;
+		int height;
+		int depth;
+
+		/**
+		* Origin of the walked box in the texture
+		*/
+		int originX;
+		int originY;
+		int originZ;
+
+		/**
+		* Number of bricks in a row of the texture
+		*/
+		int brickRow;
+
+		/**
+		* Number of bricks in a slice of the texture
+		*/
+		int brickSlice;
+
+		/**
+		* Gradient factor of each direction. It replaces Field3D::Exponential_Factor, which computes a square
+		* root on every step, with a table lookup.
+		*/
+		float factor[8];
+
+		/**
+		* Fills the context from a view of an image and a gradient
+		*/
+		void Set(const BinaryImageView& view, const Field3D& gradient);
+	};
+
+	/**
+	* A kernel advances a group of WALKER_LANES walkers a number of steps.
+	* @param c Kernel context
+	* @param store Walkers' store
+	* @param group Group of walkers to process
+	* @param dir Directions of the walkers, dir[k*WALKER_LANES + l] is the direction of lane l at step k
+	* @param collision Magnetization factor of a collision of lane l at step k, laid out as dir. If it is null, the
+	* factor is the delta of the walker. The absorbing walk passes zero (absorbed) or one (reflected) here.
+	* @param steps Number of steps
+	* @param acc Magnetization accumulators, MAG_LANES per step
+	*/
+	typedef void(*Walk_Kernel)(const Walk_Kernel_Context& c, WalkerStore& store, int group, const uchar* dir, const float* collision, int steps, double* acc);
+
+	void Walk_Group_Scalar(const Walk_Kernel_Context& c, WalkerStore& store, int group, const uchar* dir, const float* collision, int steps, double* acc);
+
+	/**
+	* Vector kernels, each one in its own translation unit compiled for its instruction set
+	* (rw_cpu_kernels_avx2.cpp, rw_cpu_kernels_avx512.cpp)
+	*/
+	void Walk_Group_AVX2(const Walk_Kernel_Context& c, WalkerStore& store, int group, const uchar* dir, const float* collision, int steps, double* acc);
+	void Walk_Group_AVX512(const Walk_Kernel_Context& c, WalkerStore& store, int group, const uchar* dir, const float* collision, int steps, double* acc);
+
+	/**
+	* @return The kernel for the instruction set. ISA_AUTO selects the widest one supported by the processor
+	* @param isa Instruction set, and on return, the instruction set of the selected kernel
+	*/
+	Walk_Kernel Select_Walk_Kernel(int& isa);
+}
+
+#endif
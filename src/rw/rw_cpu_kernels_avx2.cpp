@@ -0,0 +1,86 @@
+#include <immintrin.h>
+#include "rw_cpu_kernels.h"
+
+/**
+* The AVX2 kernel lives alone in this file, which the project compiles with /arch:AVX2, so the compiler may use
+* the instruction set here and nowhere else. The kernel is only called when the processor supports it
+* (see Select_Walk_Kernel). GCC and clang take the instruction set from the target attribute instead.
+*/
+#if defined(__GNUC__) || defined(__clang__)
+	#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+	#define TARGET_AVX2
+#endif
+
+namespace rw
+{
+	TARGET_AVX2 void Walk_Group_AVX2(const Walk_Kernel_Context& c, WalkerStore& store, int group, const uchar* dir, const float* collision, int steps, double* acc)
+	{
+		const __m256i tdx = _mm256_setr_epi32(-1, 1, 0, 0, 0, 0, 0, 0);
+		const __m256i tdy = _mm256_setr_epi32(0, 0, -1, 1, 0, 0, 0, 0);
+		const __m256i tdz = _mm256_setr_epi32(0, 0, 0, 0, -1, 1, 0, 0);
+		const __m256 tf = _mm256_loadu_ps(c.factor);
+		const __m256i vw = _mm256_set1_epi32(c.width);
+		const __m256i vh = _mm256_set1_epi32(c.height);
+		const __m256i vd = _mm256_set1_epi32(c.depth);
+		const __m256i brow = _mm256_set1_epi32(c.brickRow);
+		const __m256i bslice = _mm256_set1_epi32(c.brickSlice);
+		const __m256i ox = _mm256_set1_epi32(c.originX);
+		const __m256i oy = _mm256_set1_epi32(c.originY);
+		const __m256i oz = _mm256_set1_epi32(c.originZ);
+		const __m256i minus = _mm256_set1_epi32(-1);
+		const __m256i one = _mm256_set1_epi32(1);
+		const __m256i three = _mm256_set1_epi32(3);
+		const __m256i hit = _mm256_set1_epi32(1 << SHIFT_STRIKES);
+		const __m256i zero = _mm256_setzero_si256();
+		const int* texture = (const int*)c.texture;
+		for (int half = 0; half < WALKER_LANES; half += 8)
+		{
+			int first = group * WALKER_LANES + half;
+			__m256i x = _mm256_loadu_si256((const __m256i*)(store.X() + first));
+			__m256i y = _mm256_loadu_si256((const __m256i*)(store.Y() + first));
+			__m256i z = _mm256_loadu_si256((const __m256i*)(store.Z() + first));
+			__m256i h = _mm256_loadu_si256((const __m256i*)(store.Hits() + first));
+			__m256 e = _mm256_loadu_ps(store.Energy() + first);
+			const __m256 dl = _mm256_loadu_ps(store.Delta() + first);
+			for (int k = 0; k < steps; ++k)
+			{
+				__m256i dv = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(dir + k * WALKER_LANES + half)));
+				__m256i nx = _mm256_add_epi32(x, _mm256_permutevar8x32_epi32(tdx, dv));
+				__m256i ny = _mm256_add_epi32(y, _mm256_permutevar8x32_epi32(tdy, dv));
+				__m256i nz = _mm256_add_epi32(z, _mm256_permutevar8x32_epi32(tdz, dv));
+				__m256i inb = _mm256_and_si256(_mm256_cmpgt_epi32(nx, minus), _mm256_cmpgt_epi32(vw, nx));
+				inb = _mm256_and_si256(inb, _mm256_and_si256(_mm256_cmpgt_epi32(ny, minus), _mm256_cmpgt_epi32(vh, ny)));
+				inb = _mm256_and_si256(inb, _mm256_and_si256(_mm256_cmpgt_epi32(nz, minus), _mm256_cmpgt_epi32(vd, nz)));
+				__m256i tx = _mm256_add_epi32(nx, ox);
+				__m256i ty = _mm256_add_epi32(ny, oy);
+				__m256i tz = _mm256_add_epi32(nz, oz);
+				__m256i b = _mm256_add_epi32(_mm256_srai_epi32(tx, 2),
+					_mm256_add_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(ty, 2), brow), _mm256_mullo_epi32(_mm256_srai_epi32(tz, 2), bslice)));
+				__m256i widx = _mm256_add_epi32(_mm256_slli_epi32(b, 1), _mm256_srli_epi32(_mm256_and_si256(tz, three), 1));
+				__m256i bit = _mm256_add_epi32(_mm256_and_si256(tx, three),
+					_mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(ty, three), 2), _mm256_slli_epi32(_mm256_and_si256(tz, one), 4)));
+				__m256i word = _mm256_mask_i32gather_epi32(zero, texture, widx, inb, 4);
+				__m256i v = _mm256_and_si256(_mm256_srlv_epi32(word, bit), one);
+				__m256i solid = _mm256_and_si256(_mm256_cmpeq_epi32(v, one), inb);
+				__m256i pore = _mm256_andnot_si256(solid, inb);
+				x = _mm256_blendv_epi8(x, nx, pore);
+				y = _mm256_blendv_epi8(y, ny, pore);
+				z = _mm256_blendv_epi8(z, nz, pore);
+				__m256 f = _mm256_permutevar8x32_ps(tf, dv);
+				e = _mm256_blendv_ps(e, _mm256_mul_ps(e, f), _mm256_castsi256_ps(pore));
+				const __m256 dk = (collision) ? _mm256_loadu_ps(collision + k * WALKER_LANES + half) : dl;
+				e = _mm256_blendv_ps(e, _mm256_mul_ps(e, dk), _mm256_castsi256_ps(solid));
+				h = _mm256_add_epi32(h, _mm256_and_si256(solid, hit));
+				__m256d s = _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(e)), _mm256_cvtps_pd(_mm256_extractf128_ps(e, 1)));
+				double* ak = acc + k * MAG_LANES;
+				_mm256_storeu_pd(ak, _mm256_add_pd(_mm256_loadu_pd(ak), s));
+			}
+			_mm256_storeu_si256((__m256i*)(store.X() + first), x);
+			_mm256_storeu_si256((__m256i*)(store.Y() + first), y);
+			_mm256_storeu_si256((__m256i*)(store.Z() + first), z);
+			_mm256_storeu_si256((__m256i*)(store.Hits() + first), h);
+			_mm256_storeu_ps(store.Energy() + first, e);
+		}
+	}
+}
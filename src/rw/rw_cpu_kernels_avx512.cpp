@@ -0,0 +1,84 @@
+#include <immintrin.h>
+#include "rw_cpu_kernels.h"
+
+/**
+* The AVX-512 kernel lives alone in this file, which the project compiles with /arch:AVX512, so the compiler may use
+* the instruction set here and nowhere else. The kernel is only called when the processor supports it
+* (see Select_Walk_Kernel). GCC and clang take the instruction set from the target attribute instead.
+*/
+#if defined(__GNUC__) || defined(__clang__)
+	#define TARGET_AVX512 __attribute__((target("avx512f,avx512cd,avx512bw,avx512dq,avx512vl,avx2,fma")))
+#else
+	#define TARGET_AVX512
+#endif
+
+namespace rw
+{
+	TARGET_AVX512 void Walk_Group_AVX512(const Walk_Kernel_Context& c, WalkerStore& store, int group, const uchar* dir, const float* collision, int steps, double* acc)
+	{
+		const __m512i tdx = _mm512_setr_epi32(-1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m512i tdy = _mm512_setr_epi32(0, 0, -1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m512i tdz = _mm512_setr_epi32(0, 0, 0, 0, -1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m512 tf = _mm512_castps256_ps512(_mm256_loadu_ps(c.factor));
+		const __m512i vw = _mm512_set1_epi32(c.width);
+		const __m512i vh = _mm512_set1_epi32(c.height);
+		const __m512i vd = _mm512_set1_epi32(c.depth);
+		const __m512i brow = _mm512_set1_epi32(c.brickRow);
+		const __m512i bslice = _mm512_set1_epi32(c.brickSlice);
+		const __m512i ox = _mm512_set1_epi32(c.originX);
+		const __m512i oy = _mm512_set1_epi32(c.originY);
+		const __m512i oz = _mm512_set1_epi32(c.originZ);
+		const __m512i minus = _mm512_set1_epi32(-1);
+		const __m512i one = _mm512_set1_epi32(1);
+		const __m512i three = _mm512_set1_epi32(3);
+		const __m512i hit = _mm512_set1_epi32(1 << SHIFT_STRIKES);
+		const __m512i zero = _mm512_setzero_si512();
+		int first = group * WALKER_LANES;
+		__m512i x = _mm512_loadu_si512(store.X() + first);
+		__m512i y = _mm512_loadu_si512(store.Y() + first);
+		__m512i z = _mm512_loadu_si512(store.Z() + first);
+		__m512i h = _mm512_loadu_si512(store.Hits() + first);
+		__m512 e = _mm512_loadu_ps(store.Energy() + first);
+		const __m512 dl = _mm512_loadu_ps(store.Delta() + first);
+		for (int k = 0; k < steps; ++k)
+		{
+			__m512i dv = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)(dir + k * WALKER_LANES)));
+			__m512i nx = _mm512_add_epi32(x, _mm512_permutexvar_epi32(dv, tdx));
+			__m512i ny = _mm512_add_epi32(y, _mm512_permutexvar_epi32(dv, tdy));
+			__m512i nz = _mm512_add_epi32(z, _mm512_permutexvar_epi32(dv, tdz));
+			__mmask16 inb = _mm512_cmpgt_epi32_mask(nx, minus) & _mm512_cmplt_epi32_mask(nx, vw) &
+				_mm512_cmpgt_epi32_mask(ny, minus) & _mm512_cmplt_epi32_mask(ny, vh) &
+				_mm512_cmpgt_epi32_mask(nz, minus) & _mm512_cmplt_epi32_mask(nz, vd);
+			__m512i tx = _mm512_add_epi32(nx, ox);
+			__m512i ty = _mm512_add_epi32(ny, oy);
+			__m512i tz = _mm512_add_epi32(nz, oz);
+			__m512i b = _mm512_add_epi32(_mm512_srai_epi32(tx, 2),
+				_mm512_add_epi32(_mm512_mullo_epi32(_mm512_srai_epi32(ty, 2), brow), _mm512_mullo_epi32(_mm512_srai_epi32(tz, 2), bslice)));
+			__m512i widx = _mm512_add_epi32(_mm512_slli_epi32(b, 1), _mm512_srli_epi32(_mm512_and_si512(tz, three), 1));
+			__m512i bit = _mm512_add_epi32(_mm512_and_si512(tx, three),
+				_mm512_add_epi32(_mm512_slli_epi32(_mm512_and_si512(ty, three), 2), _mm512_slli_epi32(_mm512_and_si512(tz, one), 4)));
+			__m512i word = _mm512_mask_i32gather_epi32(zero, inb, widx, c.texture, 4);
+			__m512i v = _mm512_and_si512(_mm512_srlv_epi32(word, bit), one);
+			__mmask16 solid = _mm512_mask_cmpeq_epi32_mask(inb, v, one);
+			__mmask16 pore = (__mmask16)(inb & ~solid);
+			x = _mm512_mask_mov_epi32(x, pore, nx);
+			y = _mm512_mask_mov_epi32(y, pore, ny);
+			z = _mm512_mask_mov_epi32(z, pore, nz);
+			e = _mm512_mask_mul_ps(e, pore, e, _mm512_permutexvar_ps(dv, tf));
+			const __m512 dk = (collision) ? _mm512_loadu_ps(collision + k * WALKER_LANES) : dl;
+			e = _mm512_mask_mul_ps(e, solid, e, dk);
+			h = _mm512_mask_add_epi32(h, solid, h, hit);
+			__m512d lo = _mm512_cvtps_pd(_mm512_castps512_ps256(e));
+			__m512d hi = _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(e), 1)));
+			__m512d s8 = _mm512_add_pd(lo, hi);
+			__m256d s = _mm256_add_pd(_mm512_castpd512_pd256(s8), _mm512_extractf64x4_pd(s8, 1));
+			double* ak = acc + k * MAG_LANES;
+			_mm256_storeu_pd(ak, _mm256_add_pd(_mm256_loadu_pd(ak), s));
+		}
+		_mm512_storeu_si512(store.X() + first, x);
+		_mm512_storeu_si512(store.Y() + first, y);
+		_mm512_storeu_si512(store.Z() + first, z);
+		_mm512_storeu_si512(store.Hits() + first, h);
+		_mm512_storeu_ps(store.Energy() + first, e);
+	}
+}
@@ -0,0 +1,383 @@
+#include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
+#include <tbb/parallel_reduce.h>
+#include <math.h>
+#include <time.h>
+#include "rw_first_passage_impl.h"
+#include "rw_cpu_degrade_impl.h"
+
+namespace rw
+{
+	static const int TimeSize = 512;
+	static const scalar Pi = 3.14159265358979323846;
+	static const scalar Word_Scale = 1.0 / 4294967296.0;
+
+	/**
+	* Displacement of each of the six lattice directions, as in the stepping kernels
+	*/
+	static const int FP_Dir_X[6] = { -1, 1, 0, 0, 0, 0 };
+	static const int FP_Dir_Y[6] = { 0, 0, -1, 1, 0, 0 };
+	static const int FP_Dir_Z[6] = { 0, 0, 0, 0, -1, 1 };
+
+	float RandomWalkFirstPassageImplementor::_quantiles[FP_TABLE_SIZE];
+
+	/**
+	* @return Probability that a Brownian particle starting at the center of the unit sphere, with unit
+	* diffusion coefficient, has not left the sphere at time t
+	*/
+	static scalar Sphere_Survival(scalar t)
+	{
+		scalar s = 0;
+		scalar sign = 1;
+		for (int n = 1; n <= 256; ++n)
+		{
+			scalar term = exp(-(scalar)(n*n)*Pi*Pi*t);
+			s = s + sign * term;
+			if (term < 1e-18)
+			{
+				break;
+			}
+			sign = -sign;
+		}
+		return(2 * s);
+	}
+
+	bool RandomWalkFirstPassageImplementor::Build_Quantiles()
+	{
+		RandomWalkFirstPassageImplementor::_quantiles[0] = 0;
+		for (int i = 1; i < FP_TABLE_SIZE; ++i)
+		{
+			scalar u = (scalar)i / (scalar)FP_TABLE_SIZE;
+			scalar lo = 0;
+			scalar hi = 4;
+			for (int it = 0; it < 64; ++it)
+			{
+				scalar mid = (lo + hi) / 2;
+				if ((1 - Sphere_Survival(mid)) < u)
+				{
+					lo = mid;
+				}
+				else
+				{
+					hi = mid;
+				}
+			}
+			RandomWalkFirstPassageImplementor::_quantiles[i] = (float)((lo + hi) / 2);
+		}
+		return(true);
+	}
+
+	scalar RandomWalkFirstPassageImplementor::First_Passage_Time(uint rnd)
+	{
+		scalar u = (scalar)rnd * Word_Scale;
+		scalar p = u * (scalar)FP_TABLE_SIZE;
+		int i = (int)p;
+		if (i < FP_TABLE_SIZE - 1)
+		{
+			scalar f = p - (scalar)i;
+			return((1 - f)*(scalar)_quantiles[i] + f * (scalar)_quantiles[i + 1]);
+		}
+		/**
+		* The last quantile is unbounded. There only the first term of the survival series remains.
+		*/
+		return(-log((1 - u) / 2) / (Pi*Pi));
+	}
+
+	RandomWalkFirstPassageImplementor::RandomWalkFirstPassageImplementor(rw::Plug* parent) : RandomWalkImplementor(parent)
+	{
+		static const bool quantiles = RandomWalkFirstPassageImplementor::Build_Quantiles();
+		(void)quantiles;
+		this->_chunkSize = 64;
+		this->_shared = false;
+		this->_currentIteration = 0;
+		this->_magnetization = new scalar[TimeSize];
+		this->_store = new WalkerStore();
+		this->_resume = new vec(uint);
+		this->_events = new vec(uint);
+		this->_distance = 0;
+		this->_context.Set(parent->Plug_View(), parent->Gradient());
+		this->_jumps = 0;
+		this->_jumpFactor = 0;
+		for (int d = 0; d < 6; ++d)
+		{
+			this->_jumpFactor = this->_jumpFactor + log((scalar)this->_context.factor[d]);
+		}
+		this->_jumpFactor = this->_jumpFactor / (scalar)6;
+	}
+
+	RandomWalkFirstPassageImplementor::RandomWalkFirstPassageImplementor(RandomWalkFirstPassageImplementor& p, split) : RandomWalkImplementor(p)
+	{
+		this->_shared = true;
+		this->_chunkSize = p._chunkSize;
+		this->_generator = p._generator;
+		this->_currentIteration = p._currentIteration;
+		this->_store = p._store;
+		this->_resume = p._resume;
+		this->_events = p._events;
+		this->_distance = p._distance;
+		this->_context = p._context;
+		this->_jumpFactor = p._jumpFactor;
+		this->_jumps = 0;
+		this->_magnetization = new scalar[TimeSize];
+		this->init();
+	}
+
+	RandomWalkFirstPassageImplementor::~RandomWalkFirstPassageImplementor()
+	{
+		if (!this->_shared)
+		{
+			delete this->_store;
+			delete this->_resume;
+			delete this->_events;
+		}
+		delete[]this->_magnetization;
+	}
+
+	void RandomWalkFirstPassageImplementor::init()
+	{
+		for (int k = 0; k < TimeSize; ++k)
+		{
+			this->_magnetization[k] = 0;
+		}
+	}
+
+	void RandomWalkFirstPassageImplementor::operator()()
+	{
+		this->Execute();
+	}
+
+	inline bool RandomWalkFirstPassageImplementor::Solid(int x, int y, int z) const
+	{
+		const Walk_Kernel_Context& c = this->_context;
+		x = x + c.originX;
+		y = y + c.originY;
+		z = z + c.originZ;
+		uint b = (x >> 2) + (y >> 2)*c.brickRow + (z >> 2)*c.brickSlice;
+		uint word = c.texture[2 * b + ((z & 0x03) >> 1)];
+		uint bit = (x & 0x03) + ((y & 0x03) << 2) + ((z & 0x01) << 4);
+		return(((word >> bit) & 0x01) != 0);
+	}
+
+	inline int RandomWalkFirstPassageImplementor::Jump_Radius(int x, int y, int z) const
+	{
+		const Walk_Kernel_Context& c = this->_context;
+		/**
+		* The distance transform guarantees a free ball of radius dist. One voxel is left for the rounding of
+		* the landing point, and the jump must not leave the image either.
+		*/
+		int r = (int)(*this->_distance)[x + y * c.width + z * c.width*c.height] - 1;
+		r = std::min(r, std::min(x, c.width - 1 - x));
+		r = std::min(r, std::min(y, c.height - 1 - y));
+		r = std::min(r, std::min(z, c.depth - 1 - z));
+		return((r >= FP_MIN_RADIUS) ? r : 0);
+	}
+
+	void RandomWalkFirstPassageImplementor::Walk(int id, int steps)
+	{
+		const Walk_Kernel_Context& c = this->_context;
+		int* X = this->_store->X();
+		int* Y = this->_store->Y();
+		int* Z = this->_store->Z();
+		int* H = this->_store->Hits();
+		float* E = this->_store->Energy();
+		const float* D = this->_store->Delta();
+		uint& resume = (*this->_resume)[id];
+		uint& events = (*this->_events)[id];
+		float e = E[id];
+		this->_magnetization[0] = this->_magnetization[0] + (scalar)e;
+		int k = std::max((int)resume - (int)this->_currentIteration, 0);
+		uint rnd[PHILOX_BLOCK];
+		int used = PHILOX_BLOCK;
+		while (k < steps)
+		{
+			int x = X[id];
+			int y = Y[id];
+			int z = Z[id];
+			float en = e;
+			int event = k;
+			int R = this->Jump_Radius(x, y, z);
+			if (R > 0)
+			{
+				this->_generator.Generate((uint)id, events, rnd);
+				++events;
+				++this->_jumps;
+				used = PHILOX_BLOCK;
+				scalar cz = 2 * (scalar)rnd[0] * Word_Scale - 1;
+				scalar sz = sqrt(std::max((scalar)0, 1 - cz * cz));
+				scalar phi = 2 * Pi*(scalar)rnd[1] * Word_Scale;
+				int nx = x + (int)floor((scalar)R*sz*cos(phi) + (scalar)0.5);
+				int ny = y + (int)floor((scalar)R*sz*sin(phi) + (scalar)0.5);
+				int nz = z + (int)floor((scalar)R*cz + (scalar)0.5);
+				scalar t = (scalar)6 * (scalar)(R*R)*RandomWalkFirstPassageImplementor::First_Passage_Time(rnd[2]);
+				int n = (int)t;
+				if ((scalar)rnd[3] * Word_Scale < t - (scalar)n)
+				{
+					++n;
+				}
+				n = std::max(n, 1);
+				if (!this->Solid(nx, ny, nz))
+				{
+					X[id] = nx;
+					Y[id] = ny;
+					Z[id] = nz;
+				}
+				en = (float)((scalar)e*exp((scalar)n*this->_jumpFactor));
+				k = k + n;
+			}
+			else
+			{
+				if (used == PHILOX_BLOCK)
+				{
+					this->_generator.Generate((uint)id, events, rnd);
+					++events;
+					used = 0;
+				}
+				int d = PhiloxGenerator::Bounded(rnd[used], 6);
+				++used;
+				x = x + FP_Dir_X[d];
+				y = y + FP_Dir_Y[d];
+				z = z + FP_Dir_Z[d];
+				if ((x >= 0) && (x < c.width) && (y >= 0) && (y < c.height) && (z >= 0) && (z < c.depth))
+				{
+					if (!this->Solid(x, y, z))
+					{
+						X[id] = x;
+						Y[id] = y;
+						Z[id] = z;
+						en = e * c.factor[d];
+					}
+					else
+					{
+						en = e * D[id];
+						H[id] = H[id] + (1 << SHIFT_STRIKES);
+					}
+				}
+				k = k + 1;
+			}
+			this->_magnetization[event] = this->_magnetization[event] + (scalar)(en - e);
+			e = en;
+		}
+		resume = this->_currentIteration + (uint)k;
+		E[id] = e;
+	}
+
+	void RandomWalkFirstPassageImplementor::operator()(const blocked_range<int>& range)
+	{
+		for (int id = range.begin(); id < range.end(); ++id)
+		{
+			this->Walk(id, TimeSize);
+		}
+	}
+
+	void RandomWalkFirstPassageImplementor::join(RandomWalkFirstPassageImplementor& p)
+	{
+		for (int k = 0; k < TimeSize; ++k)
+		{
+			this->_magnetization[k] = this->_magnetization[k] + p._magnetization[k];
+		}
+		this->_jumps = this->_jumps + p._jumps;
+	}
+
+	void RandomWalkFirstPassageImplementor::Execute()
+	{
+		rw::Plug& frm_sample = this->Plug();
+		this->_chunkSize = std::max(frm_sample.Minimal_Walkers_Per_Thread(), (uint)1);
+		clock_t tstart = clock();
+		frm_sample.Clear_Decay_Steps();
+		this->Reserve_Values_Memory_Space(300000);
+		frm_sample.Copy_Section();
+		this->_distance = &frm_sample.Plug_Texture().Wall_Distance();
+		this->_jumps = 0;
+		this->_store->Load(this->Walkers());
+		int nw = this->_store->Size();
+		this->_resume->assign(nw, 0);
+		this->_events->assign(nw, 0);
+		scalar E = 1;
+		scalar rate_factor = exp(-frm_sample.Time_Step() / frm_sample.TBulk_Seconds());
+		this->Init_Iterations();
+		uint seed = 0;
+		if (frm_sample.Repeating_Walkers_Paths())
+		{
+			seed = frm_sample.Seed_For_Random_Number_Generation();
+		}
+		else
+		{
+			seed = (uint)this->Pick_New_Seed();
+		}
+		this->_generator.Set_Seed(seed);
+		this->Set_Seed(seed);
+		scalar Ebulk = (scalar)1.0;
+		uint currentIteration = 0;
+		int updprof = frm_sample.Update_Profile_Interval();
+		while ((E > frm_sample.Stop_Threshold()) && (currentIteration < (int)frm_sample.Max_Number_Of_Iterations()))
+		{
+			this->init();
+			this->_currentIteration = currentIteration;
+			tbb::parallel_deterministic_reduce(tbb::blocked_range<int>(0, nw, this->_chunkSize), *this);
+			bool updateCollision = false;
+			scalar mk = 0;
+			for (int k = 0; k < TimeSize; ++k)
+			{
+				mk = mk + this->_magnetization[k];
+				scalar frac = mk / (scalar)(frm_sample.Number_Of_Walking_Particles());
+				Ebulk = Ebulk * rate_factor;
+				E = frac;
+				E = E * Ebulk;
+				rw::Step_Value v;
+				v.Magnetization = E;
+				v.Iteration = currentIteration;
+				v.Time = ((scalar)currentIteration)*frm_sample.Time_Step();
+				this->Push_Seq_Step_Value(v);
+				++currentIteration;
+				if ((updprof > 0) && (currentIteration % updprof == 0))
+				{
+					updateCollision = true;
+				}
+			}
+			if ((updateCollision) || (this->Has_Walk_Event()))
+			{
+				this->_store->Store(this->Walkers());
+			}
+			if (updateCollision)
+			{
+				frm_sample.Update_Collision_Profile(currentIteration);
+			}
+			this->Observe(currentIteration, E);
+		}
+		this->_store->Store(this->Walkers());
+		frm_sample.Set_Total_Number_Of_Simulated_Iterations(currentIteration);
+		this->Check_T1_Experiment();
+		clock_t tend = clock();
+		clock_t diff = tend - tstart;
+		float ms_elapsed = static_cast<float>(diff) * 1000 / CLOCKS_PER_SEC;
+		int isecs = (int)ms_elapsed;
+		isecs = isecs / 1000;
+		this->Walk_End(isecs);
+	}
+
+	void RandomWalkFirstPassageImplementor::Compare_With_Lattice(const rw::Plug& plug, unsigned long long& jumps, scalar& deviation)
+	{
+		rw::Plug lattice(plug, true);
+		rw::Plug passage(plug, true);
+		lattice.Repeat_Walkers_Paths(true, plug.Seed_For_Random_Number_Generation());
+		passage.Repeat_Walkers_Paths(true, plug.Seed_For_Random_Number_Generation());
+		RandomWalkCPUDegradeImplementor lattice_walk(&lattice);
+		lattice_walk.Execute();
+		RandomWalkFirstPassageImplementor passage_walk(&passage);
+		passage_walk.Execute();
+		jumps = passage_walk.Jumps();
+		deviation = 0;
+		uint steps = std::min(lattice.Decay_Size(), passage.Decay_Size());
+		for (uint k = 0; k < steps; ++k)
+		{
+			scalar d = fabs(lattice.Decay_Step_Value(k).Magnetization - passage.Decay_Step_Value(k).Magnetization);
+			deviation = std::max(deviation, d);
+		}
+	}
+
+	bool RandomWalkFirstPassageImplementor::Supports(const rw::Plug& plug)
+	{
+		const SimulationParams& params = plug.Simulation_Parameters();
+		return((!params.Kill()) && (params.Magnetization_Floor() <= 0) && (plug.Hit_Histogram_Interval() == 0));
+	}
+}
@@ -0,0 +1,187 @@
+#ifndef RANDOM_WALK_FIRST_PASSAGE_IMPLEMENTOR_H
+#define RANDOM_WALK_FIRST_PASSAGE_IMPLEMENTOR_H
+
+#include "random_walk_implementor.h"
+#include "rw/walker.h"
+#include "rw/plug.h"
+#include "rw/philox_generator.h"
+#include "rw/walker_store.h"
+#include "rw/rw_cpu_kernels.h"
+
+namespace rw
+{
+	/**
+	* Minimal radius of a sphere jump. Closer to the walls the walkers take lattice steps.
+	*/
+	#define FP_MIN_RADIUS 2
+
+	/**
+	* Number of quantiles of the tabulated first-passage time distribution
+	*/
+	#define FP_TABLE_SIZE 1024
+
+	/**
+	* The CPU random walk accelerated by first-passage jumps. A walker whose distance to the nearest wall
+	* is R (taken from the exact distance transform of the texture) cannot collide before it leaves the sphere
+	* of radius R around it, so the walk inside the sphere is replaced by a single jump to a uniform point
+	* of its surface. The number of steps spent in the jump is sampled from the first-passage time
+	* distribution of the sphere, which for the lattice walk has mean R^2 steps. Near the walls the walkers
+	* take the usual lattice steps.
+	*
+	* The magnetization of a walker is constant between two of its events, so every walker records only
+	* the changes of its magnetization, and the decay of a block of steps is the prefix sum of these
+	* changes. The work per walker is proportional to its number of events rather than to the number of
+	* steps. The decisions are drawn from a counter-based generator keyed by the walker and its number of
+	* events, so the walk is reproducible.
+	*/
+	class RandomWalkFirstPassageImplementor : public RandomWalkImplementor
+	{
+	private:
+		/**
+		* The chunk size of the parallel block
+		*/
+		uint _chunkSize;
+
+		/**
+		* Marks the children of the reduction, which cannot free the shared data
+		*/
+		bool _shared;
+
+		/**
+		* Magnetization changes processed by the instance, one per step of the block
+		*/
+		scalar* _magnetization;
+
+		/**
+		* Generator of the walkers' decisions
+		*/
+		PhiloxGenerator _generator;
+
+		/**
+		* Iteration at which the current block of steps starts
+		*/
+		uint _currentIteration;
+
+		/**
+		* Structure-of-arrays copy of the walkers
+		*/
+		WalkerStore* _store;
+
+		/**
+		* Iteration of the next event of every walker. A walker in the middle of a jump resumes in a later block.
+		*/
+		vec(uint)* _resume;
+
+		/**
+		* Number of random blocks drawn by every walker
+		*/
+		vec(uint)* _events;
+
+		/**
+		* Distance to the nearest wall of every voxel, kept by the texture of the plug (see
+		* BinaryImage::Wall_Distance)
+		*/
+		const vec(uchar)* _distance;
+
+		/**
+		* Texture and gradient information of the lattice steps
+		*/
+		Walk_Kernel_Context _context;
+
+		/**
+		* Number of sphere jumps taken by the instance
+		*/
+		unsigned long long _jumps;
+
+		/**
+		* Mean logarithm of the gradient factors of the six directions, applied per step of a jump
+		*/
+		scalar _jumpFactor;
+
+		/**
+		* Inverse cumulative distribution of the first-passage time of the unit sphere, in units of R^2/D
+		*/
+		static float _quantiles[FP_TABLE_SIZE];
+
+		/**
+		* Fills the quantile table
+		* @return TRUE, so it can initialize a static flag
+		*/
+		static bool Build_Quantiles();
+
+		/**
+		* @return A first-passage time of the unit sphere, sampled by inverse transform
+		* @param rnd Random word
+		*/
+		static scalar First_Passage_Time(uint rnd);
+
+		/**
+		* @return The radius of the largest sphere jump from the position, zero if the walker must take a lattice step
+		*/
+		int Jump_Radius(int x, int y, int z) const;
+
+		/**
+		* @return TRUE if the voxel is solid
+		*/
+		bool Solid(int x, int y, int z) const;
+
+		/**
+		* Advances a walker until its next event falls beyond the block
+		* @param id Walker id
+		* @param steps Number of steps of the block
+		*/
+		void Walk(int id, int steps);
+	public:
+		RandomWalkFirstPassageImplementor(rw::Plug* parent);
+		RandomWalkFirstPassageImplementor(RandomWalkFirstPassageImplementor& p, split);
+		~RandomWalkFirstPassageImplementor();
+
+		/**
+		* Clears the magnetization changes of the block
+		*/
+		void init();
+
+		/**
+		* Processes a range of walkers during a block of steps
+		*/
+		void operator()(const blocked_range<int>& r);
+
+		/**
+		* Joins two handlers, reducing the magnetization changes
+		*/
+		void join(RandomWalkFirstPassageImplementor& p);
+
+		void operator()();
+
+		virtual void Execute();
+
+		/**
+		* @return Number of sphere jumps taken by the walkers during the last call to Execute
+		*/
+		unsigned long long Jumps() const;
+
+		/**
+		* Walks copies of a plug with the first-passage walk and with the lattice walk (see
+		* RandomWalkCPUDegradeImplementor), from the same starting positions. The plug is not modified.
+		* @param plug Plug with its walkers placed
+		* @param jumps Number of sphere jumps taken by the first-passage walk
+		* @param deviation Largest absolute difference between the two decays, over the common steps
+		*/
+		static void Compare_With_Lattice(const rw::Plug& plug, unsigned long long& jumps, scalar& deviation);
+
+		/**
+		* @return TRUE if the first-passage walk reproduces the walk of the plug. A jump skips the steps inside
+		* its sphere, so the walls must relax rather than absorb, and no magnetization floor nor hit histogram,
+		* which follow every step of a walker, may be set.
+		* @param plug Plug to walk
+		*/
+		static bool Supports(const rw::Plug& plug);
+	};
+
+	inline unsigned long long RandomWalkFirstPassageImplementor::Jumps() const
+	{
+		return(this->_jumps);
+	}
+}
+
+#endif
@@ -1,5 +1,5 @@
-#include <amp.h>
 #include "rw_gpu_degrade_impl.h"
+#ifdef GPU_AMP
 #include "binary_image/binary_image_executor.h"
 
 namespace rw
@@ -344,4 +344,6 @@ namespace rw
 	{
 		this->Execute();
 	}
-}
\ No newline at end of file
+}
+
+#endif
@@ -1,9 +1,9 @@
 #ifndef RANDOM_WALK_GPU_DEGRADE_IMPLEMENTOR_H
 #define RANDOM_WALK_GPU_DEGRADE_IMPLEMENTOR_H
 
-#include <amp.h>
-#include <amp_math.h>
 #include "math_la/mdefs.h"
+#ifdef GPU_AMP
+#include <amp_math.h>
 #include "random_walk_implementor.h"
 #include "walker.h"
 
@@ -133,3 +133,4 @@ namespace rw
 
 #endif
 
+#endif
@@ -2,6 +2,7 @@
 #include "rw/plug.h"
 #include "rw_cpu_degrade_impl.h"
 #include "rw_gpu_degrade_impl.h"
+#include "rw_first_passage_impl.h"
 #include "rw_simulator_impl.h"
 
 namespace rw
@@ -14,11 +15,19 @@ namespace rw
 		rw::RandomWalkImplementor* implementor = 0;
 		if (dimension == 3)
 		{
-			if (gpu)
+#ifdef GPU_AMP
+			if ((gpu) && (formation->Hit_Histogram_Interval() == 0) && (!formation->Recording_Collision_Trace()))
 			{
 				implementor = new RandomWalkGPUDegradeImplementor(formation);
 			}
 			else
+#endif
+			if ((formation->Simulation_Parameters().Walk_Mode() == WALK_FIRST_PASSAGE) &&
+				(RandomWalkFirstPassageImplementor::Supports(*formation)))
+			{
+				implementor = new RandomWalkFirstPassageImplementor(formation);
+			}
+			else
 			{
 				implementor = new RandomWalkCPUDegradeImplementor(formation);
 			}
@@ -1,3 +1,4 @@
+#include <math.h>
 #include "rw_placer.h"
 
 namespace rw
@@ -6,8 +7,8 @@ namespace rw
 	RandomWalkPlacer::RandomWalkPlacer(rw::Plug* parent)
 	{
 		this->_parentFormation = parent;
-		this->_mtx = new tbb::spin_mutex();
-		this->_positions = new map<rw::Pos3i, uint>();
+		this->_spacing = new vec(scalar)();
+		this->_pores = 0;
 		this->_copied = false;
 		this->_recharge = true;
 	}
@@ -15,8 +16,9 @@ namespace rw
 	RandomWalkPlacer::RandomWalkPlacer(const RandomWalkPlacer& wp)
 	{
 		this->_parentFormation = wp._parentFormation;
-		this->_mtx = wp._mtx;
-		this->_positions = wp._positions;
+		this->_generator = wp._generator;
+		this->_spacing = wp._spacing;
+		this->_pores = wp._pores;
 		this->_copied = true;
 		this->_recharge = wp._recharge;
 	}
@@ -26,30 +28,59 @@ namespace rw
 	{
 		if (!this->_copied)
 		{
-			delete this->_positions;
-			delete this->_mtx;
+			delete this->_spacing;
 		}
 		this->_parentFormation = 0;
 	}
 
-	void RandomWalkPlacer::Assign_Position_Map_To_Walkers()
+	void RandomWalkPlacer::Build_Spacing(int nw)
 	{
-		map<rw::Pos3i, uint>::const_iterator itr = this->_positions->begin();
-		uint id = 0;
-		while (itr != this->_positions->end())
+		static const scalar Word_Scale = 1.0 / 4294967296.0;
+		vec(scalar)& spacing = *this->_spacing;
+		int size = nw + 1;
+		spacing.resize(size);
+		int chunks = (size + DCHUNK_SIZE - 1) / DCHUNK_SIZE;
+		vec(scalar) offset(chunks + 1, 0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, chunks, 1), [this, size, &spacing, &offset](const tbb::blocked_range<int>& b)
 		{
-			rw::Pos3i pp = itr->first;
-			for (int k = 0; k < (int)itr->second; ++k)
+			uint rnd[PHILOX_BLOCK];
+			for (int c = b.begin(); c < b.end(); ++c)
 			{
-				this->Set_Walker_Start_Position(id,pp);
-				++id;
+				int end = std::min((c + 1)*DCHUNK_SIZE, size);
+				scalar s = 0;
+				for (int i = c * DCHUNK_SIZE; i < end; ++i)
+				{
+					this->_generator.Generate((uint)i, 0, rnd, PHILOX_STREAM_PLACEMENT);
+					s = s - log(((scalar)rnd[0] + (scalar)1.0) * Word_Scale);
+					spacing[i] = s;
+				}
+				offset[c + 1] = s;
 			}
-			++itr;
+		});
+		for (int c = 0; c < chunks; ++c)
+		{
+			offset[c + 1] = offset[c + 1] + offset[c];
 		}
+		tbb::parallel_for(tbb::blocked_range<int>(1, chunks, 1), [size, &spacing, &offset](const tbb::blocked_range<int>& b)
+		{
+			for (int c = b.begin(); c < b.end(); ++c)
+			{
+				int end = std::min((c + 1)*DCHUNK_SIZE, size);
+				for (int i = c * DCHUNK_SIZE; i < end; ++i)
+				{
+					spacing[i] = spacing[i] + offset[c];
+				}
+			}
+		});
 	}
 
 	void RandomWalkPlacer::RandomWalkPlacer::operator()(const tbb::blocked_range<int>& r) const
 	{
+		const BinaryImageView& view = this->_parentFormation->_view;
+		const vec(uint)& rows = this->_parentFormation->_poreRanks;
+		const vec(scalar)& spacing = *this->_spacing;
+		uint pores = (this->_pores) ? (uint)this->_pores->Size() : rows.back();
+		scalar total = spacing.back();
 		for (int t = r.begin(); t < r.end(); ++t)
 		{
 			rw::Walker& w = this->_parentFormation->Walking_Particle(t);
@@ -58,54 +89,33 @@ namespace rw
 			{
 				w.Set_Magnetization(1);
 			}
-			bool placed = false;
-			scalar ic = this->_parentFormation->Pick_Random_Normalized_Number();
-			while (!placed)
+			uint rank = (uint)(spacing[t] / total * (scalar)pores);
+			rank = std::min(rank, pores - 1);
+			rw::Pos3i pp;
+			if (this->_pores)
 			{
-				int id = (int)(ic*((int)this->_parentFormation->_image->Length()));
-				rw::Pos3i pp;
-				Pos3i::Int_To_Pos3i(id, this->_parentFormation->_image->Width(),
-					this->_parentFormation->_image->Height(),
-					this->_parentFormation->_image->Depth(), pp);
-				if ((*this->_parentFormation->_image)(pp) == 0)
-				{
-					Pos3i nxyz;
-					Pos3i::Int_To_Pos3i(id, this->_parentFormation->Plug_Texture().Width(),
-						this->_parentFormation->Plug_Texture().Height(),
-						this->_parentFormation->Plug_Texture().Depth(), nxyz);
-					placed = true;
-					map<rw::Pos3i, uint>::iterator fitr = this->_positions->find(nxyz);
-					if (fitr == this->_positions->end())
-					{
-						std::pair<rw::Pos3i, uint> p;
-						p.first = nxyz;
-						p.second = 1;
-						this->_mtx->lock();
-						this->_positions->insert(p);
-						this->_mtx->unlock();
-					}
-					else
-					{
-						this->_mtx->lock();
-						fitr->second++;
-						this->_mtx->unlock();
-					}
-				}
-				else
-				{
-					ic = this->_parentFormation->Pick_Random_Normalized_Number();
-				}
+				rw::Pos3i::Int_To_Pos3i(this->_pores->Voxel((int)rank), view.Width(), view.Height(), view.Depth(), pp);
 			}
+			else
+			{
+				pp = view.Pore_Voxel_Of_Rank(rows, rank);
+			}
+			this->_parentFormation->_walkersStartPosition[t] = pp;
+			w.Set_Position(pp);
 		}
 	}
 
 	void RandomWalkPlacer::operator()()
 	{
-		this->Formation().Clear_Collision_Profile();		
-		this->Reset_Seed();
+		this->Formation().Clear_Collision_Profile();
 		int nw = this->Formation().Number_Of_Walking_Particles();
+		if (this->Rank_Pores() == 0)
+		{
+			return;
+		}
+		this->_generator.Set_Seed(this->Formation().Seed_For_Random_Number_Generation());
+		this->Build_Spacing(nw);
 		tbb::parallel_for(tbb::blocked_range<int>(0, nw, this->Formation().Minimal_Walkers_Per_Thread()), *this);
-		this->Assign_Position_Map_To_Walkers();		
 		this->Place_End();
 	}
-}
\ No newline at end of file
+}
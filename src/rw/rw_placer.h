@@ -1,19 +1,26 @@
 #ifndef RANDOM_WALK_PLACER
 #define RANDOM_WALK_PLACER
 
-#include <map>
-#include "tbb/spin_mutex.h"
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "math_la/mdefs.h"
 #include "binary_image/pos3i.h"
 #include "rw/walker.h"
 #include "rw/plug.h"
+#include "rw/philox_generator.h"
 
 namespace rw
 {
-	using std::map;
 	class Plug;
+
+	/**
+	* Places the walkers uniformly in the pore space. The pore voxels are selected by their rank, from the
+	* pore map of the image when the plug covers it whole, and otherwise from the rank index of the section
+	* (see BinaryImageView::Pore_Rank_Index), so there is no rejection of solid voxels.
+	* The ranks are drawn in increasing order from the exponential spacings of a counter-based generator
+	* keyed by the plug seed: the placement is deterministic for a given seed, needs no lock, and leaves the
+	* walkers sorted by position as the walk expects.
+	*/
 	class RandomWalkPlacer
 	{
 	private:
@@ -23,14 +30,19 @@ namespace rw
 		Plug* _parentFormation;
 
 		/**
-		* Mutex to update walker positions along different threads
+		* Generator of the exponential spacings of the walkers
+		*/
+		PhiloxGenerator _generator;
+
+		/**
+		* Cumulative exponential spacings: walker i is placed at the fraction _spacing[i] / _spacing[N] of the pore voxels
 		*/
-		tbb::spin_mutex* _mtx;
+		vec(scalar)* _spacing;
 
 		/**
-		* Walkers positions
+		* Pore map of the image, 0 if the plug is a section and the pore voxels are ranked by the rank index
 		*/
-		map<rw::Pos3i, uint>* _positions;
+		const BinaryImagePoreMap* _pores;
 
 		/**
 		* Defines if a handler is copied or not
@@ -39,22 +51,41 @@ namespace rw
 		bool _recharge;
 	protected:
 		rw::Plug& Formation();
-		map<rw::Pos3i, uint>& Position_Map();
-		tbb::spin_mutex& Mutex();
 		rw::Walker& Walker(uint id);
 		vec(rw::Walker)& Walkers();
 		void Set_Walker_Start_Position(uint walker_id, const rw::Pos3i& position);
-		void Assign_Position_Map_To_Walkers();
-		void Reset_Seed();
+
+		/**
+		* Builds the rank index of the plug image, if it has not been built yet
+		* @return The rank index
+		*/
+		const vec(uint)& Pore_Rank_Index();
+
+		/**
+		* Selects the ranking of the pore voxels: the pore map of the image if there is one, or else the rank
+		* index of the section
+		* @return Number of pore voxels of the plug
+		*/
+		uint Rank_Pores();
+
+		/**
+		* Accumulates the exponential spacings of the walkers, in parallel chunks
+		* @param nw Number of walkers
+		*/
+		void Build_Spacing(int nw);
 		void Place_End();
 	public:
 		RandomWalkPlacer(rw::Plug* parent);
 		RandomWalkPlacer(const RandomWalkPlacer& wp);
 		~RandomWalkPlacer();
 		/**
-		* Copies sorted positions to the parent walkers list
+		* Places the walkers of the parent formation, sorted by position
 		*/
 		virtual void operator()();
+
+		/**
+		* Places a range of walkers, once the spacings have been built
+		*/
 		void operator()(const tbb::blocked_range<int>& r) const;
 		void Recharge(bool recharge);
 		bool Recharging() const;
@@ -76,16 +107,6 @@ namespace rw
 		return(*this->_parentFormation);
 	}
 
-	inline map<rw::Pos3i, uint>& RandomWalkPlacer::Position_Map()
-	{
-		return(*this->_positions);
-	}
-
-	inline tbb::spin_mutex& RandomWalkPlacer::Mutex()
-	{
-		return(*this->_mtx);
-	}
-
 	inline rw::Walker& RandomWalkPlacer::Walker(uint id)
 	{
 		return(this->_parentFormation->_walkers[id]);
@@ -104,9 +125,23 @@ namespace rw
 		this->_parentFormation->_walkers[walker_id].Set_Position(position);
 	}
 
-	inline void RandomWalkPlacer::Reset_Seed()
+	inline const vec(uint)& RandomWalkPlacer::Pore_Rank_Index()
+	{
+		if (this->_parentFormation->_poreRanks.empty())
+		{
+			this->_parentFormation->_view.Pore_Rank_Index(this->_parentFormation->_poreRanks);
+		}
+		return(this->_parentFormation->_poreRanks);
+	}
+
+	inline uint RandomWalkPlacer::Rank_Pores()
 	{
-		this->_parentFormation->_randomGenerator.seed((uint)this->_parentFormation->_randomSeedGenerator());
+		this->_pores = this->_parentFormation->_view.Pore_Map();
+		if (this->_pores)
+		{
+			return((uint)this->_pores->Size());
+		}
+		return(this->Pore_Rank_Index().back());
 	}
 
 	inline void RandomWalkPlacer::Place_End()
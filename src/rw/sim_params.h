@@ -1,6 +1,7 @@
 #ifndef SIM_PARAMS_H
 #define SIM_PARAMS_H
 
+#include <string.h>
 #include "math_la/mdefs.h"
 
 #define PARAMS_SIZE    512
@@ -21,6 +22,16 @@
 #define DIM_Y						504
 #define DIM_Z						505
 #define DECAY_REDUCTION				502
+#define SIMD_LEVEL					501
+#define WALK_MODE					500
+#define MAGNETIZATION_FLOOR			499
+#define HIT_HISTOGRAM_INTERVAL		498
+#define COLLISION_TRACE				497
+#define LAPLACE_INVERSION			496
+#define LAPLACE_RANK				495
+
+#define WALK_LATTICE				0
+#define WALK_FIRST_PASSAGE			1
 
 namespace rw
 {
@@ -39,12 +50,16 @@ namespace rw
 		bool Get_Bool(uint idx) const;
 		void Set_Value(uint idx, uint value);
 		uint Get_Value(uint idx) const;
+		void Set_Float(uint idx, float value);
+		float Get_Float(uint idx) const;
 		bool Kill() const;
 		bool Degrade() const;
 		bool Gpu() const;
 		bool Cpu() const;
 		bool T2_Relaxation() const;
 		bool T1_Relaxation() const;
+		uint Walk_Mode() const;
+		float Magnetization_Floor() const;
 		void Fill_Array(uint* array) const;
 	};
 
@@ -91,8 +106,8 @@ namespace rw
 
 	inline void SimulationParams::Set_Bool(uint idx, bool value)
 	{
-		uint id = idx / PARAMS_SIZE;
-		uint bit = idx - id * PARAMS_SIZE;
+		uint id = idx / (8 * sizeof(uint));
+		uint bit = idx - id * (8 * sizeof(uint));
 		uint mask = 0x01 << bit;
 		mask = ~mask;
 		this->_field[id] = this->_field[id] & mask;
@@ -105,8 +120,8 @@ namespace rw
 
 	inline bool SimulationParams::Get_Bool(uint idx) const
 	{
-		uint id = idx / PARAMS_SIZE;
-		uint bit = idx - id * PARAMS_SIZE;
+		uint id = idx / (8 * sizeof(uint));
+		uint bit = idx - id * (8 * sizeof(uint));
 		uint mask = 0x01 << bit;
 		uint ret = this->_field[id] & mask;
 		return(ret > 0);
@@ -153,6 +168,28 @@ namespace rw
 		return(!this->Get_Bool(T2));
 	}
 
+	inline void SimulationParams::Set_Float(uint idx, float value)
+	{
+		memcpy(&this->_field[idx], &value, sizeof(float));
+	}
+
+	inline float SimulationParams::Get_Float(uint idx) const
+	{
+		float value;
+		memcpy(&value, &this->_field[idx], sizeof(float));
+		return(value);
+	}
+
+	inline float SimulationParams::Magnetization_Floor() const
+	{
+		return(this->Get_Float(MAGNETIZATION_FLOOR));
+	}
+
+	inline uint SimulationParams::Walk_Mode() const
+	{
+		return(this->Get_Value(WALK_MODE));
+	}
+
 	inline void SimulationParams::Fill_Array(uint* array) const
 	{
 		for (uint i = 0; i < PARAMS_SIZE; ++i)
@@ -6,6 +6,7 @@ namespace rw
 
 Simulator::Simulator()
 {
+	this->_profileUpdateInterval = 0;
 	this->_totalParticles = 0;
 	this->_distribution = 0;
 }
@@ -1,9 +1,10 @@
 #ifndef FORMATION_WALKER_H
 #define FORMATION_WALKER_H
 
-#include <amp.h>
-#include <amp_math.h>
 #include "math_la/mdefs.h"
+#ifdef GPU_AMP
+	#include <amp_math.h>
+#endif
 
 namespace rw
 {
@@ -0,0 +1,177 @@
+#include "tbb/parallel_for.h"
+#include "walker_store.h"
+
+namespace rw
+{
+	static const int Dead_Coordinate = -16;
+
+	WalkerStore::WalkerStore()
+	{
+		this->_size = 0;
+		this->_paddedSize = 0;
+	}
+
+	void WalkerStore::Pad()
+	{
+		this->_paddedSize = ((this->_size + WALKER_LANES - 1) / WALKER_LANES)*WALKER_LANES;
+		this->_x.resize(this->_paddedSize);
+		this->_y.resize(this->_paddedSize);
+		this->_z.resize(this->_paddedSize);
+		this->_hits.resize(this->_paddedSize);
+		this->_energy.resize(this->_paddedSize);
+		this->_delta.resize(this->_paddedSize);
+		this->_ids.resize(this->_paddedSize);
+		for (int i = this->_size; i < this->_paddedSize; ++i)
+		{
+			this->_x[i] = Dead_Coordinate;
+			this->_y[i] = Dead_Coordinate;
+			this->_z[i] = Dead_Coordinate;
+			this->_hits[i] = 0;
+			this->_energy[i] = 0.0f;
+			this->_delta[i] = 0.0f;
+			this->_ids[i] = -1;
+		}
+	}
+
+	void WalkerStore::Load(const vec(rw::Walker)& walkers)
+	{
+		this->_size = (int)walkers.size();
+		this->Pad();
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->_size, DCHUNK_SIZE), [this, &walkers](const tbb::blocked_range<int>& b)
+		{
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				const rw::Walker& w = walkers[i];
+				rw::Pos3i pp = w.Position();
+				this->_x[i] = pp.x;
+				this->_y[i] = pp.y;
+				this->_z[i] = pp.z;
+				this->_hits[i] = w.Hits_Dim_Flag();
+				this->_energy[i] = (float)w.Magnetization();
+				this->_delta[i] = (float)w.Rho();
+				this->_ids[i] = i;
+			}
+		});
+	}
+
+	void WalkerStore::Store(vec(rw::Walker)& walkers) const
+	{
+		tbb::parallel_for(tbb::blocked_range<int>(0, this->_size, DCHUNK_SIZE), [this, &walkers](const tbb::blocked_range<int>& b)
+		{
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				rw::Walker& w = walkers[this->_ids[i]];
+				rw::Pos3i pp;
+				pp.x = this->_x[i];
+				pp.y = this->_y[i];
+				pp.z = this->_z[i];
+				w.Set_Position(pp);
+				w.Set_Hits_Dim_Flag(this->_hits[i]);
+				w.Set_Magnetization(this->_energy[i]);
+			}
+		});
+	}
+
+	void WalkerStore::Set_Delta(float delta)
+	{
+		for (int i = 0; i < this->_size; ++i)
+		{
+			this->_delta[i] = delta;
+		}
+	}
+
+	int WalkerStore::Compact(vec(rw::Walker)& walkers, float floor, scalar& frozen)
+	{
+		int chunks = (this->_size + DCHUNK_SIZE - 1) / DCHUNK_SIZE;
+		vec(int) offset(chunks + 1, 0);
+		vec(scalar) retired(chunks, 0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, chunks, 1), [this, floor, &offset, &retired](const tbb::blocked_range<int>& b)
+		{
+			for (int c = b.begin(); c < b.end(); ++c)
+			{
+				int end = std::min((c + 1)*DCHUNK_SIZE, this->_size);
+				int kept = 0;
+				scalar energy = 0;
+				for (int i = c * DCHUNK_SIZE; i < end; ++i)
+				{
+					if (this->_energy[i] > floor)
+					{
+						++kept;
+					}
+					else
+					{
+						energy = energy + (scalar)this->_energy[i];
+					}
+				}
+				offset[c + 1] = kept;
+				retired[c] = energy;
+			}
+		});
+		for (int c = 0; c < chunks; ++c)
+		{
+			offset[c + 1] = offset[c + 1] + offset[c];
+			frozen = frozen + retired[c];
+		}
+		int active = offset[chunks];
+		int dropped = this->_size - active;
+		if (dropped == 0)
+		{
+			return(0);
+		}
+		vec(int) x(active);
+		vec(int) y(active);
+		vec(int) z(active);
+		vec(int) hits(active);
+		vec(float) energy(active);
+		vec(float) delta(active);
+		vec(int) ids(active);
+		tbb::parallel_for(tbb::blocked_range<int>(0, chunks, 1),
+			[this, floor, &offset, &walkers, &x, &y, &z, &hits, &energy, &delta, &ids](const tbb::blocked_range<int>& b)
+		{
+			for (int c = b.begin(); c < b.end(); ++c)
+			{
+				int end = std::min((c + 1)*DCHUNK_SIZE, this->_size);
+				int j = offset[c];
+				for (int i = c * DCHUNK_SIZE; i < end; ++i)
+				{
+					if (this->_energy[i] > floor)
+					{
+						x[j] = this->_x[i];
+						y[j] = this->_y[i];
+						z[j] = this->_z[i];
+						hits[j] = this->_hits[i];
+						energy[j] = this->_energy[i];
+						delta[j] = this->_delta[i];
+						ids[j] = this->_ids[i];
+						++j;
+					}
+					else
+					{
+						rw::Walker& w = walkers[this->_ids[i]];
+						rw::Pos3i pp;
+						pp.x = this->_x[i];
+						pp.y = this->_y[i];
+						pp.z = this->_z[i];
+						w.Set_Position(pp);
+						w.Set_Hits_Dim_Flag(this->_hits[i]);
+						w.Set_Magnetization(this->_energy[i]);
+						if (this->_energy[i] == 0.0f)
+						{
+							w.Kill();
+						}
+					}
+				}
+			}
+		});
+		this->_x.swap(x);
+		this->_y.swap(y);
+		this->_z.swap(z);
+		this->_hits.swap(hits);
+		this->_energy.swap(energy);
+		this->_delta.swap(delta);
+		this->_ids.swap(ids);
+		this->_size = active;
+		this->Pad();
+		return(dropped);
+	}
+}
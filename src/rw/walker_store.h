@@ -0,0 +1,190 @@
+#ifndef WALKER_STORE_H
+#define WALKER_STORE_H
+
+#include "math_la/mdefs.h"
+#include "rw/binary_image/pos3i.h"
+#include "rw/walker.h"
+
+namespace rw
+{
+	#define WALKER_LANES 16
+
+	/**
+	* A structure-of-arrays copy of the walkers. Every attribute of the walker is stored in its own
+	* contiguous array, so a group of WALKER_LANES walkers can be loaded into vector registers at once.
+	* The store is padded to a multiple of WALKER_LANES with dead walkers: they have zero magnetization
+	* and lie far outside the texture, so they never move or collide.
+	* The store holds only the active walkers: Compact() retires the walkers that no longer need to walk, and
+	* every stored walker keeps the index of the walker it was copied from.
+	*/
+	class WalkerStore
+	{
+	private:
+		/**
+		* Number of real walkers
+		*/
+		int _size;
+
+		/**
+		* Number of walkers, including the padding
+		*/
+		int _paddedSize;
+
+		/**
+		* Coordinates of the walkers
+		*/
+		vec(int) _x;
+		vec(int) _y;
+		vec(int) _z;
+
+		/**
+		* Hits and dimension flag of the walkers (see Walker::Hits_Dim_Flag())
+		*/
+		vec(int) _hits;
+
+		/**
+		* Magnetization of the walkers
+		*/
+		vec(float) _energy;
+
+		/**
+		* Magnetization factor applied on every collision
+		*/
+		vec(float) _delta;
+
+		/**
+		* Index of every stored walker in the walkers' vector, -1 for the padding
+		*/
+		vec(int) _ids;
+
+		/**
+		* Sets the walkers from size to the padded size as dead walkers
+		*/
+		void Pad();
+	public:
+		WalkerStore();
+
+		/**
+		* Copies the walkers into the arrays
+		* @param walkers Walkers to be copied
+		*/
+		void Load(const vec(rw::Walker)& walkers);
+
+		/**
+		* Copies the arrays back to the walkers. Only the active walkers are copied, the retired ones were
+		* copied when they were retired.
+		* @param walkers Destination walkers
+		*/
+		void Store(vec(rw::Walker)& walkers) const;
+
+		/**
+		* Retires the walkers whose magnetization is not above the floor, by a parallel stream compaction of the
+		* arrays which keeps the order of the active walkers. The retired walkers are copied back to their
+		* walkers; those with no magnetization left are marked as dead.
+		* @param walkers Destination of the retired walkers
+		* @param floor Magnetization floor
+		* @param frozen Increased by the magnetization of the retired walkers
+		* @return Number of retired walkers
+		*/
+		int Compact(vec(rw::Walker)& walkers, float floor, scalar& frozen);
+
+		/**
+		* Sets the same collision factor to all the stored walkers
+		* @param delta Magnetization factor of a collision
+		*/
+		void Set_Delta(float delta);
+
+		/**
+		* @return Number of real walkers
+		*/
+		int Size() const;
+
+		/**
+		* @return Number of walkers including the padding, always a multiple of WALKER_LANES
+		*/
+		int Padded_Size() const;
+
+		/**
+		* @return Number of groups of WALKER_LANES walkers
+		*/
+		int Groups() const;
+
+		int* X();
+		int* Y();
+		int* Z();
+		int* Hits();
+		float* Energy();
+		float* Delta();
+		const int* Ids() const;
+		const float* Delta() const;
+		const int* Hits() const;
+		const float* Energy() const;
+	};
+
+	inline int WalkerStore::Size() const
+	{
+		return(this->_size);
+	}
+
+	inline int WalkerStore::Padded_Size() const
+	{
+		return(this->_paddedSize);
+	}
+
+	inline int WalkerStore::Groups() const
+	{
+		return(this->_paddedSize / WALKER_LANES);
+	}
+
+	inline int* WalkerStore::X()
+	{
+		return(this->_x.data());
+	}
+
+	inline int* WalkerStore::Y()
+	{
+		return(this->_y.data());
+	}
+
+	inline int* WalkerStore::Z()
+	{
+		return(this->_z.data());
+	}
+
+	inline int* WalkerStore::Hits()
+	{
+		return(this->_hits.data());
+	}
+
+	inline const int* WalkerStore::Hits() const
+	{
+		return(this->_hits.data());
+	}
+
+	inline float* WalkerStore::Energy()
+	{
+		return(this->_energy.data());
+	}
+
+	inline const float* WalkerStore::Energy() const
+	{
+		return(this->_energy.data());
+	}
+
+	inline float* WalkerStore::Delta()
+	{
+		return(this->_delta.data());
+	}
+
+	inline const float* WalkerStore::Delta() const
+	{
+		return(this->_delta.data());
+	}
+
+	inline const int* WalkerStore::Ids() const
+	{
+		return(this->_ids.data());
+	}
+}
+
+#endif
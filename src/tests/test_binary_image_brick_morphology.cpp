@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <atomic>
+#include <tbb/parallel_for.h>
+#include "rw/binary_image/binary_image_brick_morphology.h"
+#include "unit_tests.h"
+#include "test_images.h"
+
+namespace tests
+{
+	typedef rw::BinaryImageBrickMorphology::Brick Brick;
+
+	/**
+	* @return TRUE if a voxel is set in the brick masks of an image, FALSE if it is outside the image
+	*/
+	static bool Mask_Bit(const rw::Pos3i& size, const vec(Brick)& m, int x, int y, int z)
+	{
+		if ((x < 0) || (x >= size.x) || (y < 0) || (y >= size.y) || (z < 0) || (z >= size.z))
+		{
+			return(false);
+		}
+		int bx = (size.x >> 2) + 1;
+		int by = (size.y >> 2) + 1;
+		int k = (x >> 2) + (y >> 2)*bx + (z >> 2)*bx*by;
+		return(((m[k] >> ((x & 3) + ((y & 3) << 2) + ((z & 3) << 4))) & 0x01) != 0);
+	}
+
+	/**
+	* @return TRUE if a voxel is inside the image and belongs to a phase
+	*/
+	static bool Phase_Bit(const rw::BinaryImage& img, bool solid, int x, int y, int z)
+	{
+		if ((x < 0) || (x >= img.Width()) || (y < 0) || (y >= img.Height()) || (z < 0) || (z >= img.Depth()))
+		{
+			return(false);
+		}
+		rw::Pos3i p;
+		p.x = x;
+		p.y = y;
+		p.z = z;
+		return((img(p) != 0) == solid);
+	}
+
+	/**
+	* Checks Load, Dilate, Erode and Border against the morphology of the image voxel by voxel, for both phases
+	* @return Number of voxels where a phase, a dilation, an erosion or a border class differs from the voxel
+	* by voxel result, summed over the two phases
+	*/
+	static int Check_Morphology(const rw::BinaryImage& img)
+	{
+		rw::Pos3i size = Size(img);
+		rw::BinaryImageBrickMorphology morphology(size);
+		std::atomic<int> errors(0);
+		int plane = size.x*size.y;
+		for (int s = 0; s < 2; ++s)
+		{
+			bool solid = (s == 0);
+			vec(Brick) phase;
+			vec(Brick) dilated;
+			vec(Brick) eroded;
+			vec(int) corner;
+			vec(int) surface;
+			morphology.Load(img.Data(), solid, phase);
+			morphology.Dilate(phase, dilated);
+			morphology.Erode(phase, eroded);
+			morphology.Border(img.Data(), solid, corner, surface);
+			vec(uchar) border(plane*size.z, 0);
+			for (int k = 0; k < (int)surface.size(); ++k)
+			{
+				border[surface[k]] = border[surface[k]] + 1;
+			}
+			for (int k = 0; k < (int)corner.size(); ++k)
+			{
+				border[corner[k]] = border[corner[k]] + 2;
+			}
+			tbb::parallel_for(tbb::blocked_range<int>(0, size.z, 1), [&img, size, plane, solid, &phase, &dilated, &eroded, &border, &errors](const tbb::blocked_range<int>& b)
+			{
+				for (int z = b.begin(); z < b.end(); ++z)
+				{
+					for (int y = 0; y < size.y; ++y)
+					{
+						for (int x = 0; x < size.x; ++x)
+						{
+							bool any = false;
+							bool all = true;
+							for (int dz = -1; dz <= 1; ++dz)
+							{
+								for (int dy = -1; dy <= 1; ++dy)
+								{
+									for (int dx = -1; dx <= 1; ++dx)
+									{
+										any = any || Phase_Bit(img, solid, x + dx, y + dy, z + dz);
+										all = all && (!Phase_Bit(img, !solid, x + dx, y + dy, z + dz));
+									}
+								}
+							}
+							bool in = Phase_Bit(img, solid, x, y, z);
+							int expected = 0;
+							if (in && (!all))
+							{
+								bool cx = Phase_Bit(img, !solid, x - 1, y, z) || Phase_Bit(img, !solid, x + 1, y, z);
+								bool cy = Phase_Bit(img, !solid, x, y - 1, z) || Phase_Bit(img, !solid, x, y + 1, z);
+								bool cz = Phase_Bit(img, !solid, x, y, z - 1) || Phase_Bit(img, !solid, x, y, z + 1);
+								expected = (cx && cy && cz) ? 2 : 1;
+							}
+							if (Mask_Bit(size, phase, x, y, z) != in)
+							{
+								++errors;
+							}
+							if (Mask_Bit(size, dilated, x, y, z) != any)
+							{
+								++errors;
+							}
+							if (Mask_Bit(size, eroded, x, y, z) != (in && all))
+							{
+								++errors;
+							}
+							if ((int)border[z * plane + y * size.x + x] != expected)
+							{
+								++errors;
+							}
+						}
+					}
+				}
+			});
+		}
+		return(errors);
+	}
+
+	int Test_Morphology()
+	{
+		static const int Spheres[] = { 0, 40, 400, 4000 };
+		int errors = 0;
+		for (int k = 0; k < 4; ++k)
+		{
+			rw::BinaryImage img;
+			Random_Spheres(img, 37, 29, 45, Spheres[k], 51 + k);
+			int e = Check_Morphology(img);
+			if (e != 0)
+			{
+				printf("morphology: %d voxels differ, %d spheres\n", e, Spheres[k]);
+			}
+			errors = errors + e;
+		}
+		return(errors);
+	}
+}
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <algorithm>
+#include <limits>
+#include <atomic>
+#include <tbb/parallel_for.h>
+#include "rw/binary_image/binary_image_distance.h"
+#include "unit_tests.h"
+#include "test_images.h"
+
+namespace tests
+{
+	/**
+	* Searches the nearest solid voxel in cubic shells of growing radius. Every voxel of the shell r is at least
+	* r away, so the search ends once the nearest solid voxel found is not farther than the shell.
+	* @return Squared distance to the nearest solid voxel, not smaller than limit if there is none closer
+	*/
+	static int Nearest_Solid(const rw::BinaryImage& img, const rw::Pos3i& v, int limit)
+	{
+		int extent = std::max(img.Width(), std::max(img.Height(), img.Depth()));
+		int best = std::numeric_limits<int>::max();
+		for (int r = 0; (r <= extent) && (best > r*r) && (r*r < limit); ++r)
+		{
+			rw::Pos3i p;
+			for (p.z = std::max(v.z - r, 0); p.z <= std::min(v.z + r, img.Depth() - 1); ++p.z)
+			{
+				for (p.y = std::max(v.y - r, 0); p.y <= std::min(v.y + r, img.Height() - 1); ++p.y)
+				{
+					bool face = (abs(p.z - v.z) == r) || (abs(p.y - v.y) == r);
+					int step = (face) ? 1 : std::max(2 * r, 1);
+					for (p.x = v.x - r; p.x <= v.x + r; p.x = p.x + step)
+					{
+						if ((p.x >= 0) && (p.x < img.Width()) && img(p))
+						{
+							best = std::min(best, (p.x - v.x)*(p.x - v.x) + (p.y - v.y)*(p.y - v.y) + (p.z - v.z)*(p.z - v.z));
+						}
+					}
+				}
+			}
+		}
+		return(best);
+	}
+
+	/**
+	* @return The distance of a squared distance rounded down, saturated as in BinaryImage::Wall_Distance
+	*/
+	static int Wall_Distance(int d2)
+	{
+		int d = 0;
+		while ((d < 255) && ((d + 1)*(d + 1) <= d2))
+		{
+			++d;
+		}
+		return(d);
+	}
+
+	/**
+	* Checks every voxel of an image. Distances beyond the saturation of the rows only have to be saturated.
+	* @return Number of voxels whose distance, diameter or distance map entry differs from the brute force
+	*/
+	static int Check_Transform(const rw::BinaryImage& img)
+	{
+		rw::BinaryImageDistance distance;
+		distance.Execute(img);
+		const vec(uchar)& wall = img.Wall_Distance();
+		std::atomic<int> errors(0);
+		tbb::parallel_for(tbb::blocked_range<int>(0, Voxels(img), 64), [&img, &distance, &wall, &errors](const tbb::blocked_range<int>& b)
+		{
+			static const int Saturated = 255 * 255;
+			for (int i = b.begin(); i < b.end(); ++i)
+			{
+				rw::Pos3i v;
+				v.x = i % img.Width();
+				v.y = (i / img.Width()) % img.Height();
+				v.z = i / (img.Width()*img.Height());
+				int best = Nearest_Solid(img, v, Saturated);
+				uint d2 = distance.Square_Distance(i);
+				bool same = (best < Saturated) ? (d2 == (uint)best) : (d2 >= (uint)Saturated);
+				if (same)
+				{
+					int diam = 0;
+					for (int d = 1; d <= OPEN_MAX_DIAMETER; d = d + 2)
+					{
+						if ((int)d2 > rw::BinaryImageDistance::Erosion_Bound(d))
+						{
+							diam = d;
+						}
+					}
+					same = (distance.Diameter(i) == diam) && ((int)wall[i] == Wall_Distance((int)d2));
+				}
+				if (!same)
+				{
+					++errors;
+				}
+			}
+		});
+		return(errors);
+	}
+
+	int Test_Distance_Transform()
+	{
+		static const int Spheres[] = { 6, 40, 400 };
+		int errors = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			rw::BinaryImage img;
+			Random_Spheres(img, 37, 29, 45, Spheres[k], 11 + k);
+			int e = Check_Transform(img);
+			if (e != 0)
+			{
+				printf("distance transform: %d of %d voxels differ, %d spheres\n", e, Voxels(img), Spheres[k]);
+			}
+			errors = errors + e;
+		}
+		return(errors);
+	}
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <algorithm>
+#include <memory>
+#include "rw/binary_image/binary_image_pore_map.h"
+#include "rw/binary_image/binary_image_view.h"
+#include "unit_tests.h"
+#include "test_images.h"
+
+namespace tests
+{
+	/**
+	* Checks the index of an image against a linear scan: every pore voxel must have the number of pore voxels
+	* before it as its rank and be the voxel of that rank, and every solid voxel must have no rank
+	* @return Number of voxels whose rank or voxel differs from the scan, plus one if the number of pore voxels
+	* differs
+	*/
+	static int Check_Pore_Map(const rw::BinaryImage& img)
+	{
+		vec(uint) buffer;
+		Buffer(img, buffer);
+		rw::BinaryImagePoreMap pores;
+		pores.Build(buffer, Size(img));
+		int errors = 0;
+		int count = 0;
+		for (int i = 0; i < Voxels(img); ++i)
+		{
+			rw::Pos3i p;
+			rw::Pos3i::Int_To_Pos3i(i, img.Width(), img.Height(), img.Depth(), p);
+			if (img(p) == 0)
+			{
+				if ((pores.Rank(i) != count) || (count >= pores.Size()) || (pores.Voxel(count) != i))
+				{
+					++errors;
+				}
+				++count;
+			}
+			else if (pores.Rank(i) != -1)
+			{
+				++errors;
+			}
+		}
+		if (count != pores.Size())
+		{
+			++errors;
+		}
+		if (pores.Rank(Voxels(img) + 64) != -1)
+		{
+			++errors;
+		}
+		/**
+		* The walkers of a whole image are placed by the pore map and those of a section by the rank index of
+		* the view, which must select the same voxel for every rank
+		*/
+		rw::BinaryImageView view(std::make_shared<rw::BinaryImage>(img));
+		vec(uint) rows;
+		view.Pore_Rank_Index(rows);
+		if ((int)rows.back() != pores.Size())
+		{
+			++errors;
+		}
+		for (int r = 0; r < std::min((int)rows.back(), pores.Size()); ++r)
+		{
+			rw::Pos3i p = view.Pore_Voxel_Of_Rank(rows, (uint)r);
+			if (rw::Pos3i::Pos3i_To_Int(p, img.Width(), img.Height(), img.Depth()) != pores.Voxel(r))
+			{
+				++errors;
+			}
+		}
+		return(errors);
+	}
+
+	int Test_Pore_Map()
+	{
+		static const int Spheres[] = { 0, 40, 400, 4000 };
+		int errors = 0;
+		for (int k = 0; k < 4; ++k)
+		{
+			rw::BinaryImage img;
+			Random_Spheres(img, 37, 29, 45, Spheres[k], 21 + k);
+			int e = Check_Pore_Map(img);
+			if (e != 0)
+			{
+				printf("pore map: %d of %d voxels differ, %d spheres\n", e, Voxels(img), Spheres[k]);
+			}
+			errors = errors + e;
+		}
+		return(errors);
+	}
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <random>
+#include "rw/binary_image/binary_image.h"
+#include "unit_tests.h"
+#include "test_images.h"
+
+namespace tests
+{
+	/**
+	* @return Number of pore voxels inside a box, counted voxel by voxel
+	*/
+	static uint Count_Pores(const rw::BinaryImage& img, const rw::Pos3i& origin, const rw::Pos3i& box)
+	{
+		uint count = 0;
+		rw::Pos3i p;
+		for (p.z = origin.z; p.z < origin.z + box.z; ++p.z)
+		{
+			for (p.y = origin.y; p.y < origin.y + box.y; ++p.y)
+			{
+				for (p.x = origin.x; p.x < origin.x + box.x; ++p.x)
+				{
+					if (img(p) == 0)
+					{
+						++count;
+					}
+				}
+			}
+		}
+		return(count);
+	}
+
+	/**
+	* Checks the summed volume table of an image against a voxel by voxel count on random boxes, and on the
+	* whole image
+	* @return Number of boxes whose count differs
+	*/
+	static int Check_Pore_Sums(const rw::BinaryImage& img, int samples, uint seed)
+	{
+		img.Build_Pore_Sums();
+		rw::Pos3i size = Size(img);
+		rw::Pos3i zero;
+		int errors = (img.Pore_Voxels(zero, size) != Count_Pores(img, zero, size)) ? 1 : 0;
+		std::mt19937 rnd(seed);
+		for (int k = 0; k < samples; ++k)
+		{
+			rw::Pos3i origin;
+			rw::Pos3i box;
+			origin.x = std::uniform_int_distribution<int>(0, size.x - 1)(rnd);
+			origin.y = std::uniform_int_distribution<int>(0, size.y - 1)(rnd);
+			origin.z = std::uniform_int_distribution<int>(0, size.z - 1)(rnd);
+			box.x = std::uniform_int_distribution<int>(1, size.x - origin.x)(rnd);
+			box.y = std::uniform_int_distribution<int>(1, size.y - origin.y)(rnd);
+			box.z = std::uniform_int_distribution<int>(1, size.z - origin.z)(rnd);
+			if (img.Pore_Voxels(origin, box) != Count_Pores(img, origin, box))
+			{
+				++errors;
+			}
+		}
+		return(errors);
+	}
+
+	int Test_Pore_Sums()
+	{
+		static const int Spheres[] = { 0, 40, 400 };
+		int errors = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			rw::BinaryImage img;
+			Random_Spheres(img, 37, 29, 45, Spheres[k], 61 + k);
+			int e = Check_Pore_Sums(img, 512, 71 + k);
+			if (e != 0)
+			{
+				printf("pore sums: %d boxes differ, %d spheres\n", e, Spheres[k]);
+			}
+			errors = errors + e;
+		}
+		/**
+		* The denoiser writes the buffer of the image, so the table built before must not be kept
+		*/
+		rw::BinaryImage img;
+		Random_Spheres(img, 37, 29, 45, 200, 74);
+		img.Build_Pore_Sums();
+		img.Denoise(3);
+		int e = Check_Pore_Sums(img, 512, 75);
+		if (e != 0)
+		{
+			printf("pore sums: %d boxes differ after denoising\n", e);
+		}
+		errors = errors + e;
+		return(errors);
+	}
+}
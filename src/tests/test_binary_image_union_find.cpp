@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <vector>
+#include "rw/binary_image/binary_image_union_find.h"
+#include "unit_tests.h"
+#include "test_images.h"
+
+namespace tests
+{
+	/**
+	* Labels the pore space of an image and checks it against a serial flood fill through the face neighbors:
+	* the root of every pore voxel must be the smallest rank of its flood filled component
+	* @param same Connectivity of the face neighbors, as in rw::BinaryImageUnionFind::Label
+	* @return Number of pore voxels whose root differs from the flood fill
+	*/
+	template<class Same>
+	static int Check_Components(const rw::BinaryImagePoreMap& pores, const rw::Pos3i& size, const Same& same)
+	{
+		static const int dx[6] = { -1, 1, 0, 0, 0, 0 };
+		static const int dy[6] = { 0, 0, -1, 1, 0, 0 };
+		static const int dz[6] = { 0, 0, 0, 0, -1, 1 };
+		rw::BinaryImageUnionFind components;
+		components.Label(pores, size, same);
+		std::vector<int> label(pores.Size(), -1);
+		std::vector<int> queue;
+		int errors = 0;
+		for (int r = 0; r < pores.Size(); ++r)
+		{
+			if (label[r] < 0)
+			{
+				label[r] = r;
+				queue.assign(1, r);
+				while (!queue.empty())
+				{
+					int q = queue.back();
+					queue.pop_back();
+					rw::Pos3i pp;
+					rw::Pos3i::Int_To_Pos3i(pores.Voxel(q), size.x, size.y, size.z, pp);
+					for (int k = 0; k < 6; ++k)
+					{
+						rw::Pos3i pn;
+						pn.x = pp.x + dx[k];
+						pn.y = pp.y + dy[k];
+						pn.z = pp.z + dz[k];
+						if ((pn.x < 0) || (pn.x >= size.x) || (pn.y < 0) || (pn.y >= size.y) || (pn.z < 0) || (pn.z >= size.z))
+						{
+							continue;
+						}
+						int n = pores.Rank(rw::Pos3i::Pos3i_To_Int(pn, size.x, size.y, size.z));
+						if ((n >= 0) && (label[n] < 0) && (same(q, n)))
+						{
+							label[n] = r;
+							queue.push_back(n);
+						}
+					}
+				}
+			}
+			if (components.Root(r) != label[r])
+			{
+				++errors;
+			}
+		}
+		return(errors);
+	}
+
+	int Test_Pore_Components()
+	{
+		static const int Spheres[] = { 40, 150, 400 };
+		int errors = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			rw::BinaryImage img;
+			Random_Spheres(img, 37, 29, 45, Spheres[k], 31 + k);
+			vec(uint) buffer;
+			Buffer(img, buffer);
+			rw::BinaryImagePoreMap pores;
+			pores.Build(buffer, Size(img));
+			/**
+			* The pore space connected by faces, as Remove_Isolated_Pores labels it, and a connectivity that cuts
+			* it at every seventh voxel, as a clustering does
+			*/
+			int e = Check_Components(pores, Size(img), [](int ra, int rb) { return(true); });
+			e = e + Check_Components(pores, Size(img), [&pores](int ra, int rb) { return(((pores.Voxel(ra) % 7) != 0) && ((pores.Voxel(rb) % 7) != 0)); });
+			if (e != 0)
+			{
+				printf("pore components: %d of %d pore voxels differ, %d spheres\n", e, pores.Size(), Spheres[k]);
+			}
+			errors = errors + e;
+		}
+		return(errors);
+	}
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include "rw/binary_image/binary_image_watershed_clusterer.h"
+#include "unit_tests.h"
+#include "test_images.h"
+
+namespace tests
+{
+	/**
+	* Floods the whole image as a single slab, as a reference for the flooding by slabs
+	*/
+	class WaterShedReference : public rw::BinaryImageWaterShedClusterer
+	{
+	public:
+		WaterShedReference(rw::BinaryImageExecutor& executor) : rw::BinaryImageWaterShedClusterer(executor)
+		{
+		}
+
+		/**
+		* Segments the pore space as Execute, and checks the basins against the flooding of the whole image:
+		* every cluster must be the seed of a regional maximum, and every regional maximum a cluster. The voxels
+		* near the seams may fall in another basin, as the flooding of a slab does not see across the seams, so
+		* they are not compared.
+		* @return Number of clusters that are not seeds of the single slab flooding, plus the number of its
+		* seeds that are not clusters
+		*/
+		int Check()
+		{
+			this->Execute();
+			rw::BinaryImagePoreMap& pmap = this->Pore_Map();
+			vec(uchar) height;
+			this->Median(height);
+			vec(int) basin(pmap.Size(), -1);
+			this->Flood_Slab(0, this->Size_3D().z, height, basin);
+			vec(uchar) seed(pmap.Size(), 0);
+			for (int r = 0; r < pmap.Size(); ++r)
+			{
+				int sr = pmap.Rank(basin[r]);
+				int cr = pmap.Rank(pmap.Cluster(r));
+				if (sr >= 0)
+				{
+					seed[sr] = seed[sr] | 1;
+				}
+				if (cr >= 0)
+				{
+					seed[cr] = seed[cr] | 2;
+				}
+			}
+			int errors = 0;
+			for (int r = 0; r < pmap.Size(); ++r)
+			{
+				if ((seed[r] == 1) || (seed[r] == 2))
+				{
+					++errors;
+				}
+			}
+			return(errors);
+		}
+	};
+
+	int Test_Watershed()
+	{
+		static const int Spheres[] = { 40, 150, 400 };
+		int errors = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			rw::BinaryImage img;
+			Random_Spheres(img, 37, 29, 3 * WATERSHED_SLAB + 5, Spheres[k], 41 + k);
+			img.Open();
+			rw::BinaryImageExecutor state(&img);
+			WaterShedReference watershed(state);
+			int e = watershed.Check();
+			if (e != 0)
+			{
+				printf("watershed: %d basins differ from the single slab flooding, %d spheres\n", e, Spheres[k]);
+			}
+			errors = errors + e;
+		}
+		return(errors);
+	}
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <cmath>
+#include <memory>
+#include "rw/plug.h"
+#include "rw/sim_params.h"
+#include "rw/rw_cpu_degrade_impl.h"
+#include "unit_tests.h"
+#include "test_images.h"
+
+namespace tests
+{
+	/**
+	* Places the walkers of a plug with the seed of the paths, so that every plug placed with the same seed starts
+	* from the same positions
+	* @param plug Plug
+	* @param img Image of the plug
+	* @param delta Magnetization factor of a collision of every walker
+	* @param seed Seed of the positions and of the paths
+	*/
+	static void Place(rw::Plug& plug, const rw::BinaryImageHandle& img, scalar delta, uint seed)
+	{
+		plug.Set_Image_Formation(img);
+		plug.Set_Number_Of_Walking_Particles(1000);
+		plug.Set_TBulk_Time_Seconds(2.8);
+		plug.Set_Time_Step(1e-4);
+		plug.Set_Stop_Threshold(1e-3);
+		plug.Limit_Maximal_Number_Of_Iterations(6000);
+		plug.Set_Surface_Relaxivity_Delta(delta);
+		plug.Repeat_Walkers_Paths(true, seed);
+		plug.Place_Walking_Particles();
+	}
+
+	int Test_Collision_Trace()
+	{
+		const uint seed = 41;
+		std::shared_ptr<rw::BinaryImage> img = std::make_shared<rw::BinaryImage>();
+		Random_Spheres(*img, 37, 29, 23, 40, 31);
+
+		/**
+		* The trace is walked as the relaxivity optimizer does, without relaxation at the walls
+		*/
+		rw::Plug traced;
+		Place(traced, img, 1, seed);
+		rw::SimulationParams params(traced.Simulation_Parameters());
+		params.Set_Value(COLLISION_TRACE, 1);
+		traced.Set_Simulation_Parameter(params);
+		rw::RandomWalkCPUDegradeImplementor trace_walk(&traced);
+		trace_walk.Execute();
+		const scalar deltas[] = { 0.8, 0.9, 0.97 };
+		int errors = 0;
+		for (int relaxivity = 0; relaxivity < 3; ++relaxivity)
+		{
+			rw::Plug walked;
+			Place(walked, img, deltas[relaxivity], seed);
+			rw::RandomWalkCPUDegradeImplementor walk(&walked);
+			walk.Execute();
+			rw::Plug replayed;
+			Place(replayed, img, deltas[relaxivity], seed);
+			if (!replayed.Replay_Collision_Trace(traced.Collision_Trace()))
+			{
+				printf("collision_trace: relaxivity %d is not replayed\n", relaxivity);
+				++errors;
+				continue;
+			}
+			/**
+			* The walk checks its stop criterion once per block of steps, so its decay may go on after the replay
+			* stops
+			*/
+			uint steps = replayed.Decay_Size();
+			if ((steps == 0) || (steps > walked.Decay_Size()))
+			{
+				printf("collision_trace: relaxivity %d replays %u steps of a walk of %u\n", relaxivity, steps,
+					walked.Decay_Size());
+				++errors;
+				continue;
+			}
+			for (uint k = 0; k < steps; ++k)
+			{
+				scalar a = walked.Decay_Step_Value(k).Magnetization;
+				scalar b = replayed.Decay_Step_Value(k).Magnetization;
+				if (fabs(a - b) > 1e-5)
+				{
+					printf("collision_trace: relaxivity %d, step %u: walk %g, replay %g\n", relaxivity, k, (double)a, (double)b);
+					++errors;
+					break;
+				}
+			}
+		}
+		return(errors);
+	}
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "rw/exponential_fitting.h"
+#include "unit_tests.h"
+
+using math_la::math_lac::full::Matrix;
+using math_la::math_lac::full::Vector;
+
+namespace tests
+{
+	/**
+	* Inverts every decay of a batch alone and compares its distribution with the one of the batch
+	* @param decays Decay magnetizations, one per column
+	* @param times Time of every sample of the decays
+	* @return Number of decays whose distributions differ
+	*/
+	static int Check_Batch(const Matrix& decays, const vector<scalar>& times, int kernel_type, int inversion,
+		scalar lambda, bool normalize)
+	{
+		int n = decays.Rows();
+		int count = decays.Columns();
+		rw::ExponentialFitting fit;
+		vector<rw::Step_Value> values(n);
+		for (int i = 0; i < n; ++i)
+		{
+			values[i].Time = times[i];
+			values[i].Magnetization = decays(i, 0);
+		}
+		fit.Set_Kernel_Type(kernel_type);
+		fit.Normalize(normalize);
+		fit.Load_Decay(values);
+		fit.Kernel_T2_Mount(-3, 1, 64, lambda);
+		fit.Set_Inversion(inversion, 16);
+		Matrix bins;
+		Vector factors;
+		if (!fit.Solve_Batch(decays, bins, factors))
+		{
+			printf("batch_inversion: kernel %d, inversion %d, the batch is not solved\n", kernel_type, inversion);
+			return(count);
+		}
+		int errors = 0;
+		for (int c = 0; c < count; ++c)
+		{
+			rw::ExponentialFitting alone;
+			for (int i = 0; i < n; ++i)
+			{
+				values[i].Magnetization = decays(i, c);
+			}
+			alone.Set_Kernel_Type(kernel_type);
+			alone.Normalize(normalize);
+			alone.Load_Decay(values);
+			alone.Kernel_T2_Mount(-3, 1, 64, lambda);
+			alone.Set_Inversion(inversion, 16);
+			Vector domain;
+			Vector range;
+			alone.Solve(domain, range);
+			bool same = (range.Size() == bins.Rows()) && (fabs(factors(c) - alone.Laplace_Factor()) <=
+				1e-6*std::max((scalar)1, fabs(alone.Laplace_Factor())));
+			for (int j = 0; (same) && (j < bins.Rows()); ++j)
+			{
+				same = (fabs(bins(j, c) - range(j)) <= 1e-6*std::max((scalar)1, fabs(range(j))));
+			}
+			if (!same)
+			{
+				printf("batch_inversion: kernel %d, inversion %d, decay %d differs from the one inverted alone\n",
+					kernel_type, inversion, c);
+				++errors;
+			}
+		}
+		return(errors);
+	}
+
+	int Test_Batch_Inversion()
+	{
+		const int n = 200;
+		const int count = 24;
+		std::mt19937 rnd(29);
+		std::uniform_real_distribution<double> scales(0.5, 1.5);
+		std::normal_distribution<double> noise(0, 1e-3);
+		vector<scalar> times(n);
+		vector<scalar> decay(n);
+		for (int i = 0; i < n; ++i)
+		{
+			times[i] = (scalar)3 * (scalar)(i + 1) / (scalar)n;
+			decay[i] = (scalar)0.6*exp(-times[i] / (scalar)0.05) + (scalar)0.4*exp(-times[i] / (scalar)0.8);
+		}
+		int errors = 0;
+		for (int k = 0; k < 4; ++k)
+		{
+			int kernel_type = k / 2;
+			int inversion = (k % 2 == 0) ? rw::ExponentialFitting::NNLS_Inversion : rw::ExponentialFitting::BRD_Inversion;
+			scalar lambda = (k == 1 || k == 2) ? (scalar)0.05 : (scalar)0;
+			Matrix decays(n, count);
+			for (int c = 0; c < count; ++c)
+			{
+				scalar s = (scalar)scales(rnd);
+				for (int i = 0; i < n; ++i)
+				{
+					scalar v = s*decay[i] + (scalar)noise(rnd);
+					decays(i, c, (kernel_type == 0) ? (scalar)1 - (scalar)2 * v : v);
+				}
+			}
+			errors += Check_Batch(decays, times, kernel_type, inversion, lambda, (k % 2) == 1);
+		}
+		return(errors);
+	}
+}
@@ -0,0 +1,54 @@
+#include <random>
+#include "test_images.h"
+
+namespace tests
+{
+	void Random_Spheres(rw::BinaryImage& img, int width, int height, int depth, int spheres, uint seed)
+	{
+		img.Create(width, height, depth);
+		std::mt19937 rnd(seed);
+		std::uniform_int_distribution<int> x_uid(0, width - 1), y_uid(0, height - 1), z_uid(0, depth - 1), r_uid(2, 7);
+		for (int s = 0; s < spheres; ++s)
+		{
+			rw::Pos3i c;
+			c.x = x_uid(rnd);
+			c.y = y_uid(rnd);
+			c.z = z_uid(rnd);
+			int r = r_uid(rnd);
+			rw::Pos3i p;
+			for (p.z = std::max(c.z - r, 0); p.z <= std::min(c.z + r, depth - 1); ++p.z)
+			{
+				for (p.y = std::max(c.y - r, 0); p.y <= std::min(c.y + r, height - 1); ++p.y)
+				{
+					for (p.x = std::max(c.x - r, 0); p.x <= std::min(c.x + r, width - 1); ++p.x)
+					{
+						if ((p.x - c.x)*(p.x - c.x) + (p.y - c.y)*(p.y - c.y) + (p.z - c.z)*(p.z - c.z) <= r*r)
+						{
+							img(p, 1);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	int Voxels(const rw::BinaryImage& img)
+	{
+		return(img.Width()*img.Height()*img.Depth());
+	}
+
+	rw::Pos3i Size(const rw::BinaryImage& img)
+	{
+		rw::Pos3i size;
+		size.x = img.Width();
+		size.y = img.Height();
+		size.z = img.Depth();
+		return(size);
+	}
+
+	void Buffer(const rw::BinaryImage& img, vec(uint)& buffer)
+	{
+		int bricks = ((img.Width() >> 2) + 1)*((img.Height() >> 2) + 1)*((img.Depth() >> 2) + 1);
+		buffer.assign(img.Data(), img.Data() + 2 * bricks);
+	}
+}
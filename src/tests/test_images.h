@@ -0,0 +1,38 @@
+#ifndef TEST_IMAGES_H
+#define TEST_IMAGES_H
+
+#include "rw/binary_image/binary_image.h"
+
+namespace tests
+{
+	/**
+	* Creates an image of random overlapping solid spheres. The sizes are not multiples of the bricks, so the
+	* checks also walk the partial bricks of the borders.
+	* @param img Created image
+	* @param width Width of the image
+	* @param height Height of the image
+	* @param depth Depth of the image
+	* @param spheres Number of solid spheres
+	* @param seed Seed of the centers and radii
+	*/
+	void Random_Spheres(rw::BinaryImage& img, int width, int height, int depth, int spheres, uint seed);
+
+	/**
+	* @return Number of voxels of an image
+	*/
+	int Voxels(const rw::BinaryImage& img);
+
+	/**
+	* @return Size of an image
+	*/
+	rw::Pos3i Size(const rw::BinaryImage& img);
+
+	/**
+	* Copies the bricked buffer of an image (see rw::BinaryImage::Accesor_Read)
+	* @param img Image
+	* @param buffer Copy of its buffer
+	*/
+	void Buffer(const rw::BinaryImage& img, vec(uint)& buffer);
+}
+
+#endif
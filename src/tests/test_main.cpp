@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <string.h>
+#include "unit_tests.h"
+
+struct UnitTestEntry
+{
+	const char* name;
+	tests::UnitTest test;
+};
+
+static const UnitTestEntry Unit_Tests[] =
+{
+	{ "distance_transform", tests::Test_Distance_Transform },
+	{ "pore_map", tests::Test_Pore_Map },
+	{ "pore_components", tests::Test_Pore_Components },
+	{ "watershed", tests::Test_Watershed },
+	{ "morphology", tests::Test_Morphology },
+	{ "pore_sums", tests::Test_Pore_Sums },
+	{ "profile_sequence", tests::Test_Profile_Sequence },
+	{ "nnls", tests::Test_NNLS },
+	{ "batch_inversion", tests::Test_Batch_Inversion },
+	{ "collision_trace", tests::Test_Collision_Trace },
+};
+
+/**
+* Runs every check, or the ones whose name contains one of the arguments
+* @return Number of checks that fail
+*/
+int main(int argc, char** argv)
+{
+	int failed = 0;
+	int run = 0;
+	for (const UnitTestEntry& entry : Unit_Tests)
+	{
+		bool selected = (argc < 2);
+		for (int a = 1; a < argc; ++a)
+		{
+			selected = selected || (strstr(entry.name, argv[a]) != 0);
+		}
+		if (!selected)
+		{
+			continue;
+		}
+		++run;
+		int errors = entry.test();
+		printf("%-24s %s", entry.name, (errors == 0) ? "passed\n" : "FAILED");
+		if (errors != 0)
+		{
+			printf(" (%d)\n", errors);
+			++failed;
+		}
+	}
+	printf("%d of %d checks passed\n", run - failed, run);
+	return(failed);
+}
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include "math_la/math_lac/full/matrix.h"
+#include "math_la/math_lac/full/vector.h"
+#include "math_la/math_lac/full/nnls_solver.h"
+#include "unit_tests.h"
+
+using math_la::math_lac::full::Matrix;
+using math_la::math_lac::full::Vector;
+using math_la::math_lac::full::NNLSSolver;
+
+namespace tests
+{
+	/**
+	* @return Residual y - A x
+	*/
+	static Vector Residual(const Matrix& A, const Vector& y, const Vector& x)
+	{
+		Vector r(A.Rows());
+		for (int i = 0; i < A.Rows(); ++i)
+		{
+			scalar s = y(i);
+			for (int j = 0; j < A.Columns(); ++j)
+			{
+				s = s - A(i, j)*x(j);
+			}
+			r(i, s);
+		}
+		return(r);
+	}
+
+	/**
+	* Counts the indexes at which a solution fails the KKT conditions: x >= 0, w = A'(y - A x) <= 0, and w = 0
+	* where x > 0
+	* @param tolerance Tolerance on the gradient w
+	* @return Number of indexes that fail
+	*/
+	static int KKT_Violations(const Matrix& A, const Vector& y, const Vector& x, scalar tolerance)
+	{
+		Vector r = Residual(A, y, x);
+		int violations = 0;
+		for (int j = 0; j < A.Columns(); ++j)
+		{
+			scalar w = 0;
+			for (int i = 0; i < A.Rows(); ++i)
+			{
+				w = w + A(i, j)*r(i);
+			}
+			if ((x(j) < 0) || (w > tolerance) || ((x(j) > 0) && (w < -tolerance)))
+			{
+				++violations;
+			}
+		}
+		return(violations);
+	}
+
+	/**
+	* Builds a decay sampled on [0, 3] with T2 bins from 1e-3 to 10, of two nonnegative peaks plus 1% of noise
+	*/
+	static void T2_Problem(Matrix& A, Vector& y, std::mt19937& rnd)
+	{
+		std::normal_distribution<double> gauss(0, 1);
+		std::uniform_real_distribution<double> uniform(0, 1);
+		int rows = A.Rows();
+		int cols = A.Columns();
+		Vector x(cols);
+		for (int j = 0; j < cols; ++j)
+		{
+			x(j, (scalar)0);
+		}
+		for (int peak = 0; peak < 2; ++peak)
+		{
+			int c = std::min((int)(uniform(rnd)*(double)cols), cols - 1);
+			x(c, x(c) + uniform(rnd));
+		}
+		for (int i = 0; i < rows; ++i)
+		{
+			scalar t = (scalar)3 * (scalar)(i + 1) / (scalar)rows;
+			scalar s = 0;
+			for (int j = 0; j < cols; ++j)
+			{
+				scalar T2 = pow((scalar)10, (scalar)-3 + (scalar)4 * (scalar)j / (scalar)(cols - 1));
+				A(i, j, exp(-t / T2));
+				s = s + A(i, j)*x(j);
+			}
+			y(i, s + (scalar)0.01*(scalar)gauss(rnd));
+		}
+	}
+
+	int Test_NNLS()
+	{
+		const int problems = 64;
+		const int rows = 256;
+		const int cols = 64;
+		std::mt19937 rnd(23);
+		std::normal_distribution<double> gauss(0, 1);
+		NNLSSolver solver;
+		int errors = 0;
+		for (int p = 0; p < problems; ++p)
+		{
+			Matrix A(rows, cols);
+			Vector y(rows);
+			if (p % 2 == 0)
+			{
+				T2_Problem(A, y, rnd);
+			}
+			else
+			{
+				for (int i = 0; i < rows; ++i)
+				{
+					for (int j = 0; j < cols; ++j)
+					{
+						A(i, j, (scalar)gauss(rnd));
+					}
+					y(i, (scalar)gauss(rnd));
+				}
+			}
+			solver.Set_Matrix(A);
+			Vector x;
+			solver.Solve(y, x);
+			Vector reference = Matrix::NNLS_Iterative(A, y);
+			scalar scale = 0;
+			for (int j = 0; j < cols; ++j)
+			{
+				scalar c = 0;
+				for (int i = 0; i < rows; ++i)
+				{
+					c = c + A(i, j)*A(i, j);
+				}
+				scale = std::max(scale, c);
+			}
+			scale = sqrt(scale)*y.Norm();
+			if (x.Size() != cols)
+			{
+				printf("nnls: problem %d has %d unknowns instead of %d\n", p, x.Size(), cols);
+				++errors;
+				continue;
+			}
+			int violations = KKT_Violations(A, y, x, (scalar)1e-8*scale);
+			scalar residual = Residual(A, y, x).Norm();
+			scalar limit = Residual(A, y, reference).Norm()*((scalar)1 + (scalar)1e-6) + (scalar)1e-9*y.Norm();
+			if ((violations > 0) || (residual > limit))
+			{
+				printf("nnls: problem %d fails %d KKT conditions, residual %g against %g\n", p, violations,
+					(double)residual, (double)limit);
+				++errors;
+			}
+		}
+		return(errors);
+	}
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include "rw/profile_sequence.h"
+#include "unit_tests.h"
+
+namespace tests
+{
+	/**
+	* @return Half the quantization step of a profile, with room for the rounding of the step itself
+	*/
+	static double Tolerance(const std::vector<scalar>& profile)
+	{
+		double top = 0;
+		for (int i = 0; i < (int)profile.size(); ++i)
+		{
+			top = std::max(top, std::fabs((double)profile[i]));
+		}
+		return(0.5*top / (double)(1 << PROFILE_SEQUENCE_BITS) * (1.0 + 1e-9));
+	}
+
+	int Test_Profile_Sequence()
+	{
+		static const int Profiles = 1024;
+		static const char* Filename = "test_profile_sequence.bin";
+		std::mt19937 rnd(19);
+		std::uniform_int_distribution<int> sizes(0, 256);
+		std::uniform_int_distribution<int> scales(-6, 6);
+		std::uniform_real_distribution<double> values(0, 1);
+		std::vector<std::vector<scalar> > pushed(Profiles);
+		rw::ProfileSequence sequence;
+		for (int k = 0; k < Profiles; ++k)
+		{
+			double scale = pow(10.0, (double)scales(rnd));
+			pushed[k].resize(sizes(rnd));
+			for (int i = 0; i < (int)pushed[k].size(); ++i)
+			{
+				pushed[k][i] = (k % 8 == 0) ? (scalar)0 : (scalar)(values(rnd)*scale);
+			}
+			std::sort(pushed[k].begin(), pushed[k].end(), [](scalar a, scalar b) { return(a > b); });
+			sequence.Push(pushed[k]);
+		}
+		file::Binary output(WRITE);
+		if (!output.Open(Filename))
+		{
+			printf("profile sequence: %s cannot be written\n", Filename);
+			return(1);
+		}
+		sequence.Write(output);
+		output.Close();
+		rw::ProfileSequence loaded;
+		file::Binary input(READ);
+		if (!input.Open(Filename))
+		{
+			printf("profile sequence: %s cannot be read\n", Filename);
+			return(1);
+		}
+		loaded.Read(input);
+		input.Close();
+		remove(Filename);
+		if ((sequence.Size() != Profiles) || (loaded.Size() != Profiles))
+		{
+			printf("profile sequence: %d profiles coded and %d read, of %d\n", sequence.Size(), loaded.Size(), Profiles);
+			return(Profiles);
+		}
+		int errors = 0;
+		std::vector<scalar> decoded;
+		std::vector<scalar> reloaded;
+		for (int k = 0; k < Profiles; ++k)
+		{
+			sequence.Decode(k, decoded);
+			loaded.Decode(k, reloaded);
+			if ((decoded.size() != pushed[k].size()) || (reloaded.size() != pushed[k].size()))
+			{
+				errors = errors + (int)pushed[k].size();
+				continue;
+			}
+			double tolerance = Tolerance(pushed[k]);
+			for (int i = 0; i < (int)pushed[k].size(); ++i)
+			{
+				if ((std::fabs((double)decoded[i] - (double)pushed[k][i]) > tolerance) || (decoded[i] != reloaded[i]))
+				{
+					++errors;
+				}
+			}
+		}
+		if (errors != 0)
+		{
+			printf("profile sequence: %d values differ after coding or after the file round trip\n", errors);
+		}
+		return(errors);
+	}
+}
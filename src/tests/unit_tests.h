@@ -0,0 +1,78 @@
+#ifndef UNIT_TESTS_H
+#define UNIT_TESTS_H
+
+#include "math_la/mdefs.h"
+
+/**
+* Checks of the library against brute force references. They are built in their own console target, so the
+* application does not carry them. Every check prints the cases that fail and returns their number.
+*/
+namespace tests
+{
+	/**
+	* A check, returning the number of failed cases
+	*/
+	typedef int(*UnitTest)();
+
+	/**
+	* Compares the distance transform, the largest diameters and the distance map of the image with a brute
+	* force search of the nearest solid voxel (see rw::BinaryImageDistance)
+	*/
+	int Test_Distance_Transform();
+
+	/**
+	* Compares the ranks of the pore voxels with a linear scan of the image and with the rank index of a view
+	* (see rw::BinaryImagePoreMap)
+	*/
+	int Test_Pore_Map();
+
+	/**
+	* Compares the union-find labelling of the pore space with a serial flood fill (see
+	* rw::BinaryImageUnionFind)
+	*/
+	int Test_Pore_Components();
+
+	/**
+	* Compares the basins of the watershed flooded by slabs with the flooding of the whole image (see
+	* rw::BinaryImageWaterShedClusterer)
+	*/
+	int Test_Watershed();
+
+	/**
+	* Compares the brick dilation, erosion and border with the morphology voxel by voxel (see
+	* rw::BinaryImageBrickMorphology)
+	*/
+	int Test_Morphology();
+
+	/**
+	* Compares the porosity of sub-volumes with a voxel by voxel count (see rw::BinaryImagePoreSums)
+	*/
+	int Test_Pore_Sums();
+
+	/**
+	* Codes random decreasing profiles, and compares them with the decoded ones and with the ones read back
+	* from a file (see rw::ProfileSequence)
+	*/
+	int Test_Profile_Sequence();
+
+	/**
+	* Solves T2 kernels and Gaussian problems, and checks the KKT conditions of the solutions and their
+	* residual against the iterative solver (see math_la::math_lac::full::NNLSSolver)
+	*/
+	int Test_NNLS();
+
+	/**
+	* Inverts perturbed decays as a batch, and compares the distributions with the ones of the decays inverted
+	* alone (see rw::ExponentialFitting::Solve_Batch)
+	*/
+	int Test_Batch_Inversion();
+
+	/**
+	* Replays the collision trace of a walk without relaxation at the walls for several relaxivities of the
+	* walkers, and compares the decays with the ones of full walks with the same seed (see
+	* rw::Plug::Replay_Collision_Trace)
+	*/
+	int Test_Collision_Trace();
+}
+
+#endif